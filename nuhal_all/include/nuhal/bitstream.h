@@ -0,0 +1,98 @@
+#ifndef NUHAL_BITSTREAM_H_INCLUDE_GUARD
+#define NUHAL_BITSTREAM_H_INCLUDE_GUARD
+/// @file
+/// @brief Pack fields of 1 to 32 bits into a bytestream.
+///
+/// Flags and small enumerations waste most of a byte when each one is sent
+/// with bytestream_inject_u8. A bitstream packs them together, most
+/// significant bit first, on top of a bytestream:
+///
+///     struct bitstream bits;
+///     bitstream_init(&bits, bs);
+///     bitstream_put_bool(&bits, enabled);
+///     bitstream_put(&bits, mode, 3);
+///     bitstream_flush(&bits);
+///     bytestream_inject_f(bs, setpoint);
+///
+/// Bits are gathered in an accumulator and written to the bytestream in
+/// whole bytes, so the bytestream must not be used directly while a
+/// bitstream is writing to it until bitstream_flush pads the last byte with
+/// zeros. Likewise, a reader calls bitstream_align to skip the padding
+/// before reading from the bytestream again. The reader only consumes the
+/// bytes that hold the fields it reads.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nuhal/bytestream.h"
+
+/// @brief A stream of bits stored in a bytestream
+struct bitstream
+{
+    /// The bytestream holding the bits
+    struct bytestream * bs;
+
+    /// \cond implementation detail
+    // bits that have been written but not stored, or loaded but not read,
+    // in the least significant bits
+    uint64_t accumulator;
+
+    // the number of bits in the accumulator
+    unsigned int count;
+    /// \endcond
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief start reading or writing bits at the current position of a
+/// bytestream
+/// @param out - the bitstream to initialize
+/// @param bs - the bytestream
+void bitstream_init(struct bitstream * out, struct bytestream * bs);
+
+/// @brief place a field into the bitstream
+/// @param bits - the bitstream
+/// @param value - the value of the field, which must fit in width bits
+/// @param width - the number of bits in the field, from 1 to 32
+void bitstream_put(struct bitstream * bits, uint32_t value, unsigned int width);
+
+/// @brief get a field from the bitstream
+/// @param bits - the bitstream
+/// @param width - the number of bits in the field, from 1 to 32
+/// @return the value of the field
+uint32_t bitstream_get(struct bitstream * bits, unsigned int width);
+
+/// @brief place a single bit into the bitstream
+/// @param bits - the bitstream
+/// @param flag - the bit
+void bitstream_put_bool(struct bitstream * bits, bool flag);
+
+/// @brief get a single bit from the bitstream
+/// @param bits - the bitstream
+/// @return the bit
+bool bitstream_get_bool(struct bitstream * bits);
+
+/// @brief write the remaining bits to the bytestream, padding the last
+/// byte with zeros, so that the bytestream can be written directly
+/// @param bits - the bitstream
+void bitstream_flush(struct bitstream * bits);
+
+/// @brief skip the rest of the current byte, so that the bytestream can be
+/// read directly
+/// @param bits - the bitstream
+void bitstream_align(struct bitstream * bits);
+
+/// @brief the number of bytes needed to hold a number of bits
+/// @param count - the number of bits
+/// @return the number of bytes
+static inline size_t bitstream_bytes(size_t count)
+{
+    return (count + 7u) / 8u;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
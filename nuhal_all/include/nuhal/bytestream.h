@@ -6,10 +6,20 @@
 /// This file provides the basic framework for serialization and
 /// methods to serialize built-in types. User should add their
 /// own extraction and injection functions for custom types.
+///
+/// Each inject/extract function checks that the stream has room for its
+/// data. Types with a fixed size can instead check once, with
+/// bytestream_reserve, and then use the unchecked bytestream_put and
+/// bytestream_get functions on the returned cursor:
+///
+///     uint8_t * cursor = bytestream_reserve(bs, 2*sizeof(float));
+///     bytestream_put_f(&cursor, x);
+///     bytestream_put_f(&cursor, y);
 
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
 
 /// @brief Data for bytestream serialization functions.
 ///
@@ -29,6 +39,17 @@ struct bytestream
     size_t size;
 };
 
+/// @brief Bytes in the buffer of a bytestream, which are read in place
+/// rather than copied. A view is only valid while the buffer is
+struct bytestream_view
+{
+    /// The first byte
+    const uint8_t * data;
+
+    /// The number of bytes
+    size_t len;
+};
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -115,6 +136,308 @@ void bytestream_inject_u8_array(struct bytestream * bs,
                                 const uint8_t bytes[],
                                 size_t len);
 
+/// @brief extract an array of bytes from a bytestream
+/// @param bs - the bytestream, which should hold at least len bytes
+/// @param bytes [out] - the bytes extracted from the stream
+/// @param len - the number of bytes to extract
+void bytestream_extract_u8_array(struct bytestream * bs,
+                                 uint8_t bytes[],
+                                 size_t len);
+
+/// @brief extract bytes from a bytestream without copying them
+/// @param bs - the bytestream, which should hold at least len bytes
+/// @param len - the number of bytes to extract
+/// @return a view of the bytes in the buffer of the bytestream
+struct bytestream_view bytestream_extract_view(struct bytestream * bs, size_t len);
+
+/// @brief extract a string from a bytestream without copying it
+/// @param bs - the bytestream, which should contain characters followed
+/// by a null character
+/// @return a view of the string in the buffer of the bytestream. data
+/// points to the null terminated string, and len does not include the
+/// null character
+/// @post it is an error if the end of the stream is reached without a null
+/// character
+struct bytestream_view bytestream_extract_string_view(struct bytestream * bs);
+
+/// @brief inject an array of uint16_t into a bytestream. The result is the
+/// same as calling bytestream_inject_u16 on each element, but faster
+/// @param bs - the bytestream, which should have room for the array
+/// @param u16 - the values to inject
+/// @param len - the number of values
+void bytestream_inject_u16_array(struct bytestream * bs,
+                                 const uint16_t u16[],
+                                 size_t len);
+
+/// @brief extract an array of uint16_t from a bytestream
+/// @param bs - the bytestream, which should hold the array
+/// @param u16 [out] - the values extracted from the stream
+/// @param len - the number of values
+void bytestream_extract_u16_array(struct bytestream * bs,
+                                  uint16_t u16[],
+                                  size_t len);
+
+/// @brief inject an array of uint32_t into a bytestream. The result is the
+/// same as calling bytestream_inject_u32 on each element, but faster
+/// @param bs - the bytestream, which should have room for the array
+/// @param u32 - the values to inject
+/// @param len - the number of values
+void bytestream_inject_u32_array(struct bytestream * bs,
+                                 const uint32_t u32[],
+                                 size_t len);
+
+/// @brief extract an array of uint32_t from a bytestream
+/// @param bs - the bytestream, which should hold the array
+/// @param u32 [out] - the values extracted from the stream
+/// @param len - the number of values
+void bytestream_extract_u32_array(struct bytestream * bs,
+                                  uint32_t u32[],
+                                  size_t len);
+
+/// @brief inject an array of floats into a bytestream. The result is the
+/// same as calling bytestream_inject_f on each element, but faster
+/// @param bs - the bytestream, which should have room for the array
+/// @param f - the values to inject
+/// @param len - the number of values
+void bytestream_inject_f_array(struct bytestream * bs,
+                               const float f[],
+                               size_t len);
+
+/// @brief extract an array of floats from a bytestream
+/// @param bs - the bytestream, which should hold the array
+/// @param f [out] - the values extracted from the stream
+/// @param len - the number of values
+void bytestream_extract_f_array(struct bytestream * bs,
+                                float f[],
+                                size_t len);
+
+/// @brief convert a float to IEEE 754 half precision, rounding to nearest.
+/// Values too large for half precision become infinity
+/// @param f - the float
+/// @return the bits of the half precision value
+uint16_t bytestream_f32_to_f16(float f);
+
+/// @brief convert an IEEE 754 half precision value to a float, exactly
+/// @param f16 - the bits of the half precision value
+/// @return the float
+float bytestream_f16_to_f32(uint16_t f16);
+
+/// @brief place a float into the bytestream in IEEE 754 half precision,
+/// which has 11 significant bits and a largest value of 65504
+/// @param bs - the bytestream, which will be advanced by two bytes
+/// @param f - the data to place in the stream
+void bytestream_inject_f16(struct bytestream * bs, float f);
+
+/// @brief get a half precision float from the bytestream
+/// @param bs - the bytestream, which will be advanced by two bytes
+/// @return the value
+float bytestream_extract_f16(struct bytestream * bs);
+
+/// @brief place a float in [-range, range] into the bytestream as a signed
+/// 16-bit fraction of the range, with a resolution of range/32767.
+/// Values outside of the range are saturated, and NaN becomes 0
+/// @param bs - the bytestream, which will be advanced by two bytes
+/// @param f - the data to place in the stream
+/// @param range - the largest magnitude of the value, which must be positive
+void bytestream_inject_q15(struct bytestream * bs, float f, float range);
+
+/// @brief get a float from a signed 16-bit fraction of a range
+/// @param bs - the bytestream, which will be advanced by two bytes
+/// @param range - the range used when the value was injected
+/// @return the value
+float bytestream_extract_q15(struct bytestream * bs, float range);
+
+/// @brief place a float in [0, range] into the bytestream as an unsigned
+/// 16-bit fraction of the range, with a resolution of range/65535.
+/// Values outside of the range are saturated, and NaN becomes 0
+/// @param bs - the bytestream, which will be advanced by two bytes
+/// @param f - the data to place in the stream
+/// @param range - the largest value, which must be positive
+void bytestream_inject_q16(struct bytestream * bs, float f, float range);
+
+/// @brief get a float from an unsigned 16-bit fraction of a range
+/// @param bs - the bytestream, which will be advanced by two bytes
+/// @param range - the range used when the value was injected
+/// @return the value
+float bytestream_extract_q16(struct bytestream * bs, float range);
+
+/// @brief the most bytes used by a varint
+#define BYTESTREAM_VARINT_MAX_BYTES 5u
+
+/// @brief place a uint32_t into the bytestream as a LEB128 varint: seven bits
+/// per byte, least significant first, with the high bit of each byte set if
+/// another byte follows. Small values use fewer bytes (0-127 use one)
+/// @param bs - the bytestream, which will be advanced by 1 to 5 bytes
+/// @param u32 - the data to place in the stream
+void bytestream_inject_varint(struct bytestream * bs, uint32_t u32);
+
+/// @brief get a LEB128 varint from the bytestream
+/// @param bs - the bytestream, which will be advanced by 1 to 5 bytes
+/// @return the value
+/// @post it is an error if the varint is longer than five bytes, does not
+/// fit in a uint32_t, or runs past the end of the stream
+uint32_t bytestream_extract_varint(struct bytestream * bs);
+
+/// @brief place an int32_t into the bytestream as a zigzag-encoded varint,
+/// so that values close to zero (positive or negative) use fewer bytes
+/// @param bs - the bytestream, which will be advanced by 1 to 5 bytes
+/// @param i32 - the data to place in the stream
+void bytestream_inject_zigzag(struct bytestream * bs, int32_t i32);
+
+/// @brief get a zigzag-encoded varint from the bytestream
+/// @param bs - the bytestream, which will be advanced by 1 to 5 bytes
+/// @return the value
+int32_t bytestream_extract_zigzag(struct bytestream * bs);
+
+/// @brief the number of bytes used by a varint
+/// @param u32 - the value
+/// @return the number of bytes, from 1 to BYTESTREAM_VARINT_MAX_BYTES
+size_t bytestream_varint_size(uint32_t u32);
+
+/// @brief map a signed value to an unsigned value, so that values close to
+/// zero map to small values: 0, -1, 1, -2, 2 map to 0, 1, 2, 3, 4
+/// @param i32 - the signed value
+/// @return the unsigned value
+static inline uint32_t bytestream_zigzag_encode(int32_t i32)
+{
+    // the arithmetic shift spreads the sign bit to every bit
+    return ((uint32_t)i32 << 1) ^ (uint32_t)(-(int32_t)((uint32_t)i32 >> 31));
+}
+
+/// @brief undo bytestream_zigzag_encode
+/// @param u32 - the unsigned value
+/// @return the signed value
+static inline int32_t bytestream_zigzag_decode(uint32_t u32)
+{
+    return (int32_t)((u32 >> 1) ^ (uint32_t)(-(int32_t)(u32 & 1u)));
+}
+
+/// @brief check that a bytestream has room for len bytes and advance past them
+/// @param bs - the bytestream
+/// @param len - the number of bytes to reserve
+/// @return a cursor to the first reserved byte, for use with the
+/// bytestream_put and bytestream_get functions, which must not access more
+/// than len bytes
+uint8_t * bytestream_reserve(struct bytestream * bs, size_t len);
+
+/// @brief write a byte at a cursor without checking for room
+/// @param cursor [in/out] - the cursor, which will be advanced by one byte
+/// @param u8 - the byte to write
+static inline void bytestream_put_u8(uint8_t ** cursor, uint8_t u8)
+{
+    (*cursor)[0] = u8;
+    *cursor += sizeof(u8);
+}
+
+/// @brief write a uint16_t at a cursor without checking for room
+/// @param cursor [in/out] - the cursor, which will be advanced by two bytes
+/// @param u16 - the data to write, in the same format as bytestream_inject_u16
+static inline void bytestream_put_u16(uint8_t ** cursor, uint16_t u16)
+{
+    (*cursor)[0] = (uint8_t)(u16 >> 8);
+    (*cursor)[1] = (uint8_t)u16;
+    *cursor += sizeof(u16);
+}
+
+/// @brief write a uint32_t at a cursor without checking for room
+/// @param cursor [in/out] - the cursor, which will be advanced by four bytes
+/// @param u32 - the data to write, in the same format as bytestream_inject_u32
+static inline void bytestream_put_u32(uint8_t ** cursor, uint32_t u32)
+{
+    (*cursor)[0] = (uint8_t)(u32 >> 24);
+    (*cursor)[1] = (uint8_t)(u32 >> 16);
+    (*cursor)[2] = (uint8_t)(u32 >> 8);
+    (*cursor)[3] = (uint8_t)u32;
+    *cursor += sizeof(u32);
+}
+
+/// @brief write an int32_t at a cursor without checking for room
+/// @param cursor [in/out] - the cursor, which will be advanced by four bytes
+/// @param i32 - the data to write
+static inline void bytestream_put_i32(uint8_t ** cursor, int32_t i32)
+{
+    bytestream_put_u32(cursor, (uint32_t)i32);
+}
+
+/// @brief write a float at a cursor without checking for room
+/// @param cursor [in/out] - the cursor, which will be advanced by four bytes
+/// @param f - the data to write
+static inline void bytestream_put_f(uint8_t ** cursor, float f)
+{
+    uint32_t float_as_u32 = 0u;
+    memcpy(&float_as_u32, &f, sizeof(float_as_u32));
+    bytestream_put_u32(cursor, float_as_u32);
+}
+
+/// @brief write a half precision float at a cursor without checking for room
+/// @param cursor [in/out] - the cursor, which will be advanced by two bytes
+/// @param f - the data to write
+static inline void bytestream_put_f16(uint8_t ** cursor, float f)
+{
+    bytestream_put_u16(cursor, bytestream_f32_to_f16(f));
+}
+
+/// @brief read a byte at a cursor without checking for room
+/// @param cursor [in/out] - the cursor, which will be advanced by one byte
+/// @return the byte
+static inline uint8_t bytestream_get_u8(uint8_t ** cursor)
+{
+    const uint8_t res = (*cursor)[0];
+    *cursor += sizeof(res);
+    return res;
+}
+
+/// @brief read a uint16_t at a cursor without checking for room
+/// @param cursor [in/out] - the cursor, which will be advanced by two bytes
+/// @return the data
+static inline uint16_t bytestream_get_u16(uint8_t ** cursor)
+{
+    const uint16_t res = (uint16_t)(((uint16_t)(*cursor)[0] << 8) | (*cursor)[1]);
+    *cursor += sizeof(res);
+    return res;
+}
+
+/// @brief read a uint32_t at a cursor without checking for room
+/// @param cursor [in/out] - the cursor, which will be advanced by four bytes
+/// @return the data
+static inline uint32_t bytestream_get_u32(uint8_t ** cursor)
+{
+    const uint32_t res =
+        ((uint32_t)(*cursor)[0] << 24)
+        | ((uint32_t)(*cursor)[1] << 16)
+        | ((uint32_t)(*cursor)[2] << 8)
+        | (uint32_t)(*cursor)[3];
+    *cursor += sizeof(res);
+    return res;
+}
+
+/// @brief read an int32_t at a cursor without checking for room
+/// @param cursor [in/out] - the cursor, which will be advanced by four bytes
+/// @return the data
+static inline int32_t bytestream_get_i32(uint8_t ** cursor)
+{
+    return (int32_t)bytestream_get_u32(cursor);
+}
+
+/// @brief read a half precision float at a cursor without checking for room
+/// @param cursor [in/out] - the cursor, which will be advanced by two bytes
+/// @return the data
+static inline float bytestream_get_f16(uint8_t ** cursor)
+{
+    return bytestream_f16_to_f32(bytestream_get_u16(cursor));
+}
+
+/// @brief read a float at a cursor without checking for room
+/// @param cursor [in/out] - the cursor, which will be advanced by four bytes
+/// @return the data
+static inline float bytestream_get_f(uint8_t ** cursor)
+{
+    const uint32_t float_as_u32 = bytestream_get_u32(cursor);
+    float float_as_float = 0.0f;
+    memcpy(&float_as_float, &float_as_u32, sizeof(float_as_float));
+    return float_as_float;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -98,6 +98,40 @@ struct encoder_gimbal
     float z_radians;
 };
 
+/// @brief the serialized fields of encoder_joints (@see serialize.h)
+#define ENCODER_JOINTS_FIELDS(X) \
+    X(i32, before_ticks)         \
+    X(f, before_radians)         \
+    X(i32, after_ticks)          \
+    X(f, after_radians)
+
+/// @brief the serialized fields of encoder_joints, with the angles in half
+/// precision (@see serialize.h)
+#define ENCODER_JOINTS_F16_FIELDS(X) \
+    X(i32, before_ticks)             \
+    X(f16, before_radians)           \
+    X(i32, after_ticks)              \
+    X(f16, after_radians)
+
+/// @brief the serialized fields of encoder_gimbal (@see serialize.h)
+#define ENCODER_GIMBAL_FIELDS(X) \
+    X(i32, x_ticks)              \
+    X(i32, y_ticks)              \
+    X(i32, z_ticks)              \
+    X(f, x_radians)              \
+    X(f, y_radians)              \
+    X(f, z_radians)
+
+/// @brief the serialized fields of encoder_gimbal, with the angles in half
+/// precision (@see serialize.h)
+#define ENCODER_GIMBAL_F16_FIELDS(X) \
+    X(i32, x_ticks)                  \
+    X(i32, y_ticks)                  \
+    X(i32, z_ticks)                  \
+    X(f16, x_radians)                \
+    X(f16, y_radians)                \
+    X(f16, z_radians)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -148,6 +182,28 @@ void encoder_joints_inject(struct bytestream * bs,
 void encoder_joints_extract(struct bytestream * bs,
                            struct encoder_joints * out);
 
+/// @brief serialize the joint encoder values with the angles in half
+/// precision, which resolves about 0.002 radians near pi
+/// @param bs - the bytestream
+/// @param enc - the encoder data to store in the stream
+void encoder_joints_f16_inject(struct bytestream * bs,
+                               const struct encoder_joints * enc);
+
+/// @brief deserialize joint encoder data serialized with
+/// encoder_joints_f16_inject
+/// @param[in,out] bs  The bytestream
+/// @param[out] out    The encoder data read from the stream
+void encoder_joints_f16_extract(struct bytestream * bs,
+                                struct encoder_joints * out);
+
+/// @brief get the fingerprint of the serialized layout of encoder_joints
+/// @return the fingerprint (@see serialize.h)
+uint8_t encoder_joints_fingerprint(void);
+
+/// @brief get the fingerprint of the half precision layout of encoder_joints
+/// @return the fingerprint (@see serialize.h)
+uint8_t encoder_joints_f16_fingerprint(void);
+
 
 /// @brief Serialize the gimbal encoder values into a bytestream
 /// @param[in,out] bs  The bytestream to write the data to
@@ -160,6 +216,28 @@ void encoder_gimbal_inject(struct bytestream * bs,
 /// @param[out]    out   The encoder data read from the stream
 void encoder_gimbal_extract(struct bytestream * bs,
                            struct encoder_gimbal * out);
+
+/// @brief serialize the gimbal encoder values with the angles in half
+/// precision, which resolves about 0.002 radians near pi
+/// @param bs - the bytestream
+/// @param enc - the encoder data to store in the stream
+void encoder_gimbal_f16_inject(struct bytestream * bs,
+                               const struct encoder_gimbal * enc);
+
+/// @brief deserialize gimbal encoder data serialized with
+/// encoder_gimbal_f16_inject
+/// @param[in,out] bs  The bytestream
+/// @param[out] out    The encoder data read from the stream
+void encoder_gimbal_f16_extract(struct bytestream * bs,
+                                struct encoder_gimbal * out);
+
+/// @brief get the fingerprint of the serialized layout of encoder_gimbal
+/// @return the fingerprint (@see serialize.h)
+uint8_t encoder_gimbal_fingerprint(void);
+
+/// @brief get the fingerprint of the half precision layout of encoder_gimbal
+/// @return the fingerprint (@see serialize.h)
+uint8_t encoder_gimbal_f16_fingerprint(void);
 #ifdef __cplusplus
 }
 #endif
@@ -7,6 +7,7 @@
 /// works on both host and tiva
 
 struct bytestream;
+struct bitstream;
 /// @brief colors for leds. lower 3 bits of an 8 bit byte
 /// correspond to the red, green, and blue leds being on (1) or off (0)
 enum led_color
@@ -21,6 +22,9 @@ enum led_color
     LED_COLOR_WHITE = 0x7,
 };
 
+/// @brief the number of bits used by a color in a bitstream
+#define LED_COLOR_BITS 3u
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -62,6 +66,15 @@ void led_color_inject(struct bytestream * bs, enum led_color color);
 /// @return the color that was stored in the bytestream
 enum led_color led_color_extract(struct bytestream * bs);
 
+/// @brief serialize the led color using LED_COLOR_BITS bits
+/// @param bits - the bitstream
+/// @param color - the color to place in the bitstream
+void led_color_put(struct bitstream * bits, enum led_color color);
+
+/// @param bits - the bitstream
+/// @return the color that was stored in the bitstream
+enum led_color led_color_get(struct bitstream * bits);
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,7 +7,40 @@
 /// hard-coded matrix operations that are specifically needed by the
 /// microcontroller to implement various robotic mathematical functions.
 /// Features will be added as the omnid project requires.
+///
+/// The batch functions apply one operation to many matrices and vectors at
+/// once, such as the joint transforms of a simulation step. Their arguments
+/// are stored as a structure of arrays: element k of item i is at
+/// data[k*stride + i], where the elements of a matrix are numbered in
+/// row-major order. Each item gives the same result, bit for bit, as the
+/// function for a single matrix.
+///
+/// The solvers of A x = b work on copies held on the stack, without
+/// allocating, and their loops have a fixed number of iterations, so the
+/// time they take is bounded regardless of the values in A. A matrix that is
+/// singular, to within MATRIX_SOLVE_TOLERANCE, is reported by the returned
+/// status rather than by an error.
 #include<stdbool.h>
+#include<stddef.h>
+
+/// @brief the size of a pivot, relative to the largest element of the
+/// matrix, at or below which a matrix is treated as singular
+#define MATRIX_SOLVE_TOLERANCE 1e-6f
+
+/// @brief the outcome of solving a linear system
+enum matrix_status
+{
+    /// the system was solved
+    MATRIX_STATUS_OK,
+
+    /// the matrix is singular, so the system has no unique solution. The
+    /// outputs are not modified
+    MATRIX_STATUS_SINGULAR,
+
+    /// the matrix is not positive definite, so its Cholesky factor does not
+    /// exist. The outputs are not modified
+    MATRIX_STATUS_NOT_POSITIVE_DEFINITE,
+};
 
 /// @brief a 3x3 matrix
 struct matrix_3x3
@@ -67,6 +100,17 @@ struct matrix_6x6
     bool transpose;
 };
 
+/// @brief the LU factorization, with partial pivoting, of a 6x6 matrix
+struct matrix_6x6_lu
+{
+    /// L below the diagonal (its diagonal of ones is not stored) and U on
+    /// and above it, such that LU is A with its rows permuted
+    float data[6][6];
+
+    /// row i of LU is row pivot[i] of A
+    unsigned char pivot[6];
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -216,6 +260,112 @@ void matrix_3x3_multiply_matrix(const struct matrix_3x3 * A,
                                 const struct matrix_3x3 * x,
                                 struct matrix_3x3 * v);
 
+/// @brief multiply a batch of 3x3 matrices by a batch of 3x1 vectors
+/// @param A - the matrices, 9 elements per item
+/// @param x - the vectors, 3 elements per item
+/// @param[out] v - the output vectors v = Ax, 3 elements per item. Must not
+/// overlap A or x
+/// @param count - the number of items
+/// @param stride - the distance between consecutive elements of an item,
+/// at least count. Use count unless operating on part of a larger batch
+void matrix_3x3_multiply_vector_batch(const float A[],
+                                      const float x[],
+                                      float v[],
+                                      size_t count,
+                                      size_t stride);
+
+/// @brief multiply a batch of 6x6 matrices by a batch of 6x1 vectors
+/// @param A - the matrices, 36 elements per item
+/// @param x - the vectors, 6 elements per item
+/// @param[out] v - the output vectors v = Ax, 6 elements per item. Must not
+/// overlap A or x
+/// @param count - the number of items
+/// @param stride - the distance between consecutive elements of an item,
+/// at least count
+void matrix_6x6_multiply_vector_batch(const float A[],
+                                      const float x[],
+                                      float v[],
+                                      size_t count,
+                                      size_t stride);
+
+/// @brief calculate the cross products of a batch of 3x1 vectors
+/// @param w - the first vectors, 3 elements per item
+/// @param v - the second vectors, 3 elements per item
+/// @param[out] out - w x v, 3 elements per item. Must not overlap w or v
+/// @param count - the number of items
+/// @param stride - the distance between consecutive elements of an item,
+/// at least count
+void matrix_3x1_cross_batch(const float w[],
+                            const float v[],
+                            float out[],
+                            size_t count,
+                            size_t stride);
+
+/// @brief invert a 3x3 matrix using its cofactors
+/// @param A - the matrix
+/// @param[out] inverse - the inverse of A
+/// @return MATRIX_STATUS_OK or MATRIX_STATUS_SINGULAR
+enum matrix_status matrix_3x3_inverse(const struct matrix_3x3 * A,
+                                      struct matrix_3x3 * inverse);
+
+/// @brief solve A x = b for a 3x3 matrix, using its cofactors
+/// @param A - the matrix
+/// @param b - the right-hand side
+/// @param[out] x - the solution
+/// @return MATRIX_STATUS_OK or MATRIX_STATUS_SINGULAR
+enum matrix_status matrix_3x3_solve(const struct matrix_3x3 * A,
+                                    const struct matrix_3x1 * b,
+                                    struct matrix_3x1 * x);
+
+/// @brief factor a 6x6 matrix into LU form with partial pivoting, so that
+/// several systems with the same matrix can be solved
+/// @param A - the matrix
+/// @param[out] lu - the factorization
+/// @return MATRIX_STATUS_OK or MATRIX_STATUS_SINGULAR
+enum matrix_status matrix_6x6_lu_factor(const struct matrix_6x6 * A,
+                                        struct matrix_6x6_lu * lu);
+
+/// @brief solve A x = b, given the LU factorization of A
+/// @param lu - the factorization, from matrix_6x6_lu_factor
+/// @param b - the right-hand side
+/// @param[out] x - the solution
+void matrix_6x6_lu_solve(const struct matrix_6x6_lu * lu,
+                         const struct matrix_6x1 * b,
+                         struct matrix_6x1 * x);
+
+/// @brief solve A x = b for a 6x6 matrix, by LU factorization
+/// @param A - the matrix
+/// @param b - the right-hand side
+/// @param[out] x - the solution
+/// @return MATRIX_STATUS_OK or MATRIX_STATUS_SINGULAR
+enum matrix_status matrix_6x6_solve(const struct matrix_6x6 * A,
+                                    const struct matrix_6x1 * b,
+                                    struct matrix_6x1 * x);
+
+/// @brief invert a 6x6 matrix, by LU factorization
+/// @param A - the matrix
+/// @param[out] inverse - the inverse of A
+/// @return MATRIX_STATUS_OK or MATRIX_STATUS_SINGULAR
+enum matrix_status matrix_6x6_inverse(const struct matrix_6x6 * A,
+                                      struct matrix_6x6 * inverse);
+
+/// @brief find the Cholesky factor L of a symmetric positive definite 6x6
+/// matrix, such that A = L L^T. Only the lower triangle of A is used
+/// @param A - the matrix
+/// @param[out] L - the lower triangular factor, with zeros above the
+/// diagonal
+/// @return MATRIX_STATUS_OK or MATRIX_STATUS_NOT_POSITIVE_DEFINITE
+enum matrix_status matrix_6x6_cholesky_factor(const struct matrix_6x6 * A,
+                                              struct matrix_6x6 * L);
+
+/// @brief solve A x = b, given the Cholesky factor of A
+/// @param L - the factor, from matrix_6x6_cholesky_factor
+/// @param b - the right-hand side
+/// @param[out] x - the solution
+void matrix_6x6_cholesky_solve(const struct matrix_6x6 * L,
+                               const struct matrix_6x1 * b,
+                               struct matrix_6x1 * x);
+
 #ifdef __cplusplus
 }
 #endif
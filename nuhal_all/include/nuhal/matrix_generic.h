@@ -0,0 +1,117 @@
+#ifndef NUHAL_MATRIX_GENERIC_H_INCLUDE_GUARD
+#define NUHAL_MATRIX_GENERIC_H_INCLUDE_GUARD
+/// @file
+/// @brief Generate matrix-vector products for a matrix of any fixed size.
+///
+/// MATRIX_GENERIC_DEFINE(prefix, rows, cols) defines static inline
+/// functions that operate on rows x cols floats in row-major order, such as
+/// the data of the matrix structures in matrix.h. The matrix is passed as a
+/// pointer to its first element, because C does not convert a float[][]
+/// to a const float[][] without a cast:
+///
+///     MATRIX_GENERIC_DEFINE(matrix_2x5, 2, 5)
+///     float A[2][5];
+///     matrix_2x5_multiply_vector(&A[0][0], x, v);           // v = A x
+///     matrix_2x5_multiply_add(&A[0][0], x, b, v);           // v = A x + b
+///     matrix_2x5_transpose_multiply_vector(&A[0][0], y, u); // u = A^T y
+///     matrix_2x5_transpose_multiply_add(&A[0][0], y, c, u); // u = A^T y+c
+///
+/// The shape and whether the matrix is transposed are known at compile
+/// time, so the loops are fully unrolled into straight-line code with no
+/// runtime checks of a transpose flag, and A^T is used in place without
+/// copying it. Each element is summed from the first column (or row) to the
+/// last, like the hand-written functions in matrix.h, so the results are
+/// identical. The pointers are not checked, so the callers must pass valid
+/// arrays, and the output must not overlap the inputs.
+
+/// \cond implementation detail
+// unroll the loop that follows; the loops have a fixed number of iterations
+// so they are unrolled completely for all but the largest matrices
+#define MATRIX_GENERIC_UNROLL _Pragma("GCC unroll 16")
+
+// the element at (row, col) of a row-major matrix with cols columns
+#define MATRIX_GENERIC_AT(A, cols, row, col) ((A)[(row)*(cols) + (col)])
+/// \endcond
+
+/// @brief define the products of a rows x cols matrix and a vector
+/// @param prefix - the prefix of the function names
+/// @param rows - the number of rows
+/// @param cols - the number of columns
+#define MATRIX_GENERIC_DEFINE(prefix, rows, cols)                           \
+    __attribute__((unused))                                                 \
+    static inline void prefix##_multiply_add(const float * A,               \
+                                             const float x[cols],           \
+                                             const float b[rows],           \
+                                             float v[rows])                 \
+    {                                                                       \
+        MATRIX_GENERIC_UNROLL                                               \
+        for(unsigned int row = 0; row != (rows); ++row)                     \
+        {                                                                   \
+            float sum = MATRIX_GENERIC_AT(A, cols, row, 0)*x[0];            \
+            MATRIX_GENERIC_UNROLL                                           \
+            for(unsigned int col = 1; col != (cols); ++col)                 \
+            {                                                               \
+                sum += MATRIX_GENERIC_AT(A, cols, row, col)*x[col];         \
+            }                                                               \
+            v[row] = sum + b[row];                                          \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    __attribute__((unused))                                                 \
+    static inline void prefix##_multiply_vector(const float * A,            \
+                                                const float x[cols],        \
+                                                float v[rows])              \
+    {                                                                       \
+        MATRIX_GENERIC_UNROLL                                               \
+        for(unsigned int row = 0; row != (rows); ++row)                     \
+        {                                                                   \
+            float sum = MATRIX_GENERIC_AT(A, cols, row, 0)*x[0];            \
+            MATRIX_GENERIC_UNROLL                                           \
+            for(unsigned int col = 1; col != (cols); ++col)                 \
+            {                                                               \
+                sum += MATRIX_GENERIC_AT(A, cols, row, col)*x[col];         \
+            }                                                               \
+            v[row] = sum;                                                   \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    __attribute__((unused))                                                 \
+    static inline void prefix##_transpose_multiply_add(                     \
+        const float * A,                                                    \
+        const float x[rows],                                                \
+        const float b[cols],                                                \
+        float v[cols])                                                      \
+    {                                                                       \
+        MATRIX_GENERIC_UNROLL                                               \
+        for(unsigned int col = 0; col != (cols); ++col)                     \
+        {                                                                   \
+            float sum = MATRIX_GENERIC_AT(A, cols, 0, col)*x[0];            \
+            MATRIX_GENERIC_UNROLL                                           \
+            for(unsigned int row = 1; row != (rows); ++row)                 \
+            {                                                               \
+                sum += MATRIX_GENERIC_AT(A, cols, row, col)*x[row];         \
+            }                                                               \
+            v[col] = sum + b[col];                                          \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    __attribute__((unused))                                                 \
+    static inline void prefix##_transpose_multiply_vector(                  \
+        const float * A,                                                    \
+        const float x[rows],                                                \
+        float v[cols])                                                      \
+    {                                                                       \
+        MATRIX_GENERIC_UNROLL                                               \
+        for(unsigned int col = 0; col != (cols); ++col)                     \
+        {                                                                   \
+            float sum = MATRIX_GENERIC_AT(A, cols, 0, col)*x[0];            \
+            MATRIX_GENERIC_UNROLL                                           \
+            for(unsigned int row = 1; row != (rows); ++row)                 \
+            {                                                               \
+                sum += MATRIX_GENERIC_AT(A, cols, row, col)*x[row];         \
+            }                                                               \
+            v[col] = sum;                                                   \
+        }                                                                   \
+    }
+
+#endif
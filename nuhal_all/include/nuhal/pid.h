@@ -87,6 +87,42 @@ struct pid_signals
     float effort;      
 };
 
+/// @brief the serialized fields of pid_gains (@see serialize.h)
+#define PID_GAINS_FIELDS(X) \
+    X(f, kp)                \
+    X(f, ki)                \
+    X(f, kd)                \
+    X(f, u_max)             \
+    X(f, u_min)             \
+    X(f, i_max)             \
+    X(f, i_min)
+
+/// @brief the serialized fields of pid_state (@see serialize.h)
+#define PID_STATE_FIELDS(X) \
+    X(f, p_error)           \
+    X(f, i_error)           \
+    X(f, d_error)
+
+/// @brief the serialized fields of pid_signals (@see serialize.h)
+#define PID_SIGNALS_FIELDS(X) \
+    X(f, reference)           \
+    X(f, measurement)         \
+    X(f, effort)
+
+/// @brief the serialized fields of pid_state in half precision, which uses
+/// half the bytes (@see serialize.h)
+#define PID_STATE_F16_FIELDS(X) \
+    X(f16, p_error)             \
+    X(f16, i_error)             \
+    X(f16, d_error)
+
+/// @brief the serialized fields of pid_signals in half precision, which uses
+/// half the bytes (@see serialize.h)
+#define PID_SIGNALS_F16_FIELDS(X) \
+    X(f16, reference)             \
+    X(f16, measurement)           \
+    X(f16, effort)
+
 /// @brief information used to debug pid controllers
 struct pid_debug_info
 {
@@ -161,6 +197,46 @@ void pid_signals_inject(struct bytestream * bs, const struct pid_signals * signa
 /// @pre the bytestream must contain the data corresponding to signals
 void pid_signals_extract(struct bytestream * bs, struct pid_signals * signals);
 
+/// @brief serialize pid state in half precision (@see PID_STATE_F16_FIELDS)
+/// @param bs - bytestream into which the state should be inserted
+/// @param state - the state to insert into the bytestream
+void pid_state_f16_inject(struct bytestream * bs, const struct pid_state * state);
+
+/// @brief deserialize pid state that was serialized in half precision
+/// @param bs - the bytestream from which to load the state
+/// @param state [out] - the state
+void pid_state_f16_extract(struct bytestream * bs, struct pid_state * state);
+
+/// @brief serialize pid signals in half precision (@see PID_SIGNALS_F16_FIELDS)
+/// @param bs - bytestream into which the signals should be inserted
+/// @param signals - the signals to insert into the bytestream
+void pid_signals_f16_inject(struct bytestream * bs, const struct pid_signals * signals);
+
+/// @brief deserialize pid signals that were serialized in half precision
+/// @param bs - the bytestream from which to load the signals
+/// @param signals [out] - the signals
+void pid_signals_f16_extract(struct bytestream * bs, struct pid_signals * signals);
+
+/// @brief get the fingerprint of the serialized layout of pid_gains
+/// @return the fingerprint (@see serialize.h)
+uint8_t pid_gains_fingerprint(void);
+
+/// @brief get the fingerprint of the serialized layout of pid_state
+/// @return the fingerprint (@see serialize.h)
+uint8_t pid_state_fingerprint(void);
+
+/// @brief get the fingerprint of the serialized layout of pid_signals
+/// @return the fingerprint (@see serialize.h)
+uint8_t pid_signals_fingerprint(void);
+
+/// @brief get the fingerprint of the half precision layout of pid_state
+/// @return the fingerprint (@see serialize.h)
+uint8_t pid_state_f16_fingerprint(void);
+
+/// @brief get the fingerprint of the half precision layout of pid_signals
+/// @return the fingerprint (@see serialize.h)
+uint8_t pid_signals_f16_fingerprint(void);
+
 
 /// @brief serialize pid debug_info
 /// @param bs - bytestream into which the state should be inserted
@@ -173,6 +249,18 @@ void pid_debug_info_inject(struct bytestream * bs, const struct pid_debug_info *
 /// @param info [out] - data from the bytestream is used to write the signal
 /// @pre the bytestream must contain the data corresponding to debug_info
 void pid_debug_info_extract(struct bytestream * bs, struct pid_debug_info * info);
+
+/// @brief serialize pid debug_info with its state and signals in half
+/// precision, in 14 bytes rather than 26
+/// @param bs - bytestream into which the debug_info should be inserted
+/// @param debug_info - the debug_info to insert into the bytestream
+void pid_debug_info_f16_inject(struct bytestream * bs,
+                               const struct pid_debug_info * debug_info);
+
+/// @brief deserialize pid debug_info that was serialized in half precision
+/// @param bs - the bytestream from which to load the debug_info
+/// @param info [out] - the debug_info
+void pid_debug_info_f16_extract(struct bytestream * bs, struct pid_debug_info * info);
 #ifdef __cplusplus
 }
 #endif
@@ -36,6 +36,10 @@
 /// @brief the maximum length of a protocol packet
 #define PROTOCOL_PACKET_MAX_LENGTH 255
 
+/// @brief the maximum number of data bytes that can follow the command byte
+/// (the packet length minus the two header bytes and the command byte)
+#define PROTOCOL_DATA_MAX_LENGTH (PROTOCOL_PACKET_MAX_LENGTH - 3)
+
 /// @brief the communications packet that is sent between processors
 /// The packet must be initialized prior to use, either by
 /// 1. Call protocol_packet_init
@@ -66,6 +70,120 @@ extern "C" {
 /// indicate that there was an error processing the request.
 #define PROTOCOL_ERROR 0xFF
 
+/// a request or response that carries a sequence number.
+/// The data is the sequence number followed by the wrapped packet data,
+/// starting with its command byte. @see protocol_packet_sequence
+#define PROTOCOL_SEQUENCED 0xFD
+
+/// a request or response for a single device on a multi-drop bus.
+/// The data is the address of the device followed by the wrapped packet
+/// data, starting with its command byte. When a request is also sequenced,
+/// the sequence number wraps the address. @see protocol_packet_address
+#define PROTOCOL_ADDRESSED 0xFC
+
+/// the address of a request for every device on a bus. Devices carry out
+/// broadcast requests without responding
+#define PROTOCOL_ADDRESS_BROADCAST 0xFF
+
+/// negotiate the baud rate and features of a link. @see protocol_negotiate.
+/// Request data: u32 features offered, u8 number of baud rates N, N u32 baud
+/// rates. Response data: u32 features agreed, u32 baud rate selected.
+/// A request with no baud rates confirms the current baud rate
+#define PROTOCOL_NEGOTIATE 0xFE
+
+/// feature bit: PROTOCOL_SEQUENCED requests are supported
+#define PROTOCOL_FEATURE_SEQUENCED 0x1u
+
+/// the maximum number of baud rates that can be offered in a negotiation
+#define PROTOCOL_NEGOTIATE_MAX_BAUDS 16u
+
+/// time in ms that the host waits for the reply to a negotiation request or
+/// to each confirmation of a new baud rate
+#define PROTOCOL_NEGOTIATE_TIMEOUT_MS 100u
+
+/// the number of times the host confirms a new baud rate before returning to
+/// the old one. The device switches for good once it hears a confirmation
+#define PROTOCOL_NEGOTIATE_CONFIRM_ATTEMPTS 3u
+
+/// time in ms that the device waits for a confirmation at a new baud rate
+/// before returning to the old one. It outlasts every confirmation the host
+/// sends, so that the device stays at the new rate if only some are lost
+#define PROTOCOL_NEGOTIATE_CONFIRM_WINDOW_MS \
+    ((PROTOCOL_NEGOTIATE_CONFIRM_ATTEMPTS + 1u) * PROTOCOL_NEGOTIATE_TIMEOUT_MS)
+
+/// @brief the outcome of a request
+enum protocol_status
+{
+    /// a valid response was received
+    PROTOCOL_STATUS_OK,
+
+    /// the response was not received in time
+    PROTOCOL_STATUS_TIMEOUT,
+
+    /// the response was corrupt: its checksum or length was invalid
+    PROTOCOL_STATUS_CHECKSUM,
+
+    /// the response was a PROTOCOL_ERROR
+    PROTOCOL_STATUS_ERROR_RESPONSE,
+
+    /// the response did not match the request: it had a different command
+    /// or (for sequenced requests) a different sequence number
+    PROTOCOL_STATUS_MISMATCH,
+};
+
+/// @brief how requests that fail due to transmission errors are retried.
+///
+/// Timeouts, corrupt responses and mismatched responses are retried.
+/// Before each retry, the receive side of the port is drained until it
+/// has been quiet for drain_ms, so that the remains of a corrupt or late
+/// response are not mistaken for the start of the next one.
+///
+/// A request that is retried may be carried out twice by the device, if
+/// only its response was lost. If that is not acceptable, set sequenced:
+/// each request is then wrapped with a per-port sequence number (@see
+/// PROTOCOL_SEQUENCED) and the device (@see protocol_server.h) replies to
+/// a repeated sequence number with its previous response, without carrying
+/// out the request again.
+struct protocol_retry_policy
+{
+    /// the number of times a request is resent after it first fails
+    uint8_t retries;
+
+    /// delay before the first retry, in ms. It doubles with each retry
+    uint32_t backoff_ms;
+
+    /// the maximum delay between retries, in ms, which also limits the
+    /// first delay
+    uint32_t backoff_max_ms;
+
+    /// how long the port must be quiet before a retry, in ms
+    uint32_t drain_ms;
+
+    /// if true, requests are sent with sequence numbers. The device
+    /// must support PROTOCOL_SEQUENCED
+    bool sequenced;
+};
+
+/// @brief initializer for the default policy: failed requests are not retried
+#define PROTOCOL_RETRY_POLICY_NONE {0, 0, 0, 0, false}
+
+/// @brief round trip time estimate of a port, as in TCP (RFC 6298).
+///
+/// The round trip time excludes the time spent sending the request and the
+/// response, which depends on their length and the baud rate. It therefore
+/// measures how long the device takes to start responding.
+struct protocol_rtt
+{
+    /// smoothed round trip time, in us
+    uint32_t srtt_us;
+
+    /// round trip time variation, in us
+    uint32_t rttvar_us;
+
+    /// false until the first measurement
+    bool valid;
+};
+
 /// @brief type of relationship used for sending data to joints
 enum protocol_broadcast_type
 {
@@ -76,15 +194,110 @@ enum protocol_broadcast_type
     PROTOCOL_ANYCAST,
 };
 
+/// @brief the direction in which a packet travelled, relative to this processor
+enum protocol_direction
+{
+    /// the packet was received
+    PROTOCOL_DIRECTION_RX,
+
+    /// the packet was sent
+    PROTOCOL_DIRECTION_TX,
+};
+
+/// @brief a function that observes every packet that is sent or received
+/// @param port - the port over which the packet travelled
+/// @param direction - whether the packet was sent or received
+/// @param data - the raw bytes of the packet, including the header
+/// @param len - the number of raw bytes in the packet
+/// @param context - the context given to protocol_set_tap
+typedef void (*protocol_tap)(const struct uart_port * port,
+                             enum protocol_direction direction,
+                             const uint8_t data[],
+                             size_t len,
+                             void * context);
+
 /// default timeout to wait for a response when executing a request or broadcast
 /// units of ms
 #define PROTOCOL_TIMEOUT_DEFAULT  200u
 
+/// @brief the most ports that can be open with the protocol at once. The
+/// protocol keeps state, such as the sequence number and round trip time, for
+/// each port, in a table that is safe to use from several threads as long as
+/// each port is used by only one thread at a time (@see uart_lock on linux)
+#define PROTOCOL_MAX_PORTS 8u
+
 /// @brief open a uart port for use with the protocol
 /// @param uart_port_name - the name of the underlying uart port
 /// @return a handle to the uart_port
 const struct uart_port * protocol_open(const char uart_port_name[]);
 
+/// @brief open a uart port for use with the protocol at a given baud rate,
+/// for example to talk to the bootloader
+/// @param uart_port_name - the name of the underlying uart port
+/// @param baud - the baud rate, which the uart must support
+/// @return a handle to the uart_port
+const struct uart_port * protocol_open_baud(const char uart_port_name[],
+                                            uint32_t baud);
+
+/// @brief open a port and negotiate the fastest baud rate supported
+/// by both ends (@see protocol_negotiate)
+/// @param uart_port_name - the name of the underlying uart port
+/// @param bauds - the baud rates the host supports
+/// @param num_bauds - the number of baud rates
+/// @param features [in/out] - the features the host supports, replaced
+/// by the features both ends support. May be NULL
+/// @return a handle to the uart_port
+const struct uart_port * protocol_open_negotiate(const char uart_port_name[],
+                                                 const uint32_t bauds[],
+                                                 unsigned int num_bauds,
+                                                 uint32_t * features);
+
+/// @brief agree on a baud rate and features with the device on a port
+/// @param port - the port, which must be idle
+/// @param bauds - the baud rates the host supports
+/// @param num_bauds - the number of baud rates, at most
+/// PROTOCOL_NEGOTIATE_MAX_BAUDS
+/// @param features [in/out] - the features the host supports (a combination
+/// of PROTOCOL_FEATURE_ bits), replaced by the features both ends support.
+/// May be NULL
+/// @return the baud rate in use after the negotiation
+///
+/// The device selects the highest baud rate that both ends support and
+/// responds at the current baud rate. Both ends then switch, and the host
+/// sends a confirmation at the new rate, which the device answers at the new
+/// rate. The device keeps the new rate once it receives a confirmation, and
+/// waits for one for PROTOCOL_NEGOTIATE_CONFIRM_WINDOW_MS, so the host sends
+/// the confirmation again (up to PROTOCOL_NEGOTIATE_CONFIRM_ATTEMPTS times)
+/// if either the confirmation or its answer is lost. If the device does not support negotiation (it replies with an
+/// error or not at all) or no confirmation is answered, both ends stay at
+/// (or return to) the current baud rate, and no features are agreed.
+uint32_t protocol_negotiate(const struct uart_port * port,
+                            const uint32_t bauds[],
+                            unsigned int num_bauds,
+                            uint32_t * features);
+
+/// @brief select the baud rate for a link
+/// @param offered - the baud rates offered by the host
+/// @param num_offered - the number of offered baud rates
+/// @param supported - the baud rates supported by the device
+/// @param num_supported - the number of supported baud rates
+/// @return the highest baud rate in both lists, or 0 if there is none
+uint32_t protocol_select_baud(const uint32_t offered[],
+                              unsigned int num_offered,
+                              const uint32_t supported[],
+                              unsigned int num_supported);
+
+/// @brief get the baud rate of a port opened with protocol_open
+/// @param port - the port
+/// @return the baud rate, which may have been changed by protocol_negotiate
+uint32_t protocol_baud(const struct uart_port * port);
+
+/// @brief close a port that was opened with protocol_open
+/// @param port - the port
+/// @post the state the protocol keeps for the port, such as its round trip
+/// time estimate, is discarded and the uart port is closed
+void protocol_close(const struct uart_port * port);
+
 /// @brief initialize a packet with the given command byte
 /// @param out [out] - the packet to be initialized
 /// @param command - the command byte to set.
@@ -96,6 +309,60 @@ void protocol_packet_init(struct protocol_packet * out, uint8_t command);
 /// @param in - the packet to parse
 uint8_t protocol_packet_command(const struct protocol_packet * in);
 
+/// @brief re-initialize a received packet, in place, so that it can be used
+/// to build the response to itself
+/// @param packet [in/out] - a packet that was read. Its command byte is kept
+/// and its stream is reset so that the response data can be injected.
+/// Any request data that is needed must be extracted before calling this
+void protocol_packet_reply_init(struct protocol_packet * packet);
+
+/// @brief copy a packet
+/// @param out - the copy
+/// @param in - the packet to copy, including the position of its stream
+void protocol_packet_copy(struct protocol_packet * out,
+                          const struct protocol_packet * in);
+
+/// @brief wrap a packet that is about to be sent with a sequence number
+/// @param packet [in/out] - a packet that has been initialized and filled
+/// with data. Its command becomes PROTOCOL_SEQUENCED and its data grows by
+/// two bytes, so it must have room for two more bytes.
+/// @param sequence - the sequence number
+void protocol_packet_sequence(struct protocol_packet * packet, uint8_t sequence);
+
+/// @brief unwrap a received packet that has a sequence number
+/// @param packet [in/out] - a received packet. If its command is
+/// PROTOCOL_SEQUENCED, it is replaced by the wrapped packet, with
+/// its stream positioned after the wrapped command byte
+/// @param sequence [out] - the sequence number of the packet
+/// @return true if the packet had a sequence number, false otherwise,
+/// in which case the packet is unchanged
+bool protocol_packet_unsequence(struct protocol_packet * packet,
+                                uint8_t * sequence);
+
+/// @brief wrap a packet that is about to be sent with a device address
+/// @param packet [in/out] - a packet that has been initialized and filled
+/// with data. Its command becomes PROTOCOL_ADDRESSED and its data grows by
+/// two bytes, so it must have room for two more bytes.
+/// @param address - the address of the device
+void protocol_packet_address(struct protocol_packet * packet, uint8_t address);
+
+/// @brief unwrap a received packet that has a device address
+/// @param packet [in/out] - a received packet. If its command is
+/// PROTOCOL_ADDRESSED, it is replaced by the wrapped packet, with
+/// its stream positioned after the wrapped command byte
+/// @param address [out] - the address of the packet
+/// @return true if the packet had an address, false otherwise,
+/// in which case the packet is unchanged
+bool protocol_packet_unaddress(struct protocol_packet * packet,
+                               uint8_t * address);
+
+/// @brief get the address of a received packet without unwrapping it
+/// @param packet - a received packet, which may also be sequenced
+/// @param address [out] - the address of the packet
+/// @return true if the packet has an address
+bool protocol_packet_destination(const struct protocol_packet * packet,
+                                 uint8_t * address);
+
 /// @brief send a packet to the port
 /// @param port - port on which to send the packet
 /// @param packet [in/out] - the packet to send over the port.
@@ -107,6 +374,17 @@ uint8_t protocol_packet_command(const struct protocol_packet * in);
 void protocol_write_block(const struct uart_port * port,
                           struct protocol_packet * packet);
 
+/// @brief send a packet whose header has already been computed
+/// (@see protocol_template.h)
+/// @param port - port on which to send the packet
+/// @param frame - the packet, including its header
+/// @param length - the length of the packet, including its header
+/// @post the timeout is predetermined by the protocol and violating it
+/// results in an error
+void protocol_write_frame(const struct uart_port * port,
+                          const uint8_t frame[],
+                          uint8_t length);
+
 /// @brief wait for a protocol packet to be received
 /// @param port - the protocol port
 /// @param out [out] - contains the packet that was read, or NULL to ignore the
@@ -142,15 +420,33 @@ bool protocol_read_block_error(const struct uart_port * port,
 bool protocol_read_nonblock(const struct uart_port * port,
                             struct protocol_packet * out);
 
+/// @brief read a packet, reporting failures instead of causing an error
+/// @param port - the port from which to read
+/// @param out [out] - the packet that was read
+/// @param timeout - time in ms to wait for the packet. 0 waits forever
+/// @return PROTOCOL_STATUS_OK, PROTOCOL_STATUS_TIMEOUT if the whole packet
+/// was not read in time or PROTOCOL_STATUS_CHECKSUM if it was corrupt
+/// After a failure, use protocol_drain to find the start of the next packet
+enum protocol_status protocol_read_status(const struct uart_port * port,
+                                          struct protocol_packet * out,
+                                          uint32_t timeout);
+
+/// @brief discard received data until the port is quiet
+/// @param port - the port
+/// @param quiet_ms - return once no data has been received for this
+/// many ms. If 0, only discard the data that has already been received
+void protocol_drain(const struct uart_port * port, uint32_t quiet_ms);
+
 /// @brief send a request and wait for the matching response
 /// @param port - the protocol port
 /// @param in [in/out] - the request packet to send. packet will be modified
 /// in the same way that it is in @see protocol_write_block
 /// @param out - the response. if NULL the response is still checked internally
 /// but the data is discarded
-/// @post the response is validated using protocol_validate_response
-/// and an error will occur if the response is invalid
-/// @post an error also occurs if there is a timeout waiting for the response
+/// @post the request is retried according to the retry policy, as in
+/// protocol_request_status. An error occurs if the last attempt does not
+/// end with PROTOCOL_STATUS_OK: the response timed out, was corrupt, was a
+/// PROTOCOL_ERROR or did not match the request
 void protocol_request(const struct uart_port * port,
                       struct protocol_packet * in,
                       struct protocol_packet * out);
@@ -163,6 +459,8 @@ void protocol_request(const struct uart_port * port,
 /// @param timeout_error - if true, an error occurs on timeout
 /// if false, this function returns false on timeout
 /// @return false if the request timed out
+/// Requests are retried according to the retry policy
+/// (@see protocol_set_retry_policy) before they are considered failed
 bool protocol_request_timeout(const struct uart_port * port,
                               struct protocol_packet * in,
                               struct protocol_packet * out,
@@ -170,6 +468,19 @@ bool protocol_request_timeout(const struct uart_port * port,
                               bool timeout_error);
 
 
+/// @brief Send a request and wait for a response, retrying it according to
+/// the retry policy (@see protocol_set_retry_policy)
+/// @param port The port over which to send the packet
+/// @param[in] in The packet to send, modified as in protocol_write_block
+/// @param[out] out The response. If NULL, the response is discarded
+/// @param timeout_ms base time to wait for each response, in ms
+/// @return the status of the last attempt. Unlike the other request
+/// functions, no error occurs if the request fails
+enum protocol_status protocol_request_status(const struct uart_port * port,
+                                             struct protocol_packet * in,
+                                             struct protocol_packet * out,
+                                             uint32_t timeout_ms);
+
 /// @brief Send a request to N ports (interleaving the transmissions)
 /// Then waits for the response for each port (interleaving the waiting)
 /// @param ports - the ports to which the packet should be broadcast,
@@ -193,6 +504,23 @@ void protocol_broadcast_timeout(const struct uart_port * const ports[],
                                 enum protocol_broadcast_type btype,
                                 uint32_t timeout);
 
+/// @brief @see protocol_broadcast_timeout, but failures are returned
+/// instead of causing an error.
+/// @param status [out] - if not NULL, num_ports elements that are set
+/// to the status of each port
+/// @return PROTOCOL_STATUS_OK if every port responded, otherwise the
+/// status of the first port that failed.
+/// Ports that fail are retried individually according to the retry policy
+/// (@see protocol_set_retry_policy), while the other responses are kept
+enum protocol_status
+protocol_broadcast_status(const struct uart_port * const ports[],
+                          unsigned int num_ports,
+                          struct protocol_packet  pkt[],
+                          struct protocol_packet response[],
+                          enum protocol_broadcast_type btype,
+                          uint32_t timeout,
+                          enum protocol_status status[]);
+
 /// @brief same as @see protocol_broadcast-timeout except uses the default value
 void protocol_broadcast(const struct uart_port * const ports[],
                         unsigned int num_ports,
@@ -200,6 +528,64 @@ void protocol_broadcast(const struct uart_port * const ports[],
                         struct protocol_packet response[],
                         enum protocol_broadcast_type btype);
 
+/// @brief install a tap that is called with every packet that is sent
+/// or received by the protocol functions (for example, to record traffic)
+/// @param tap - the function to call, or NULL to remove the tap
+/// @param context - user data passed to the tap
+/// Packets are passed to the tap after they are sent and after they are
+/// received but before their checksum is verified, so the tap sees
+/// exactly what went over the wire.
+void protocol_set_tap(protocol_tap tap, void * context);
+
+/// @brief set how failed requests are retried
+/// @param policy - the policy, which is copied. NULL restores the default,
+/// PROTOCOL_RETRY_POLICY_NONE
+/// The policy applies to all ports. It should be set before any requests are
+/// made, and not changed while requests are in progress
+void protocol_set_retry_policy(const struct protocol_retry_policy * policy);
+
+/// @brief enable adaptive timeouts on a port
+/// @param port - the port
+/// @param floor_us - the minimum timeout, in us
+/// @param ceiling_us - the maximum timeout, in us, also used until the
+/// round trip time has been measured. 0 disables adaptive timeouts
+///
+/// With adaptive timeouts, the request and broadcast functions ignore their
+/// timeout argument for the port. Instead, they wait for the smoothed round
+/// trip time plus four times its variation (but at least 1 ms, the
+/// resolution of the timers), clamped between floor_us and ceiling_us, plus
+/// the time needed to send the packets at the baud rate of the port.
+/// Only responses to requests that were not retried update the estimate.
+void protocol_set_timeout_limits(const struct uart_port * port,
+                                 uint32_t floor_us,
+                                 uint32_t ceiling_us);
+
+/// @brief get the round trip time estimate of a port
+/// @param port - the port
+/// @return the estimate, which is only updated if adaptive timeouts are
+/// enabled (@see protocol_set_timeout_limits)
+struct protocol_rtt protocol_port_rtt(const struct uart_port * port);
+
+/// @brief update a round trip time estimate with a measurement
+/// @param rtt [in/out] - the estimate
+/// @param sample_us - the measured round trip time, in us
+void protocol_rtt_update(struct protocol_rtt * rtt, uint32_t sample_us);
+
+/// @brief compute the timeout implied by a round trip time estimate
+/// @param rtt - the estimate
+/// @param floor_us - the minimum timeout, in us
+/// @param ceiling_us - the maximum timeout, in us, which is used if
+/// there is no estimate yet
+/// @return the timeout, in us, excluding the time to send the packets
+uint32_t protocol_rtt_timeout_us(const struct protocol_rtt * rtt,
+                                 uint32_t floor_us,
+                                 uint32_t ceiling_us);
+
+/// @brief get a description of a status
+/// @param status - the status
+/// @return a string describing the status
+const char * protocol_status_string(enum protocol_status status);
+
 /// @brief send an error response to a packet with the given command
 /// @param port - the port on which to send the packet
 ///
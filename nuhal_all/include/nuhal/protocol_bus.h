@@ -0,0 +1,155 @@
+#ifndef NUHAL_PROTOCOL_BUS_H
+#define NUHAL_PROTOCOL_BUS_H
+/// @file
+/// @brief Host side of a multi-drop (RS-485) bus shared by several devices.
+///
+/// Each request is wrapped with the address of a device (@see
+/// PROTOCOL_ADDRESSED), and only that device responds (@see
+/// protocol_server_address). The bus master polls every device, or drop,
+/// in turn, so only one device transmits at a time.
+///
+/// With PROTOCOL_BUS_ROUND_ROBIN, each poll is sent as soon as the previous
+/// one completes. With PROTOCOL_BUS_TIME_SLOTTED, each drop has a fixed slot
+/// in a cycle of drops * slot_us, and its poll starts at the beginning of its
+/// slot, so every drop is polled at the same rate regardless of how quickly
+/// the others respond. A poll that takes longer than its slot delays the
+/// next one, so slot_us should exceed the time of a poll and its timeout.
+
+#include<stdint.h>
+#include<stdbool.h>
+#include"nuhal/protocol.h"
+#include"nuhal/time.h"
+
+/// @brief maximum number of devices on a bus
+#define PROTOCOL_BUS_MAX_DROPS 32
+
+/// @brief how the polls of a bus are scheduled
+enum protocol_bus_schedule
+{
+    /// poll each drop as soon as the previous poll completes
+    PROTOCOL_BUS_ROUND_ROBIN,
+    /// poll each drop at the start of its time slot
+    PROTOCOL_BUS_TIME_SLOTTED
+};
+
+/// @brief build the request for a poll
+/// @param address - the address of the drop being polled
+/// @param request [out] - the request to send, without an address
+/// @param context - the context given to protocol_bus_poll
+typedef void (*protocol_bus_request_builder)(uint8_t address,
+                                             struct protocol_packet * request,
+                                             void * context);
+
+/// @brief handle the response to a poll
+/// @param address - the address of the drop that was polled
+/// @param status - the status of the request
+/// @param response - the response, with its address removed. Only valid if
+/// status is PROTOCOL_STATUS_OK
+/// @param context - the context given to protocol_bus_poll
+typedef void (*protocol_bus_response_handler)(uint8_t address,
+                                              enum protocol_status status,
+                                              struct protocol_packet * response,
+                                              void * context);
+
+/// @brief a bus master
+struct protocol_bus
+{
+    /// the port to which the bus is connected
+    const struct uart_port * port;
+
+    /// the addresses of the drops, in the order in which they are polled
+    uint8_t address[PROTOCOL_BUS_MAX_DROPS];
+
+    /// the number of drops
+    unsigned int drops;
+
+    /// how polls are scheduled
+    enum protocol_bus_schedule schedule;
+
+    /// the length of each time slot, in us
+    uint32_t slot_us;
+
+    /// the timeout of each poll, in ms
+    uint32_t timeout_ms;
+
+    /// the index of the next drop to poll
+    unsigned int next;
+
+    /// the time since the start of the current cycle
+    struct time_elapsed_us cycle;
+
+    /// true once the first cycle has started
+    bool started;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief initialize a bus with no drops
+/// @param out - the bus
+/// @param port - the port, opened with protocol_open
+/// @param schedule - how polls are scheduled
+/// @param slot_us - the length of each time slot, in us. Only used by
+/// PROTOCOL_BUS_TIME_SLOTTED
+/// @param timeout_ms - the timeout of each poll, in ms
+void protocol_bus_init(struct protocol_bus * out,
+                       const struct uart_port * port,
+                       enum protocol_bus_schedule schedule,
+                       uint32_t slot_us,
+                       uint32_t timeout_ms);
+
+/// @brief add a drop to the end of the polling order
+/// @param bus - the bus
+/// @param address - the address of the drop. PROTOCOL_ADDRESS_BROADCAST
+/// cannot be used
+void protocol_bus_add(struct protocol_bus * bus, uint8_t address);
+
+/// @brief send a request to a single drop and receive its response
+/// @param bus - the bus
+/// @param address - the address of the drop
+/// @param in - the request, without an address
+/// @param out [out] - the response, with its address removed. May be NULL
+/// @param timeout_ms - the timeout, as in protocol_request_status
+/// @return the status of the request. A response from another drop is a
+/// PROTOCOL_STATUS_MISMATCH
+enum protocol_status protocol_bus_request(struct protocol_bus * bus,
+                                          uint8_t address,
+                                          const struct protocol_packet * in,
+                                          struct protocol_packet * out,
+                                          uint32_t timeout_ms);
+
+/// @brief send a request to every drop. Drops do not respond
+/// @param bus - the bus
+/// @param in - the request, without an address
+void protocol_bus_broadcast(struct protocol_bus * bus,
+                            const struct protocol_packet * in);
+
+/// @brief poll the next drop, waiting for its time slot if the bus is
+/// time slotted
+/// @param bus - the bus, which must have at least one drop
+/// @param build - called to build the request
+/// @param handle - called with the response. May be NULL
+/// @param context - passed to build and handle
+/// @return the status of the poll
+enum protocol_status protocol_bus_poll(struct protocol_bus * bus,
+                                       protocol_bus_request_builder build,
+                                       protocol_bus_response_handler handle,
+                                       void * context);
+
+/// @brief poll every drop once, starting with the next drop
+/// @param bus - the bus, which must have at least one drop
+/// @param build - called to build each request
+/// @param handle - called with each response. May be NULL
+/// @param context - passed to build and handle
+/// @return the number of drops that responded successfully
+unsigned int protocol_bus_cycle(struct protocol_bus * bus,
+                                protocol_bus_request_builder build,
+                                protocol_bus_response_handler handle,
+                                void * context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
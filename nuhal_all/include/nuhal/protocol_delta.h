@@ -0,0 +1,156 @@
+#ifndef NUHAL_PROTOCOL_DELTA_H
+#define NUHAL_PROTOCOL_DELTA_H
+/// @file
+/// @brief Delta compression of frames that are streamed continuously.
+///
+/// A frame is a fixed-length block of bytes, such as a serialized
+/// pid_debug_info, that is sent over and over with small changes. Rather
+/// than sending the whole frame each time, the sender encodes it relative
+/// to an earlier frame (the base) that the receiver already has:
+///
+/// data[0] - flags: PROTOCOL_DELTA_KEY for a key frame
+/// data[1] - the sequence number of this frame
+/// data[2] - the sequence number of the base (ignored for key frames)
+/// Key frame: the whole frame
+/// Delta frame: a bitmask with one bit per 32-bit word of the frame (least
+///   significant bit first), set if the word changed. Then, for each word
+///   that changed, the difference between the new and base values of the
+///   word (as big endian integers) as a zigzag varint.
+///
+/// Differences of integer counters and of floats that change slowly are
+/// small, so a changed word usually takes one to three bytes.
+///
+/// The base is either the previous frame, or the most recent frame that the
+/// receiver acknowledged (with protocol_delta_ack). Acknowledged bases let the
+/// stream survive lost frames, at the cost of a back channel. Either way,
+/// key frames are sent periodically so that a receiver that has lost track
+/// of the stream can resynchronize.
+
+#include<stdint.h>
+#include<stdbool.h>
+#include<stddef.h>
+#include"nuhal/bytestream.h"
+#include"nuhal/protocol.h"
+
+/// @brief the number of bytes in the header of a delta-encoded frame
+#define PROTOCOL_DELTA_HEADER_BYTES 3u
+
+/// @brief the longest frame, which fits in a packet as a key frame
+#define PROTOCOL_DELTA_FRAME_MAX \
+    (PROTOCOL_DATA_MAX_LENGTH - PROTOCOL_DELTA_HEADER_BYTES)
+
+/// @brief the number of recent frames each side remembers
+#define PROTOCOL_DELTA_HISTORY 4u
+
+/// @brief the flag that marks a key frame
+#define PROTOCOL_DELTA_KEY 0x01u
+
+/// @brief the frame against which delta frames are encoded
+enum protocol_delta_base
+{
+    /// the previous frame: no back channel is needed, but after a frame is
+    /// lost, nothing can be decoded until the next key frame
+    PROTOCOL_DELTA_PREVIOUS,
+
+    /// the most recently acknowledged frame
+    PROTOCOL_DELTA_ACKNOWLEDGED
+};
+
+/// @brief one side of a delta-compressed stream. The sender and the
+/// receiver each keep one
+struct protocol_delta
+{
+    /// the length of every frame
+    size_t length;
+
+    /// the frame against which delta frames are encoded
+    enum protocol_delta_base base;
+
+    /// a key frame is sent after this many delta frames. 0 sends only
+    /// the first key frame. Sequence numbers are 8 bits, so if a multiple
+    /// of 256 frames in a row is lost, a delta frame can appear to be
+    /// relative to the last decoded frame; in PROTOCOL_DELTA_PREVIOUS mode,
+    /// use an interval well under 256 to limit how long such a stream
+    /// stays wrong
+    uint32_t key_interval;
+
+    /// \cond implementation detail
+    // the recent frames and their sequence numbers, oldest first
+    uint8_t history[PROTOCOL_DELTA_HISTORY][PROTOCOL_DELTA_FRAME_MAX];
+    uint8_t history_sequence[PROTOCOL_DELTA_HISTORY];
+    unsigned int history_count;
+
+    // the sequence number of the last frame sent or received
+    uint8_t sequence;
+
+    // the sender's base in acknowledged mode, if there is one
+    uint8_t acknowledged;
+    bool has_acknowledged;
+
+    // delta frames sent since the last key frame
+    uint32_t since_key;
+    bool key_requested;
+    /// \endcond
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief initialize the sender or receiver of a delta-compressed stream
+/// @param out - the stream state
+/// @param length - the length of each frame, at most PROTOCOL_DELTA_FRAME_MAX
+/// @param base - the frame against which delta frames are encoded. Both
+/// sides must use the same setting
+/// @param key_interval - the number of delta frames between key frames
+void protocol_delta_init(struct protocol_delta * out,
+                         size_t length,
+                         enum protocol_delta_base base,
+                         uint32_t key_interval);
+
+/// @brief encode a frame
+/// @param delta - the sender's state
+/// @param frame - the frame, of the length given to protocol_delta_init
+/// @param bs - the stream into which the encoded frame is written, which
+/// must have room for PROTOCOL_DELTA_HEADER_BYTES plus the frame length
+/// @return true if a key frame was written
+bool protocol_delta_encode(struct protocol_delta * delta,
+                           const uint8_t frame[],
+                           struct bytestream * bs);
+
+/// @brief decode a frame
+/// @param delta - the receiver's state
+/// @param bs - the stream holding the encoded frame. The whole frame is
+/// consumed
+/// @param frame [out] - the frame, of the length given to protocol_delta_init
+/// @return true if the frame was decoded. false if its base is not known,
+/// or if it is no newer than the last frame decoded (because it is a
+/// duplicate, or the sequence numbers wrapped while frames were lost), in
+/// which case frames cannot be decoded until the next key frame
+bool protocol_delta_decode(struct protocol_delta * delta,
+                           struct bytestream * bs,
+                           uint8_t frame[]);
+
+/// @brief get the sequence number of the last frame that was encoded or
+/// decoded, which the receiver sends back to acknowledge it
+/// @param delta - the state
+/// @return the sequence number
+uint8_t protocol_delta_sequence(const struct protocol_delta * delta);
+
+/// @brief tell the sender that the receiver decoded a frame, so that it can
+/// be used as a base. Acknowledgements of frames that are too old to be
+/// remembered, or older than the last acknowledged frame, are ignored
+/// @param delta - the sender's state
+/// @param sequence - the sequence number of the frame
+void protocol_delta_ack(struct protocol_delta * delta, uint8_t sequence);
+
+/// @brief make the sender send a key frame next, for example because the
+/// receiver could not decode a frame
+/// @param delta - the sender's state
+void protocol_delta_request_key(struct protocol_delta * delta);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
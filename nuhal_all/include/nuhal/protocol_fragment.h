@@ -0,0 +1,115 @@
+#ifndef NUHAL_PROTOCOL_FRAGMENT_H
+#define NUHAL_PROTOCOL_FRAGMENT_H
+/// @file
+/// @brief Transfers that are larger than a single protocol packet.
+///
+/// The legacy framing (a one byte length) is left untouched. Instead,
+/// a large transfer is split into fragments, each of which is an ordinary
+/// protocol packet whose data begins with a fragment header:
+///
+/// data[0] - the command byte (the same for every fragment of a transfer)
+/// data[1..2] - total length of the transfer, in bytes (big endian)
+/// data[3..4] - offset of this fragment in the transfer, in bytes (big endian)
+/// data[5..N] - the fragment data
+///
+/// Fragments must arrive in order. A fragment with an offset of zero
+/// (re)starts a transfer, which lets the receiver recover from a
+/// transfer that was abandoned part-way through.
+
+#include<stdint.h>
+#include<stdbool.h>
+#include<stddef.h>
+#include"nuhal/protocol.h"
+
+/// @brief number of bytes in the fragment header
+#define PROTOCOL_FRAGMENT_HEADER_BYTES 4
+
+/// @brief maximum number of data bytes carried by a single fragment
+#define PROTOCOL_FRAGMENT_DATA_MAX \
+    (PROTOCOL_DATA_MAX_LENGTH - PROTOCOL_FRAGMENT_HEADER_BYTES)
+
+/// @brief maximum total length of a fragmented transfer
+#define PROTOCOL_FRAGMENT_TOTAL_MAX 0xFFFFu
+
+/// @brief Receiver-side state used to reassemble a fragmented transfer
+struct protocol_reassembly
+{
+    /// Buffer where the transfer is reassembled
+    uint8_t * data;
+
+    /// The length, in bytes, of the data buffer
+    size_t capacity;
+
+    /// Total length of the transfer in progress
+    size_t total;
+
+    /// Number of bytes of the transfer received so far
+    size_t received;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Initialize a reassembly buffer
+/// @param[out] out The reassembly state to initialize
+/// @param data Buffer in which to reassemble transfers
+/// @param capacity The length of the data buffer. Transfers longer than this
+/// cause an error.
+void protocol_reassembly_init(struct protocol_reassembly * out,
+                              uint8_t data[],
+                              size_t capacity);
+
+/// @brief Place the next fragment of a transfer into a bytestream
+/// @param bs The bytestream, positioned after the command byte
+/// @param data The full data of the transfer
+/// @param total The total length of the transfer, in bytes
+/// @param offset Offset of the first byte in data to place in this fragment
+/// @return The number of data bytes placed in the fragment. This is
+/// as many bytes as fit in the stream, up to total - offset
+size_t protocol_fragment_inject(struct bytestream * bs,
+                                const uint8_t data[],
+                                size_t total,
+                                size_t offset);
+
+/// @brief Add a received fragment to the reassembly buffer
+/// @param ra The reassembly state
+/// @param bs The bytestream of the fragment, positioned after the command byte
+/// (as it is after a packet is read).  The whole stream is consumed.
+/// @return true if the transfer is complete, false if more fragments are needed
+/// or the fragment was rejected
+/// @post A fragment that is out of sequence (its offset is not the number of
+/// bytes received so far, or its total differs) is rejected and the transfer
+/// in progress is discarded.  Fragments are then ignored until one with
+/// offset 0 starts a new transfer.
+/// @post an error occurs if the fragment does not fit in the reassembly buffer
+bool protocol_reassembly_extract(struct protocol_reassembly * ra,
+                                 struct bytestream * bs);
+
+/// @brief Send a transfer of arbitrary length as a series of fragments
+/// @param port The port over which to send the transfer
+/// @param command The command byte to use for every fragment
+/// @param data The data to send
+/// @param len The length of the data, at most PROTOCOL_FRAGMENT_TOTAL_MAX
+void protocol_write_fragmented(const struct uart_port * port,
+                               uint8_t command,
+                               const uint8_t data[],
+                               size_t len);
+
+/// @brief Read fragments until a full transfer has been reassembled
+/// @param port The port from which to read
+/// @param command The expected command byte of each fragment.
+/// Receiving any other command is an error.
+/// @param ra The reassembly state, where the transfer is stored
+/// @param timeout Timeout, in ms, to wait for each fragment. 0 is infinite
+/// @return The total length of the transfer, which is in ra->data
+size_t protocol_read_fragmented(const struct uart_port * port,
+                                uint8_t command,
+                                struct protocol_reassembly * ra,
+                                uint32_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
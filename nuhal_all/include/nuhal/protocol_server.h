@@ -0,0 +1,193 @@
+#ifndef NUHAL_PROTOCOL_SERVER_H
+#define NUHAL_PROTOCOL_SERVER_H
+/// @file
+/// @brief Dispatch received protocol packets to handlers based on their
+/// command byte.
+///
+/// This replaces the usual switch statement on protocol_packet_command()
+/// in the main loop of a device (or of a host service that acts as a device).
+/// Handlers are stored in a table indexed by the command byte, so dispatching
+/// takes constant time regardless of how many commands are registered.
+///
+/// Handlers build their response in place, in the request packet:
+/// 1. Extract the request data from packet->stream
+/// 2. Call protocol_packet_reply_init(packet)
+/// 3. Inject the response data into packet->stream
+/// 4. Return true
+///
+/// If the handler returns false, or no handler is registered for the command,
+/// the server replies with an error response (@see protocol_error_response)
+///
+/// Sequenced requests (@see PROTOCOL_SEQUENCED) are unwrapped before they are
+/// passed to the handler, and the response is wrapped with the same sequence
+/// number. If a request arrives with the same sequence number as the previous
+/// one, it is a retry from a client that did not receive the response:
+/// the previous response is sent again without calling the handler. Responses
+/// to sequenced requests must leave room for two bytes (the PROTOCOL_SEQUENCED
+/// command and the sequence number), otherwise an error response is sent.
+/// Because only the last response is kept, a server that handles sequenced
+/// requests should receive requests from a single client.
+///
+/// A server that is given its baud rates and features with
+/// protocol_server_negotiation() answers PROTOCOL_NEGOTIATE requests in
+/// protocol_server_poll() and switches the port to the selected baud rate.
+///
+/// On a multi-drop bus, give each server its address with
+/// protocol_server_address(). protocol_server_poll() then ignores packets
+/// that are not addressed (@see PROTOCOL_ADDRESSED) to it, including the
+/// responses of other devices, and carries out broadcast requests without
+/// responding. Addressed requests are unwrapped before they are passed to
+/// the handler, and the response is wrapped with the same address.
+
+#include<stdint.h>
+#include<stdbool.h>
+#include"nuhal/protocol.h"
+
+/// @brief A function that handles a single command
+/// @param packet [in/out] - the request packet. The stream is positioned
+/// after the command byte. The response is built in place (see above)
+/// @param context - the context pointer given when the handler was registered
+/// @return true if the response was built, false to reply with an error
+typedef bool (*protocol_handler)(struct protocol_packet * packet, void * context);
+
+/// @brief A handler and the context that is passed to it
+struct protocol_server_entry
+{
+    /// The handler, or NULL if the command is not registered
+    protocol_handler handler;
+
+    /// User data passed to the handler
+    void * context;
+};
+
+/// @brief Table mapping each command byte to its handler
+struct protocol_server
+{
+    /// One entry per possible command byte
+    struct protocol_server_entry entry[256];
+
+    /// The response to the last sequenced request
+    struct protocol_packet last_response;
+
+    /// The value returned by protocol_server_handle for the last
+    /// sequenced request
+    bool last_result;
+
+    /// The sequence number of the last sequenced request
+    uint8_t last_sequence;
+
+    /// A hash of the command and data of the last sequenced request. A
+    /// request is only a retry if both its sequence number and its contents
+    /// match, so a new request that reuses the sequence number (such as
+    /// the first request from a client that has restarted) is carried out
+    uint32_t last_request;
+
+    /// True once a sequenced request has been handled
+    bool has_last;
+
+    /// The baud rates that can be negotiated, or NULL if the server does
+    /// not handle PROTOCOL_NEGOTIATE
+    const uint32_t * bauds;
+
+    /// The number of elements in bauds
+    unsigned int num_bauds;
+
+    /// The current baud rate of the port
+    uint32_t baud;
+
+    /// The features supported by the server (PROTOCOL_FEATURE_ bits)
+    uint32_t features;
+
+    /// The address of the server on a multi-drop bus
+    uint8_t address;
+
+    /// True if the server only handles requests sent to its address
+    bool has_address;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Initialize a server with no registered commands
+/// @param[out] out The server to initialize
+void protocol_server_init(struct protocol_server * out);
+
+/// @brief Register the handler for a command
+/// @param server The server
+/// @param command The command byte. PROTOCOL_ERROR cannot be registered
+/// @param handler The function to call when the command is received.
+/// NULL unregisters the command
+/// @param context User data that is passed to the handler
+void protocol_server_register(struct protocol_server * server,
+                              uint8_t command,
+                              protocol_handler handler,
+                              void * context);
+
+/// @brief Enable baud rate negotiation (@see protocol_negotiate)
+/// @param server The server
+/// @param baud The baud rate that the port was opened with
+/// @param bauds The baud rates that the port supports. Must remain valid
+/// while the server is in use. NULL disables negotiation
+/// @param num_bauds The number of elements in bauds
+/// @param features The features that the server supports
+void protocol_server_negotiation(struct protocol_server * server,
+                                 uint32_t baud,
+                                 const uint32_t bauds[],
+                                 unsigned int num_bauds,
+                                 uint32_t features);
+
+/// @brief Set the address of a server on a multi-drop bus
+/// @param server The server
+/// @param address The address. PROTOCOL_ADDRESS_BROADCAST cannot be used
+void protocol_server_address(struct protocol_server * server, uint8_t address);
+
+/// @brief Run the handler for a received packet and build the response
+/// @param server The server
+/// @param packet [in/out] The received request. On return it holds the
+/// response that should be sent: either the response built by the handler
+/// or an error response
+/// @return true if the handler built a response, false if packet now
+/// holds an error response
+bool protocol_server_handle(struct protocol_server * server,
+                            struct protocol_packet * packet);
+
+/// @brief Handle a single request, if one is available on the port
+/// @param server The server
+/// @param port The port on which to receive requests and send responses
+/// @return true if a request was handled, false if no data was available
+/// the request was corrupt, or it was for another device on the bus.
+/// Corrupt requests are discarded without a response, so that the client
+/// retries them
+bool protocol_server_poll(struct protocol_server * server,
+                          const struct uart_port * port);
+
+/// @brief Handle a request that has already been received, as
+/// protocol_server_poll() does: requests for other devices are ignored,
+/// broadcasts are carried out without a response, and PROTOCOL_NEGOTIATE
+/// is answered on the port. Used to put something between the port and the
+/// server, such as a simulated link
+/// @param server The server
+/// @param port The port on which the request was received
+/// @param packet [in/out] The request, which is replaced by the response
+/// @param respond [out] true if packet holds a response that the caller
+/// must send
+/// @return true if the request was handled, false if it was for another
+/// device on the bus
+bool protocol_server_process(struct protocol_server * server,
+                             const struct uart_port * port,
+                             struct protocol_packet * packet,
+                             bool * respond);
+
+/// @brief Handle requests on the port forever
+/// @param server The server
+/// @param port The port on which to receive requests and send responses
+void protocol_server_run(struct protocol_server * server,
+                         const struct uart_port * port)
+    __attribute__((noreturn));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
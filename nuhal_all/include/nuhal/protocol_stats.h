@@ -0,0 +1,127 @@
+#ifndef NUHAL_PROTOCOL_STATS_H_INCLUDE_GUARD
+#define NUHAL_PROTOCOL_STATS_H_INCLUDE_GUARD
+/// @file
+/// @brief Per-command latency histograms and error counters for the protocol.
+///
+/// When enabled, protocol_request_timeout() and protocol_broadcast_timeout()
+/// count every request by its command byte, along with the number of
+/// timeouts, checksum failures, PROTOCOL_ERROR responses, mismatched
+/// responses and retries. Sequenced requests are counted by the command
+/// that they wrap. The round-trip time of each successful request is
+/// recorded in a log-linear histogram (similar to an HdrHistogram): values
+/// below 8 us each have their own bucket, and every power of two above that
+/// is split into 8 equal buckets, so any recorded value is within 12.5% of
+/// its bucket.
+///
+/// Statistics are updated with atomic operations, so another thread (or an
+/// interrupt) can read them with protocol_stats_snapshot() without locking.
+/// A snapshot is not taken atomically as a whole: a request that completes
+/// while the snapshot is taken may be only partially reflected in it.
+
+#include<stdint.h>
+#include<stdbool.h>
+#include<stddef.h>
+
+/// @brief each power of two is split into 2^PROTOCOL_STATS_SUB_BUCKET_BITS buckets
+#define PROTOCOL_STATS_SUB_BUCKET_BITS 3u
+
+/// @brief number of buckets per power of two
+#define PROTOCOL_STATS_SUB_BUCKETS (1u << PROTOCOL_STATS_SUB_BUCKET_BITS)
+
+/// @brief the number of buckets needed to cover every uint32_t latency
+#define PROTOCOL_STATS_BUCKETS \
+    ((32u - PROTOCOL_STATS_SUB_BUCKET_BITS + 1u) * PROTOCOL_STATS_SUB_BUCKETS)
+
+/// @brief the counters kept for each command
+enum protocol_stats_counter
+{
+    /// requests sent
+    PROTOCOL_STATS_REQUESTS,
+    /// requests for which no complete response arrived in time
+    PROTOCOL_STATS_TIMEOUTS,
+    /// responses with an invalid checksum
+    PROTOCOL_STATS_CHECKSUM_ERRORS,
+    /// PROTOCOL_ERROR responses
+    PROTOCOL_STATS_ERROR_RESPONSES,
+    /// responses with a command byte (or sequence number) that does
+    /// not match the request
+    PROTOCOL_STATS_MISMATCHES,
+    /// requests that were sent again after failing
+    /// (@see protocol_set_retry_policy)
+    PROTOCOL_STATS_RETRIES,
+    /// the number of counters
+    PROTOCOL_STATS_COUNTERS
+};
+
+/// @brief statistics for a single command
+struct protocol_command_stats
+{
+    /// counters, indexed by enum protocol_stats_counter
+    uint32_t counter[PROTOCOL_STATS_COUNTERS];
+
+    /// round-trip latency histogram of successful requests, in us.
+    /// @see protocol_stats_bucket
+    uint32_t latency_us[PROTOCOL_STATS_BUCKETS];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Start (or stop) recording protocol statistics
+/// @param stats - storage for the statistics, indexed by command byte.
+/// NULL stops recording. The storage is zeroed and must remain valid
+/// until recording stops
+/// @param count - the number of elements in stats. Commands greater than
+/// or equal to count are not recorded. Use 256 to record every command.
+/// @pre not called while a request is in progress
+void protocol_stats_enable(struct protocol_command_stats stats[], size_t count);
+
+/// @brief Determine if statistics are being recorded
+/// @return true if protocol_stats_enable was called with storage
+bool protocol_stats_enabled(void);
+
+/// @brief Copy the statistics for a command, optionally resetting them
+/// @param command - the command byte
+/// @param[out] out - the statistics. Zeroed if the command is not recorded
+/// @param reset - if true, each value is atomically reset to zero as it is
+/// read, so no event is lost between consecutive snapshots
+void protocol_stats_snapshot(uint8_t command,
+                             struct protocol_command_stats * out,
+                             bool reset);
+
+/// @brief Increment a counter for a command
+/// @param command - the command byte
+/// @param counter - the counter
+/// Called by the protocol functions; does nothing unless stats are enabled
+void protocol_stats_count(uint8_t command, enum protocol_stats_counter counter);
+
+/// @brief Record the round-trip latency of a successful request
+/// @param command - the command byte
+/// @param latency_us - the latency, in us
+/// Called by the protocol functions; does nothing unless stats are enabled
+void protocol_stats_latency(uint8_t command, uint32_t latency_us);
+
+/// @brief get the histogram bucket in which a value is recorded
+/// @param value - the value
+/// @return the index of the bucket, less than PROTOCOL_STATS_BUCKETS
+uint32_t protocol_stats_bucket(uint32_t value);
+
+/// @brief get the smallest value recorded in a bucket
+/// @param bucket - the index of the bucket
+/// @return the lowest value that maps to the bucket
+uint32_t protocol_stats_bucket_value(uint32_t bucket);
+
+/// @brief Compute a percentile of a latency histogram
+/// @param stats - the statistics (typically a snapshot)
+/// @param percentile - the percentile, between 0 and 100
+/// @return the lowest value of the bucket containing the percentile, or
+/// 0 if no latencies were recorded
+uint32_t protocol_stats_percentile(const struct protocol_command_stats * stats,
+                                   float percentile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef NUHAL_PROTOCOL_TEMPLATE_H
+#define NUHAL_PROTOCOL_TEMPLATE_H
+/// @file
+/// @brief Packets that are sent repeatedly with only some fields changed.
+///
+/// A template is built once, like any other packet, and its header is
+/// computed when it is created. Afterwards, individual fields are
+/// overwritten in place and the checksum is adjusted by the difference
+/// between the old and new bytes, so sending the packet again costs a few
+/// stores rather than re-serializing and re-summing the whole packet.
+///
+/// Example:
+///     struct protocol_packet packet;
+///     protocol_packet_init(&packet, COMMAND);
+///     const uint8_t torque = protocol_template_field(&packet);
+///     bytestream_inject_f(&packet.stream, 0.0f);
+///     struct protocol_template frame;
+///     protocol_template_init(&frame, &packet);
+///     for(;;)
+///     {
+///         protocol_template_set_f(&frame, torque, compute_torque());
+///         protocol_template_write(port, &frame);
+///     }
+///
+/// Fields are written in the same (big endian) format as the bytestream
+/// functions.
+
+#include<stdint.h>
+#include"nuhal/protocol.h"
+
+/// @brief a complete packet, including its header, that is ready to send
+struct protocol_template
+{
+    /// \brief the length of the packet, including the header
+    uint8_t length;
+
+    /// \brief the packet: do not access directly.
+    ///
+    /// Instead, modify it with the protocol_template_set functions
+    uint8_t _frame[PROTOCOL_PACKET_MAX_LENGTH];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief get the field of a template that the next value injected into
+/// a packet will occupy
+/// @param packet - the packet that is being built
+/// @return the field, for use with protocol_template_set
+uint8_t protocol_template_field(const struct protocol_packet * packet);
+
+/// @brief create a template from a packet
+/// @param out - the template
+/// @param packet - the packet, built with protocol_packet_init and the
+/// bytestream functions. The packet is not modified
+void protocol_template_init(struct protocol_template * out,
+                            const struct protocol_packet * packet);
+
+/// @brief overwrite a u8 field of a template
+/// @param frame - the template
+/// @param field - the field, from protocol_template_field
+/// @param u8 - the new value
+void protocol_template_set_u8(struct protocol_template * frame,
+                              uint8_t field,
+                              uint8_t u8);
+
+/// @brief overwrite a u16 field of a template
+/// @param frame - the template
+/// @param field - the field, from protocol_template_field
+/// @param u16 - the new value
+void protocol_template_set_u16(struct protocol_template * frame,
+                               uint8_t field,
+                               uint16_t u16);
+
+/// @brief overwrite a u32 field of a template
+/// @param frame - the template
+/// @param field - the field, from protocol_template_field
+/// @param u32 - the new value
+void protocol_template_set_u32(struct protocol_template * frame,
+                               uint8_t field,
+                               uint32_t u32);
+
+/// @brief overwrite an i32 field of a template
+/// @param frame - the template
+/// @param field - the field, from protocol_template_field
+/// @param i32 - the new value
+void protocol_template_set_i32(struct protocol_template * frame,
+                               uint8_t field,
+                               int32_t i32);
+
+/// @brief overwrite a float field of a template
+/// @param frame - the template
+/// @param field - the field, from protocol_template_field
+/// @param f - the new value
+void protocol_template_set_f(struct protocol_template * frame,
+                             uint8_t field,
+                             float f);
+
+/// @brief send a template
+/// @param port - the port over which to send the template
+/// @param frame - the template
+void protocol_template_write(const struct uart_port * port,
+                             const struct protocol_template * frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
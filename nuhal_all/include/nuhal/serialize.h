@@ -0,0 +1,137 @@
+#ifndef NUHAL_SERIALIZE_H_INCLUDE_GUARD
+#define NUHAL_SERIALIZE_H_INCLUDE_GUARD
+/// @file
+/// @brief Generate the inject/extract functions of a structure from a
+/// description of its fields.
+///
+/// The fields are described once with an X-macro that lists the type
+/// (u8, u16, u32, i32, f or f16) and name of each field, in the order in which
+/// they are sent (usually spread over several lines):
+///
+///     #define ENCODER_JOINTS_FIELDS(X) X(i32, before_ticks) X(f, before_radians)
+///
+/// In the header, SERIALIZE_DECLARE(encoder_joints, struct encoder_joints)
+/// declares encoder_joints_inject, encoder_joints_extract and
+/// encoder_joints_fingerprint. In the source file,
+/// SERIALIZE_DEFINE(encoder_joints, struct encoder_joints,
+/// ENCODER_JOINTS_FIELDS, false) defines them.
+///
+/// The generated functions check for room in the stream once and then
+/// serialize every field with straight-line code. A compile-time check
+/// ensures that the structure fits in the data of a protocol packet.
+///
+/// The fingerprint is a hash of the number, order and types of the fields,
+/// which determine the layout on the wire. Renaming a field does not change
+/// it. When the last argument of SERIALIZE_DEFINE is true, the
+/// fingerprint is sent before the fields and checked when they are
+/// extracted, so a host and a microcontroller built with different
+/// descriptions fail with an error instead of silently misreading the data.
+#include "nuhal/bytestream.h"
+#include "nuhal/error.h"
+#include "nuhal/protocol.h"
+#include "nuhal/utilities.h"
+
+/// \cond implementation detail
+// bytes used by each type of field
+#define SERIALIZE_SIZE_u8 1u
+#define SERIALIZE_SIZE_u16 2u
+#define SERIALIZE_SIZE_u32 4u
+#define SERIALIZE_SIZE_i32 4u
+#define SERIALIZE_SIZE_f 4u
+#define SERIALIZE_SIZE_f16 2u
+
+// the code of each type of field, for the fingerprint
+#define SERIALIZE_CODE_u8 1u
+#define SERIALIZE_CODE_u16 2u
+#define SERIALIZE_CODE_u32 3u
+#define SERIALIZE_CODE_i32 4u
+#define SERIALIZE_CODE_f 5u
+#define SERIALIZE_CODE_f16 6u
+
+// callbacks for the field descriptions
+#define SERIALIZE_FIELD_SIZE(type, name) + SERIALIZE_SIZE_##type
+#define SERIALIZE_FIELD_INDEX(type, name) serialize_index_##name,
+#define SERIALIZE_FIELD_HASH(type, name)                      \
+    + (serialize_index_##name + 1u)                           \
+    * ((serialize_index_##name + 1u) * 37u                    \
+       + SERIALIZE_CODE_##type * 11u)
+#define SERIALIZE_FIELD_PUT(type, name) bytestream_put_##type(cursor, in->name);
+#define SERIALIZE_FIELD_GET(type, name) out->name = bytestream_get_##type(cursor);
+/// \endcond
+
+/// @brief the number of bytes in a serialized structure, not including the
+/// fingerprint
+/// @param FIELDS - the X-macro that describes the fields
+#define SERIALIZE_BYTES(FIELDS) (0u FIELDS(SERIALIZE_FIELD_SIZE))
+
+/// @brief declare the functions generated by SERIALIZE_DEFINE
+/// @param prefix - the prefix of the function names
+/// @param type - the type of the structure
+#define SERIALIZE_DECLARE(prefix, type)                               \
+    void prefix##_inject(struct bytestream * bs, const type * in);    \
+    void prefix##_extract(struct bytestream * bs, type * out);        \
+    uint8_t prefix##_fingerprint(void)
+
+/// @brief define the functions that serialize a structure
+/// @param prefix - the prefix of the function names
+/// @param type - the type of the structure
+/// @param FIELDS - the X-macro that describes the fields
+/// @param versioned - if true, the fingerprint is sent before the fields
+/// @post also defines the static functions prefix_put and prefix_get, which
+/// write and read the fields at a cursor (@see bytestream_reserve) and can
+/// be used to serialize structures that contain this one
+#define SERIALIZE_DEFINE(prefix, type, FIELDS, versioned)                   \
+    STATIC_ASSERT((versioned ? 1u : 0u) + SERIALIZE_BYTES(FIELDS)           \
+                  <= PROTOCOL_DATA_MAX_LENGTH,                              \
+                  prefix##_fits_in_a_packet);                               \
+                                                                            \
+    uint8_t prefix##_fingerprint(void)                                      \
+    {                                                                       \
+        enum { FIELDS(SERIALIZE_FIELD_INDEX) serialize_count };             \
+        return (uint8_t)(serialize_count FIELDS(SERIALIZE_FIELD_HASH));     \
+    }                                                                       \
+                                                                            \
+    __attribute__((unused))                                                 \
+    static void prefix##_put(uint8_t ** cursor, const type * in)            \
+    {                                                                       \
+        FIELDS(SERIALIZE_FIELD_PUT)                                         \
+    }                                                                       \
+                                                                            \
+    __attribute__((unused))                                                 \
+    static void prefix##_get(uint8_t ** cursor, type * out)                 \
+    {                                                                       \
+        FIELDS(SERIALIZE_FIELD_GET)                                         \
+    }                                                                       \
+                                                                            \
+    void prefix##_inject(struct bytestream * bs, const type * in)           \
+    {                                                                       \
+        if(!bs || !in)                                                      \
+        {                                                                   \
+            error(FILE_LINE, "NULL ptr");                                   \
+        }                                                                   \
+        uint8_t * cursor = bytestream_reserve(                              \
+            bs, (versioned ? 1u : 0u) + SERIALIZE_BYTES(FIELDS));           \
+        if(versioned)                                                       \
+        {                                                                   \
+            bytestream_put_u8(&cursor, prefix##_fingerprint());             \
+        }                                                                   \
+        prefix##_put(&cursor, in);                                          \
+    }                                                                       \
+                                                                            \
+    void prefix##_extract(struct bytestream * bs, type * out)               \
+    {                                                                       \
+        if(!bs || !out)                                                     \
+        {                                                                   \
+            error(FILE_LINE, "NULL ptr");                                   \
+        }                                                                   \
+        uint8_t * cursor = bytestream_reserve(                              \
+            bs, (versioned ? 1u : 0u) + SERIALIZE_BYTES(FIELDS));           \
+        if(versioned                                                        \
+           && bytestream_get_u8(&cursor) != prefix##_fingerprint())         \
+        {                                                                   \
+            error(FILE_LINE, "fingerprint mismatch");                       \
+        }                                                                   \
+        prefix##_get(&cursor, out);                                         \
+    }
+
+#endif
@@ -139,6 +139,13 @@ int uart_write_nonblock(const struct uart_port * port,
 int uart_write_block(const struct uart_port * port, const void * data,
                      size_t len, uint32_t timeout);
 
+/// @brief change the baud rate of an open port
+/// @param port - the port
+/// @param baud - the new baud rate. It must be supported by uart_open
+/// @post data that was already written is sent at the old baud rate
+/// before the rate changes. Errors result in program termination
+void uart_set_baud(const struct uart_port * port, uint32_t baud);
+
 /// @brief close the given serial port. The handle will no longer be valid
 /// @param port - the port to close
 /// @post all errors result in program termination.
@@ -0,0 +1,112 @@
+#include "nuhal/bitstream.h"
+#include "nuhal/error.h"
+
+// the widest field
+#define MAX_WIDTH 32u
+
+void bitstream_init(struct bitstream * out, struct bytestream * bs)
+{
+    if(!out || !bs)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    out->bs = bs;
+    out->accumulator = 0;
+    out->count = 0;
+}
+
+void bitstream_put(struct bitstream * bits, uint32_t value, unsigned int width)
+{
+    if(!bits)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(0 == width || width > MAX_WIDTH
+       || (width < MAX_WIDTH && value >> width != 0))
+    {
+        error(FILE_LINE, "invalid param");
+    }
+
+    // fewer than 32 bits are held between calls, so the accumulator
+    // cannot overflow
+    bits->accumulator = (bits->accumulator << width) | value;
+    bits->count += width;
+    if(bits->count >= MAX_WIDTH)
+    {
+        bits->count -= MAX_WIDTH;
+        bytestream_inject_u32(bits->bs, (uint32_t)(bits->accumulator >> bits->count));
+    }
+}
+
+uint32_t bitstream_get(struct bitstream * bits, unsigned int width)
+{
+    if(!bits)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(0 == width || width > MAX_WIDTH)
+    {
+        error(FILE_LINE, "invalid param");
+    }
+
+    // load only the bytes that hold the field, fewer than 8 bits are held
+    // between calls
+    if(bits->count < width)
+    {
+        const size_t len = bitstream_bytes(width - bits->count);
+        const uint8_t * cursor = bytestream_reserve(bits->bs, len);
+        for(size_t i = 0; i != len; ++i)
+        {
+            bits->accumulator = (bits->accumulator << 8) | cursor[i];
+        }
+        bits->count += 8u * len;
+    }
+
+    bits->count -= width;
+    const uint32_t value =
+        (uint32_t)(bits->accumulator >> bits->count) & (uint32_t)(UINT64_MAX >> (64u - width));
+    bits->accumulator &= ~(UINT64_MAX << bits->count);
+    return value;
+}
+
+void bitstream_put_bool(struct bitstream * bits, bool flag)
+{
+    bitstream_put(bits, flag ? 1u : 0u, 1u);
+}
+
+bool bitstream_get_bool(struct bitstream * bits)
+{
+    return 1u == bitstream_get(bits, 1u);
+}
+
+void bitstream_flush(struct bitstream * bits)
+{
+    if(!bits)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    const size_t len = bitstream_bytes(bits->count);
+    const uint64_t padded = bits->accumulator << (8u * len - bits->count);
+    uint8_t * cursor = bytestream_reserve(bits->bs, len);
+    for(size_t i = 0; i != len; ++i)
+    {
+        cursor[i] = (uint8_t)(padded >> (8u * (len - 1u - i)));
+    }
+    bits->accumulator = 0;
+    bits->count = 0;
+}
+
+void bitstream_align(struct bitstream * bits)
+{
+    if(!bits)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    // the bits held are the unread part of the last byte loaded
+    bits->accumulator = 0;
+    bits->count = 0;
+}
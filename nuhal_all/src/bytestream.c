@@ -1,6 +1,14 @@
 #include "nuhal/bytestream.h"
 #include "nuhal/error.h"
+#include <stdint.h>
 #include <string.h>
+#include <math.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
 // ensure that we can use floats and u32's in memory the same via unions
 STATIC_ASSERT(sizeof(float) == sizeof(uint32_t), sizeof_float_u32);
 
@@ -144,27 +152,429 @@ void bytestream_inject_string(struct bytestream * bs, const char * str)
 
 void bytestream_extract_string(struct bytestream * bs, char str[], size_t len)
 {
-    // verify with 0 length
-    verify_args(bs, 0);
     if(!str)
     {
         error(FILE_LINE, "NULL ptr");
     }
-    size_t in_len = utilities_strlen((char*)&bs->data[bs->size], bs->capacity);
-    if(in_len >= bs->capacity)
+
+    const struct bytestream_view view = bytestream_extract_string_view(bs);
+    if(view.len >= len)
+    {
+        // the string will not fit in str
+        error(FILE_LINE, "string too long");
+    }
+
+    memcpy(str, view.data, view.len + 1); // plus one for null char
+}
+
+void bytestream_extract_u8_array(struct bytestream * bs,
+                                 uint8_t bytes[],
+                                 size_t len)
+{
+    if(!bytes)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    memcpy(bytes, bytestream_reserve(bs, len), len);
+}
+
+struct bytestream_view bytestream_extract_view(struct bytestream * bs, size_t len)
+{
+    const struct bytestream_view view = {bytestream_reserve(bs, len), len};
+    return view;
+}
+
+struct bytestream_view bytestream_extract_string_view(struct bytestream * bs)
+{
+    // verify with 0 length
+    verify_args(bs, 0);
+
+    // only the rest of the stream is searched for the null character
+    const size_t remaining = bs->capacity - bs->size;
+    const uint8_t * start = &bs->data[bs->size];
+    const uint8_t * end = memchr(start, '\0', remaining);
+    if(!end)
     {
         error(FILE_LINE, "string not null terminated");
     }
 
-    if(in_len >= len)
+    const struct bytestream_view view = {start, (size_t)(end - start)};
+    bs->size += view.len + 1; // plus one for null char
+    return view;
+}
+
+// reserve room in a bytestream for an array of len elements of a given size
+static uint8_t * reserve_array(struct bytestream * bs,
+                               const void * array,
+                               size_t len,
+                               size_t size)
+{
+    if(!array)
     {
-        // the string will not fit in str
-        error(FILE_LINE, "string too long");
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(len > SIZE_MAX / size)
+    {
+        error(FILE_LINE, "overflow");
     }
+    return bytestream_reserve(bs, len * size);
+}
 
-    memcpy(str, &bs->data[bs->size], in_len);
-    str[in_len] = '\0';
-    bs->size += in_len + 1; // plus one for null char
+// copy count 16-bit values, reversing the bytes of each when the host is
+// little endian. Used in both directions, since the swap is its own inverse
+static void copy_swap16(uint8_t * dest, const uint8_t * src, size_t count)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    memcpy(dest, src, count * sizeof(uint16_t));
+#else
+    size_t i = 0;
+#if defined(__SSSE3__)
+    // eight values per shuffle
+    const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                                       9, 8, 11, 10, 13, 12, 15, 14);
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i *)&src[2*i]);
+        _mm_storeu_si128((__m128i *)&dest[2*i], _mm_shuffle_epi8(v, swap));
+    }
+#endif
+    for(; i != count; ++i)
+    {
+        uint16_t value = 0;
+        memcpy(&value, &src[2*i], sizeof(value));
+        value = __builtin_bswap16(value);
+        memcpy(&dest[2*i], &value, sizeof(value));
+    }
+#endif
+}
+
+// copy count 32-bit values, reversing the bytes of each when the host is
+// little endian. On ARM, __builtin_bswap32 is a single REV instruction
+static void copy_swap32(uint8_t * dest, const uint8_t * src, size_t count)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    memcpy(dest, src, count * sizeof(uint32_t));
+#else
+    size_t i = 0;
+#if defined(__SSSE3__)
+    // four values per shuffle
+    const __m128i swap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                       11, 10, 9, 8, 15, 14, 13, 12);
+    for(; i + 4 <= count; i += 4)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i *)&src[4*i]);
+        _mm_storeu_si128((__m128i *)&dest[4*i], _mm_shuffle_epi8(v, swap));
+    }
+#endif
+    for(; i != count; ++i)
+    {
+        uint32_t value = 0;
+        memcpy(&value, &src[4*i], sizeof(value));
+        value = __builtin_bswap32(value);
+        memcpy(&dest[4*i], &value, sizeof(value));
+    }
+#endif
+}
+
+void bytestream_inject_u16_array(struct bytestream * bs,
+                                 const uint16_t u16[],
+                                 size_t len)
+{
+    uint8_t * cursor = reserve_array(bs, u16, len, sizeof(uint16_t));
+    copy_swap16(cursor, (const uint8_t *)u16, len);
+}
+
+void bytestream_extract_u16_array(struct bytestream * bs,
+                                  uint16_t u16[],
+                                  size_t len)
+{
+    const uint8_t * cursor = reserve_array(bs, u16, len, sizeof(uint16_t));
+    copy_swap16((uint8_t *)u16, cursor, len);
+}
+
+void bytestream_inject_u32_array(struct bytestream * bs,
+                                 const uint32_t u32[],
+                                 size_t len)
+{
+    uint8_t * cursor = reserve_array(bs, u32, len, sizeof(uint32_t));
+    copy_swap32(cursor, (const uint8_t *)u32, len);
+}
+
+void bytestream_extract_u32_array(struct bytestream * bs,
+                                  uint32_t u32[],
+                                  size_t len)
+{
+    const uint8_t * cursor = reserve_array(bs, u32, len, sizeof(uint32_t));
+    copy_swap32((uint8_t *)u32, cursor, len);
+}
+
+void bytestream_inject_f_array(struct bytestream * bs,
+                               const float f[],
+                               size_t len)
+{
+    // floats are sent as the bytes of a u32
+    uint8_t * cursor = reserve_array(bs, f, len, sizeof(float));
+    copy_swap32(cursor, (const uint8_t *)f, len);
+}
+
+void bytestream_extract_f_array(struct bytestream * bs,
+                                float f[],
+                                size_t len)
+{
+    const uint8_t * cursor = reserve_array(bs, f, len, sizeof(float));
+    copy_swap32((uint8_t *)f, cursor, len);
+}
+
+uint16_t bytestream_f32_to_f16(float f)
+{
+#if defined(__F16C__)
+    return _cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT);
+#else
+    uint32_t bits = 0;
+    memcpy(&bits, &f, sizeof(bits));
+    const uint16_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t exponent = (bits >> 23) & 0xFFu;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    if(0xFFu == exponent)
+    {
+        // infinity, or NaN (which stays a NaN)
+        return sign | 0x7C00u | (0 != mantissa ? 0x200u | (mantissa >> 13) : 0u);
+    }
+
+    // the exponent of the result, with the half precision bias
+    const int32_t half_exponent = (int32_t)exponent - 127 + 15;
+    if(half_exponent >= 0x1F)
+    {
+        return sign | 0x7C00u;
+    }
+
+    uint32_t shift = 13;
+    uint32_t half = 0;
+    if(half_exponent <= 0)
+    {
+        // subnormal: the implicit leading bit becomes explicit and the
+        // mantissa is shifted to an exponent of -14
+        if(half_exponent < -10)
+        {
+            return sign;
+        }
+        mantissa |= 0x800000u;
+        shift = 14 - half_exponent;
+        half = mantissa >> shift;
+    }
+    else
+    {
+        half = ((uint32_t)half_exponent << 10) | (mantissa >> shift);
+    }
+
+    // round to nearest, ties to even. A carry out of the mantissa correctly
+    // increments the exponent (or rounds up to infinity)
+    const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+    const uint32_t halfway = 1u << (shift - 1);
+    if(remainder > halfway || (remainder == halfway && (half & 1u)))
+    {
+        ++half;
+    }
+    return sign | (uint16_t)half;
+#endif
+}
+
+float bytestream_f16_to_f32(uint16_t f16)
+{
+#if defined(__F16C__)
+    return _cvtsh_ss(f16);
+#else
+    const uint32_t sign = (uint32_t)(f16 & 0x8000u) << 16;
+    uint32_t exponent = (f16 >> 10) & 0x1Fu;
+    uint32_t mantissa = f16 & 0x3FFu;
+
+    uint32_t bits = 0;
+    if(0x1Fu == exponent)
+    {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    }
+    else if(0 == exponent)
+    {
+        if(0 == mantissa)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // subnormal: normalize the mantissa
+            exponent = 127 - 15 + 1;
+            while(0 == (mantissa & 0x400u))
+            {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+        }
+    }
+    else
+    {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float f = 0.0f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+#endif
+}
+
+void bytestream_inject_f16(struct bytestream * bs, float f)
+{
+    bytestream_inject_u16(bs, bytestream_f32_to_f16(f));
+}
+
+float bytestream_extract_f16(struct bytestream * bs)
+{
+    return bytestream_f16_to_f32(bytestream_extract_u16(bs));
+}
+
+// scale a value to a fraction of a range, rounded and saturated to [low, high]
+static int32_t quantize(float f, float range, int32_t low, int32_t high)
+{
+    if(!(range > 0.0f))
+    {
+        error(FILE_LINE, "invalid param");
+    }
+
+    if(isnan(f))
+    {
+        return 0;
+    }
+
+    const float scaled = roundf(f / range * (float)high);
+    if(scaled <= (float)low)
+    {
+        return low;
+    }
+    if(scaled >= (float)high)
+    {
+        return high;
+    }
+    return (int32_t)scaled;
+}
+
+void bytestream_inject_q15(struct bytestream * bs, float f, float range)
+{
+    const int32_t q15 = quantize(f, range, -INT16_MAX, INT16_MAX);
+    bytestream_inject_u16(bs, (uint16_t)(int16_t)q15);
+}
+
+float bytestream_extract_q15(struct bytestream * bs, float range)
+{
+    const int16_t q15 = (int16_t)bytestream_extract_u16(bs);
+    return (float)q15 * range / (float)INT16_MAX;
+}
+
+void bytestream_inject_q16(struct bytestream * bs, float f, float range)
+{
+    const int32_t q16 = quantize(f, range, 0, UINT16_MAX);
+    bytestream_inject_u16(bs, (uint16_t)q16);
+}
+
+float bytestream_extract_q16(struct bytestream * bs, float range)
+{
+    return (float)bytestream_extract_u16(bs) * range / (float)UINT16_MAX;
+}
+
+size_t bytestream_varint_size(uint32_t u32)
+{
+    size_t len = 1;
+    while(u32 >= 0x80)
+    {
+        u32 >>= 7;
+        ++len;
+    }
+    return len;
+}
+
+void bytestream_inject_varint(struct bytestream * bs, uint32_t u32)
+{
+    uint8_t * cursor = bytestream_reserve(bs, bytestream_varint_size(u32));
+    while(u32 >= 0x80)
+    {
+        bytestream_put_u8(&cursor, (uint8_t)(u32 | 0x80));
+        u32 >>= 7;
+    }
+    bytestream_put_u8(&cursor, (uint8_t)u32);
+}
+
+uint32_t bytestream_extract_varint(struct bytestream * bs)
+{
+    verify_args(bs, 1);
+    const uint8_t * data = &bs->data[bs->size];
+    const size_t remaining = bs->capacity - bs->size;
+
+    if(remaining >= 4)
+    {
+        // read four bytes at once. Bytes without the continuation bit set end
+        // the varint, so the lowest one gives its length
+        const uint32_t word = (uint32_t)data[0]
+            | ((uint32_t)data[1] << 8)
+            | ((uint32_t)data[2] << 16)
+            | ((uint32_t)data[3] << 24);
+        const uint32_t ends = ~word & 0x80808080u;
+        if(0 != ends)
+        {
+            const uint32_t len = ((uint32_t)__builtin_ctz(ends) >> 3) + 1u;
+            const uint32_t bytes = word & (0xFFFFFFFFu >> (32u - 8u * len));
+
+            // squeeze out the continuation bits
+            const uint32_t value = (bytes & 0x7Fu)
+                | ((bytes >> 1) & 0x3F80u)
+                | ((bytes >> 2) & 0x1FC000u)
+                | ((bytes >> 3) & 0xFE00000u);
+            bs->size += len;
+            return value;
+        }
+    }
+
+    // five byte varints and the end of the stream
+    uint32_t value = 0;
+    for(size_t i = 0; i != BYTESTREAM_VARINT_MAX_BYTES; ++i)
+    {
+        if(i == remaining)
+        {
+            error(FILE_LINE, "overflow");
+        }
+
+        // the fifth byte holds the last four bits
+        if(BYTESTREAM_VARINT_MAX_BYTES - 1 == i && data[i] > 0x0F)
+        {
+            break;
+        }
+
+        value |= (uint32_t)(data[i] & 0x7F) << (7 * i);
+        if(0 == (data[i] & 0x80))
+        {
+            bs->size += i + 1;
+            return value;
+        }
+    }
+    error(FILE_LINE, "invalid varint");
+}
+
+void bytestream_inject_zigzag(struct bytestream * bs, int32_t i32)
+{
+    bytestream_inject_varint(bs, bytestream_zigzag_encode(i32));
+}
+
+int32_t bytestream_extract_zigzag(struct bytestream * bs)
+{
+    return bytestream_zigzag_decode(bytestream_extract_varint(bs));
+}
+
+uint8_t * bytestream_reserve(struct bytestream * bs, size_t len)
+{
+    verify_args(bs, len);
+    uint8_t * cursor = &bs->data[bs->size];
+    bs->size += len;
+    return cursor;
 }
 
 void bytestream_inject_u8_array(struct bytestream * bs,
@@ -175,7 +585,7 @@ void bytestream_inject_u8_array(struct bytestream * bs,
     {
         error(FILE_LINE, "NULL ptr");
     }
-    if(bs->capacity - bs->size <= len)
+    if(bs->capacity - bs->size < len)
     {
         error(FILE_LINE, "buffer overrun");
     }
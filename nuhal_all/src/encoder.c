@@ -1,6 +1,7 @@
 #include "nuhal/encoder.h"
 #include "nuhal/error.h"
 #include "nuhal/bytestream.h"
+#include "nuhal/serialize.h"
 
 int32_t encoder_ticks(const struct encoder * enc, struct encoder_raw raw)
 {
@@ -104,60 +105,11 @@ uint32_t encoder_zero_raw(const struct encoder * enc,
     }
 }
 
-void encoder_joints_inject(struct bytestream * bs,
-                          const struct encoder_joints * enc)
-{
-    if(!bs || !enc)
-    {
-        error(FILE_LINE, "NULL ptr");
-    }
-    bytestream_inject_i32(bs, enc->before_ticks);
-    bytestream_inject_f(bs, enc->before_radians);
-    bytestream_inject_i32(bs, enc->after_ticks);
-    bytestream_inject_f(bs, enc->after_radians);
-}
-
-void encoder_joints_extract(struct bytestream * bs,
-                           struct encoder_joints * out)
-{
-    if(!bs || !out)
-    {
-        error(FILE_LINE, "NULL ptr");
-    }
-    out->before_ticks = bytestream_extract_i32(bs);
-    out->before_radians = bytestream_extract_f(bs);
-    out->after_ticks = bytestream_extract_i32(bs);
-    out->after_radians = bytestream_extract_f(bs);
-}
+// not versioned, so that the layouts stay compatible with existing firmware
+SERIALIZE_DEFINE(encoder_joints, struct encoder_joints, ENCODER_JOINTS_FIELDS, false)
 
-void encoder_gimbal_inject(struct bytestream * bs,
-                          const struct encoder_gimbal * enc)
-{
-    if(!bs || !enc)
-    {
-        error(FILE_LINE, "NULL ptr");
-    }
-    bytestream_inject_i32(bs, enc->x_ticks);
-    bytestream_inject_i32(bs, enc->y_ticks);
-    bytestream_inject_i32(bs, enc->z_ticks);
+SERIALIZE_DEFINE(encoder_gimbal, struct encoder_gimbal, ENCODER_GIMBAL_FIELDS, false)
 
-    bytestream_inject_f(bs, enc->x_radians);
-    bytestream_inject_f(bs, enc->y_radians);
-    bytestream_inject_f(bs, enc->z_radians);
-}
+SERIALIZE_DEFINE(encoder_joints_f16, struct encoder_joints, ENCODER_JOINTS_F16_FIELDS, false)
 
-void encoder_gimbal_extract(struct bytestream * bs,
-                           struct encoder_gimbal * out)
-{
-    if(!bs || !out)
-    {
-        error(FILE_LINE, "NULL ptr");
-    }
-    out->x_ticks = bytestream_extract_i32(bs);
-    out->y_ticks = bytestream_extract_i32(bs);
-    out->z_ticks = bytestream_extract_i32(bs);
-
-    out->x_radians = bytestream_extract_f(bs);
-    out->y_radians = bytestream_extract_f(bs);
-    out->z_radians = bytestream_extract_f(bs);
-}
+SERIALIZE_DEFINE(encoder_gimbal_f16, struct encoder_gimbal, ENCODER_GIMBAL_F16_FIELDS, false)
@@ -2,6 +2,7 @@
 #include "nuhal/error.h"
 #include "nuhal/time.h"
 #include "nuhal/bytestream.h"
+#include "nuhal/bitstream.h"
 
 void led_error_basic(void)
 {
@@ -60,3 +61,25 @@ enum led_color led_color_extract(struct bytestream * bs)
     }
     return color;
 }
+
+void led_color_put(struct bitstream * bits, enum led_color color)
+{
+    if(!bits)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    if(color > 0x7)
+    {
+        error(FILE_LINE, "invalid color");
+    }
+    bitstream_put(bits, color, LED_COLOR_BITS);
+}
+
+enum led_color led_color_get(struct bitstream * bits)
+{
+    if(!bits)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    return (enum led_color)bitstream_get(bits, LED_COLOR_BITS);
+}
@@ -1,5 +1,162 @@
 #include "nuhal/matrix.h"
+#include "nuhal/matrix_generic.h"
 #include "nuhal/error.h"
+#include <math.h>
+
+// the scalar products of the shapes in matrix.h, with and without transposing
+MATRIX_GENERIC_DEFINE(kernel_3x3, 3, 3)
+MATRIX_GENERIC_DEFINE(kernel_4x3, 4, 3)
+MATRIX_GENERIC_DEFINE(kernel_6x6, 6, 6)
+
+// The products below have SIMD versions for hosts with SSE (x86) or NEON
+// (ARM), written with the vec4 functions. Each lane performs the same
+// multiplications and additions, in the same order, as the scalar code, so
+// the results are identical. The tiva has neither, and its DSP extensions
+// operate on integers, so it uses the scalar code. The product of a 3x3
+// matrix and a vector is always scalar: gathering the columns of A into
+// vectors takes longer than the three multiplications it saves.
+#if defined(__SSE__) || defined(__ARM_NEON)
+#define MATRIX_SIMD
+#endif
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+typedef __m128 vec4;
+
+static inline vec4 vec4_set(float a, float b, float c, float d)
+{
+    return _mm_setr_ps(a, b, c, d);
+}
+
+static inline vec4 vec4_splat(float a)
+{
+    return _mm_set1_ps(a);
+}
+
+static inline vec4 vec4_load(const float * p)
+{
+    return _mm_loadu_ps(p);
+}
+
+static inline void vec4_store(float * p, vec4 a)
+{
+    _mm_storeu_ps(p, a);
+}
+
+static inline vec4 vec4_mul(vec4 a, vec4 b)
+{
+    return _mm_mul_ps(a, b);
+}
+
+static inline vec4 vec4_add(vec4 a, vec4 b)
+{
+    return _mm_add_ps(a, b);
+}
+
+static inline vec4 vec4_sub(vec4 a, vec4 b)
+{
+    return _mm_sub_ps(a, b);
+}
+
+// turn four rows into four columns
+static inline void vec4_transpose(vec4 r[4])
+{
+    _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+}
+
+// load three floats into the first lanes of a vector
+static inline vec4 vec4_load3(const float p[3])
+{
+    return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)p),
+                         _mm_load_ss(&p[2]));
+}
+
+// store the first three lanes of a vector
+static inline void vec4_store3(float p[3], vec4 a)
+{
+    _mm_storel_pi((__m64 *)p, a);
+    _mm_store_ss(&p[2], _mm_movehl_ps(a, a));
+}
+
+// rotate the first three lanes: (a1, a2, a0)
+static inline vec4 vec4_yzx(vec4 a)
+{
+    return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+}
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+typedef float32x4_t vec4;
+
+static inline vec4 vec4_set(float a, float b, float c, float d)
+{
+    const float lanes[4] = {a, b, c, d};
+    return vld1q_f32(lanes);
+}
+
+static inline vec4 vec4_splat(float a)
+{
+    return vdupq_n_f32(a);
+}
+
+static inline vec4 vec4_load(const float * p)
+{
+    return vld1q_f32(p);
+}
+
+static inline void vec4_store(float * p, vec4 a)
+{
+    vst1q_f32(p, a);
+}
+
+// separate multiply and add (not vmlaq or vfmaq), which round the product
+// like the scalar code does
+static inline vec4 vec4_mul(vec4 a, vec4 b)
+{
+    return vmulq_f32(a, b);
+}
+
+static inline vec4 vec4_add(vec4 a, vec4 b)
+{
+    return vaddq_f32(a, b);
+}
+
+static inline vec4 vec4_sub(vec4 a, vec4 b)
+{
+    return vsubq_f32(a, b);
+}
+
+// turn four rows into four columns
+static inline void vec4_transpose(vec4 r[4])
+{
+    const float32x4x2_t r01 = vtrnq_f32(r[0], r[1]);
+    const float32x4x2_t r23 = vtrnq_f32(r[2], r[3]);
+    r[0] = vcombine_f32(vget_low_f32(r01.val[0]), vget_low_f32(r23.val[0]));
+    r[1] = vcombine_f32(vget_low_f32(r01.val[1]), vget_low_f32(r23.val[1]));
+    r[2] = vcombine_f32(vget_high_f32(r01.val[0]), vget_high_f32(r23.val[0]));
+    r[3] = vcombine_f32(vget_high_f32(r01.val[1]), vget_high_f32(r23.val[1]));
+}
+
+// load three floats into the first lanes of a vector
+static inline vec4 vec4_load3(const float p[3])
+{
+    return vcombine_f32(vld1_f32(p), vld1_lane_f32(&p[2], vdup_n_f32(0.0f), 0));
+}
+
+// store the first three lanes of a vector
+static inline void vec4_store3(float p[3], vec4 a)
+{
+    vst1_f32(p, vget_low_f32(a));
+    vst1q_lane_f32(&p[2], a, 2);
+}
+
+// rotate the first three lanes: (a1, a2, a0)
+static inline vec4 vec4_yzx(vec4 a)
+{
+    return vcombine_f32(vext_f32(vget_low_f32(a), vget_high_f32(a), 1),
+                        vget_low_f32(a));
+}
+#endif
+
 
 void matrix_3x3_init(struct matrix_3x3 * out,
                      float a11, float a12, float a13,
@@ -161,21 +318,11 @@ void  matrix_3x3_multiply_vector(const struct matrix_3x3 * A,
 
     if(A->transpose)
     {
-        v->data[0] = A->data[0][0]*x->data[0] + A->data[1][0]*x->data[1]
-            + A->data[2][0]*x->data[2];
-        v->data[1] = A->data[0][1]*x->data[0] + A->data[1][1]*x->data[1]
-            + A->data[2][1]*x->data[2];
-        v->data[2] = A->data[0][2]*x->data[0] + A->data[1][2]*x->data[1]
-            + A->data[2][2]*x->data[2];
+        kernel_3x3_transpose_multiply_vector(&A->data[0][0], x->data, v->data);
     }
     else
     {
-        v->data[0] = A->data[0][0]*x->data[0] + A->data[0][1]*x->data[1]
-            + A->data[0][2]*x->data[2];
-        v->data[1] = A->data[1][0]*x->data[0] + A->data[1][1]*x->data[1]
-            + A->data[1][2]*x->data[2];
-        v->data[2] = A->data[2][0]*x->data[0] + A->data[2][1]*x->data[1]
-            + A->data[2][2]*x->data[2];
+        kernel_3x3_multiply_vector(&A->data[0][0], x->data, v->data);
     }
 }
 
@@ -194,14 +341,21 @@ void matrix_4x3_3x1_multiply_vector(const struct matrix_4x3 * A,
         error(FILE_LINE, "Invalid shape");
     }
 
-    v->data[0] = A->data[0][0]*x->data[0] + A->data[0][1]*x->data[1]
-        + A->data[0][2]*x->data[2];
-    v->data[1] = A->data[1][0]*x->data[0] + A->data[1][1]*x->data[1]
-        + A->data[1][2]*x->data[2];
-    v->data[2] = A->data[2][0]*x->data[0] + A->data[2][1]*x->data[1]
-        + A->data[2][2]*x->data[2];
-    v->data[3] = A->data[3][0]*x->data[0] + A->data[3][1]*x->data[1]
-        + A->data[3][2]*x->data[2];
+#if defined(MATRIX_SIMD)
+    // v is the sum of the columns of A, weighted by the elements of x
+    vec4 sum = vec4_mul(
+        vec4_set(A->data[0][0], A->data[1][0], A->data[2][0], A->data[3][0]),
+        vec4_splat(x->data[0]));
+    sum = vec4_add(sum, vec4_mul(
+        vec4_set(A->data[0][1], A->data[1][1], A->data[2][1], A->data[3][1]),
+        vec4_splat(x->data[1])));
+    sum = vec4_add(sum, vec4_mul(
+        vec4_set(A->data[0][2], A->data[1][2], A->data[2][2], A->data[3][2]),
+        vec4_splat(x->data[2])));
+    vec4_store(v->data, sum);
+#else
+    kernel_4x3_multiply_vector(&A->data[0][0], x->data, v->data);
+#endif
 }
 
 void matrix_4x3T_4x1_multiply_vector(const struct matrix_4x3 * A,
@@ -219,13 +373,42 @@ void matrix_4x3T_4x1_multiply_vector(const struct matrix_4x3 * A,
     error(FILE_LINE, "Invalid shape");
   }
 
-  v->data[0] = A->data[0][0]*x->data[0] + A->data[1][0]*x->data[1]
-      + A->data[2][0]*x->data[2] + A->data[3][0]*x->data[3];
-  v->data[1] = A->data[0][1]*x->data[0] + A->data[1][1]*x->data[1]
-      + A->data[2][1]*x->data[2] + A->data[3][1]*x->data[3];
-  v->data[2] = A->data[0][2]*x->data[0] + A->data[1][2]*x->data[1]
-      + A->data[2][2]*x->data[2] + A->data[3][2]*x->data[3];
+#if defined(MATRIX_SIMD)
+  // v is the sum of the rows of A, weighted by the elements of x
+  vec4 sum = vec4_mul(vec4_load3(A->data[0]), vec4_splat(x->data[0]));
+  sum = vec4_add(sum, vec4_mul(vec4_load3(A->data[1]), vec4_splat(x->data[1])));
+  sum = vec4_add(sum, vec4_mul(vec4_load3(A->data[2]), vec4_splat(x->data[2])));
+  sum = vec4_add(sum, vec4_mul(vec4_load3(A->data[3]), vec4_splat(x->data[3])));
+  vec4_store3(v->data, sum);
+#else
+  kernel_4x3_transpose_multiply_vector(&A->data[0][0], x->data, v->data);
+#endif
+}
+
+#if defined(MATRIX_SIMD)
+// multiply four rows of a 6x6 matrix by a vector: the sum of the columns of
+// the rows, weighted by the elements of x. The columns are found by
+// transposing the blocks of columns 0-3 and 2-5
+static inline vec4 matrix_6x6_multiply_rows(const struct matrix_6x6 * A,
+                                            const struct matrix_6x1 * x,
+                                            unsigned int r0, unsigned int r1,
+                                            unsigned int r2, unsigned int r3)
+{
+    vec4 left[4] = {vec4_load(&A->data[r0][0]), vec4_load(&A->data[r1][0]),
+                    vec4_load(&A->data[r2][0]), vec4_load(&A->data[r3][0])};
+    vec4 right[4] = {vec4_load(&A->data[r0][2]), vec4_load(&A->data[r1][2]),
+                     vec4_load(&A->data[r2][2]), vec4_load(&A->data[r3][2])};
+    vec4_transpose(left);
+    vec4_transpose(right);
+
+    vec4 sum = vec4_mul(left[0], vec4_splat(x->data[0]));
+    sum = vec4_add(sum, vec4_mul(left[1], vec4_splat(x->data[1])));
+    sum = vec4_add(sum, vec4_mul(left[2], vec4_splat(x->data[2])));
+    sum = vec4_add(sum, vec4_mul(left[3], vec4_splat(x->data[3])));
+    sum = vec4_add(sum, vec4_mul(right[2], vec4_splat(x->data[4])));
+    return vec4_add(sum, vec4_mul(right[3], vec4_splat(x->data[5])));
 }
+#endif
 
 void matrix_6x6_multiply_vector(const struct matrix_6x6 * A,
                                     const struct matrix_6x1 * x,
@@ -236,24 +419,25 @@ void matrix_6x6_multiply_vector(const struct matrix_6x6 * A,
         error(FILE_LINE, "NULL ptr");
     }
 
-    v->data[0] = A->data[0][0]*x->data[0] + A->data[0][1]*x->data[1]
-        + A->data[0][2]*x->data[2] + A->data[0][3]*x->data[3]
-        + A->data[0][4]*x->data[4] + A->data[0][5]*x->data[5];
-    v->data[1] = A->data[1][0]*x->data[0] + A->data[1][1]*x->data[1]
-        + A->data[1][2]*x->data[2] + A->data[1][3]*x->data[3]
-        + A->data[1][4]*x->data[4] + A->data[1][5]*x->data[5];
-    v->data[2] = A->data[2][0]*x->data[0] + A->data[2][1]*x->data[1]
-        + A->data[2][2]*x->data[2] + A->data[2][3]*x->data[3]
-        + A->data[2][4]*x->data[4] + A->data[2][5]*x->data[5];
-    v->data[3] = A->data[3][0]*x->data[0] + A->data[3][1]*x->data[1]
-        + A->data[3][2]*x->data[2] + A->data[3][3]*x->data[3]
-        + A->data[3][4]*x->data[4] + A->data[3][5]*x->data[5];
-    v->data[4] = A->data[4][0]*x->data[0] + A->data[4][1]*x->data[1]
-        + A->data[4][2]*x->data[2] + A->data[4][3]*x->data[3]
-        + A->data[4][4]*x->data[4] + A->data[4][5]*x->data[5];
-    v->data[5] = A->data[5][0]*x->data[0] + A->data[5][1]*x->data[1]
-        + A->data[5][2]*x->data[2] + A->data[5][3]*x->data[3]
-        + A->data[5][4]*x->data[4] + A->data[5][5]*x->data[5];
+    if(A->transpose)
+    {
+        kernel_6x6_transpose_multiply_vector(&A->data[0][0], x->data, v->data);
+        return;
+    }
+
+#if defined(MATRIX_SIMD)
+    // the first four rows fill one vector, and the last two (repeated)
+    // another
+    float result[8];
+    vec4_store(&result[0], matrix_6x6_multiply_rows(A, x, 0, 1, 2, 3));
+    vec4_store(&result[4], matrix_6x6_multiply_rows(A, x, 4, 5, 4, 5));
+    for(unsigned int i = 0; i != 6; ++i)
+    {
+        v->data[i] = result[i];
+    }
+#else
+    kernel_6x6_multiply_vector(&A->data[0][0], x->data, v->data);
+#endif
 }
 
 void matrix_3x1_cross(const struct matrix_3x1 * w,
@@ -265,9 +449,17 @@ void matrix_3x1_cross(const struct matrix_3x1 * w,
         error(FILE_LINE, "NULL ptr");
     }
 
+#if defined(MATRIX_SIMD)
+    // (w0 v1 - w1 v0, w1 v2 - w2 v1, w2 v0 - w0 v2), rotated into place
+    const vec4 a = vec4_load3(w->data);
+    const vec4 b = vec4_load3(v->data);
+    const vec4 c = vec4_sub(vec4_mul(a, vec4_yzx(b)), vec4_mul(vec4_yzx(a), b));
+    vec4_store3(out->data, vec4_yzx(c));
+#else
     out->data[0] = (w->data[1] * v->data[2]) - (v->data[1] * w->data[2]);
     out->data[1] = (v->data[0] * w->data[2]) - (w->data[0] * v->data[2]);
     out->data[2] = (w->data[0] * v->data[1]) - (v->data[0] * w->data[1]);
+#endif
 }
 
 void matrix_3x3_multiply_matrix(const struct matrix_3x3 * A,
@@ -279,6 +471,24 @@ void matrix_3x3_multiply_matrix(const struct matrix_3x3 * A,
         error(FILE_LINE, "NULL ptr");
     }
 
+#if defined(MATRIX_SIMD)
+    // each row of v is the sum of the rows of x, weighted by the elements
+    // of the row of A
+    const vec4 x0 = vec4_load3(x->data[0]);
+    const vec4 x1 = vec4_load3(x->data[1]);
+    const vec4 x2 = vec4_load3(x->data[2]);
+    vec4 rows[3];
+    for(unsigned int row = 0; row != 3; ++row)
+    {
+        rows[row] = vec4_mul(vec4_splat(A->data[row][0]), x0);
+        rows[row] = vec4_add(rows[row], vec4_mul(vec4_splat(A->data[row][1]), x1));
+        rows[row] = vec4_add(rows[row], vec4_mul(vec4_splat(A->data[row][2]), x2));
+    }
+    for(unsigned int row = 0; row != 3; ++row)
+    {
+        vec4_store3(v->data[row], rows[row]);
+    }
+#else
     v->data[0][0] = A->data[0][0]*x->data[0][0] + A->data[0][1]*x->data[1][0] + A->data[0][2]*x->data[2][0];
     v->data[0][1] = A->data[0][0]*x->data[0][1] + A->data[0][1]*x->data[1][1] + A->data[0][2]*x->data[2][1];
     v->data[0][2] = A->data[0][0]*x->data[0][2] + A->data[0][1]*x->data[1][2] + A->data[0][2]*x->data[2][2];
@@ -290,4 +500,531 @@ void matrix_3x3_multiply_matrix(const struct matrix_3x3 * A,
     v->data[2][0] = A->data[2][0]*x->data[0][0] + A->data[2][1]*x->data[1][0] + A->data[2][2]*x->data[2][0];
     v->data[2][1] = A->data[2][0]*x->data[0][1] + A->data[2][1]*x->data[1][1] + A->data[2][2]*x->data[2][1];
     v->data[2][2] = A->data[2][0]*x->data[0][2] + A->data[2][1]*x->data[1][2] + A->data[2][2]*x->data[2][2];
+#endif
+}
+
+// check the arguments common to the batch functions
+static void matrix_batch_check(const float * a,
+                               const float * b,
+                               const float * out,
+                               size_t count,
+                               size_t stride)
+{
+    if(!a || !b || !out)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(count > stride)
+    {
+        error(FILE_LINE, "Invalid shape");
+    }
+}
+
+// The batch functions vectorize across items: lane j of a vector holds item
+// i + j, so the elements of an item are loaded from consecutive addresses
+// without any gathering. The items left over after the last full vector use
+// the scalar code, which is also used for whole batches on the tiva.
+
+void matrix_3x3_multiply_vector_batch(const float A[],
+                                      const float x[],
+                                      float v[],
+                                      size_t count,
+                                      size_t stride)
+{
+    matrix_batch_check(A, x, v, count, stride);
+
+    size_t i = 0;
+#if defined(MATRIX_SIMD)
+    for(; count - i >= 4; i += 4)
+    {
+        const vec4 x0 = vec4_load(&x[0*stride + i]);
+        const vec4 x1 = vec4_load(&x[1*stride + i]);
+        const vec4 x2 = vec4_load(&x[2*stride + i]);
+        for(unsigned int row = 0; row != 3; ++row)
+        {
+            vec4 sum = vec4_mul(vec4_load(&A[(3*row + 0)*stride + i]), x0);
+            sum = vec4_add(sum, vec4_mul(vec4_load(&A[(3*row + 1)*stride + i]), x1));
+            sum = vec4_add(sum, vec4_mul(vec4_load(&A[(3*row + 2)*stride + i]), x2));
+            vec4_store(&v[row*stride + i], sum);
+        }
+    }
+#endif
+    for(; i != count; ++i)
+    {
+        for(unsigned int row = 0; row != 3; ++row)
+        {
+            v[row*stride + i] = A[(3*row + 0)*stride + i]*x[0*stride + i]
+                + A[(3*row + 1)*stride + i]*x[1*stride + i]
+                + A[(3*row + 2)*stride + i]*x[2*stride + i];
+        }
+    }
+}
+
+void matrix_6x6_multiply_vector_batch(const float A[],
+                                      const float x[],
+                                      float v[],
+                                      size_t count,
+                                      size_t stride)
+{
+    matrix_batch_check(A, x, v, count, stride);
+
+    size_t i = 0;
+#if defined(MATRIX_SIMD)
+    for(; count - i >= 4; i += 4)
+    {
+        const vec4 x0 = vec4_load(&x[0*stride + i]);
+        const vec4 x1 = vec4_load(&x[1*stride + i]);
+        const vec4 x2 = vec4_load(&x[2*stride + i]);
+        const vec4 x3 = vec4_load(&x[3*stride + i]);
+        const vec4 x4 = vec4_load(&x[4*stride + i]);
+        const vec4 x5 = vec4_load(&x[5*stride + i]);
+        for(unsigned int row = 0; row != 6; ++row)
+        {
+            const float * a = &A[6*row*stride + i];
+            vec4 sum = vec4_mul(vec4_load(&a[0*stride]), x0);
+            sum = vec4_add(sum, vec4_mul(vec4_load(&a[1*stride]), x1));
+            sum = vec4_add(sum, vec4_mul(vec4_load(&a[2*stride]), x2));
+            sum = vec4_add(sum, vec4_mul(vec4_load(&a[3*stride]), x3));
+            sum = vec4_add(sum, vec4_mul(vec4_load(&a[4*stride]), x4));
+            sum = vec4_add(sum, vec4_mul(vec4_load(&a[5*stride]), x5));
+            vec4_store(&v[row*stride + i], sum);
+        }
+    }
+#endif
+    for(; i != count; ++i)
+    {
+        for(unsigned int row = 0; row != 6; ++row)
+        {
+            float sum = A[(6*row + 0)*stride + i]*x[0*stride + i];
+            for(unsigned int col = 1; col != 6; ++col)
+            {
+                sum += A[(6*row + col)*stride + i]*x[col*stride + i];
+            }
+            v[row*stride + i] = sum;
+        }
+    }
+}
+
+void matrix_3x1_cross_batch(const float w[],
+                            const float v[],
+                            float out[],
+                            size_t count,
+                            size_t stride)
+{
+    matrix_batch_check(w, v, out, count, stride);
+
+    size_t i = 0;
+#if defined(MATRIX_SIMD)
+    for(; count - i >= 4; i += 4)
+    {
+        const vec4 w0 = vec4_load(&w[0*stride + i]);
+        const vec4 w1 = vec4_load(&w[1*stride + i]);
+        const vec4 w2 = vec4_load(&w[2*stride + i]);
+        const vec4 v0 = vec4_load(&v[0*stride + i]);
+        const vec4 v1 = vec4_load(&v[1*stride + i]);
+        const vec4 v2 = vec4_load(&v[2*stride + i]);
+        vec4_store(&out[0*stride + i], vec4_sub(vec4_mul(w1, v2), vec4_mul(v1, w2)));
+        vec4_store(&out[1*stride + i], vec4_sub(vec4_mul(v0, w2), vec4_mul(w0, v2)));
+        vec4_store(&out[2*stride + i], vec4_sub(vec4_mul(w0, v1), vec4_mul(v0, w1)));
+    }
+#endif
+    for(; i != count; ++i)
+    {
+        const float w0 = w[0*stride + i];
+        const float w1 = w[1*stride + i];
+        const float w2 = w[2*stride + i];
+        const float v0 = v[0*stride + i];
+        const float v1 = v[1*stride + i];
+        const float v2 = v[2*stride + i];
+        out[0*stride + i] = (w1 * v2) - (v1 * w2);
+        out[1*stride + i] = (v0 * w2) - (w0 * v2);
+        out[2*stride + i] = (w0 * v1) - (v0 * w1);
+    }
+}
+
+// element (row, col) of a 3x3 matrix, taking the transpose flag into account
+static float matrix_3x3_at(const struct matrix_3x3 * A,
+                           unsigned int row,
+                           unsigned int col)
+{
+    return A->transpose ? A->data[col][row] : A->data[row][col];
+}
+
+// copy a 6x6 matrix, taking the transpose flag into account. Returns the
+// magnitude of its largest element
+static float matrix_6x6_copy(const struct matrix_6x6 * A, float out[6][6])
+{
+    float scale = 0.0f;
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int row = 0; row != 6; ++row)
+    {
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int col = 0; col != 6; ++col)
+        {
+            out[row][col] = A->transpose ? A->data[col][row] : A->data[row][col];
+            scale = fabsf(out[row][col]) > scale ? fabsf(out[row][col]) : scale;
+        }
+    }
+    return scale;
+}
+
+// find the adjugate (the transpose of the matrix of cofactors) and the
+// determinant of a 3x3 matrix. Returns false if the matrix is singular
+static bool matrix_3x3_adjugate(const struct matrix_3x3 * A,
+                                float adj[3][3],
+                                float * det)
+{
+    float a[3][3];
+    float scale = 0.0f;
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int row = 0; row != 3; ++row)
+    {
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int col = 0; col != 3; ++col)
+        {
+            a[row][col] = matrix_3x3_at(A, row, col);
+            scale = fabsf(a[row][col]) > scale ? fabsf(a[row][col]) : scale;
+        }
+    }
+
+    adj[0][0] = a[1][1]*a[2][2] - a[1][2]*a[2][1];
+    adj[1][0] = a[1][2]*a[2][0] - a[1][0]*a[2][2];
+    adj[2][0] = a[1][0]*a[2][1] - a[1][1]*a[2][0];
+
+    adj[0][1] = a[0][2]*a[2][1] - a[0][1]*a[2][2];
+    adj[1][1] = a[0][0]*a[2][2] - a[0][2]*a[2][0];
+    adj[2][1] = a[0][1]*a[2][0] - a[0][0]*a[2][1];
+
+    adj[0][2] = a[0][1]*a[1][2] - a[0][2]*a[1][1];
+    adj[1][2] = a[0][2]*a[1][0] - a[0][0]*a[1][2];
+    adj[2][2] = a[0][0]*a[1][1] - a[0][1]*a[1][0];
+
+    // expand along the first row. The determinant is the product of three
+    // pivots, so it is compared to the cube of the largest element
+    *det = a[0][0]*adj[0][0] + a[0][1]*adj[1][0] + a[0][2]*adj[2][0];
+    return fabsf(*det) > MATRIX_SOLVE_TOLERANCE * scale * scale * scale;
+}
+
+enum matrix_status matrix_3x3_inverse(const struct matrix_3x3 * A,
+                                      struct matrix_3x3 * inverse)
+{
+    if(!A || !inverse)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    float adj[3][3];
+    float det;
+    if(!matrix_3x3_adjugate(A, adj, &det))
+    {
+        return MATRIX_STATUS_SINGULAR;
+    }
+
+    const float inv_det = 1.0f / det;
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int row = 0; row != 3; ++row)
+    {
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int col = 0; col != 3; ++col)
+        {
+            inverse->data[row][col] = adj[row][col] * inv_det;
+        }
+    }
+    inverse->transpose = false;
+    return MATRIX_STATUS_OK;
+}
+
+enum matrix_status matrix_3x3_solve(const struct matrix_3x3 * A,
+                                    const struct matrix_3x1 * b,
+                                    struct matrix_3x1 * x)
+{
+    if(!A || !b || !x)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    float adj[3][3];
+    float det;
+    if(!matrix_3x3_adjugate(A, adj, &det))
+    {
+        return MATRIX_STATUS_SINGULAR;
+    }
+
+    float y[3];
+    kernel_3x3_multiply_vector(&adj[0][0], b->data, y);
+    const float inv_det = 1.0f / det;
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int i = 0; i != 3; ++i)
+    {
+        x->data[i] = y[i] * inv_det;
+    }
+    return MATRIX_STATUS_OK;
+}
+
+enum matrix_status matrix_6x6_lu_factor(const struct matrix_6x6 * A,
+                                        struct matrix_6x6_lu * lu)
+{
+    if(!A || !lu)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    float m[6][6];
+    unsigned char pivot[6] = {0, 1, 2, 3, 4, 5};
+    const float scale = matrix_6x6_copy(A, m);
+
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int k = 0; k != 6; ++k)
+    {
+        // use the remaining row with the largest element in this column
+        unsigned int p = k;
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int row = k + 1; row < 6; ++row)
+        {
+            p = fabsf(m[row][k]) > fabsf(m[p][k]) ? row : p;
+        }
+
+        if(!(fabsf(m[p][k]) > MATRIX_SOLVE_TOLERANCE * scale))
+        {
+            return MATRIX_STATUS_SINGULAR;
+        }
+
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int col = 0; col != 6; ++col)
+        {
+            const float swap = m[k][col];
+            m[k][col] = m[p][col];
+            m[p][col] = swap;
+        }
+        const unsigned char swap = pivot[k];
+        pivot[k] = pivot[p];
+        pivot[p] = swap;
+
+        // eliminate the column below the pivot, keeping the multipliers
+        const float inv_pivot = 1.0f / m[k][k];
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int row = k + 1; row < 6; ++row)
+        {
+            const float factor = m[row][k] * inv_pivot;
+            m[row][k] = factor;
+            MATRIX_GENERIC_UNROLL
+            for(unsigned int col = k + 1; col < 6; ++col)
+            {
+                m[row][col] -= factor * m[k][col];
+            }
+        }
+    }
+
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int row = 0; row != 6; ++row)
+    {
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int col = 0; col != 6; ++col)
+        {
+            lu->data[row][col] = m[row][col];
+        }
+        lu->pivot[row] = pivot[row];
+    }
+    return MATRIX_STATUS_OK;
+}
+
+void matrix_6x6_lu_solve(const struct matrix_6x6_lu * lu,
+                         const struct matrix_6x1 * b,
+                         struct matrix_6x1 * x)
+{
+    if(!lu || !b || !x)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    // L y = P b, then U x = y
+    float y[6];
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int row = 0; row != 6; ++row)
+    {
+        float sum = b->data[lu->pivot[row]];
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int col = 0; col < row; ++col)
+        {
+            sum -= lu->data[row][col] * y[col];
+        }
+        y[row] = sum;
+    }
+
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int i = 0; i != 6; ++i)
+    {
+        const unsigned int row = 5 - i;
+        float sum = y[row];
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int col = row + 1; col < 6; ++col)
+        {
+            sum -= lu->data[row][col] * y[col];
+        }
+        y[row] = sum / lu->data[row][row];
+    }
+
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int i = 0; i != 6; ++i)
+    {
+        x->data[i] = y[i];
+    }
+}
+
+enum matrix_status matrix_6x6_solve(const struct matrix_6x6 * A,
+                                    const struct matrix_6x1 * b,
+                                    struct matrix_6x1 * x)
+{
+    if(!A || !b || !x)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    struct matrix_6x6_lu lu;
+    const enum matrix_status status = matrix_6x6_lu_factor(A, &lu);
+    if(MATRIX_STATUS_OK == status)
+    {
+        matrix_6x6_lu_solve(&lu, b, x);
+    }
+    return status;
+}
+
+enum matrix_status matrix_6x6_inverse(const struct matrix_6x6 * A,
+                                      struct matrix_6x6 * inverse)
+{
+    if(!A || !inverse)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    struct matrix_6x6_lu lu;
+    const enum matrix_status status = matrix_6x6_lu_factor(A, &lu);
+    if(MATRIX_STATUS_OK != status)
+    {
+        return status;
+    }
+
+    // each column of the inverse solves A x = e, for a column e of I
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int col = 0; col != 6; ++col)
+    {
+        struct matrix_6x1 e = {{0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f}};
+        e.data[col] = 1.0f;
+        struct matrix_6x1 column;
+        matrix_6x6_lu_solve(&lu, &e, &column);
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int row = 0; row != 6; ++row)
+        {
+            inverse->data[row][col] = column.data[row];
+        }
+    }
+    inverse->transpose = false;
+    return MATRIX_STATUS_OK;
+}
+
+enum matrix_status matrix_6x6_cholesky_factor(const struct matrix_6x6 * A,
+                                              struct matrix_6x6 * L)
+{
+    if(!A || !L)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    float m[6][6];
+    (void)matrix_6x6_copy(A, m);
+    float scale = 0.0f;
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int i = 0; i != 6; ++i)
+    {
+        scale = fabsf(m[i][i]) > scale ? fabsf(m[i][i]) : scale;
+    }
+
+    // m is overwritten, column by column, with L
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int col = 0; col != 6; ++col)
+    {
+        float diagonal = m[col][col];
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int k = 0; k < col; ++k)
+        {
+            diagonal -= m[col][k] * m[col][k];
+        }
+
+        // the diagonal is the square of the pivot; negative values and NaN
+        // also fail this test
+        if(!(diagonal > MATRIX_SOLVE_TOLERANCE * scale))
+        {
+            return MATRIX_STATUS_NOT_POSITIVE_DEFINITE;
+        }
+        m[col][col] = sqrtf(diagonal);
+        const float inv_pivot = 1.0f / m[col][col];
+
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int row = col + 1; row < 6; ++row)
+        {
+            float sum = m[row][col];
+            MATRIX_GENERIC_UNROLL
+            for(unsigned int k = 0; k < col; ++k)
+            {
+                sum -= m[row][k] * m[col][k];
+            }
+            m[row][col] = sum * inv_pivot;
+        }
+    }
+
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int row = 0; row != 6; ++row)
+    {
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int col = 0; col != 6; ++col)
+        {
+            L->data[row][col] = col <= row ? m[row][col] : 0.0f;
+        }
+    }
+    L->transpose = false;
+    return MATRIX_STATUS_OK;
+}
+
+void matrix_6x6_cholesky_solve(const struct matrix_6x6 * L,
+                               const struct matrix_6x1 * b,
+                               struct matrix_6x1 * x)
+{
+    if(!L || !b || !x)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    // L y = b, then L^T x = y
+    float y[6];
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int row = 0; row != 6; ++row)
+    {
+        float sum = b->data[row];
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int col = 0; col < row; ++col)
+        {
+            sum -= L->data[row][col] * y[col];
+        }
+        y[row] = sum / L->data[row][row];
+    }
+
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int i = 0; i != 6; ++i)
+    {
+        const unsigned int row = 5 - i;
+        float sum = y[row];
+        MATRIX_GENERIC_UNROLL
+        for(unsigned int col = row + 1; col < 6; ++col)
+        {
+            sum -= L->data[col][row] * y[col];
+        }
+        y[row] = sum / L->data[row][row];
+    }
+
+    MATRIX_GENERIC_UNROLL
+    for(unsigned int i = 0; i != 6; ++i)
+    {
+        x->data[i] = y[i];
+    }
 }
@@ -1,6 +1,7 @@
 #include "nuhal/pid.h"
 #include "nuhal/error.h"
 #include "nuhal/bytestream.h"
+#include "nuhal/serialize.h"
 #include<math.h>
 
 float pid_compute(const struct pid_gains * gains,
@@ -78,106 +79,76 @@ float pid_compute(const struct pid_gains * gains,
     return u_actual;
 }
 
-void pid_gains_inject(struct bytestream * bs, const struct pid_gains * gains)
-{
-    if(!bs || !gains)
-    {
-        error(FILE_LINE, "NULL ptr");
-    }
-    bytestream_inject_f(bs, gains->kp);
-    bytestream_inject_f(bs, gains->ki);
-    bytestream_inject_f(bs, gains->kd);
-    bytestream_inject_f(bs, gains->u_max);
-    bytestream_inject_f(bs, gains->u_min);
-    bytestream_inject_f(bs, gains->i_max);
-    bytestream_inject_f(bs, gains->i_min);
-}
+// not versioned, so that the layouts stay compatible with existing firmware
+SERIALIZE_DEFINE(pid_gains, struct pid_gains, PID_GAINS_FIELDS, false)
 
-void pid_gains_extract(struct bytestream * bs, struct pid_gains * gains)
-{
-    if(!bs || !gains)
-    {
-        error(FILE_LINE, "NULL ptr");
-    }
-    gains->kp = bytestream_extract_f(bs);
-    gains->ki = bytestream_extract_f(bs);
-    gains->kd = bytestream_extract_f(bs);
-    gains->u_max = bytestream_extract_f(bs);
-    gains->u_min = bytestream_extract_f(bs);
-    gains->i_max = bytestream_extract_f(bs);
-    gains->i_min = bytestream_extract_f(bs);
-}
+SERIALIZE_DEFINE(pid_state, struct pid_state, PID_STATE_FIELDS, false)
 
-void pid_state_inject(struct bytestream * bs, const struct pid_state * state)
-{
-    if(!bs || !state)
-    {
-        error(FILE_LINE, "NULL ptr");
-    }
-    bytestream_inject_f(bs, state->p_error);
-    bytestream_inject_f(bs, state->i_error);
-    bytestream_inject_f(bs, state->d_error);
-}
+SERIALIZE_DEFINE(pid_signals, struct pid_signals, PID_SIGNALS_FIELDS, false)
 
+SERIALIZE_DEFINE(pid_state_f16, struct pid_state, PID_STATE_F16_FIELDS, false)
 
-void pid_state_extract(struct bytestream * bs, struct pid_state * state)
-{
-    if(!bs || !state)
-    {
-        error(FILE_LINE, "NULL ptr");
-    }
-    state->p_error = bytestream_extract_f(bs);
-    state->i_error = bytestream_extract_f(bs);
-    state->d_error = bytestream_extract_f(bs);
-}
+SERIALIZE_DEFINE(pid_signals_f16, struct pid_signals, PID_SIGNALS_F16_FIELDS, false)
+
+// the number of bytes in serialized debug info
+#define PID_DEBUG_INFO_BYTES \
+    (SERIALIZE_BYTES(PID_STATE_FIELDS) + SERIALIZE_BYTES(PID_SIGNALS_FIELDS) \
+     + 2u * sizeof(uint8_t))
+
+// the number of bytes in debug info serialized in half precision
+#define PID_DEBUG_INFO_F16_BYTES \
+    (SERIALIZE_BYTES(PID_STATE_F16_FIELDS) + SERIALIZE_BYTES(PID_SIGNALS_F16_FIELDS) \
+     + 2u * sizeof(uint8_t))
 
-/// @brief serialize pid signals
-/// @param bs - bytestream into which the state should be inserted
-/// @param signals - the state to insert into the bytestream
-/// @pre - there must be enough space in the bytestream for the gains
-void pid_signals_inject(struct bytestream * bs, const struct pid_signals * signals)
+void pid_debug_info_inject(struct bytestream * bs, const struct pid_debug_info * debug_info)
 {
-    if(!bs || !signals)
+    if(!bs || !debug_info)
     {
         error(FILE_LINE, "NULL ptr");
     }
-    bytestream_inject_f(bs, signals->reference);
-    bytestream_inject_f(bs, signals->measurement);
-    bytestream_inject_f(bs, signals->effort);
+    uint8_t * cursor = bytestream_reserve(bs, PID_DEBUG_INFO_BYTES);
+    pid_state_put(&cursor, &debug_info->state);
+    pid_signals_put(&cursor, &debug_info->signals);
+    bytestream_put_u8(&cursor, debug_info->sequence);
+    bytestream_put_u8(&cursor, debug_info->missed);
 }
 
-void pid_signals_extract(struct bytestream * bs, struct pid_signals * signals)
+void pid_debug_info_extract(struct bytestream * bs, struct pid_debug_info * debug_info)
 {
-    if(!bs || !signals)
+    if(!bs || !debug_info)
     {
         error(FILE_LINE, "NULL ptr");
     }
-    signals->reference = bytestream_extract_f(bs);
-    signals->measurement = bytestream_extract_f(bs);
-    signals->effort = bytestream_extract_f(bs);
+    uint8_t * cursor = bytestream_reserve(bs, PID_DEBUG_INFO_BYTES);
+    pid_state_get(&cursor, &debug_info->state);
+    pid_signals_get(&cursor, &debug_info->signals);
+    debug_info->sequence = bytestream_get_u8(&cursor);
+    debug_info->missed = bytestream_get_u8(&cursor);
 }
 
-
-void pid_debug_info_inject(struct bytestream * bs, const struct pid_debug_info * debug_info)
+void pid_debug_info_f16_inject(struct bytestream * bs,
+                               const struct pid_debug_info * debug_info)
 {
     if(!bs || !debug_info)
     {
         error(FILE_LINE, "NULL ptr");
     }
-    pid_state_inject(bs, &debug_info->state);
-    pid_signals_inject(bs, &debug_info->signals);
-    bytestream_inject_u8(bs, debug_info->sequence);
-    bytestream_inject_u8(bs, debug_info->missed);
+    uint8_t * cursor = bytestream_reserve(bs, PID_DEBUG_INFO_F16_BYTES);
+    pid_state_f16_put(&cursor, &debug_info->state);
+    pid_signals_f16_put(&cursor, &debug_info->signals);
+    bytestream_put_u8(&cursor, debug_info->sequence);
+    bytestream_put_u8(&cursor, debug_info->missed);
 }
 
-void pid_debug_info_extract(struct bytestream * bs, struct pid_debug_info * debug_info)
+void pid_debug_info_f16_extract(struct bytestream * bs, struct pid_debug_info * debug_info)
 {
     if(!bs || !debug_info)
     {
         error(FILE_LINE, "NULL ptr");
     }
-    pid_state_extract(bs, &debug_info->state);
-    pid_signals_extract(bs, &debug_info->signals);
-    debug_info->sequence = bytestream_extract_u8(bs);
-    debug_info->missed = bytestream_extract_u8(bs);
+    uint8_t * cursor = bytestream_reserve(bs, PID_DEBUG_INFO_F16_BYTES);
+    pid_state_f16_get(&cursor, &debug_info->state);
+    pid_signals_f16_get(&cursor, &debug_info->signals);
+    debug_info->sequence = bytestream_get_u8(&cursor);
+    debug_info->missed = bytestream_get_u8(&cursor);
 }
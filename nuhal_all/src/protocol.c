@@ -1,5 +1,6 @@
 #include <string.h>
 #include "nuhal/protocol.h"
+#include "nuhal/protocol_stats.h"
 #include "nuhal/error.h"
 #include "nuhal/uart.h"
 #include "nuhal/time.h"
@@ -44,6 +45,14 @@
 /// max number of broadcasting ports
 #define MAX_BROADCAST_PORTS 3
 
+/// bytes added to a packet that is wrapped by another command: the
+/// wrapping command and a single byte value
+#define WRAPPER_BYTES 2
+
+/// bytes added to a packet by protocol_packet_sequence: the
+/// PROTOCOL_SEQUENCED command and the sequence number
+#define SEQUENCE_BYTES WRAPPER_BYTES
+
 // index of the length byte
 static const uint32_t LENGTH_INDEX = 0;
 
@@ -59,6 +68,138 @@ static const uint32_t TIMEOUT_MS_PER_BYTE = 10u;
 // base timeout for commands:
 static const uint32_t TIMEOUT_MS_BASE = 100u;
 
+// the number of bits sent per byte: a start bit, 8 data bits and a stop bit
+static const uint32_t BITS_PER_BYTE = 10u;
+
+// resolution of the timers used for timeouts, in us
+static const uint32_t TIMER_RESOLUTION_US = 1000u;
+
+// time for the device to switch baud rates after responding to
+// PROTOCOL_NEGOTIATE, in ms
+static const uint32_t NEGOTIATE_SWITCH_MS = 2u;
+
+// function that observes all packets, @see protocol_set_tap
+static protocol_tap tap_function = NULL;
+
+// context passed to the tap function
+static void * tap_context = NULL;
+
+// how failed requests are retried, @see protocol_set_retry_policy
+static struct protocol_retry_policy retry_policy = PROTOCOL_RETRY_POLICY_NONE;
+
+/// @brief state that is kept for each port used with the protocol
+struct port_state
+{
+    /// the port
+    const struct uart_port * port;
+
+    /// the sequence number of the last sequenced request sent on the port
+    uint8_t sequence;
+
+    /// the baud rate of the port, used to compute the time to send a byte
+    uint32_t baud;
+
+    /// the round trip time estimate used for adaptive timeouts
+    struct protocol_rtt rtt;
+
+    /// the minimum adaptive timeout, in us
+    uint32_t timeout_floor_us;
+
+    /// the maximum adaptive timeout, in us. 0 if adaptive timeouts are off
+    uint32_t timeout_ceiling_us;
+};
+
+// state of the ports that are in use, in slots whose port is not NULL. A
+// slot is claimed and released by atomically setting its port, so threads
+// using different ports can add and remove them concurrently. The rest of
+// the state is only used by the thread that is using the port
+static struct port_state port_states[PROTOCOL_MAX_PORTS];
+
+/// @brief choose the sequence number before the first request on a port.
+/// It varies from run to run, so the first requests after the host restarts
+/// are unlikely to repeat the sequence numbers of the last requests the
+/// device received
+/// @param port - the port
+/// @return the sequence number
+static uint8_t protocol_sequence_seed(const struct uart_port * port)
+{
+    uint32_t seed = time_current_us() ^ (uint32_t)(uintptr_t)port;
+    seed = (seed ^ (seed >> 16)) * 0x45D9F3Bu;
+    return (uint8_t)(seed ^ (seed >> 16));
+}
+
+/// @brief reset the state of a port to its defaults
+/// @param state - the state
+/// @param port - the port that the state belongs to
+static void protocol_port_state_init(struct port_state * state,
+                                     const struct uart_port * port)
+{
+    state->sequence = protocol_sequence_seed(port);
+    state->baud = BAUD;
+    state->rtt.srtt_us = 0;
+    state->rtt.rttvar_us = 0;
+    state->rtt.valid = false;
+    state->timeout_floor_us = 0;
+    state->timeout_ceiling_us = 0;
+}
+
+/// @brief get the state of a port, adding the port if it is new
+/// @param port - the port
+/// @return the state of the port
+static struct port_state * protocol_port_state(const struct uart_port * port)
+{
+    for(unsigned int i = 0; i != PROTOCOL_MAX_PORTS; ++i)
+    {
+        if(__atomic_load_n(&port_states[i].port, __ATOMIC_ACQUIRE) == port)
+        {
+            return &port_states[i];
+        }
+    }
+
+    for(unsigned int i = 0; i != PROTOCOL_MAX_PORTS; ++i)
+    {
+        const struct uart_port * empty = NULL;
+        if(__atomic_compare_exchange_n(&port_states[i].port, &empty, port,
+                                       false, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_ACQUIRE))
+        {
+            protocol_port_state_init(&port_states[i], port);
+            return &port_states[i];
+        }
+    }
+
+    error(FILE_LINE, "too many ports, see PROTOCOL_MAX_PORTS");
+}
+
+/// @brief the time it takes to send a byte over a port
+/// @param state - the port
+/// @return the time in us, rounded up
+static uint32_t protocol_byte_time_us(const struct port_state * state)
+{
+    return (BITS_PER_BYTE * 1000000u + state->baud - 1) / state->baud;
+}
+
+/// @brief convert a time in us to ms, rounding up
+static uint32_t protocol_us_to_ms(uint32_t us)
+{
+    return us / 1000u + (us % 1000u != 0);
+}
+
+/// @brief pass a packet's raw bytes to the tap, if there is one
+/// @param port - the port over which the packet travelled
+/// @param direction - whether the packet was sent or received
+/// @param packet - the packet
+/// @param length - the length of the packet, including the header
+static void protocol_tap_packet(const struct uart_port * port,
+                                enum protocol_direction direction,
+                                const struct protocol_packet * packet,
+                                uint32_t length)
+{
+    if(tap_function)
+    {
+        tap_function(port, direction, packet->_data, length, tap_context);
+    }
+}
 
 /// @brief compute the checksum of a packet
 static uint8_t protocol_checksum(struct protocol_packet * packet)
@@ -106,8 +247,10 @@ static uint8_t protocol_header_init(struct protocol_packet * packet)
 /// checksum and set its stream to the beginning of its data section
 /// @param out - the packet
 /// @param data_length - the length of the data payload of the packet
-static
-void protocol_verify_checksum(struct protocol_packet * out, uint8_t data_length)
+/// @return true if the checksum is valid. If it is invalid the stream
+/// is not set up
+static bool protocol_checksum_valid(struct protocol_packet * out,
+                                    uint8_t data_length)
 {
     if(!out)
     {
@@ -117,7 +260,7 @@ void protocol_verify_checksum(struct protocol_packet * out, uint8_t data_length)
     uint8_t checksum = protocol_checksum(out);
     if(checksum != out->_data[CHECKSUM_INDEX])
     {
-        error(FILE_LINE, "invalid checksum");
+        return false;
     }
 
     // set the stream to the proper position
@@ -128,32 +271,149 @@ void protocol_verify_checksum(struct protocol_packet * out, uint8_t data_length)
     {
         (void)bytestream_extract_u8(&out->stream);
     }
+    return true;
+}
+
+/// @brief check that a packet with complete data has a valid
+/// checksum and set its stream to the beginning of its data section
+/// @param out - the packet
+/// @param data_length - the length of the data payload of the packet
+/// @post an error occurs if the checksum is invalid
+static
+void protocol_verify_checksum(struct protocol_packet * out, uint8_t data_length)
+{
+    if(!protocol_checksum_valid(out, data_length))
+    {
+        error(FILE_LINE, "invalid checksum");
+    }
+}
+
+/// @brief get the command of a request, looking inside sequenced
+/// and addressed requests
+/// @param request - a packet that is being sent
+/// @return the command that is being requested
+static uint8_t protocol_request_command(const struct protocol_packet * request)
+{
+    size_t index = HEADER_BYTES;
+    if(PROTOCOL_SEQUENCED == request->_data[index])
+    {
+        index += SEQUENCE_BYTES;
+    }
+    if(PROTOCOL_ADDRESSED == request->_data[index])
+    {
+        index += WRAPPER_BYTES;
+    }
+    return request->_data[index];
 }
 
 /// @brief validate that a response is a valid reply to the given request
 /// @param request - a packet that was sent
-/// @param response - a packet that was recieved
-/// @post trigger an error on an invalid response
-///       a  response is invalid if its command does not match the request
-static void protocol_validate_response(const struct protocol_packet * request,
-                                       const struct protocol_packet * response)
+/// @param response - a packet that was received
+/// @param length - the length of the response, as returned by
+/// protocol_read_unverified
+/// @return the status of the response. A response is invalid if its command
+/// does not match the request. Sequenced responses must also have the
+/// same sequence number as the request, and are unwrapped
+/// (@see protocol_packet_unsequence) if they are valid
+static enum protocol_status
+protocol_response_status(const struct protocol_packet * request,
+                         struct protocol_packet * response,
+                         uint32_t length)
 {
-    if(!request || !response || !response->_data)
+    if(!request || !response)
     {
         error(FILE_LINE, "NULL ptr");
     }
 
-    const uint8_t req_cmd = protocol_packet_command(request);
-    const uint8_t resp_cmd = protocol_packet_command(response);
+    const uint8_t req_cmd = protocol_request_command(request);
 
-    if(PROTOCOL_ERROR == resp_cmd)
+    enum protocol_status status = PROTOCOL_STATUS_OK;
+    if(0 == length)
     {
-        error(FILE_LINE, "Received an ERROR from downstream.");
+        status = PROTOCOL_STATUS_TIMEOUT;
     }
-    else if(req_cmd != resp_cmd)
+    else if(length < HEADER_BYTES
+            || !protocol_checksum_valid(response, length - HEADER_BYTES))
     {
-        error(FILE_LINE, "Request/response mismatch.");
+        status = PROTOCOL_STATUS_CHECKSUM;
     }
+    else if(PROTOCOL_ERROR == protocol_packet_command(response))
+    {
+        // a device that does not support sequencing also reports an error
+        status = PROTOCOL_STATUS_ERROR_RESPONSE;
+    }
+    else if(PROTOCOL_SEQUENCED == protocol_packet_command(request))
+    {
+        // a response with another sequence number is a late response
+        // to an earlier request
+        uint8_t sequence = 0;
+        if(!protocol_packet_unsequence(response, &sequence)
+           || sequence != request->_data[HEADER_BYTES + 1])
+        {
+            status = PROTOCOL_STATUS_MISMATCH;
+        }
+    }
+
+    uint8_t request_address = 0;
+    if(PROTOCOL_STATUS_OK == status
+       && protocol_packet_destination(request, &request_address))
+    {
+        // a response from another device on the bus
+        uint8_t address = 0;
+        if(PROTOCOL_ERROR != protocol_packet_command(response)
+           && (!protocol_packet_unaddress(response, &address)
+               || address != request_address))
+        {
+            status = PROTOCOL_STATUS_MISMATCH;
+        }
+    }
+
+    if(PROTOCOL_STATUS_OK == status)
+    {
+        const uint8_t resp_cmd = protocol_packet_command(response);
+        if(PROTOCOL_ERROR == resp_cmd)
+        {
+            status = PROTOCOL_STATUS_ERROR_RESPONSE;
+        }
+        else if(req_cmd != resp_cmd)
+        {
+            status = PROTOCOL_STATUS_MISMATCH;
+        }
+    }
+
+    switch(status)
+    {
+    case PROTOCOL_STATUS_OK:
+        break;
+    case PROTOCOL_STATUS_TIMEOUT:
+        protocol_stats_count(req_cmd, PROTOCOL_STATS_TIMEOUTS);
+        break;
+    case PROTOCOL_STATUS_CHECKSUM:
+        protocol_stats_count(req_cmd, PROTOCOL_STATS_CHECKSUM_ERRORS);
+        break;
+    case PROTOCOL_STATUS_ERROR_RESPONSE:
+        protocol_stats_count(req_cmd, PROTOCOL_STATS_ERROR_RESPONSES);
+        break;
+    case PROTOCOL_STATUS_MISMATCH:
+        protocol_stats_count(req_cmd, PROTOCOL_STATS_MISMATCHES);
+        break;
+    default:
+        error(FILE_LINE, "unknown status");
+    }
+    return status;
+}
+
+/// @brief determine if a request that failed with the given status
+/// should be sent again
+/// @param status - the status of the failed request
+/// @return true if the failure may have been caused by a transmission error.
+/// Error responses are not retried: the device received the request but
+/// could not carry it out
+static bool protocol_status_retryable(enum protocol_status status)
+{
+    return PROTOCOL_STATUS_TIMEOUT == status
+        || PROTOCOL_STATUS_CHECKSUM == status
+        || PROTOCOL_STATUS_MISMATCH == status;
 }
 
 
@@ -162,7 +422,209 @@ static void protocol_validate_response(const struct protocol_packet * request,
 /// @return a handle to the uart_port
 const struct uart_port * protocol_open(const char uart_port_name[])
 {
-    return uart_open(uart_port_name, BAUD, UART_FLOW_NONE, UART_PARITY_NONE);
+    return protocol_open_baud(uart_port_name, BAUD);
+}
+
+const struct uart_port * protocol_open_baud(const char uart_port_name[],
+                                            uint32_t baud)
+{
+    const struct uart_port * port =
+        uart_open(uart_port_name, baud, UART_FLOW_NONE, UART_PARITY_NONE);
+
+    // register the port now rather than on its first request. If the port
+    // has state, it belonged to a port that was closed at the same address
+    struct port_state * state = protocol_port_state(port);
+    protocol_port_state_init(state, port);
+    state->baud = baud;
+    return port;
+}
+
+const struct uart_port * protocol_open_negotiate(const char uart_port_name[],
+                                                 const uint32_t bauds[],
+                                                 unsigned int num_bauds,
+                                                 uint32_t * features)
+{
+    const struct uart_port * port = protocol_open(uart_port_name);
+    (void)protocol_negotiate(port, bauds, num_bauds, features);
+    return port;
+}
+
+/// @brief build a PROTOCOL_NEGOTIATE request
+/// @param out - the request
+/// @param features - the features offered
+/// @param bauds - the baud rates offered
+/// @param num_bauds - the number of baud rates. 0 confirms the current rate
+static void protocol_negotiate_request(struct protocol_packet * out,
+                                       uint32_t features,
+                                       const uint32_t bauds[],
+                                       unsigned int num_bauds)
+{
+    protocol_packet_init(out, PROTOCOL_NEGOTIATE);
+    bytestream_inject_u32(&out->stream, features);
+    bytestream_inject_u8(&out->stream, num_bauds);
+    for(unsigned int i = 0; i != num_bauds; ++i)
+    {
+        bytestream_inject_u32(&out->stream, bauds[i]);
+    }
+}
+
+/// @brief send a PROTOCOL_NEGOTIATE request and read the response
+/// @param port - the port
+/// @param features - the features offered
+/// @param bauds - the baud rates offered
+/// @param num_bauds - the number of baud rates. 0 confirms the current rate
+/// @param agreed [out] - the features agreed upon
+/// @param baud [out] - the baud rate selected
+/// @return true if a valid response was received
+static bool protocol_negotiate_exchange(const struct uart_port * port,
+                                        uint32_t features,
+                                        const uint32_t bauds[],
+                                        unsigned int num_bauds,
+                                        uint32_t * agreed,
+                                        uint32_t * baud)
+{
+    struct protocol_packet request;
+    protocol_negotiate_request(&request, features, bauds, num_bauds);
+    protocol_write_block(port, &request);
+
+    struct protocol_packet response;
+    if(PROTOCOL_STATUS_OK != protocol_read_status(port, &response,
+                                                  PROTOCOL_NEGOTIATE_TIMEOUT_MS)
+       || PROTOCOL_NEGOTIATE != protocol_packet_command(&response)
+       || response.stream.capacity < COMMAND_BYTES + 2*sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    *agreed = bytestream_extract_u32(&response.stream);
+    *baud = bytestream_extract_u32(&response.stream);
+    return true;
+}
+
+uint32_t protocol_negotiate(const struct uart_port * port,
+                            const uint32_t bauds[],
+                            unsigned int num_bauds,
+                            uint32_t * features)
+{
+    if(!port || !bauds)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(num_bauds > PROTOCOL_NEGOTIATE_MAX_BAUDS)
+    {
+        error(FILE_LINE, "too many baud rates");
+    }
+
+    struct port_state * state = protocol_port_state(port);
+    const uint32_t offered = features ? *features : 0;
+    if(features)
+    {
+        *features = 0;
+    }
+
+    uint32_t agreed = 0;
+    uint32_t baud = 0;
+    if(!protocol_negotiate_exchange(port, offered, bauds, num_bauds,
+                                    &agreed, &baud))
+    {
+        // the device does not support negotiation
+        protocol_drain(port, 0);
+        return state->baud;
+    }
+
+    if(baud != state->baud)
+    {
+        const uint32_t old_baud = state->baud;
+        uart_set_baud(port, baud);
+        struct time_elapsed_ms switched = time_elapsed_ms_init();
+        time_delay_ms(NEGOTIATE_SWITCH_MS);
+
+        // the device switches for good once it hears a confirmation, so if
+        // the confirmation or the reply is lost, the next one can succeed
+        uint32_t confirmed = 0;
+        for(unsigned int i = 0; i != PROTOCOL_NEGOTIATE_CONFIRM_ATTEMPTS; ++i)
+        {
+            if(protocol_negotiate_exchange(port, offered, bauds, 0,
+                                           &agreed, &confirmed)
+               && confirmed == baud)
+            {
+                break;
+            }
+            protocol_drain(port, 0);
+        }
+
+        if(confirmed != baud)
+        {
+            // wait for the device to give up on the new baud rate
+            uart_set_baud(port, old_baud);
+            const uint32_t waited = time_elapsed_ms(&switched);
+            if(waited < PROTOCOL_NEGOTIATE_CONFIRM_WINDOW_MS)
+            {
+                time_delay_ms(PROTOCOL_NEGOTIATE_CONFIRM_WINDOW_MS - waited);
+            }
+            protocol_drain(port, 0);
+            return old_baud;
+        }
+        state->baud = baud;
+    }
+
+    if(features)
+    {
+        *features = agreed;
+    }
+    return baud;
+}
+
+uint32_t protocol_select_baud(const uint32_t offered[],
+                              unsigned int num_offered,
+                              const uint32_t supported[],
+                              unsigned int num_supported)
+{
+    if(!offered || !supported)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    uint32_t best = 0;
+    for(unsigned int i = 0; i != num_offered; ++i)
+    {
+        for(unsigned int j = 0; j != num_supported; ++j)
+        {
+            if(offered[i] == supported[j] && offered[i] > best)
+            {
+                best = offered[i];
+            }
+        }
+    }
+    return best;
+}
+
+uint32_t protocol_baud(const struct uart_port * port)
+{
+    if(!port)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    return protocol_port_state(port)->baud;
+}
+
+void protocol_close(const struct uart_port * port)
+{
+    if(!port)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    for(unsigned int i = 0; i != PROTOCOL_MAX_PORTS; ++i)
+    {
+        if(__atomic_load_n(&port_states[i].port, __ATOMIC_ACQUIRE) == port)
+        {
+            __atomic_store_n(&port_states[i].port, NULL, __ATOMIC_RELEASE);
+            break;
+        }
+    }
+    uart_close(port);
 }
 
 // initialize the stream portion of the packet without setting a command
@@ -193,6 +655,159 @@ uint8_t protocol_packet_command(const struct protocol_packet * pkt)
     return pkt->_data[HEADER_BYTES];
 }
 
+void protocol_packet_reply_init(struct protocol_packet * packet)
+{
+    // the command byte is overwritten with itself
+    protocol_packet_init(packet, protocol_packet_command(packet));
+}
+
+void protocol_packet_copy(struct protocol_packet * out,
+                          const struct protocol_packet * in)
+{
+    if(!out || !in)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    memcpy(out->_data, in->_data, sizeof(out->_data));
+
+    // the copied stream must refer to the copied data
+    out->stream = in->stream;
+    out->stream.data = out->_data + (in->stream.data - in->_data);
+}
+
+/// @brief wrap a packet that is about to be sent with another command
+/// @param packet [in/out] - the packet
+/// @param command - the wrapping command
+/// @param value - the byte that follows the wrapping command
+static void protocol_packet_wrap(struct protocol_packet * packet,
+                                 uint8_t command,
+                                 uint8_t value)
+{
+    if(!packet)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(packet->stream.size + WRAPPER_BYTES
+       > ARRAY_LEN(packet->_data) - HEADER_BYTES)
+    {
+        error(FILE_LINE, "packet too long");
+    }
+
+    memmove(&packet->_data[HEADER_BYTES + WRAPPER_BYTES],
+            &packet->_data[HEADER_BYTES],
+            packet->stream.size);
+    packet->_data[HEADER_BYTES] = command;
+    packet->_data[HEADER_BYTES + 1] = value;
+    packet->stream.size += WRAPPER_BYTES;
+    packet->stream.capacity = ARRAY_LEN(packet->_data) - HEADER_BYTES;
+}
+
+/// @brief unwrap a received packet that is wrapped by a command
+/// @param packet [in/out] - the packet
+/// @param command - the wrapping command
+/// @param value [out] - the byte that follows the wrapping command
+/// @return true if the packet was wrapped by command
+static bool protocol_packet_unwrap(struct protocol_packet * packet,
+                                   uint8_t command,
+                                   uint8_t * value)
+{
+    if(!packet || !value)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    // the stream capacity of a received packet is its data length,
+    // which must include the wrapped command byte
+    if(command != protocol_packet_command(packet)
+       || packet->stream.capacity < WRAPPER_BYTES + COMMAND_BYTES)
+    {
+        return false;
+    }
+
+    *value = packet->_data[HEADER_BYTES + 1];
+    const size_t data_length = packet->stream.capacity - WRAPPER_BYTES;
+    memmove(&packet->_data[HEADER_BYTES],
+            &packet->_data[HEADER_BYTES + WRAPPER_BYTES],
+            data_length);
+
+    // keep the header consistent with the unwrapped data
+    packet->_data[LENGTH_INDEX] -= WRAPPER_BYTES;
+    packet->_data[CHECKSUM_INDEX] = protocol_checksum(packet);
+
+    bytestream_init(&packet->stream, &packet->_data[HEADER_BYTES], data_length);
+    (void)bytestream_extract_u8(&packet->stream);
+    return true;
+}
+
+void protocol_packet_sequence(struct protocol_packet * packet, uint8_t sequence)
+{
+    protocol_packet_wrap(packet, PROTOCOL_SEQUENCED, sequence);
+}
+
+bool protocol_packet_unsequence(struct protocol_packet * packet,
+                                uint8_t * sequence)
+{
+    return protocol_packet_unwrap(packet, PROTOCOL_SEQUENCED, sequence);
+}
+
+void protocol_packet_address(struct protocol_packet * packet, uint8_t address)
+{
+    protocol_packet_wrap(packet, PROTOCOL_ADDRESSED, address);
+}
+
+bool protocol_packet_unaddress(struct protocol_packet * packet,
+                               uint8_t * address)
+{
+    return protocol_packet_unwrap(packet, PROTOCOL_ADDRESSED, address);
+}
+
+bool protocol_packet_destination(const struct protocol_packet * packet,
+                                 uint8_t * address)
+{
+    if(!packet || !address)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    size_t index = HEADER_BYTES;
+    if(PROTOCOL_SEQUENCED == packet->_data[index])
+    {
+        index += SEQUENCE_BYTES;
+    }
+
+    // the address byte must be followed by a command byte
+    if(PROTOCOL_ADDRESSED != packet->_data[index]
+       || index + WRAPPER_BYTES + COMMAND_BYTES
+       > (size_t)(packet->stream.data - packet->_data) + packet->stream.capacity)
+    {
+        return false;
+    }
+    *address = packet->_data[index + 1];
+    return true;
+}
+
+/// @brief undo protocol_packet_sequence on a packet that has been sent
+/// @param packet - the sent packet
+static void protocol_packet_unsequence_sent(struct protocol_packet * packet)
+{
+    packet->stream.size -= SEQUENCE_BYTES;
+    memmove(&packet->_data[HEADER_BYTES],
+            &packet->_data[HEADER_BYTES + SEQUENCE_BYTES],
+            packet->stream.size);
+    (void)protocol_header_init(packet);
+}
+
+/// @brief get the sequence number for a new request on a port
+/// @param port - the port
+/// @return the sequence number, which differs from that of the
+/// previous request sent over the port
+static uint8_t protocol_next_sequence(const struct uart_port * port)
+{
+    struct port_state * state = protocol_port_state(port);
+    return ++state->sequence;
+}
+
 void protocol_write_block(const struct uart_port * port,
                           struct protocol_packet * packet)
 {
@@ -206,30 +821,60 @@ void protocol_write_block(const struct uart_port * port,
 
     const uint32_t timeout = length * TIMEOUT_MS_PER_BYTE + TIMEOUT_MS_BASE;
     (void)uart_write_block(port, packet->_data, length, timeout);
+    protocol_tap_packet(port, PROTOCOL_DIRECTION_TX, packet, length);
 }
 
-bool protocol_read_block_error(const struct uart_port * port,
-                               struct protocol_packet * out,
-                               uint32_t timeout,
-                               bool timeout_error)
+void protocol_write_frame(const struct uart_port * port,
+                          const uint8_t frame[],
+                          uint8_t length)
 {
-    if(!port)
+    if(!port || !frame)
     {
         error(FILE_LINE, "NULL ptr");
     }
 
-    struct protocol_packet temp = {0};
-    if(!out)
+    if(length < HEADER_BYTES)
     {
-        out = &temp;
+        error(FILE_LINE, "invalid param");
+    }
+
+    const uint32_t timeout = length * TIMEOUT_MS_PER_BYTE + TIMEOUT_MS_BASE;
+    (void)uart_write_block(port, frame, length, timeout);
+    if(tap_function)
+    {
+        tap_function(port, PROTOCOL_DIRECTION_TX, frame, length, tap_context);
     }
+}
+
+/// @brief read a packet without verifying its checksum
+/// @param port - the port from which to read
+/// @param out - the packet. Its stream is not set up
+/// @param timeout - base timeout, in ms.  0 waits forever
+/// @param byte_timeout_us - time allowed for each byte, in us
+/// @param timeout_error - if true, an error occurs on timeout
+/// @return the length of the packet, including the header, or
+/// 0 if the packet was not fully read before the timeout.
+/// A length of less than HEADER_BYTES indicates a corrupt length byte
+static uint32_t protocol_read_unverified(const struct uart_port * port,
+                                         struct protocol_packet * out,
+                                         uint32_t timeout,
+                                         uint32_t byte_timeout_us,
+                                         bool timeout_error)
+{
     protocol_packet_stream_init(out);
 
     // read the header
-    uart_read_block(port, &out->_data[0], HEADER_BYTES,
-                    0 == timeout ? 0
-                    : timeout + TIMEOUT_MS_PER_BYTE * HEADER_BYTES ,
-                    UART_TERM_NONE);
+    const int header_read =
+        uart_read_block_error(port, &out->_data[0], HEADER_BYTES,
+                              0 == timeout ? 0
+                              : timeout + protocol_us_to_ms(byte_timeout_us
+                                                            * HEADER_BYTES),
+                              UART_TERM_NONE,
+                              timeout_error);
+    if(header_read != HEADER_BYTES)
+    {
+        return 0;
+    }
 
     // ACK packets from the bootloader have a length of 0, so that length
     // does not include the header bytes. In all other packets, the length
@@ -237,6 +882,11 @@ bool protocol_read_block_error(const struct uart_port * port,
     const uint32_t length = 0 == out->_data[LENGTH_INDEX] ?
         HEADER_BYTES : out->_data[LENGTH_INDEX];
 
+    if(length < HEADER_BYTES)
+    {
+        return length;
+    }
+
     const uint32_t data_length = length - HEADER_BYTES;
 
     // read the rest of the packet
@@ -244,19 +894,50 @@ bool protocol_read_block_error(const struct uart_port * port,
         uart_read_block_error(port,
                               &out->_data[HEADER_BYTES],
                               data_length,
-                              TIMEOUT_MS_PER_BYTE * data_length + timeout,
+                              protocol_us_to_ms(byte_timeout_us * data_length)
+                              + timeout,
                               UART_TERM_NONE,
                               timeout_error);
 
-    if(read == 0)
+    if((uint32_t)read != data_length)
+    {
+        return 0;
+    }
+
+    protocol_tap_packet(port, PROTOCOL_DIRECTION_RX, out, length);
+    return length;
+}
+
+bool protocol_read_block_error(const struct uart_port * port,
+                               struct protocol_packet * out,
+                               uint32_t timeout,
+                               bool timeout_error)
+{
+    if(!port)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    struct protocol_packet temp = {0};
+    if(!out)
+    {
+        out = &temp;
+    }
+
+    const uint32_t length =
+        protocol_read_unverified(port, out, timeout,
+                                 TIMEOUT_MS_PER_BYTE * 1000u, timeout_error);
+    if(0 == length)
     {
         return false;
     }
-    else
+
+    if(length < HEADER_BYTES)
     {
-        protocol_verify_checksum(out, data_length);
-        return true;
+        error(FILE_LINE, "invalid length");
     }
+    protocol_verify_checksum(out, length - HEADER_BYTES);
+    return true;
 }
 
 void protocol_read_block(const struct uart_port * port,
@@ -283,11 +964,177 @@ bool protocol_read_nonblock(const struct uart_port * port,
     return true;
 }
 
-bool protocol_request_timeout(const struct uart_port * port,
-                              struct protocol_packet * in,
-                              struct protocol_packet * out,
-                              uint32_t timeout_ms,
-                              bool timeout_error)
+enum protocol_status protocol_read_status(const struct uart_port * port,
+                                          struct protocol_packet * out,
+                                          uint32_t timeout)
+{
+    if(!port || !out)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    const uint32_t length =
+        protocol_read_unverified(port, out, timeout,
+                                 TIMEOUT_MS_PER_BYTE * 1000u, false);
+    if(0 == length)
+    {
+        return PROTOCOL_STATUS_TIMEOUT;
+    }
+
+    if(length < HEADER_BYTES
+       || !protocol_checksum_valid(out, length - HEADER_BYTES))
+    {
+        return PROTOCOL_STATUS_CHECKSUM;
+    }
+    return PROTOCOL_STATUS_OK;
+}
+
+void protocol_drain(const struct uart_port * port, uint32_t quiet_ms)
+{
+    if(!port)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    uint8_t discard[16];
+    for(;;)
+    {
+        while(uart_read_nonblock(port, discard, sizeof(discard)) > 0)
+        {
+            ;
+        }
+
+        // a timeout of 0 would wait forever
+        if(0 == quiet_ms || !uart_wait_for_data(port, quiet_ms))
+        {
+            return;
+        }
+    }
+}
+
+/// @brief update the round trip time estimate of a port with a response
+/// @param state - the port
+/// @param elapsed_us - the time from sending the request to receiving
+/// the full response
+/// @param bytes - the number of bytes in the request and the response
+static void protocol_rtt_sample(struct port_state * state,
+                               uint32_t elapsed_us,
+                               uint32_t bytes)
+{
+    // the estimate excludes the time spent sending the bytes, which is
+    // added back based on the length of each packet
+    const uint32_t transmit_us = bytes * protocol_byte_time_us(state);
+    protocol_rtt_update(&state->rtt,
+                        elapsed_us > transmit_us ? elapsed_us - transmit_us : 0);
+}
+
+/// @brief send a request and read its response, once
+/// @param port - the port
+/// @param in - the request
+/// @param out - the response
+/// @param timeout_ms - the base time to wait for the response, unless
+/// the port has adaptive timeouts
+/// @param first - true if this is the first time the request is sent.
+/// Following Karn's algorithm, only responses to requests that were not
+/// retried are used to estimate the round trip time, because a response
+/// to a retried request may be a response to an earlier attempt
+/// @return the status of the response
+static enum protocol_status protocol_attempt(const struct uart_port * port,
+                                             struct protocol_packet * in,
+                                             struct protocol_packet * out,
+                                             uint32_t timeout_ms,
+                                             bool first)
+{
+    struct port_state * state = protocol_port_state(port);
+    const bool adaptive = 0 != state->timeout_ceiling_us;
+
+    // only measure the latency if it will be used
+    const bool record_latency = protocol_stats_enabled() || adaptive;
+    struct time_elapsed_us elapsed = {{0, 0, 0}};
+    if(record_latency)
+    {
+        elapsed = time_elapsed_us_init();
+    }
+
+    protocol_write_block(port, in);
+    const uint32_t request_length = in->_data[LENGTH_INDEX];
+
+    uint32_t byte_timeout_us = TIMEOUT_MS_PER_BYTE * 1000u;
+    if(adaptive)
+    {
+        // the request is still being sent when the wait starts
+        byte_timeout_us = protocol_byte_time_us(state);
+        timeout_ms = protocol_us_to_ms(
+            protocol_rtt_timeout_us(&state->rtt,
+                                    state->timeout_floor_us,
+                                    state->timeout_ceiling_us)
+            + request_length * byte_timeout_us);
+    }
+
+    // timeouts are reported as a status, so that they can be retried
+    const uint32_t length =
+        protocol_read_unverified(port, out, timeout_ms, byte_timeout_us, false);
+
+    const enum protocol_status status =
+        protocol_response_status(in, out, length);
+
+    if(record_latency && PROTOCOL_STATUS_OK == status)
+    {
+        const uint32_t latency_us = time_elapsed_us(&elapsed);
+        protocol_stats_latency(protocol_request_command(in), latency_us);
+        if(adaptive && first)
+        {
+            protocol_rtt_sample(state, latency_us, request_length + length);
+        }
+    }
+    return status;
+}
+
+/// @brief resend a request until it succeeds or the retries run out
+/// @param port - the port
+/// @param in - the request, which has been sent once
+/// @param out - the response
+/// @param timeout_ms - the base time to wait for each response
+/// @param status - the status of the first attempt
+/// @param policy - how to retry the request
+/// @return the status of the last attempt
+static enum protocol_status
+protocol_retry(const struct uart_port * port,
+               struct protocol_packet * in,
+               struct protocol_packet * out,
+               uint32_t timeout_ms,
+               enum protocol_status status,
+               const struct protocol_retry_policy * policy)
+{
+    // the first delay is limited too, so no delay exceeds backoff_max_ms
+    uint32_t backoff_ms = policy->backoff_ms < policy->backoff_max_ms ?
+        policy->backoff_ms : policy->backoff_max_ms;
+    for(unsigned int retry = 0;
+        protocol_status_retryable(status) && retry != policy->retries;
+        ++retry)
+    {
+        protocol_stats_count(protocol_request_command(in),
+                             PROTOCOL_STATS_RETRIES);
+
+        // discard the rest of a corrupt or late response, so the next
+        // response starts at a packet boundary
+        protocol_drain(port, policy->drain_ms);
+        if(backoff_ms > 0)
+        {
+            time_delay_ms(backoff_ms);
+        }
+        backoff_ms = backoff_ms > policy->backoff_max_ms / 2 ?
+            policy->backoff_max_ms : 2 * backoff_ms;
+
+        status = protocol_attempt(port, in, out, timeout_ms, false);
+    }
+    return status;
+}
+
+enum protocol_status protocol_request_status(const struct uart_port * port,
+                                             struct protocol_packet * in,
+                                             struct protocol_packet * out,
+                                             uint32_t timeout_ms)
 {
     if(!port || !in)
     {
@@ -301,24 +1148,44 @@ bool protocol_request_timeout(const struct uart_port * port,
         out = &devnull;
     }
 
-    protocol_write_block(port, in);
+    const struct protocol_retry_policy policy = retry_policy;
+    if(policy.sequenced)
+    {
+        protocol_packet_sequence(in, protocol_next_sequence(port));
+    }
 
-    const bool success =
-        protocol_read_block_error(port, out, timeout_ms, timeout_error);
+    protocol_stats_count(protocol_request_command(in), PROTOCOL_STATS_REQUESTS);
 
-    if(success)
+    enum protocol_status status =
+        protocol_attempt(port, in, out, timeout_ms, true);
+    status = protocol_retry(port, in, out, timeout_ms, status, &policy);
+
+    if(policy.sequenced)
     {
-        protocol_validate_response(in, out);
-        return true;
+        protocol_packet_unsequence_sent(in);
     }
-    else
+    return status;
+}
+
+bool protocol_request_timeout(const struct uart_port * port,
+                              struct protocol_packet * in,
+                              struct protocol_packet * out,
+                              uint32_t timeout_ms,
+                              bool timeout_error)
+{
+    const enum protocol_status status =
+        protocol_request_status(port, in, out, timeout_ms);
+
+    if(PROTOCOL_STATUS_TIMEOUT == status && !timeout_error)
     {
-        if(timeout_error)
-        {
-            error(FILE_LINE, "timeout");
-        }
         return false;
     }
+
+    if(PROTOCOL_STATUS_OK != status)
+    {
+        error(FILE_LINE, protocol_status_string(status));
+    }
+    return true;
 }
 
 
@@ -330,12 +1197,14 @@ void protocol_request(const struct uart_port * port,
 }
 
 
-void protocol_broadcast_timeout(const struct uart_port * const ports[],
-                                unsigned int num_ports,
-                                struct protocol_packet  pkt[],
-                                struct protocol_packet response[],
-                                enum protocol_broadcast_type btype,
-                                uint32_t timeout)
+enum protocol_status
+protocol_broadcast_status(const struct uart_port * const ports[],
+                          unsigned int num_ports,
+                          struct protocol_packet  pkt[],
+                          struct protocol_packet response[],
+                          enum protocol_broadcast_type btype,
+                          uint32_t timeout,
+                          enum protocol_status status[])
 {
     if(!pkt || !ports)
     {
@@ -347,32 +1216,50 @@ void protocol_broadcast_timeout(const struct uart_port * const ports[],
         error(FILE_LINE, "invalid number of ports");
     }
 
+    if(PROTOCOL_BROADCAST != btype && PROTOCOL_ANYCAST != btype)
+    {
+        error(FILE_LINE, "Unknown btype");
+    }
+
+    const struct protocol_retry_policy policy = retry_policy;
+
     // get the leng
     uint32_t out_length[MAX_BROADCAST_PORTS] = {0};
-    const struct protocol_packet * outpack[MAX_BROADCAST_PORTS] = {NULL};
+    struct protocol_packet * outpack[MAX_BROADCAST_PORTS] = {NULL};
 
-    out_length[0] = protocol_header_init(&pkt[0]);
-    outpack[0] = &pkt[0];
+    // sequenced packets are copied, because each port has its own
+    // sequence numbers
+    struct protocol_packet sequenced[MAX_BROADCAST_PORTS];
 
-    for(unsigned int i = 1; i < num_ports; ++i)
+    for(unsigned int i = 0; i < num_ports; ++i)
     {
-        switch(btype)
+        struct protocol_packet * source =
+            PROTOCOL_BROADCAST == btype ? &pkt[0] : &pkt[i];
+        if(policy.sequenced)
         {
-        case PROTOCOL_ANYCAST: // each packet sent is different
-            out_length[i] = protocol_header_init(&pkt[i]);
-            outpack[i] = &pkt[i];
-            if(out_length[i] != out_length[0])
-            {
-                // packets must have the same length
-                error(FILE_LINE, "packet length mismatch");
-            }
-            break;
-        case PROTOCOL_BROADCAST: // each packet sent is the same
-            out_length[i] = out_length[0];
+            protocol_packet_copy(&sequenced[i], source);
+            protocol_packet_sequence(&sequenced[i],
+                                     protocol_next_sequence(ports[i]));
+            outpack[i] = &sequenced[i];
+            out_length[i] = protocol_header_init(outpack[i]);
+        }
+        else if(0 == i || PROTOCOL_ANYCAST == btype)
+        {
+            // each packet sent is different
+            outpack[i] = source;
+            out_length[i] = protocol_header_init(outpack[i]);
+        }
+        else
+        {
+            // each packet sent is the same
             outpack[i] = outpack[0];
-            break;
-        default:
-            error(FILE_LINE, "Unknown btype");
+            out_length[i] = out_length[0];
+        }
+
+        if(out_length[i] != out_length[0])
+        {
+            // packets must have the same length
+            error(FILE_LINE, "packet length mismatch");
         }
     }
 
@@ -381,6 +1268,38 @@ void protocol_broadcast_timeout(const struct uart_port * const ports[],
         error(FILE_LINE, "packet data too long");
     }
 
+    // ports with adaptive timeouts wait for as long as their round trip
+    // time requires, and the loop waits for the slowest port
+    bool adaptive[MAX_BROADCAST_PORTS] = {false};
+    bool any_adaptive = false;
+    uint32_t wait_ms = 0;
+    for(unsigned int port = 0; port != num_ports; ++port)
+    {
+        const struct port_state * state = protocol_port_state(ports[port]);
+        adaptive[port] = 0 != state->timeout_ceiling_us;
+        any_adaptive |= adaptive[port];
+
+        // the length of the response is not known in advance
+        const uint32_t port_ms = !adaptive[port] ? timeout :
+            protocol_us_to_ms(
+                protocol_rtt_timeout_us(&state->rtt,
+                                        state->timeout_floor_us,
+                                        state->timeout_ceiling_us)
+                + (out_length[port] + PROTOCOL_PACKET_MAX_LENGTH)
+                * protocol_byte_time_us(state));
+        wait_ms = port_ms > wait_ms ? port_ms : wait_ms;
+    }
+
+    // only measure the latency if it will be used
+    const bool record_latency = protocol_stats_enabled() || any_adaptive;
+    struct time_elapsed_us latency = {{0, 0, 0}};
+    if(record_latency)
+    {
+        latency = time_elapsed_us_init();
+    }
+
+    // the time at which each port's response was complete, in us
+    uint32_t latency_us[MAX_BROADCAST_PORTS] = {0};
 
     // TODO: there is an optimal point between how much data to send
     // per interleaved. for now interleave every byte
@@ -391,6 +1310,13 @@ void protocol_broadcast_timeout(const struct uart_port * const ports[],
             uart_write_nonblock(ports[port], &outpack[port]->_data[i], 1);
         }
     }
+    for(unsigned int port = 0; port != num_ports; ++port)
+    {
+        protocol_tap_packet(ports[port], PROTOCOL_DIRECTION_TX,
+                            outpack[port], out_length[port]);
+        protocol_stats_count(protocol_request_command(outpack[port]),
+                             PROTOCOL_STATS_REQUESTS);
+    }
 
     // garbage buffer if caller does not want a response
     struct protocol_packet in_packets[MAX_BROADCAST_PORTS];
@@ -421,8 +1347,17 @@ void protocol_broadcast_timeout(const struct uart_port * const ports[],
         // reasons
         for(unsigned int port = 0; port != num_ports; ++port)
         {
-            index[port] += uart_read_nonblock(ports[port],
-                                     &in_packet[port]._data[index[port]], 12);
+            // do not read past the end of the packet: anything after it
+            // is not part of the response
+            const uint8_t remaining = length[port] > index[port] ?
+                length[port] - index[port] : 0;
+            if(remaining > 0)
+            {
+                index[port] +=
+                    uart_read_nonblock(ports[port],
+                                       &in_packet[port]._data[index[port]],
+                                       remaining < 12 ? remaining : 12);
+            }
         }
 
         // if we have read the length byte from the packet, then
@@ -436,34 +1371,95 @@ void protocol_broadcast_timeout(const struct uart_port * const ports[],
             }
         }
 
-        if(time_elapsed_ms(&elapsed) > timeout)
-        {
-            error(FILE_LINE, "timeout");
-        }
-
         // determine if we still must load more data
         keep_looping = false;
         for(unsigned int port = 0; port != num_ports; ++port)
         {
-            keep_looping |= index[port] < length[port];
+            const bool waiting = index[port] < length[port];
+            if(record_latency && !waiting && 0 == latency_us[port])
+            {
+                latency_us[port] = time_elapsed_us(&latency);
+            }
+            keep_looping |= waiting;
+        }
+
+        // ports that have not responded are handled below
+        if(keep_looping && time_elapsed_ms(&elapsed) > wait_ms)
+        {
+            break;
         }
     }
 
     // verify and validate the response
+    enum protocol_status result = PROTOCOL_STATUS_OK;
     for(unsigned int port = 0; port != num_ports; ++port)
     {
-        if(length[port] < HEADER_BYTES)
+        // NOTE: for simplicity, broadcasting is incompatible with bootloader
+        // therefore a length of 0 is never permissible, unlike when sending
+        // a single packet, and is treated as a corrupt packet.
+        const bool complete = index[port] >= length[port];
+        if(complete && length[port] >= HEADER_BYTES)
+        {
+            protocol_tap_packet(ports[port], PROTOCOL_DIRECTION_RX,
+                                &in_packet[port], length[port]);
+        }
+
+        // a received length of 0 is a timeout, and lengths shorter
+        // than the header are corrupt
+        uint32_t received = 0;
+        if(complete)
         {
-            // NOTE: for simplicity, broadcasting is incompatible with bootloader
-            // therefore a length of 0 is never permissible, unlike when sending
-            // a single packet.
-            error(FILE_LINE, "invalid length");
+            received = length[port] < HEADER_BYTES ? LENGTH_BYTES : length[port];
         }
 
         // setup the packet data from the raw data and
         // verify that the checksum is correct
-        protocol_verify_checksum(&in_packet[port], length[port] - HEADER_BYTES);
-        protocol_validate_response(outpack[port], &in_packet[port]);
+        enum protocol_status port_status =
+            protocol_response_status(outpack[port], &in_packet[port], received);
+
+        if(record_latency && PROTOCOL_STATUS_OK == port_status)
+        {
+            protocol_stats_latency(protocol_request_command(outpack[port]),
+                                   latency_us[port]);
+            if(adaptive[port])
+            {
+                protocol_rtt_sample(protocol_port_state(ports[port]),
+                                    latency_us[port],
+                                    out_length[port] + length[port]);
+            }
+        }
+
+        // ports that failed are retried one at a time
+        port_status = protocol_retry(ports[port], outpack[port],
+                                     &in_packet[port], timeout,
+                                     port_status, &policy);
+
+        if(status)
+        {
+            status[port] = port_status;
+        }
+
+        if(PROTOCOL_STATUS_OK == result)
+        {
+            result = port_status;
+        }
+    }
+    return result;
+}
+
+void protocol_broadcast_timeout(const struct uart_port * const ports[],
+                                unsigned int num_ports,
+                                struct protocol_packet  pkt[],
+                                struct protocol_packet response[],
+                                enum protocol_broadcast_type btype,
+                                uint32_t timeout)
+{
+    const enum protocol_status status =
+        protocol_broadcast_status(ports, num_ports, pkt, response,
+                                  btype, timeout, NULL);
+    if(PROTOCOL_STATUS_OK != status)
+    {
+        error(FILE_LINE, protocol_status_string(status));
     }
 }
 
@@ -487,3 +1483,122 @@ void protocol_error_response(const struct uart_port * port)
     protocol_packet_init(&out, PROTOCOL_ERROR);
     protocol_write_block(port, &out);
 }
+
+void protocol_set_tap(protocol_tap tap, void * context)
+{
+    tap_function = tap;
+    tap_context = context;
+}
+
+void protocol_set_retry_policy(const struct protocol_retry_policy * policy)
+{
+    if(policy)
+    {
+        retry_policy = *policy;
+    }
+    else
+    {
+        const struct protocol_retry_policy none = PROTOCOL_RETRY_POLICY_NONE;
+        retry_policy = none;
+    }
+}
+
+void protocol_set_timeout_limits(const struct uart_port * port,
+                                 uint32_t floor_us,
+                                 uint32_t ceiling_us)
+{
+    if(!port)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(floor_us > ceiling_us)
+    {
+        error(FILE_LINE, "timeout floor above ceiling");
+    }
+
+    struct port_state * state = protocol_port_state(port);
+    state->timeout_floor_us = floor_us;
+    state->timeout_ceiling_us = ceiling_us;
+}
+
+struct protocol_rtt protocol_port_rtt(const struct uart_port * port)
+{
+    if(!port)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    return protocol_port_state(port)->rtt;
+}
+
+void protocol_rtt_update(struct protocol_rtt * rtt, uint32_t sample_us)
+{
+    if(!rtt)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(!rtt->valid)
+    {
+        rtt->srtt_us = sample_us;
+        rtt->rttvar_us = sample_us / 2;
+        rtt->valid = true;
+        return;
+    }
+
+    // the gains are 1/4 for the variation and 1/8 for the round trip time,
+    // as recommended by RFC 6298
+    const uint32_t deviation = rtt->srtt_us > sample_us ?
+        rtt->srtt_us - sample_us : sample_us - rtt->srtt_us;
+    rtt->rttvar_us = (uint32_t)((3ull * rtt->rttvar_us + deviation) / 4);
+    rtt->srtt_us = (uint32_t)((7ull * rtt->srtt_us + sample_us) / 8);
+}
+
+uint32_t protocol_rtt_timeout_us(const struct protocol_rtt * rtt,
+                                 uint32_t floor_us,
+                                 uint32_t ceiling_us)
+{
+    if(!rtt)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(!rtt->valid)
+    {
+        return ceiling_us;
+    }
+
+    // a variation smaller than the timer resolution cannot be measured
+    const uint64_t variation = 4ull * rtt->rttvar_us;
+    const uint64_t timeout = rtt->srtt_us
+        + (variation > TIMER_RESOLUTION_US ? variation : TIMER_RESOLUTION_US);
+
+    if(timeout < floor_us)
+    {
+        return floor_us;
+    }
+    if(timeout > ceiling_us)
+    {
+        return ceiling_us;
+    }
+    return (uint32_t)timeout;
+}
+
+const char * protocol_status_string(enum protocol_status status)
+{
+    switch(status)
+    {
+    case PROTOCOL_STATUS_OK:
+        return "OK";
+    case PROTOCOL_STATUS_TIMEOUT:
+        return "timeout";
+    case PROTOCOL_STATUS_CHECKSUM:
+        return "invalid checksum";
+    case PROTOCOL_STATUS_ERROR_RESPONSE:
+        return "Received an ERROR from downstream.";
+    case PROTOCOL_STATUS_MISMATCH:
+        return "Request/response mismatch.";
+    default:
+        return "unknown status";
+    }
+}
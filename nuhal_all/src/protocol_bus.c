@@ -0,0 +1,163 @@
+#include "nuhal/protocol_bus.h"
+#include "nuhal/error.h"
+#include "nuhal/utilities.h"
+
+void protocol_bus_init(struct protocol_bus * out,
+                       const struct uart_port * port,
+                       enum protocol_bus_schedule schedule,
+                       uint32_t slot_us,
+                       uint32_t timeout_ms)
+{
+    if(!out || !port)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(PROTOCOL_BUS_TIME_SLOTTED == schedule && 0 == slot_us)
+    {
+        error(FILE_LINE, "time slots must have a length");
+    }
+
+    out->port = port;
+    out->drops = 0;
+    out->schedule = schedule;
+    out->slot_us = slot_us;
+    out->timeout_ms = timeout_ms;
+    out->next = 0;
+    out->started = false;
+}
+
+void protocol_bus_add(struct protocol_bus * bus, uint8_t address)
+{
+    if(!bus)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(PROTOCOL_ADDRESS_BROADCAST == address)
+    {
+        error(FILE_LINE, "reserved address");
+    }
+
+    if(bus->drops == ARRAY_LEN(bus->address))
+    {
+        error(FILE_LINE, "too many drops");
+    }
+    bus->address[bus->drops] = address;
+    ++bus->drops;
+}
+
+enum protocol_status protocol_bus_request(struct protocol_bus * bus,
+                                          uint8_t address,
+                                          const struct protocol_packet * in,
+                                          struct protocol_packet * out,
+                                          uint32_t timeout_ms)
+{
+    if(!bus || !in)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    // the response is checked against, and unwrapped from, this address
+    struct protocol_packet request;
+    protocol_packet_copy(&request, in);
+    protocol_packet_address(&request, address);
+    return protocol_request_status(bus->port, &request, out, timeout_ms);
+}
+
+void protocol_bus_broadcast(struct protocol_bus * bus,
+                            const struct protocol_packet * in)
+{
+    if(!bus || !in)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    struct protocol_packet request;
+    protocol_packet_copy(&request, in);
+    protocol_packet_address(&request, PROTOCOL_ADDRESS_BROADCAST);
+    protocol_write_block(bus->port, &request);
+}
+
+/// @brief wait until a time after the start of the current cycle
+/// @param bus - the bus
+/// @param offset_us - the time after the start of the cycle, in us
+static void protocol_bus_wait(struct protocol_bus * bus, uint32_t offset_us)
+{
+    const uint32_t elapsed = time_elapsed_us(&bus->cycle);
+    if(elapsed < offset_us)
+    {
+        time_delay_us(offset_us - elapsed);
+    }
+}
+
+enum protocol_status protocol_bus_poll(struct protocol_bus * bus,
+                                       protocol_bus_request_builder build,
+                                       protocol_bus_response_handler handle,
+                                       void * context)
+{
+    if(!bus || !build)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(0 == bus->drops)
+    {
+        error(FILE_LINE, "no drops");
+    }
+
+    const unsigned int slot = bus->next;
+    bus->next = (slot + 1) % bus->drops;
+
+    if(PROTOCOL_BUS_TIME_SLOTTED == bus->schedule)
+    {
+        if(0 == slot)
+        {
+            // a new cycle starts when the previous one is over
+            if(bus->started)
+            {
+                protocol_bus_wait(bus, bus->drops * bus->slot_us);
+            }
+            bus->cycle = time_elapsed_us_init();
+            bus->started = true;
+        }
+        else if(bus->started)
+        {
+            protocol_bus_wait(bus, slot * bus->slot_us);
+        }
+    }
+
+    const uint8_t address = bus->address[slot];
+    struct protocol_packet request;
+    build(address, &request, context);
+
+    struct protocol_packet response;
+    const enum protocol_status status =
+        protocol_bus_request(bus, address, &request, &response, bus->timeout_ms);
+    if(handle)
+    {
+        handle(address, status, &response, context);
+    }
+    return status;
+}
+
+unsigned int protocol_bus_cycle(struct protocol_bus * bus,
+                                protocol_bus_request_builder build,
+                                protocol_bus_response_handler handle,
+                                void * context)
+{
+    if(!bus)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    unsigned int responses = 0;
+    for(unsigned int i = 0; i != bus->drops; ++i)
+    {
+        if(PROTOCOL_STATUS_OK == protocol_bus_poll(bus, build, handle, context))
+        {
+            ++responses;
+        }
+    }
+    return responses;
+}
@@ -0,0 +1,308 @@
+#include "nuhal/protocol_delta.h"
+#include "nuhal/error.h"
+#include <string.h>
+
+// the number of bytes in a word of the frame
+#define WORD_BYTES 4u
+
+// the number of words in a frame, the last of which may be short
+static size_t delta_words(const struct protocol_delta * delta)
+{
+    return (delta->length + WORD_BYTES - 1u) / WORD_BYTES;
+}
+
+// the number of bytes in the bitmask of changed words
+static size_t delta_mask_bytes(const struct protocol_delta * delta)
+{
+    return (delta_words(delta) + 7u) / 8u;
+}
+
+// the number of bytes in a word of the frame
+static size_t delta_word_bytes(const struct protocol_delta * delta, size_t word)
+{
+    const size_t remaining = delta->length - word * WORD_BYTES;
+    return remaining < WORD_BYTES ? remaining : WORD_BYTES;
+}
+
+// read a word of a frame as a big endian integer
+static uint32_t delta_word_get(const uint8_t bytes[], size_t len)
+{
+    uint32_t word = 0;
+    for(size_t i = 0; i != len; ++i)
+    {
+        word = (word << 8) | bytes[i];
+    }
+    return word;
+}
+
+// write a word of a frame as a big endian integer
+static void delta_word_set(uint8_t bytes[], size_t len, uint32_t word)
+{
+    for(size_t i = len; i != 0; --i)
+    {
+        bytes[i - 1] = (uint8_t)word;
+        word >>= 8;
+    }
+}
+
+// the difference between a word of two frames, truncated to the word size
+static int32_t delta_word_difference(const struct protocol_delta * delta,
+                                     const uint8_t frame[],
+                                     const uint8_t base[],
+                                     size_t word)
+{
+    const size_t offset = word * WORD_BYTES;
+    const size_t len = delta_word_bytes(delta, word);
+    return (int32_t)(delta_word_get(&frame[offset], len)
+                     - delta_word_get(&base[offset], len));
+}
+
+// find a remembered frame, or NULL if it has been forgotten
+static const uint8_t * delta_find(const struct protocol_delta * delta,
+                                  uint8_t sequence)
+{
+    for(unsigned int i = 0; i != delta->history_count; ++i)
+    {
+        if(delta->history_sequence[i] == sequence)
+        {
+            return delta->history[i];
+        }
+    }
+    return NULL;
+}
+
+// true if sequence number a comes after b. Sequence numbers wrap, so this
+// holds when a is less than half the sequence space ahead of b
+static bool delta_newer(uint8_t a, uint8_t b)
+{
+    return (int8_t)(uint8_t)(a - b) > 0;
+}
+
+// remember a frame, forgetting the oldest one if the history is full
+static void delta_remember(struct protocol_delta * delta,
+                           const uint8_t frame[],
+                           uint8_t sequence)
+{
+    if(PROTOCOL_DELTA_HISTORY == delta->history_count)
+    {
+        memmove(delta->history[0], delta->history[1],
+                sizeof(delta->history[0]) * (PROTOCOL_DELTA_HISTORY - 1u));
+        memmove(&delta->history_sequence[0], &delta->history_sequence[1],
+                PROTOCOL_DELTA_HISTORY - 1u);
+        --delta->history_count;
+    }
+    memcpy(delta->history[delta->history_count], frame, delta->length);
+    delta->history_sequence[delta->history_count] = sequence;
+    ++delta->history_count;
+    delta->sequence = sequence;
+}
+
+// the frame against which the next frame is encoded, or NULL to send a key frame
+static const uint8_t * delta_base(const struct protocol_delta * delta,
+                                  uint8_t * sequence)
+{
+    if(delta->key_requested || 0 == delta->history_count
+       || (0 != delta->key_interval && delta->since_key >= delta->key_interval))
+    {
+        return NULL;
+    }
+
+    if(PROTOCOL_DELTA_PREVIOUS == delta->base)
+    {
+        *sequence = delta->sequence;
+    }
+    else if(delta->has_acknowledged)
+    {
+        *sequence = delta->acknowledged;
+    }
+    else
+    {
+        return NULL;
+    }
+
+    // the receiver has decoded no more frames than have been sent since the
+    // base, so if the sender remembers the base, so does the receiver
+    return delta_find(delta, *sequence);
+}
+
+void protocol_delta_init(struct protocol_delta * out,
+                         size_t length,
+                         enum protocol_delta_base base,
+                         uint32_t key_interval)
+{
+    if(!out)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(0 == length || length > PROTOCOL_DELTA_FRAME_MAX)
+    {
+        error(FILE_LINE, "invalid param");
+    }
+
+    out->length = length;
+    out->base = base;
+    out->key_interval = key_interval;
+    out->history_count = 0;
+    out->sequence = UINT8_MAX;
+    out->acknowledged = 0;
+    out->has_acknowledged = false;
+    out->since_key = 0;
+    out->key_requested = false;
+}
+
+bool protocol_delta_encode(struct protocol_delta * delta,
+                           const uint8_t frame[],
+                           struct bytestream * bs)
+{
+    if(!delta || !frame || !bs)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    const uint8_t sequence = delta->sequence + 1u;
+    uint8_t base_sequence = 0;
+    const uint8_t * base = delta_base(delta, &base_sequence);
+
+    uint8_t mask[(PROTOCOL_DELTA_FRAME_MAX / WORD_BYTES + 8u) / 8u] = {0};
+    size_t size = delta_mask_bytes(delta);
+    if(base)
+    {
+        for(size_t word = 0; word != delta_words(delta); ++word)
+        {
+            const int32_t difference =
+                delta_word_difference(delta, frame, base, word);
+            if(0 != difference)
+            {
+                mask[word / 8u] |= (uint8_t)(1u << (word % 8u));
+                size += bytestream_varint_size(bytestream_zigzag_encode(difference));
+            }
+        }
+    }
+
+    // a delta frame that is no shorter than the frame is not worth sending
+    const bool key = !base || size >= delta->length;
+    bytestream_inject_u8(bs, key ? PROTOCOL_DELTA_KEY : 0u);
+    bytestream_inject_u8(bs, sequence);
+    bytestream_inject_u8(bs, base_sequence);
+    if(key)
+    {
+        bytestream_inject_u8_array(bs, frame, delta->length);
+        delta->since_key = 0;
+        delta->key_requested = false;
+    }
+    else
+    {
+        bytestream_inject_u8_array(bs, mask, delta_mask_bytes(delta));
+        for(size_t word = 0; word != delta_words(delta); ++word)
+        {
+            if(mask[word / 8u] & (1u << (word % 8u)))
+            {
+                bytestream_inject_zigzag(
+                    bs, delta_word_difference(delta, frame, base, word));
+            }
+        }
+        ++delta->since_key;
+    }
+
+    delta_remember(delta, frame, sequence);
+    return key;
+}
+
+bool protocol_delta_decode(struct protocol_delta * delta,
+                           struct bytestream * bs,
+                           uint8_t frame[])
+{
+    if(!delta || !bs || !frame)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    const uint8_t flags = bytestream_extract_u8(bs);
+    const uint8_t sequence = bytestream_extract_u8(bs);
+    const uint8_t base_sequence = bytestream_extract_u8(bs);
+    if(flags & PROTOCOL_DELTA_KEY)
+    {
+        bytestream_extract_u8_array(bs, frame, delta->length);
+        delta_remember(delta, frame, sequence);
+        return true;
+    }
+
+    uint8_t mask[(PROTOCOL_DELTA_FRAME_MAX / WORD_BYTES + 8u) / 8u] = {0};
+    bytestream_extract_u8_array(bs, mask, delta_mask_bytes(delta));
+
+    // a frame that is not newer than the last one decoded, or whose base is,
+    // was encoded after the sequence numbers wrapped while frames were lost,
+    // so a remembered frame with the same number is not its base
+    const uint8_t * base = NULL;
+    if(0 != delta->history_count
+       && delta_newer(sequence, delta->sequence)
+       && !delta_newer(base_sequence, delta->sequence))
+    {
+        base = delta_find(delta, base_sequence);
+    }
+    if(base)
+    {
+        memcpy(frame, base, delta->length);
+    }
+
+    for(size_t word = 0; word != delta_words(delta); ++word)
+    {
+        if(mask[word / 8u] & (1u << (word % 8u)))
+        {
+            // the differences are consumed even without a base, so that
+            // the whole frame is read
+            const int32_t difference = bytestream_extract_zigzag(bs);
+            if(base)
+            {
+                const size_t offset = word * WORD_BYTES;
+                const size_t len = delta_word_bytes(delta, word);
+                delta_word_set(&frame[offset], len,
+                               delta_word_get(&frame[offset], len)
+                               + (uint32_t)difference);
+            }
+        }
+    }
+
+    if(!base)
+    {
+        return false;
+    }
+    delta_remember(delta, frame, sequence);
+    return true;
+}
+
+uint8_t protocol_delta_sequence(const struct protocol_delta * delta)
+{
+    if(!delta)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    return delta->sequence;
+}
+
+void protocol_delta_ack(struct protocol_delta * delta, uint8_t sequence)
+{
+    if(!delta)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    // acknowledgements that arrive out of order do not move the base back
+    const bool newer = !delta->has_acknowledged
+        || delta_newer(sequence, delta->acknowledged);
+    if(newer && delta_find(delta, sequence))
+    {
+        delta->acknowledged = sequence;
+        delta->has_acknowledged = true;
+    }
+}
+
+void protocol_delta_request_key(struct protocol_delta * delta)
+{
+    if(!delta)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    delta->key_requested = true;
+}
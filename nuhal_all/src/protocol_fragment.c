@@ -0,0 +1,131 @@
+#include "nuhal/protocol_fragment.h"
+#include "nuhal/error.h"
+#include <string.h>
+
+void protocol_reassembly_init(struct protocol_reassembly * out,
+                              uint8_t data[],
+                              size_t capacity)
+{
+    if(!out || !data)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    out->data = data;
+    out->capacity = capacity;
+    out->total = 0;
+    out->received = 0;
+}
+
+size_t protocol_fragment_inject(struct bytestream * bs,
+                                const uint8_t data[],
+                                size_t total,
+                                size_t offset)
+{
+    if(!bs || (!data && total != 0))
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(total > PROTOCOL_FRAGMENT_TOTAL_MAX || offset > total)
+    {
+        error(FILE_LINE, "invalid fragment");
+    }
+
+    bytestream_inject_u16(bs, (uint16_t)total);
+    bytestream_inject_u16(bs, (uint16_t)offset);
+
+    // send as much of the remaining data as will fit in the packet
+    const size_t room = bs->capacity - bs->size;
+    const size_t len = total - offset < room ? total - offset : room;
+    memcpy(&bs->data[bs->size], &data[offset], len);
+    bs->size += len;
+    return len;
+}
+
+bool protocol_reassembly_extract(struct protocol_reassembly * ra,
+                                 struct bytestream * bs)
+{
+    if(!ra || !bs)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    const size_t total = bytestream_extract_u16(bs);
+    const size_t offset = bytestream_extract_u16(bs);
+    const size_t len = bs->capacity - bs->size;
+
+    if(0 == offset)
+    {
+        // the first fragment of a transfer. Anything received previously
+        // belongs to an abandoned transfer and is discarded
+        if(total > ra->capacity)
+        {
+            error(FILE_LINE, "transfer too long");
+        }
+        ra->total = total;
+        ra->received = 0;
+    }
+    else if(total != ra->total || offset != ra->received)
+    {
+        // a fragment was lost or reordered. The transfer in progress
+        // cannot complete, so drop it and wait for one with offset 0
+        ra->total = 0;
+        ra->received = 0;
+        bs->size = bs->capacity;
+        return false;
+    }
+
+    if(offset + len > total)
+    {
+        error(FILE_LINE, "fragment overflow");
+    }
+
+    memcpy(&ra->data[offset], &bs->data[bs->size], len);
+    bs->size += len;
+    ra->received += len;
+    return ra->received == ra->total;
+}
+
+void protocol_write_fragmented(const struct uart_port * port,
+                               uint8_t command,
+                               const uint8_t data[],
+                               size_t len)
+{
+    if(!port)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    size_t offset = 0;
+    // a zero length transfer is still sent, as a single empty fragment
+    do
+    {
+        struct protocol_packet packet;
+        protocol_packet_init(&packet, command);
+        offset += protocol_fragment_inject(&packet.stream, data, len, offset);
+        protocol_write_block(port, &packet);
+    } while(offset != len);
+}
+
+size_t protocol_read_fragmented(const struct uart_port * port,
+                                uint8_t command,
+                                struct protocol_reassembly * ra,
+                                uint32_t timeout)
+{
+    if(!port || !ra)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    struct protocol_packet packet;
+    do
+    {
+        protocol_read_block(port, &packet, timeout);
+        if(protocol_packet_command(&packet) != command)
+        {
+            error(FILE_LINE, "unexpected command");
+        }
+    } while(!protocol_reassembly_extract(ra, &packet.stream));
+
+    return ra->total;
+}
@@ -0,0 +1,355 @@
+#include "nuhal/protocol_server.h"
+#include "nuhal/error.h"
+#include "nuhal/uart.h"
+#include "nuhal/time.h"
+
+/// time to wait for the rest of a request once it starts arriving, in ms
+#define READ_TIMEOUT_MS 100u
+
+/// after a corrupt request, discard data until the port is quiet for this
+/// long, in ms, so that the next request is read from its start
+#define DRAIN_MS 2u
+
+void protocol_server_init(struct protocol_server * out)
+{
+    if(!out)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    for(unsigned int i = 0; i != ARRAY_LEN(out->entry); ++i)
+    {
+        out->entry[i].handler = NULL;
+        out->entry[i].context = NULL;
+    }
+    out->last_result = false;
+    out->last_sequence = 0;
+    out->last_request = 0;
+    out->has_last = false;
+    out->bauds = NULL;
+    out->num_bauds = 0;
+    out->baud = 0;
+    out->features = 0;
+    out->address = 0;
+    out->has_address = false;
+}
+
+void protocol_server_register(struct protocol_server * server,
+                              uint8_t command,
+                              protocol_handler handler,
+                              void * context)
+{
+    if(!server)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    // the error command is how unhandled requests are reported
+    if(PROTOCOL_ERROR == command)
+    {
+        error(FILE_LINE, "reserved command");
+    }
+    server->entry[command].handler = handler;
+    server->entry[command].context = context;
+}
+
+void protocol_server_negotiation(struct protocol_server * server,
+                                 uint32_t baud,
+                                 const uint32_t bauds[],
+                                 unsigned int num_bauds,
+                                 uint32_t features)
+{
+    if(!server)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    server->baud = baud;
+    server->bauds = bauds;
+    server->num_bauds = bauds ? num_bauds : 0;
+    server->features = features;
+}
+
+void protocol_server_address(struct protocol_server * server, uint8_t address)
+{
+    if(!server)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(PROTOCOL_ADDRESS_BROADCAST == address)
+    {
+        error(FILE_LINE, "reserved address");
+    }
+    server->address = address;
+    server->has_address = true;
+}
+
+/// @brief parse a PROTOCOL_NEGOTIATE request and build the response in place
+/// @param server The server
+/// @param packet [in/out] The request, which is replaced by the response
+/// @return the selected baud rate, or 0 if the request is malformed and
+/// packet holds an error response
+static uint32_t protocol_server_negotiate_reply(const struct protocol_server * server,
+                                                struct protocol_packet * packet)
+{
+    uint32_t offered[PROTOCOL_NEGOTIATE_MAX_BAUDS];
+
+    // the data includes the command byte
+    const size_t header = 1 + sizeof(uint32_t) + 1;
+    if(packet->stream.capacity < header)
+    {
+        protocol_packet_init(packet, PROTOCOL_ERROR);
+        return 0;
+    }
+
+    const uint32_t features = bytestream_extract_u32(&packet->stream);
+    const uint8_t num_offered = bytestream_extract_u8(&packet->stream);
+    if(num_offered > ARRAY_LEN(offered)
+       || packet->stream.capacity != header + num_offered * sizeof(uint32_t))
+    {
+        protocol_packet_init(packet, PROTOCOL_ERROR);
+        return 0;
+    }
+
+    for(unsigned int i = 0; i != num_offered; ++i)
+    {
+        offered[i] = bytestream_extract_u32(&packet->stream);
+    }
+
+    uint32_t baud = protocol_select_baud(offered, num_offered,
+                                         server->bauds, server->num_bauds);
+    if(0 == baud)
+    {
+        // no offered rates (a confirmation) or none in common
+        baud = server->baud;
+    }
+
+    protocol_packet_init(packet, PROTOCOL_NEGOTIATE);
+    bytestream_inject_u32(&packet->stream, features & server->features);
+    bytestream_inject_u32(&packet->stream, baud);
+    return baud;
+}
+
+/// @brief respond to a PROTOCOL_NEGOTIATE request and switch baud rates
+/// @param server The server
+/// @param port The port
+/// @param packet The request
+static void protocol_server_negotiate(struct protocol_server * server,
+                                      const struct uart_port * port,
+                                      struct protocol_packet * packet)
+{
+    // negotiation starts a new session with a client, so its requests
+    // cannot be retries of requests from an earlier session
+    server->has_last = false;
+
+    const uint32_t baud = protocol_server_negotiate_reply(server, packet);
+    protocol_write_block(port, packet);
+    if(0 == baud || baud == server->baud)
+    {
+        return;
+    }
+
+    // the response is sent at the old rate before the switch
+    uart_set_baud(port, baud);
+
+    // the client confirms that it can reach us at the new rate,
+    // otherwise both sides return to the old rate. A lost or corrupt
+    // confirmation does not end the wait, because the client sends it again
+    // within PROTOCOL_NEGOTIATE_CONFIRM_WINDOW_MS. Once we
+    // switch, later confirmations (sent if our reply is lost) are handled
+    // by protocol_server_poll at the new rate
+    struct time_elapsed_ms elapsed = time_elapsed_ms_init();
+    uint32_t waited = 0;
+    while(waited < PROTOCOL_NEGOTIATE_CONFIRM_WINDOW_MS)
+    {
+        struct protocol_packet confirm;
+        if(PROTOCOL_STATUS_OK == protocol_read_status(
+               port, &confirm, PROTOCOL_NEGOTIATE_CONFIRM_WINDOW_MS - waited)
+           && PROTOCOL_NEGOTIATE == protocol_packet_command(&confirm))
+        {
+            const uint32_t old_baud = server->baud;
+            server->baud = baud;
+            if(baud == protocol_server_negotiate_reply(server, &confirm))
+            {
+                protocol_write_block(port, &confirm);
+                return;
+            }
+            server->baud = old_baud;
+            break;
+        }
+        waited = time_elapsed_ms(&elapsed);
+    }
+
+    uart_set_baud(port, server->baud);
+    protocol_drain(port, DRAIN_MS);
+}
+
+/// @brief call the handler for a request
+/// @param server The server
+/// @param packet [in/out] The request, which is replaced by the response
+/// @return true if the handler built a response
+static bool protocol_server_dispatch(const struct protocol_server * server,
+                                     struct protocol_packet * packet)
+{
+    const struct protocol_server_entry * entry =
+        &server->entry[protocol_packet_command(packet)];
+
+    if(entry->handler && entry->handler(packet, entry->context))
+    {
+        return true;
+    }
+
+    // same as protocol_error_response, but built in the request buffer
+    protocol_packet_init(packet, PROTOCOL_ERROR);
+    return false;
+}
+
+/// @brief hash the command and data of a request (FNV-1a)
+/// @param packet The request, after its sequence number has been removed
+/// @return the hash
+static uint32_t protocol_server_request_hash(const struct protocol_packet * packet)
+{
+    // the stream of a received packet spans the command and the data
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i != packet->stream.capacity; ++i)
+    {
+        hash = (hash ^ packet->stream.data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+bool protocol_server_handle(struct protocol_server * server,
+                            struct protocol_packet * packet)
+{
+    if(!server || !packet)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    uint8_t sequence = 0;
+    const bool sequenced = protocol_packet_unsequence(packet, &sequence);
+    const uint32_t request = sequenced ? protocol_server_request_hash(packet) : 0;
+
+    // a retry of the last request: its response was lost
+    if(sequenced && server->has_last && sequence == server->last_sequence
+       && request == server->last_request)
+    {
+        protocol_packet_copy(packet, &server->last_response);
+        return server->last_result;
+    }
+
+    uint8_t address = 0;
+    const bool addressed = protocol_packet_unaddress(packet, &address);
+
+    bool result = protocol_server_dispatch(server, packet);
+
+    // the response must have room for the wrapping commands and their
+    // sequence number and address. The data includes the command byte
+    const size_t wrappers = (sequenced ? 2 : 0) + (addressed ? 2 : 0);
+    if(packet->stream.size + wrappers > PROTOCOL_DATA_MAX_LENGTH + 1)
+    {
+        protocol_packet_init(packet, PROTOCOL_ERROR);
+        result = false;
+    }
+
+    if(addressed)
+    {
+        protocol_packet_address(packet, address);
+    }
+
+    if(!sequenced)
+    {
+        return result;
+    }
+    protocol_packet_sequence(packet, sequence);
+
+    protocol_packet_copy(&server->last_response, packet);
+    server->last_result = result;
+    server->last_sequence = sequence;
+    server->last_request = request;
+    server->has_last = true;
+    return result;
+}
+
+bool protocol_server_poll(struct protocol_server * server,
+                          const struct uart_port * port)
+{
+    if(!server || !port)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(!uart_data_available(port))
+    {
+        return false;
+    }
+
+    struct protocol_packet packet;
+    if(PROTOCOL_STATUS_OK != protocol_read_status(port, &packet, READ_TIMEOUT_MS))
+    {
+        // the client times out and retries the request
+        protocol_drain(port, DRAIN_MS);
+        return false;
+    }
+
+    bool respond = false;
+    const bool handled = protocol_server_process(server, port, &packet, &respond);
+    if(respond)
+    {
+        protocol_write_block(port, &packet);
+    }
+    return handled;
+}
+
+bool protocol_server_process(struct protocol_server * server,
+                             const struct uart_port * port,
+                             struct protocol_packet * packet,
+                             bool * respond)
+{
+    if(!server || !port || !packet || !respond)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    *respond = false;
+    bool broadcast = false;
+    if(server->has_address)
+    {
+        uint8_t address = 0;
+        if(!protocol_packet_destination(packet, &address)
+           || (address != server->address
+               && PROTOCOL_ADDRESS_BROADCAST != address))
+        {
+            // meant for (or sent by) another device on the bus
+            return false;
+        }
+        broadcast = PROTOCOL_ADDRESS_BROADCAST == address;
+    }
+
+    if(broadcast)
+    {
+        (void)protocol_server_handle(server, packet);
+        return true;
+    }
+
+    if(server->bauds && PROTOCOL_NEGOTIATE == protocol_packet_command(packet))
+    {
+        protocol_server_negotiate(server, port, packet);
+        return true;
+    }
+
+    (void)protocol_server_handle(server, packet);
+    *respond = true;
+    return true;
+}
+
+void protocol_server_run(struct protocol_server * server,
+                         const struct uart_port * port)
+{
+    for(;;)
+    {
+        // on platforms that support it, this lets the processor sleep
+        // until there is a request
+        (void)uart_wait_for_data(port, 0);
+        (void)protocol_server_poll(server, port);
+    }
+}
@@ -0,0 +1,181 @@
+#include "nuhal/protocol_stats.h"
+#include "nuhal/error.h"
+#include "nuhal/utilities.h"
+#include <string.h>
+
+/// atomic increment for gcc compiler
+#define ATOMIC_INC(val) (void)__sync_fetch_and_add(&(val), 1)
+
+// storage for the statistics, NULL when not recording
+static struct protocol_command_stats * stats_storage = NULL;
+
+// number of commands in stats_storage
+static size_t stats_count = 0;
+
+/// @brief get the statistics for a command
+/// @return the statistics or NULL if the command is not being recorded
+static struct protocol_command_stats * stats_get(uint8_t command)
+{
+    if(!stats_storage || command >= stats_count)
+    {
+        return NULL;
+    }
+    return &stats_storage[command];
+}
+
+/// @brief read a value and possibly reset it to zero without
+/// losing any concurrent increments
+static uint32_t stats_read(uint32_t * value, bool reset)
+{
+    if(reset)
+    {
+        return __sync_lock_test_and_set(value, 0);
+    }
+    return *(volatile uint32_t *)value;
+}
+
+void protocol_stats_enable(struct protocol_command_stats stats[], size_t count)
+{
+    if(stats)
+    {
+        memset(stats, 0, count * sizeof(stats[0]));
+        stats_count = count;
+        stats_storage = stats;
+    }
+    else
+    {
+        stats_storage = NULL;
+        stats_count = 0;
+    }
+}
+
+bool protocol_stats_enabled(void)
+{
+    return NULL != stats_storage;
+}
+
+void protocol_stats_snapshot(uint8_t command,
+                             struct protocol_command_stats * out,
+                             bool reset)
+{
+    if(!out)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    struct protocol_command_stats * stats = stats_get(command);
+    if(!stats)
+    {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+
+    for(unsigned int i = 0; i != ARRAY_LEN(stats->counter); ++i)
+    {
+        out->counter[i] = stats_read(&stats->counter[i], reset);
+    }
+
+    for(unsigned int i = 0; i != ARRAY_LEN(stats->latency_us); ++i)
+    {
+        out->latency_us[i] = stats_read(&stats->latency_us[i], reset);
+    }
+}
+
+void protocol_stats_count(uint8_t command, enum protocol_stats_counter counter)
+{
+    if(counter >= PROTOCOL_STATS_COUNTERS)
+    {
+        error(FILE_LINE, "invalid counter");
+    }
+
+    struct protocol_command_stats * stats = stats_get(command);
+    if(stats)
+    {
+        ATOMIC_INC(stats->counter[counter]);
+    }
+}
+
+void protocol_stats_latency(uint8_t command, uint32_t latency_us)
+{
+    struct protocol_command_stats * stats = stats_get(command);
+    if(stats)
+    {
+        ATOMIC_INC(stats->latency_us[protocol_stats_bucket(latency_us)]);
+    }
+}
+
+uint32_t protocol_stats_bucket(uint32_t value)
+{
+    // small values each get their own bucket
+    if(value < PROTOCOL_STATS_SUB_BUCKETS)
+    {
+        return value;
+    }
+
+    // the position of the most significant bit selects the power of two
+    // and the bits that follow it select the sub-bucket
+    const uint32_t msb = 31u - (uint32_t)__builtin_clz(value);
+    const uint32_t shift = msb - PROTOCOL_STATS_SUB_BUCKET_BITS;
+    return (shift + 1u) * PROTOCOL_STATS_SUB_BUCKETS
+        + ((value >> shift) & (PROTOCOL_STATS_SUB_BUCKETS - 1u));
+}
+
+uint32_t protocol_stats_bucket_value(uint32_t bucket)
+{
+    if(bucket >= PROTOCOL_STATS_BUCKETS)
+    {
+        error(FILE_LINE, "invalid bucket");
+    }
+
+    if(bucket < PROTOCOL_STATS_SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    const uint32_t shift = bucket / PROTOCOL_STATS_SUB_BUCKETS - 1u;
+    const uint32_t sub = bucket % PROTOCOL_STATS_SUB_BUCKETS;
+    return (PROTOCOL_STATS_SUB_BUCKETS + sub) << shift;
+}
+
+uint32_t protocol_stats_percentile(const struct protocol_command_stats * stats,
+                                   float percentile)
+{
+    if(!stats)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(percentile < 0.0f || percentile > 100.0f)
+    {
+        error(FILE_LINE, "invalid percentile");
+    }
+
+    uint64_t total = 0;
+    for(unsigned int i = 0; i != ARRAY_LEN(stats->latency_us); ++i)
+    {
+        total += stats->latency_us[i];
+    }
+
+    if(0 == total)
+    {
+        return 0;
+    }
+
+    // the rank of the value at the percentile, counting from 1
+    uint64_t rank = (uint64_t)((double)total * percentile / 100.0 + 0.5);
+    if(rank < 1)
+    {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for(unsigned int i = 0; i != ARRAY_LEN(stats->latency_us); ++i)
+    {
+        seen += stats->latency_us[i];
+        if(seen >= rank)
+        {
+            return protocol_stats_bucket_value(i);
+        }
+    }
+    return protocol_stats_bucket_value(PROTOCOL_STATS_BUCKETS - 1);
+}
@@ -0,0 +1,135 @@
+#include "nuhal/protocol_template.h"
+#include "nuhal/error.h"
+#include <string.h>
+
+// index of the length byte in a frame
+#define LENGTH_INDEX 0u
+
+// index of the checksum byte in a frame
+#define CHECKSUM_INDEX 1u
+
+// the number of bytes in the header of a frame
+#define HEADER_BYTES 2u
+
+/// @brief overwrite bytes of a template and update its checksum
+/// @param frame - the template
+/// @param field - the offset of the first byte in the packet data
+/// @param bytes - the new bytes
+/// @param len - the number of bytes
+static void protocol_template_patch(struct protocol_template * frame,
+                                    uint8_t field,
+                                    const uint8_t bytes[],
+                                    size_t len)
+{
+    if(!frame)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(HEADER_BYTES + field + len > frame->length)
+    {
+        error(FILE_LINE, "invalid field");
+    }
+
+    // the checksum is the sum of the data bytes modulo 256, so it changes by
+    // the difference between the new and old bytes
+    uint8_t * dest = &frame->_frame[HEADER_BYTES + field];
+    uint8_t checksum = frame->_frame[CHECKSUM_INDEX];
+    for(size_t i = 0; i != len; ++i)
+    {
+        checksum += (uint8_t)(bytes[i] - dest[i]);
+        dest[i] = bytes[i];
+    }
+    frame->_frame[CHECKSUM_INDEX] = checksum;
+}
+
+uint8_t protocol_template_field(const struct protocol_packet * packet)
+{
+    if(!packet)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    return packet->stream.size;
+}
+
+void protocol_template_init(struct protocol_template * out,
+                            const struct protocol_packet * packet)
+{
+    if(!out || !packet)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    // a packet always has a command byte
+    if(0 == packet->stream.size)
+    {
+        error(FILE_LINE, "invalid packet");
+    }
+
+    out->length = packet->stream.size + HEADER_BYTES;
+    out->_frame[LENGTH_INDEX] = out->length;
+    memcpy(&out->_frame[HEADER_BYTES], packet->stream.data, packet->stream.size);
+
+    uint8_t checksum = 0;
+    for(uint8_t i = HEADER_BYTES; i != out->length; ++i)
+    {
+        checksum += out->_frame[i];
+    }
+    out->_frame[CHECKSUM_INDEX] = checksum;
+}
+
+void protocol_template_set_u8(struct protocol_template * frame,
+                              uint8_t field,
+                              uint8_t u8)
+{
+    protocol_template_patch(frame, field, &u8, sizeof(u8));
+}
+
+void protocol_template_set_u16(struct protocol_template * frame,
+                               uint8_t field,
+                               uint16_t u16)
+{
+    // big endian, as in the bytestream
+    const uint8_t bytes[] = {u16 >> 8, u16 & 0xFF};
+    protocol_template_patch(frame, field, bytes, sizeof(bytes));
+}
+
+void protocol_template_set_u32(struct protocol_template * frame,
+                               uint8_t field,
+                               uint32_t u32)
+{
+    // big endian, as in the bytestream
+    const uint8_t bytes[] = {
+        u32 >> 24,
+        (u32 >> 16) & 0xFF,
+        (u32 >> 8) & 0xFF,
+        u32 & 0xFF
+    };
+    protocol_template_patch(frame, field, bytes, sizeof(bytes));
+}
+
+void protocol_template_set_i32(struct protocol_template * frame,
+                               uint8_t field,
+                               int32_t i32)
+{
+    protocol_template_set_u32(frame, field, (uint32_t)i32);
+}
+
+void protocol_template_set_f(struct protocol_template * frame,
+                             uint8_t field,
+                             float f)
+{
+    uint32_t float_as_u32 = 0u;
+    memcpy(&float_as_u32, &f, sizeof(uint32_t));
+    protocol_template_set_u32(frame, field, float_as_u32);
+}
+
+void protocol_template_write(const struct uart_port * port,
+                             const struct protocol_template * frame)
+{
+    if(!frame)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    protocol_write_frame(port, frame->_frame, frame->length);
+}
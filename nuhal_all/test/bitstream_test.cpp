@@ -0,0 +1,108 @@
+/// \file
+/// \brief test packing fields of bits into a bytestream
+#include "nuhal/catch.hpp"
+#include "nuhal/bitstream.h"
+#include "nuhal/led.h"
+#include "nuhal/utilities.h"
+
+TEST_CASE("bitstream_fields", "[bitstream]")
+{
+    uint8_t buffer[16] = "";
+    bytestream bs;
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+
+    bitstream bits;
+    bitstream_init(&bits, &bs);
+    bitstream_put_bool(&bits, true);
+    bitstream_put(&bits, 0x5, 3);
+    bitstream_put(&bits, 0xABC, 12);
+    bitstream_put(&bits, 0xDEADBEEF, 32);
+    bitstream_put_bool(&bits, false);
+    bitstream_put_bool(&bits, true);
+    bitstream_flush(&bits);
+    bytestream_inject_u8(&bs, 0x42);
+
+    // 1 + 3 + 12 + 32 + 2 = 50 bits, padded to 7 bytes, most significant bit
+    // first, followed by the byte
+    REQUIRE(bs.size == 8);
+    CHECK(buffer[0] == 0xDA);
+    CHECK(buffer[1] == 0xBC);
+    CHECK(buffer[2] == 0xDE);
+    CHECK(buffer[3] == 0xAD);
+    CHECK(buffer[4] == 0xBE);
+    CHECK(buffer[5] == 0xEF);
+    CHECK(buffer[6] == 0x40);
+    CHECK(buffer[7] == 0x42);
+
+    bytestream_init(&bs, buffer, bs.size);
+    bitstream_init(&bits, &bs);
+    CHECK(bitstream_get_bool(&bits));
+    CHECK(bitstream_get(&bits, 3) == 0x5);
+    CHECK(bitstream_get(&bits, 12) == 0xABC);
+
+    // only the bytes holding the fields read so far are consumed
+    CHECK(bs.size == 2);
+    CHECK(bitstream_get(&bits, 32) == 0xDEADBEEF);
+    CHECK(!bitstream_get_bool(&bits));
+    CHECK(bitstream_get_bool(&bits));
+    CHECK(bs.size == 7);
+    bitstream_align(&bits);
+    CHECK(bytestream_extract_u8(&bs) == 0x42);
+}
+
+TEST_CASE("bitstream_widths", "[bitstream]")
+{
+    // every width, with values that set the top and bottom bits
+    uint8_t buffer[80] = "";
+    bytestream bs;
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    bitstream bits;
+    bitstream_init(&bits, &bs);
+    for(unsigned int width = 1; width <= 32; ++width)
+    {
+        const uint32_t value = 1u | (1u << (width - 1)) | ((0x55555555u >> (32 - width)));
+        bitstream_put(&bits, value, width);
+    }
+    bitstream_flush(&bits);
+
+    // 1 + 2 + ... + 32 bits
+    CHECK(bs.size == bitstream_bytes(32 * 33 / 2));
+
+    bytestream_init(&bs, buffer, bs.size);
+    bitstream_init(&bits, &bs);
+    unsigned int mismatches = 0;
+    for(unsigned int width = 1; width <= 32; ++width)
+    {
+        const uint32_t value = 1u | (1u << (width - 1)) | ((0x55555555u >> (32 - width)));
+        mismatches += bitstream_get(&bits, width) == value ? 0 : 1;
+    }
+    CHECK(mismatches == 0);
+    CHECK(bs.size == bs.capacity);
+}
+
+TEST_CASE("bitstream_led_color", "[bitstream]")
+{
+    // eight colors fit in three bytes instead of eight
+    const led_color colors[] = {
+        LED_COLOR_BLACK, LED_COLOR_RED, LED_COLOR_GREEN, LED_COLOR_BLUE,
+        LED_COLOR_YELLOW, LED_COLOR_CYAN, LED_COLOR_MAGENTA, LED_COLOR_WHITE
+    };
+    uint8_t buffer[3] = "";
+    bytestream bs;
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    bitstream bits;
+    bitstream_init(&bits, &bs);
+    for(const led_color color : colors)
+    {
+        led_color_put(&bits, color);
+    }
+    bitstream_flush(&bits);
+    CHECK(bs.size == 3);
+
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    bitstream_init(&bits, &bs);
+    for(const led_color color : colors)
+    {
+        CHECK(led_color_get(&bits) == color);
+    }
+}
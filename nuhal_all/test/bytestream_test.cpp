@@ -2,6 +2,7 @@
 #include "nuhal/catch.hpp"
 #include "nuhal/bytestream.h"
 #include "nuhal/utilities.h"
+#include <cstring>
 #include <limits>
 
 /// @brief test bytestream injection and extraction
@@ -100,3 +101,267 @@ TEST_CASE("bytestream_string", "[bytestream]")
     bytestream_extract_string(&bs, str, ARRAY_LEN(str));
     CHECK(std::string(str) == "hello\r\n");
 }
+
+TEST_CASE("bytestream_view", "[bytestream]")
+{
+    uint8_t buffer[20] = "";
+    bytestream bs;
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+
+    const uint8_t bytes[] = {1, 2, 3};
+    bytestream_inject_string(&bs, "log");
+    bytestream_inject_u8_array(&bs, bytes, ARRAY_LEN(bytes));
+    bytestream_inject_string(&bs, "");
+    const size_t size = bs.size;
+    bytestream_init(&bs, buffer, size);
+
+    // the views point into the buffer
+    const bytestream_view str = bytestream_extract_string_view(&bs);
+    CHECK(str.data == &buffer[0]);
+    CHECK(str.len == 3);
+    CHECK(std::string(reinterpret_cast<const char *>(str.data)) == "log");
+
+    const bytestream_view array = bytestream_extract_view(&bs, ARRAY_LEN(bytes));
+    CHECK(array.data == &buffer[4]);
+    CHECK(array.len == 3);
+    CHECK(0 == memcmp(array.data, bytes, ARRAY_LEN(bytes)));
+
+    const bytestream_view empty = bytestream_extract_string_view(&bs);
+    CHECK(empty.len == 0);
+    CHECK(bs.size == size);
+}
+
+TEST_CASE("bytestream_u8_array", "[bytestream]")
+{
+    uint8_t buffer[4] = {0};
+    bytestream bs;
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+
+    // the array may fill the stream exactly
+    const uint8_t bytes[] = {1, 2, 3, 4};
+    bytestream_inject_u8_array(&bs, bytes, ARRAY_LEN(bytes));
+    CHECK(bs.size == 4);
+
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    for(uint8_t i = 1; i != 5; ++i)
+    {
+        CHECK(bytestream_extract_u8(&bs) == i);
+    }
+}
+
+// test the unchecked functions on a reserved cursor
+TEST_CASE("bytestream_reserve", "[bytestream]")
+{
+    uint8_t buffer[16] = "";
+    bytestream bs;
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    bytestream_inject_u8(&bs, 7);
+
+    uint8_t * cursor = bytestream_reserve(&bs, 15);
+    CHECK(cursor == &buffer[1]);
+    CHECK(bs.size == 16);
+    bytestream_put_u8(&cursor, 0xAB);
+    bytestream_put_u16(&cursor, 1776);
+    bytestream_put_u32(&cursor, 0xDEADBEEF);
+    bytestream_put_i32(&cursor, -42);
+    bytestream_put_f(&cursor, 3.25f);
+    CHECK(cursor == &buffer[16]);
+
+    // the unchecked functions use the same format as the checked functions
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    CHECK(7 == bytestream_extract_u8(&bs));
+    CHECK(0xAB == bytestream_extract_u8(&bs));
+    CHECK(1776 == bytestream_extract_u16(&bs));
+    CHECK(0xDEADBEEF == bytestream_extract_u32(&bs));
+    CHECK(-42 == bytestream_extract_i32(&bs));
+    CHECK(3.25f == bytestream_extract_f(&bs));
+
+    cursor = &buffer[1];
+    CHECK(0xAB == bytestream_get_u8(&cursor));
+    CHECK(1776 == bytestream_get_u16(&cursor));
+    CHECK(0xDEADBEEF == bytestream_get_u32(&cursor));
+    CHECK(-42 == bytestream_get_i32(&cursor));
+    CHECK(3.25f == bytestream_get_f(&cursor));
+}
+
+// test that arrays are serialized like their elements
+TEST_CASE("bytestream_arrays", "[bytestream]")
+{
+    // odd lengths exercise both the vectorized and the scalar code
+    uint16_t u16[19];
+    uint32_t u32[11];
+    float f[13];
+    for(unsigned int i = 0; i != ARRAY_LEN(u16); ++i)
+    {
+        u16[i] = static_cast<uint16_t>(0x1234 * (i + 1));
+    }
+    for(unsigned int i = 0; i != ARRAY_LEN(u32); ++i)
+    {
+        u32[i] = 0x01234567u * (i + 1);
+    }
+    for(unsigned int i = 0; i != ARRAY_LEN(f); ++i)
+    {
+        f[i] = -1.5f * static_cast<float>(i) + 0.25f;
+    }
+
+    uint8_t buffer[sizeof(u16) + sizeof(u32) + sizeof(f) + 3] = "";
+    bytestream bs;
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+
+    // an odd offset checks that the buffer need not be aligned
+    const uint8_t bytes[] = {9, 8, 7};
+    bytestream_inject_u8_array(&bs, bytes, ARRAY_LEN(bytes));
+    bytestream_inject_u16_array(&bs, u16, ARRAY_LEN(u16));
+    bytestream_inject_u32_array(&bs, u32, ARRAY_LEN(u32));
+    bytestream_inject_f_array(&bs, f, ARRAY_LEN(f));
+    CHECK(bs.size == bs.capacity);
+
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    bs.size = ARRAY_LEN(bytes);
+    for(unsigned int i = 0; i != ARRAY_LEN(u16); ++i)
+    {
+        CHECK(u16[i] == bytestream_extract_u16(&bs));
+    }
+    for(unsigned int i = 0; i != ARRAY_LEN(u32); ++i)
+    {
+        CHECK(u32[i] == bytestream_extract_u32(&bs));
+    }
+    for(unsigned int i = 0; i != ARRAY_LEN(f); ++i)
+    {
+        CHECK(f[i] == bytestream_extract_f(&bs));
+    }
+
+    uint8_t bytes_out[3];
+    uint16_t u16_out[ARRAY_LEN(u16)];
+    uint32_t u32_out[ARRAY_LEN(u32)];
+    float f_out[ARRAY_LEN(f)];
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    bytestream_extract_u8_array(&bs, bytes_out, ARRAY_LEN(bytes_out));
+    bytestream_extract_u16_array(&bs, u16_out, ARRAY_LEN(u16_out));
+    bytestream_extract_u32_array(&bs, u32_out, ARRAY_LEN(u32_out));
+    bytestream_extract_f_array(&bs, f_out, ARRAY_LEN(f_out));
+    CHECK(0 == memcmp(bytes, bytes_out, sizeof(bytes)));
+    CHECK(0 == memcmp(u16, u16_out, sizeof(u16)));
+    CHECK(0 == memcmp(u32, u32_out, sizeof(u32)));
+    CHECK(0 == memcmp(f, f_out, sizeof(f)));
+}
+
+// test varint and zigzag encodings
+TEST_CASE("bytestream_varint", "[bytestream]")
+{
+    const uint32_t values[] = {
+        0, 1, 127, 128, 300, 16383, 16384, 2097151, 2097152,
+        268435455, 268435456, 0xDEADBEEF, 0xFFFFFFFF
+    };
+    const size_t sizes[] = {1, 1, 1, 2, 2, 2, 3, 3, 4, 4, 5, 5, 5};
+
+    uint8_t buffer[64] = "";
+    bytestream bs;
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    size_t total = 0;
+    for(unsigned int i = 0; i != ARRAY_LEN(values); ++i)
+    {
+        CHECK(bytestream_varint_size(values[i]) == sizes[i]);
+        bytestream_inject_varint(&bs, values[i]);
+        total += sizes[i];
+        CHECK(bs.size == total);
+    }
+
+    // 300 is the example from the protobuf documentation
+    CHECK(buffer[5] == 0xAC);
+    CHECK(buffer[6] == 0x02);
+
+    // the last values are read near the end of the stream, without the
+    // four byte fast path
+    bytestream_init(&bs, buffer, total);
+    for(unsigned int i = 0; i != ARRAY_LEN(values); ++i)
+    {
+        CHECK(bytestream_extract_varint(&bs) == values[i]);
+    }
+    CHECK(bs.size == total);
+
+    const int32_t signed_values[] = {0, -1, 1, -64, 63, -65, 64, 1000000,
+                                     -1000000, INT32_MAX, INT32_MIN};
+    const uint32_t encoded[] = {0, 1, 2, 127, 126, 129, 128, 2000000,
+                                1999999, 0xFFFFFFFE, 0xFFFFFFFF};
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    for(unsigned int i = 0; i != ARRAY_LEN(signed_values); ++i)
+    {
+        CHECK(bytestream_zigzag_encode(signed_values[i]) == encoded[i]);
+        CHECK(bytestream_zigzag_decode(encoded[i]) == signed_values[i]);
+        bytestream_inject_zigzag(&bs, signed_values[i]);
+    }
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    for(unsigned int i = 0; i != ARRAY_LEN(signed_values); ++i)
+    {
+        CHECK(bytestream_extract_zigzag(&bs) == signed_values[i]);
+    }
+}
+
+// test half precision floats
+TEST_CASE("bytestream_f16", "[bytestream]")
+{
+    CHECK(bytestream_f32_to_f16(0.0f) == 0x0000);
+    CHECK(bytestream_f32_to_f16(-0.0f) == 0x8000);
+    CHECK(bytestream_f32_to_f16(1.0f) == 0x3C00);
+    CHECK(bytestream_f32_to_f16(-2.0f) == 0xC000);
+    CHECK(bytestream_f32_to_f16(0.1f) == 0x2E66);
+    CHECK(bytestream_f32_to_f16(65504.0f) == 0x7BFF);
+    CHECK(bytestream_f32_to_f16(65520.0f) == 0x7C00);
+    CHECK(bytestream_f32_to_f16(1e10f) == 0x7C00);
+    CHECK(bytestream_f32_to_f16(-std::numeric_limits<float>::infinity()) == 0xFC00);
+    CHECK(bytestream_f32_to_f16(5.9604645e-8f) == 0x0001);
+    CHECK(bytestream_f32_to_f16(1e-8f) == 0x0000);
+    CHECK((bytestream_f32_to_f16(std::numeric_limits<float>::quiet_NaN()) & 0x7FFF) > 0x7C00);
+
+    // ties round to even
+    CHECK(bytestream_f32_to_f16(1.0f + 1.0f/2048) == 0x3C00);
+    CHECK(bytestream_f32_to_f16(1.0f + 3.0f/2048) == 0x3C02);
+
+    // every half precision value converts to a float and back exactly
+    unsigned int mismatches = 0;
+    for(uint32_t i = 0; i != 0x10000; ++i)
+    {
+        const uint16_t f16 = static_cast<uint16_t>(i);
+        const float f = bytestream_f16_to_f32(f16);
+        if(f == f && bytestream_f32_to_f16(f) != f16)
+        {
+            ++mismatches;
+        }
+    }
+    CHECK(mismatches == 0);
+
+    uint8_t buffer[4] = "";
+    bytestream bs;
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    bytestream_inject_f16(&bs, 3.140625f);
+    bytestream_inject_f16(&bs, -1000.0f);
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    CHECK(bytestream_extract_f16(&bs) == 3.140625f);
+    CHECK(bytestream_extract_f16(&bs) == -1000.0f);
+}
+
+// test fixed-point fractions of a range
+TEST_CASE("bytestream_q15_q16", "[bytestream]")
+{
+    uint8_t buffer[16] = "";
+    bytestream bs;
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    bytestream_inject_q15(&bs, 1.0f, 3.2f);
+    bytestream_inject_q15(&bs, -3.2f, 3.2f);
+    bytestream_inject_q15(&bs, 100.0f, 3.2f);
+    bytestream_inject_q15(&bs, std::numeric_limits<float>::quiet_NaN(), 3.2f);
+    bytestream_inject_q16(&bs, 0.25f, 2.0f);
+    bytestream_inject_q16(&bs, 2.0f, 2.0f);
+    bytestream_inject_q16(&bs, -1.0f, 2.0f);
+    CHECK(bs.size == 14);
+
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    CHECK(bytestream_extract_q15(&bs, 3.2f) == Approx(1.0f).margin(3.2f/32767));
+    CHECK(bytestream_extract_q15(&bs, 3.2f) == -3.2f);
+    CHECK(bytestream_extract_q15(&bs, 3.2f) == 3.2f);
+    CHECK(bytestream_extract_q15(&bs, 3.2f) == 0.0f);
+    CHECK(bytestream_extract_q16(&bs, 2.0f) == Approx(0.25f).margin(2.0f/65535));
+    CHECK(bytestream_extract_q16(&bs, 2.0f) == 2.0f);
+    CHECK(bytestream_extract_q16(&bs, 2.0f) == 0.0f);
+}
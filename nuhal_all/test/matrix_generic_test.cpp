@@ -0,0 +1,39 @@
+#include "nuhal/catch.hpp"
+#include "nuhal/matrix_generic.h"
+
+MATRIX_GENERIC_DEFINE(matrix_2x5, 2, 5)
+
+TEST_CASE("matrix_generic", "[matrix]")
+{
+    const float A[2][5] = {
+        {1, 2, 3, 4, 5},
+        {6, 7, 8, 9, 10}
+    };
+
+    const float x[5] = {1, -1, 2, -2, 3};
+    float v[2] = {0, 0};
+    matrix_2x5_multiply_vector(&A[0][0], x, v);
+    CHECK(v[0] == 1 - 2 + 6 - 8 + 15);
+    CHECK(v[1] == 6 - 7 + 16 - 18 + 30);
+
+    const float b[2] = {100, 200};
+    matrix_2x5_multiply_add(&A[0][0], x, b, v);
+    CHECK(v[0] == 100 + 1 - 2 + 6 - 8 + 15);
+    CHECK(v[1] == 200 + 6 - 7 + 16 - 18 + 30);
+
+    // A^T y, without copying A
+    const float y[2] = {2, -1};
+    float u[5] = {0, 0, 0, 0, 0};
+    matrix_2x5_transpose_multiply_vector(&A[0][0], y, u);
+    for(unsigned int col = 0; col != 5; ++col)
+    {
+        CHECK(u[col] == 2*A[0][col] - A[1][col]);
+    }
+
+    const float c[5] = {1, 2, 3, 4, 5};
+    matrix_2x5_transpose_multiply_add(&A[0][0], y, c, u);
+    for(unsigned int col = 0; col != 5; ++col)
+    {
+        CHECK(u[col] == 2*A[0][col] - A[1][col] + c[col]);
+    }
+}
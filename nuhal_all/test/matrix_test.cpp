@@ -1,5 +1,8 @@
 #include "nuhal/catch.hpp"
 #include "nuhal/matrix.h"
+#include <cstring>
+#include <random>
+#include <vector>
 
 TEST_CASE("matrix_multiply", "[matrix]")
 {
@@ -116,3 +119,327 @@ TEST_CASE("matrix_multiply_3x3_3x3", "[matrix]")
     CHECK(b.data[2][1] == 342);
     CHECK(b.data[2][2] == 366);
 }
+
+/// the scalar products, as computed by matrix.c without SIMD: each element
+/// is a sum of products, added from left to right
+template <unsigned int Rows, unsigned int Cols>
+static void reference_multiply(const float (&A)[Rows][Cols], bool transpose,
+                               const float * x, float * v)
+{
+    const unsigned int rows = transpose ? Cols : Rows;
+    const unsigned int cols = transpose ? Rows : Cols;
+    for(unsigned int i = 0; i != rows; ++i)
+    {
+        float sum = (transpose ? A[0][i] : A[i][0]) * x[0];
+        for(unsigned int j = 1; j != cols; ++j)
+        {
+            sum = sum + (transpose ? A[j][i] : A[i][j]) * x[j];
+        }
+        v[i] = sum;
+    }
+}
+
+TEST_CASE("matrix_reference", "[matrix]")
+{
+    // the optimized products match the scalar products bit for bit
+    std::mt19937 generator(1234);
+    std::uniform_real_distribution<float> uniform(-100.0f, 100.0f);
+    const auto fill = [&](float * data, unsigned int len) {
+        for(unsigned int i = 0; i != len; ++i)
+        {
+            data[i] = uniform(generator);
+        }
+    };
+
+    unsigned int mismatches = 0;
+    const auto compare = [&](const float * a, const float * b, unsigned int len) {
+        mismatches += 0 == memcmp(a, b, len * sizeof(float)) ? 0 : 1;
+    };
+
+    for(unsigned int trial = 0; trial != 1000; ++trial)
+    {
+        matrix_3x3 A3;
+        matrix_3x3 B3;
+        matrix_4x3 A43;
+        matrix_6x6 A6;
+        fill(&A3.data[0][0], 9);
+        fill(&B3.data[0][0], 9);
+        fill(&A43.data[0][0], 12);
+        fill(&A6.data[0][0], 36);
+        A3.transpose = 0 != trial % 2;
+        B3.transpose = false;
+        A43.transpose = false;
+        A6.transpose = 0 != trial % 3;
+
+        matrix_3x1 x3;
+        matrix_3x1 w3;
+        matrix_4x1 x4;
+        matrix_6x1 x6;
+        fill(x3.data, 3);
+        fill(w3.data, 3);
+        fill(x4.data, 4);
+        fill(x6.data, 6);
+
+        float expected[9];
+        matrix_3x1 v3;
+        matrix_3x3_multiply_vector(&A3, &x3, &v3);
+        reference_multiply(A3.data, A3.transpose, x3.data, expected);
+        compare(v3.data, expected, 3);
+
+        matrix_4x1 v4;
+        matrix_4x3_3x1_multiply_vector(&A43, &x3, &v4);
+        reference_multiply(A43.data, false, x3.data, expected);
+        compare(v4.data, expected, 4);
+
+        A43.transpose = true;
+        matrix_4x3T_4x1_multiply_vector(&A43, &x4, &v3);
+        reference_multiply(A43.data, true, x4.data, expected);
+        compare(v3.data, expected, 3);
+
+        matrix_6x1 v6;
+        matrix_6x6_multiply_vector(&A6, &x6, &v6);
+        reference_multiply(A6.data, A6.transpose, x6.data, expected);
+        compare(v6.data, expected, 6);
+
+        matrix_3x1_cross(&w3, &x3, &v3);
+        expected[0] = (w3.data[1] * x3.data[2]) - (x3.data[1] * w3.data[2]);
+        expected[1] = (x3.data[0] * w3.data[2]) - (w3.data[0] * x3.data[2]);
+        expected[2] = (w3.data[0] * x3.data[1]) - (x3.data[0] * w3.data[1]);
+        compare(v3.data, expected, 3);
+
+        // each column of the product is A times a column of B
+        A3.transpose = false;
+        matrix_3x3 P;
+        matrix_3x3_multiply_matrix(&A3, &B3, &P);
+        for(unsigned int col = 0; col != 3; ++col)
+        {
+            const float column[3] = {B3.data[0][col], B3.data[1][col], B3.data[2][col]};
+            float product[3];
+            reference_multiply(A3.data, false, column, product);
+            const float result[3] = {P.data[0][col], P.data[1][col], P.data[2][col]};
+            compare(result, product, 3);
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+TEST_CASE("matrix_batch", "[matrix]")
+{
+    // each item of a batch matches the product of a single matrix, including
+    // the items after the last full vector and with padding between elements
+    const size_t count = 13;
+    const size_t stride = 16;
+    std::mt19937 generator(5678);
+    std::uniform_real_distribution<float> uniform(-100.0f, 100.0f);
+    std::vector<float> A3(9*stride), x3(3*stride), w3(3*stride), v3(3*stride);
+    std::vector<float> A6(36*stride), x6(6*stride), v6(6*stride);
+    std::vector<float> cross(3*stride);
+    for(std::vector<float> * data : {&A3, &x3, &w3, &A6, &x6})
+    {
+        for(float & element : *data)
+        {
+            element = uniform(generator);
+        }
+    }
+
+    matrix_3x3_multiply_vector_batch(A3.data(), x3.data(), v3.data(), count, stride);
+    matrix_6x6_multiply_vector_batch(A6.data(), x6.data(), v6.data(), count, stride);
+    matrix_3x1_cross_batch(w3.data(), x3.data(), cross.data(), count, stride);
+
+    unsigned int mismatches = 0;
+    for(size_t i = 0; i != count; ++i)
+    {
+        matrix_3x3 A;
+        matrix_3x1 x;
+        matrix_3x1 w;
+        matrix_6x6 B;
+        matrix_6x1 y;
+        for(size_t k = 0; k != 9; ++k)
+        {
+            A.data[k / 3][k % 3] = A3[k*stride + i];
+        }
+        for(size_t k = 0; k != 36; ++k)
+        {
+            B.data[k / 6][k % 6] = A6[k*stride + i];
+        }
+        for(size_t k = 0; k != 3; ++k)
+        {
+            x.data[k] = x3[k*stride + i];
+            w.data[k] = w3[k*stride + i];
+        }
+        for(size_t k = 0; k != 6; ++k)
+        {
+            y.data[k] = x6[k*stride + i];
+        }
+        A.transpose = false;
+        B.transpose = false;
+
+        matrix_3x1 v;
+        matrix_3x3_multiply_vector(&A, &x, &v);
+        matrix_6x1 u;
+        matrix_6x6_multiply_vector(&B, &y, &u);
+        matrix_3x1 c;
+        matrix_3x1_cross(&w, &x, &c);
+        for(size_t k = 0; k != 3; ++k)
+        {
+            mismatches += v.data[k] == v3[k*stride + i] ? 0 : 1;
+            mismatches += c.data[k] == cross[k*stride + i] ? 0 : 1;
+        }
+        for(size_t k = 0; k != 6; ++k)
+        {
+            mismatches += u.data[k] == v6[k*stride + i] ? 0 : 1;
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+TEST_CASE("matrix_solve_3x3", "[matrix]")
+{
+    matrix_3x3 A;
+    matrix_3x3_init(&A,
+                    2, -1, 0,
+                    -1, 2, -1,
+                    0, -1, 2);
+    const matrix_3x1 expected = {{1, -2, 3}};
+    matrix_3x1 b;
+    matrix_3x3_multiply_vector(&A, &expected, &b);
+
+    matrix_3x1 x;
+    REQUIRE(matrix_3x3_solve(&A, &b, &x) == MATRIX_STATUS_OK);
+    for(unsigned int i = 0; i != 3; ++i)
+    {
+        CHECK(x.data[i] == Approx(expected.data[i]));
+    }
+
+    // A A^-1 = I
+    matrix_3x3 inverse;
+    REQUIRE(matrix_3x3_inverse(&A, &inverse) == MATRIX_STATUS_OK);
+    matrix_3x3 identity;
+    matrix_3x3_multiply_matrix(&A, &inverse, &identity);
+    for(unsigned int row = 0; row != 3; ++row)
+    {
+        for(unsigned int col = 0; col != 3; ++col)
+        {
+            CHECK(identity.data[row][col] == Approx(row == col ? 1.0f : 0.0f).margin(1e-6));
+        }
+    }
+
+    // the transpose flag is used
+    matrix_3x3_init(&A,
+                    1, 2, 0,
+                    0, 1, 0,
+                    0, 0, 1);
+    A.transpose = true;
+    const matrix_3x1 c = {{1, 2, 3}};
+    REQUIRE(matrix_3x3_solve(&A, &c, &x) == MATRIX_STATUS_OK);
+    CHECK(x.data[0] == Approx(1));
+    CHECK(x.data[1] == Approx(0));
+    CHECK(x.data[2] == Approx(3));
+
+    // the third row is the sum of the others, and the outputs are unchanged
+    matrix_3x3_init(&A,
+                    1, 2, 3,
+                    4, 5, 6,
+                    5, 7, 9);
+    const matrix_3x1 unchanged = x;
+    CHECK(matrix_3x3_solve(&A, &c, &x) == MATRIX_STATUS_SINGULAR);
+    CHECK(0 == memcmp(&x, &unchanged, sizeof(x)));
+    CHECK(matrix_3x3_inverse(&A, &inverse) == MATRIX_STATUS_SINGULAR);
+}
+
+TEST_CASE("matrix_solve_6x6", "[matrix]")
+{
+    std::mt19937 generator(4321);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+    for(unsigned int trial = 0; trial != 100; ++trial)
+    {
+        // B is general, with a zero in the corner so that rows must be
+        // swapped, and S = B B^T + I is symmetric positive definite
+        matrix_6x6 B;
+        for(auto & row : B.data)
+        {
+            for(float & element : row)
+            {
+                element = uniform(generator);
+            }
+        }
+        B.data[0][0] = 0.0f;
+        B.transpose = 0 != trial % 2;
+        matrix_6x6 S;
+        for(unsigned int row = 0; row != 6; ++row)
+        {
+            for(unsigned int col = 0; col != 6; ++col)
+            {
+                float sum = row == col ? 1.0f : 0.0f;
+                for(unsigned int k = 0; k != 6; ++k)
+                {
+                    sum += B.data[row][k] * B.data[col][k];
+                }
+                S.data[row][col] = sum;
+            }
+        }
+        S.transpose = false;
+
+        matrix_6x1 expected;
+        for(float & element : expected.data)
+        {
+            element = uniform(generator);
+        }
+
+        matrix_6x1 b;
+        matrix_6x1 x;
+        matrix_6x6_multiply_vector(&B, &expected, &b);
+        REQUIRE(matrix_6x6_solve(&B, &b, &x) == MATRIX_STATUS_OK);
+        for(unsigned int i = 0; i != 6; ++i)
+        {
+            CHECK(x.data[i] == Approx(expected.data[i]).margin(1e-3));
+        }
+
+        matrix_6x6 inverse;
+        REQUIRE(matrix_6x6_inverse(&B, &inverse) == MATRIX_STATUS_OK);
+        matrix_6x1 y;
+        matrix_6x6_multiply_vector(&inverse, &b, &y);
+        for(unsigned int i = 0; i != 6; ++i)
+        {
+            CHECK(y.data[i] == Approx(expected.data[i]).margin(1e-3));
+        }
+
+        matrix_6x6_multiply_vector(&S, &expected, &b);
+        matrix_6x6 L;
+        REQUIRE(matrix_6x6_cholesky_factor(&S, &L) == MATRIX_STATUS_OK);
+        matrix_6x6_cholesky_solve(&L, &b, &x);
+        for(unsigned int i = 0; i != 6; ++i)
+        {
+            CHECK(x.data[i] == Approx(expected.data[i]).margin(1e-3));
+            CHECK(L.data[i][i] > 0.0f);
+        }
+    }
+
+    // a repeated column
+    matrix_6x6 A;
+    matrix_6x6_init(&A,
+                    1, 2, 3, 4, 5, 1,
+                    6, 5, 4, 3, 2, 6,
+                    1, 0, 1, 0, 1, 1,
+                    2, 2, 1, 1, 0, 2,
+                    0, 3, 0, 3, 0, 0,
+                    4, 1, 4, 1, 4, 4);
+    matrix_6x6_lu lu;
+    matrix_6x1 b = {{1, 2, 3, 4, 5, 6}};
+    matrix_6x1 x;
+    CHECK(matrix_6x6_lu_factor(&A, &lu) == MATRIX_STATUS_SINGULAR);
+    CHECK(matrix_6x6_solve(&A, &b, &x) == MATRIX_STATUS_SINGULAR);
+
+    // symmetric but indefinite
+    matrix_6x6_init(&A,
+                    1, 2, 0, 0, 0, 0,
+                    2, 1, 0, 0, 0, 0,
+                    0, 0, 1, 0, 0, 0,
+                    0, 0, 0, 1, 0, 0,
+                    0, 0, 0, 0, 1, 0,
+                    0, 0, 0, 0, 0, 1);
+    matrix_6x6 L;
+    CHECK(matrix_6x6_cholesky_factor(&A, &L) == MATRIX_STATUS_NOT_POSITIVE_DEFINITE);
+    CHECK(matrix_6x6_solve(&A, &b, &x) == MATRIX_STATUS_OK);
+}
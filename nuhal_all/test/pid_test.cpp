@@ -88,6 +88,34 @@ TEST_CASE("pid_serialize_debug_info", "[pid]")
     CHECK(results.state.d_error == info.state.d_error);
 }
 
+/// Test pid_debug_info serialization in half precision
+TEST_CASE("pid_serialize_debug_info_f16", "[pid]")
+{
+    uint8_t buffer[14] = "";
+    bytestream bs;
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    struct pid_debug_info info{{115.0f, 212.0, 1333.0f}, {11.1f, 22.2f, 33.3f}, 7, 2};
+    pid_debug_info_f16_inject(&bs, &info);
+    CHECK(bs.size == 14);
+
+    // half precision has 11 significant bits
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    struct pid_debug_info results{};
+    pid_debug_info_f16_extract(&bs, &results);
+    CHECK(results.signals.reference == Approx(info.signals.reference).epsilon(1.0/2048));
+    CHECK(results.signals.measurement == Approx(info.signals.measurement).epsilon(1.0/2048));
+    CHECK(results.signals.effort == Approx(info.signals.effort).epsilon(1.0/2048));
+    CHECK(results.state.p_error == info.state.p_error);
+    CHECK(results.state.i_error == info.state.i_error);
+    CHECK(results.state.d_error == info.state.d_error);
+    CHECK(results.sequence == 7);
+    CHECK(results.missed == 2);
+
+    // a receiver can tell the half precision layouts from the full ones
+    CHECK(pid_state_f16_fingerprint() != pid_state_fingerprint());
+    CHECK(pid_signals_f16_fingerprint() != pid_signals_fingerprint());
+}
+
 /// Test some basic input/output relationships for the pid controller
 /// TODO: Test antiwindup techniques
 /// TODO: Test saturation
@@ -0,0 +1,215 @@
+/// \file
+/// \brief test delta compression of streamed frames
+#include "nuhal/catch.hpp"
+#include "nuhal/protocol_delta.h"
+#include <cstring>
+
+/// a frame of telemetry: a counter, slowly changing floats and a status byte
+struct telemetry
+{
+    uint8_t bytes[4 + 4 * 4 + 1];
+};
+
+/// the telemetry at a time step
+static telemetry make_telemetry(uint32_t step)
+{
+    telemetry frame;
+    struct bytestream bs;
+    bytestream_init(&bs, frame.bytes, sizeof(frame.bytes));
+    bytestream_inject_u32(&bs, step);
+    bytestream_inject_f(&bs, 1.0f + 0.001f * step);
+    bytestream_inject_f(&bs, -2.5f);
+    bytestream_inject_f(&bs, 100.0f - 0.01f * step);
+    bytestream_inject_f(&bs, 0.0f);
+    bytestream_inject_u8(&bs, step / 10);
+    return frame;
+}
+
+/// an encoded frame
+struct encoded
+{
+    uint8_t data[PROTOCOL_DATA_MAX_LENGTH];
+    size_t size;
+    bool key;
+};
+
+static encoded encode(protocol_delta & sender, const telemetry & frame)
+{
+    encoded out;
+    struct bytestream bs;
+    bytestream_init(&bs, out.data, sizeof(out.data));
+    out.key = protocol_delta_encode(&sender, frame.bytes, &bs);
+    out.size = bs.size;
+    return out;
+}
+
+/// decode a frame, checking that it is consumed completely
+static bool decode(protocol_delta & receiver, const encoded & in, telemetry & frame)
+{
+    uint8_t data[PROTOCOL_DATA_MAX_LENGTH];
+    memcpy(data, in.data, in.size);
+    struct bytestream bs;
+    bytestream_init(&bs, data, in.size);
+    const bool decoded = protocol_delta_decode(&receiver, &bs, frame.bytes);
+    CHECK(bs.size == in.size);
+    return decoded;
+}
+
+TEST_CASE("protocol_delta_previous", "[protocol_delta]")
+{
+    protocol_delta sender;
+    protocol_delta receiver;
+    protocol_delta_init(&sender, sizeof(telemetry), PROTOCOL_DELTA_PREVIOUS, 10);
+    protocol_delta_init(&receiver, sizeof(telemetry), PROTOCOL_DELTA_PREVIOUS, 10);
+
+    unsigned int keys = 0;
+    size_t total = 0;
+    bool all_decoded = true;
+    bool all_equal = true;
+    for(uint32_t step = 0; step != 100; ++step)
+    {
+        const telemetry frame = make_telemetry(step);
+        const encoded out = encode(sender, frame);
+        keys += out.key ? 1 : 0;
+        total += out.size;
+
+        telemetry decoded;
+        all_decoded = all_decoded && decode(receiver, out, decoded);
+        all_equal = all_equal
+            && 0 == memcmp(frame.bytes, decoded.bytes, sizeof(frame.bytes));
+    }
+    CHECK(all_decoded);
+    CHECK(all_equal);
+
+    // the first frame, then one after every ten deltas
+    CHECK(keys == 10);
+
+    // the counter and two floats change by a little each time
+    CHECK(total < 100 * (PROTOCOL_DELTA_HEADER_BYTES + sizeof(telemetry)) / 2);
+    CHECK(protocol_delta_sequence(&receiver) == 99);
+}
+
+TEST_CASE("protocol_delta_lost", "[protocol_delta]")
+{
+    protocol_delta sender;
+    protocol_delta receiver;
+    telemetry decoded;
+    protocol_delta_init(&sender, sizeof(telemetry), PROTOCOL_DELTA_PREVIOUS, 0);
+    protocol_delta_init(&receiver, sizeof(telemetry), PROTOCOL_DELTA_PREVIOUS, 0);
+
+    CHECK(decode(receiver, encode(sender, make_telemetry(0)), decoded));
+
+    // after a lost frame, nothing can be decoded until a key frame
+    encode(sender, make_telemetry(1));
+    CHECK(!decode(receiver, encode(sender, make_telemetry(2)), decoded));
+    CHECK(!decode(receiver, encode(sender, make_telemetry(3)), decoded));
+
+    protocol_delta_request_key(&sender);
+    const encoded key = encode(sender, make_telemetry(4));
+    CHECK(key.key);
+    CHECK(decode(receiver, key, decoded));
+    CHECK(0 == memcmp(decoded.bytes, make_telemetry(4).bytes, sizeof(decoded.bytes)));
+
+    const encoded next = encode(sender, make_telemetry(5));
+    CHECK(!next.key);
+    CHECK(decode(receiver, next, decoded));
+    CHECK(0 == memcmp(decoded.bytes, make_telemetry(5).bytes, sizeof(decoded.bytes)));
+}
+
+TEST_CASE("protocol_delta_wrapped", "[protocol_delta]")
+{
+    protocol_delta sender;
+    protocol_delta receiver;
+    telemetry decoded;
+    protocol_delta_init(&sender, sizeof(telemetry), PROTOCOL_DELTA_PREVIOUS, 0);
+    protocol_delta_init(&receiver, sizeof(telemetry), PROTOCOL_DELTA_PREVIOUS, 0);
+
+    // the receiver remembers frames 0 to 3
+    for(uint32_t step = 0; step != 4; ++step)
+    {
+        CHECK(decode(receiver, encode(sender, make_telemetry(step)), decoded));
+    }
+
+    // after the sequence numbers wrap, frame 259 is relative to frame 258,
+    // which has the same sequence number as the remembered frame 2
+    for(uint32_t step = 4; step != 259; ++step)
+    {
+        encode(sender, make_telemetry(step));
+    }
+    const encoded wrapped = encode(sender, make_telemetry(259));
+    CHECK(!wrapped.key);
+    CHECK(wrapped.data[2] == 2);
+    CHECK(!decode(receiver, wrapped, decoded));
+}
+
+TEST_CASE("protocol_delta_acknowledged", "[protocol_delta]")
+{
+    protocol_delta sender;
+    protocol_delta receiver;
+    telemetry decoded;
+    protocol_delta_init(&sender, sizeof(telemetry), PROTOCOL_DELTA_ACKNOWLEDGED, 0);
+    protocol_delta_init(&receiver, sizeof(telemetry), PROTOCOL_DELTA_ACKNOWLEDGED, 0);
+
+    // without an acknowledgement, every frame is a key frame
+    CHECK(encode(sender, make_telemetry(0)).key);
+    const encoded first = encode(sender, make_telemetry(1));
+    CHECK(first.key);
+    CHECK(decode(receiver, first, decoded));
+    protocol_delta_ack(&sender, protocol_delta_sequence(&receiver));
+
+    // lost frames do not stop the receiver, since each is relative to
+    // the acknowledged frame
+    CHECK(!encode(sender, make_telemetry(2)).key);
+    const encoded third = encode(sender, make_telemetry(3));
+    CHECK(!third.key);
+    CHECK(decode(receiver, third, decoded));
+    CHECK(0 == memcmp(decoded.bytes, make_telemetry(3).bytes, sizeof(decoded.bytes)));
+
+    // stale acknowledgements are ignored
+    const uint8_t acknowledged = protocol_delta_sequence(&receiver);
+    protocol_delta_ack(&sender, acknowledged);
+    protocol_delta_ack(&sender, acknowledged - 2);
+    const encoded fourth = encode(sender, make_telemetry(4));
+    CHECK(!fourth.key);
+    CHECK(fourth.data[2] == acknowledged);
+
+    // once the acknowledged frame is forgotten, key frames are sent again
+    for(uint32_t step = 5; step != 5 + PROTOCOL_DELTA_HISTORY; ++step)
+    {
+        encode(sender, make_telemetry(step));
+    }
+    CHECK(encode(sender, make_telemetry(10)).key);
+}
+
+TEST_CASE("protocol_delta_short_word", "[protocol_delta]")
+{
+    // the last word of a seven byte frame has three bytes, and differences
+    // wrap around within the word
+    uint8_t frame[7] = {0, 0, 0, 0, 0xFF, 0xFF, 0xFF};
+    uint8_t decoded[7];
+    uint8_t data[PROTOCOL_DATA_MAX_LENGTH];
+    protocol_delta sender;
+    protocol_delta receiver;
+    protocol_delta_init(&sender, sizeof(frame), PROTOCOL_DELTA_PREVIOUS, 0);
+    protocol_delta_init(&receiver, sizeof(frame), PROTOCOL_DELTA_PREVIOUS, 0);
+
+    for(unsigned int i = 0; i != 2; ++i)
+    {
+        struct bytestream bs;
+        bytestream_init(&bs, data, sizeof(data));
+        CHECK(protocol_delta_encode(&sender, frame, &bs) == (0 == i));
+        const size_t size = bs.size;
+        bytestream_init(&bs, data, size);
+        CHECK(protocol_delta_decode(&receiver, &bs, decoded));
+        CHECK(0 == memcmp(frame, decoded, sizeof(frame)));
+
+        frame[6] = 0x00;
+    }
+
+    // a header, one byte of mask, and one varint byte
+    struct bytestream bs;
+    frame[6] = 0x01;
+    bytestream_init(&bs, data, sizeof(data));
+    CHECK(!protocol_delta_encode(&sender, frame, &bs));
+    CHECK(bs.size == PROTOCOL_DELTA_HEADER_BYTES + 2);
+}
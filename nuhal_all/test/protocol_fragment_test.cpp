@@ -0,0 +1,150 @@
+/// \file
+/// \brief test splitting large transfers into fragments and reassembling them
+#include "nuhal/catch.hpp"
+#include "nuhal/protocol_fragment.h"
+#include "nuhal/utilities.h"
+#include <vector>
+
+/// Split data into fragments, each stored in its own buffer
+/// as the data portion (after the command byte) of a packet
+static std::vector<std::vector<uint8_t>> fragment(const std::vector<uint8_t> & data)
+{
+    std::vector<std::vector<uint8_t>> fragments;
+    size_t offset = 0;
+    do
+    {
+        std::vector<uint8_t> buffer(PROTOCOL_DATA_MAX_LENGTH);
+        bytestream bs;
+        bytestream_init(&bs, buffer.data(), buffer.size());
+        offset += protocol_fragment_inject(&bs, data.data(), data.size(), offset);
+        buffer.resize(bs.size);
+        fragments.push_back(buffer);
+    } while(offset != data.size());
+    return fragments;
+}
+
+TEST_CASE("protocol_fragment_roundtrip", "[protocol_fragment]")
+{
+    std::vector<uint8_t> data(1000);
+    for(size_t i = 0; i != data.size(); ++i)
+    {
+        data[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    auto fragments = fragment(data);
+    // 1000 bytes needs ceil(1000/248) fragments
+    CHECK(fragments.size() == 5);
+    CHECK(fragments[0].size() == PROTOCOL_DATA_MAX_LENGTH);
+
+    uint8_t buffer[1024] = "";
+    protocol_reassembly ra;
+    protocol_reassembly_init(&ra, buffer, ARRAY_LEN(buffer));
+    for(size_t i = 0; i != fragments.size(); ++i)
+    {
+        bytestream bs;
+        bytestream_init(&bs, fragments[i].data(), fragments[i].size());
+        CHECK(protocol_reassembly_extract(&ra, &bs) == (i + 1 == fragments.size()));
+    }
+    CHECK(ra.total == data.size());
+    CHECK(std::vector<uint8_t>(buffer, buffer + ra.total) == data);
+}
+
+TEST_CASE("protocol_fragment_empty", "[protocol_fragment]")
+{
+    auto fragments = fragment(std::vector<uint8_t>());
+    REQUIRE(fragments.size() == 1);
+    CHECK(fragments[0].size() == PROTOCOL_FRAGMENT_HEADER_BYTES);
+
+    uint8_t buffer[4] = "";
+    protocol_reassembly ra;
+    protocol_reassembly_init(&ra, buffer, ARRAY_LEN(buffer));
+    bytestream bs;
+    bytestream_init(&bs, fragments[0].data(), fragments[0].size());
+    CHECK(protocol_reassembly_extract(&ra, &bs));
+    CHECK(ra.total == 0);
+}
+
+TEST_CASE("protocol_fragment_restart", "[protocol_fragment]")
+{
+    std::vector<uint8_t> first(600, 0xAB);
+    std::vector<uint8_t> second(300, 0xCD);
+    auto abandoned = fragment(first);
+    auto fragments = fragment(second);
+    REQUIRE(abandoned.size() == 3);
+    REQUIRE(fragments.size() == 2);
+
+    uint8_t buffer[1024] = "";
+    protocol_reassembly ra;
+    protocol_reassembly_init(&ra, buffer, ARRAY_LEN(buffer));
+
+    // only part of the first transfer arrives
+    bytestream bs;
+    bytestream_init(&bs, abandoned[0].data(), abandoned[0].size());
+    CHECK(!protocol_reassembly_extract(&ra, &bs));
+
+    // a fragment with offset 0 starts the next transfer
+    bytestream_init(&bs, fragments[0].data(), fragments[0].size());
+    CHECK(!protocol_reassembly_extract(&ra, &bs));
+    bytestream_init(&bs, fragments[1].data(), fragments[1].size());
+    CHECK(protocol_reassembly_extract(&ra, &bs));
+    CHECK(ra.total == second.size());
+    CHECK(std::vector<uint8_t>(buffer, buffer + ra.total) == second);
+}
+
+TEST_CASE("protocol_fragment_out_of_sequence", "[protocol_fragment]")
+{
+    std::vector<uint8_t> data(700);
+    for(size_t i = 0; i != data.size(); ++i)
+    {
+        data[i] = static_cast<uint8_t>(i * 3);
+    }
+    auto fragments = fragment(data);
+    REQUIRE(fragments.size() == 3);
+
+    uint8_t buffer[1024] = "";
+    protocol_reassembly ra;
+    protocol_reassembly_init(&ra, buffer, ARRAY_LEN(buffer));
+    bytestream bs;
+
+    SECTION("skipped fragment")
+    {
+        bytestream_init(&bs, fragments[0].data(), fragments[0].size());
+        CHECK(!protocol_reassembly_extract(&ra, &bs));
+
+        // fragment 1 is lost, so the last fragment's offset does not
+        // match the bytes received and it must not complete the transfer
+        bytestream_init(&bs, fragments[2].data(), fragments[2].size());
+        CHECK(!protocol_reassembly_extract(&ra, &bs));
+        CHECK(bs.size == bs.capacity);
+        CHECK(ra.received == 0);
+
+        // the rest of the abandoned transfer is also rejected
+        bytestream_init(&bs, fragments[1].data(), fragments[1].size());
+        CHECK(!protocol_reassembly_extract(&ra, &bs));
+        CHECK(ra.received == 0);
+    }
+
+    SECTION("mismatched total")
+    {
+        std::vector<uint8_t> other(data.begin(), data.end() - 1);
+        auto wrong = fragment(other);
+        REQUIRE(wrong.size() == 3);
+
+        bytestream_init(&bs, fragments[0].data(), fragments[0].size());
+        CHECK(!protocol_reassembly_extract(&ra, &bs));
+
+        // the offset matches but the fragment belongs to a different transfer
+        bytestream_init(&bs, wrong[1].data(), wrong[1].size());
+        CHECK(!protocol_reassembly_extract(&ra, &bs));
+        CHECK(ra.received == 0);
+    }
+
+    // a fragment with offset 0 starts over and the full transfer succeeds
+    for(size_t i = 0; i != fragments.size(); ++i)
+    {
+        bytestream_init(&bs, fragments[i].data(), fragments[i].size());
+        CHECK(protocol_reassembly_extract(&ra, &bs) == (i + 1 == fragments.size()));
+    }
+    CHECK(ra.total == data.size());
+    CHECK(std::vector<uint8_t>(buffer, buffer + ra.total) == data);
+}
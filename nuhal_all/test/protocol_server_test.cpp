@@ -0,0 +1,171 @@
+/// \file
+/// \brief test dispatching packets to command handlers
+#include "nuhal/catch.hpp"
+#include "nuhal/protocol_server.h"
+
+/// Turn a packet that was built with protocol_packet_init into a packet
+/// that looks like it was received: the stream is positioned after the
+/// command byte and its capacity is the length of the data
+static void receive(protocol_packet & packet)
+{
+    bytestream_init(&packet.stream, packet.stream.data, packet.stream.size);
+    (void)bytestream_extract_u8(&packet.stream);
+}
+
+/// add two numbers and reply with the sum. Counts the number of calls
+static bool add_handler(protocol_packet * packet, void * context)
+{
+    const uint32_t a = bytestream_extract_u32(&packet->stream);
+    const uint32_t b = bytestream_extract_u32(&packet->stream);
+    ++*static_cast<int *>(context);
+    protocol_packet_reply_init(packet);
+    bytestream_inject_u32(&packet->stream, a + b);
+    return true;
+}
+
+/// always fails
+static bool fail_handler(protocol_packet *, void *)
+{
+    return false;
+}
+
+TEST_CASE("protocol_server_dispatch", "[protocol_server]")
+{
+    protocol_server server;
+    protocol_server_init(&server);
+    int calls = 0;
+    protocol_server_register(&server, 0x10, add_handler, &calls);
+    protocol_server_register(&server, 0x11, fail_handler, nullptr);
+
+    SECTION("registered")
+    {
+        protocol_packet packet;
+        protocol_packet_init(&packet, 0x10);
+        bytestream_inject_u32(&packet.stream, 40);
+        bytestream_inject_u32(&packet.stream, 2);
+        receive(packet);
+
+        CHECK(protocol_server_handle(&server, &packet));
+        CHECK(calls == 1);
+        CHECK(protocol_packet_command(&packet) == 0x10);
+        receive(packet);
+        CHECK(bytestream_extract_u32(&packet.stream) == 42);
+    }
+
+    SECTION("unknown")
+    {
+        protocol_packet packet;
+        protocol_packet_init(&packet, 0x12);
+        receive(packet);
+        CHECK(!protocol_server_handle(&server, &packet));
+        CHECK(protocol_packet_command(&packet) == PROTOCOL_ERROR);
+        CHECK(calls == 0);
+    }
+
+    SECTION("handler failure")
+    {
+        protocol_packet packet;
+        protocol_packet_init(&packet, 0x11);
+        receive(packet);
+        CHECK(!protocol_server_handle(&server, &packet));
+        CHECK(protocol_packet_command(&packet) == PROTOCOL_ERROR);
+    }
+
+    SECTION("sequenced")
+    {
+        protocol_packet packet;
+        protocol_packet_init(&packet, 0x10);
+        bytestream_inject_u32(&packet.stream, 40);
+        bytestream_inject_u32(&packet.stream, 2);
+        protocol_packet_sequence(&packet, 7);
+        receive(packet);
+
+        protocol_packet retry;
+        protocol_packet_copy(&retry, &packet);
+
+        CHECK(protocol_server_handle(&server, &packet));
+        CHECK(calls == 1);
+        receive(packet);
+        uint8_t sequence = 0;
+        REQUIRE(protocol_packet_unsequence(&packet, &sequence));
+        CHECK(sequence == 7);
+        CHECK(protocol_packet_command(&packet) == 0x10);
+        CHECK(bytestream_extract_u32(&packet.stream) == 42);
+
+        // the same sequence number gets the same response,
+        // without calling the handler again
+        CHECK(protocol_server_handle(&server, &retry));
+        CHECK(calls == 1);
+        receive(retry);
+        REQUIRE(protocol_packet_unsequence(&retry, &sequence));
+        CHECK(sequence == 7);
+        CHECK(bytestream_extract_u32(&retry.stream) == 42);
+
+        // a new sequence number is a new request
+        protocol_packet next;
+        protocol_packet_init(&next, 0x10);
+        bytestream_inject_u32(&next.stream, 1);
+        bytestream_inject_u32(&next.stream, 2);
+        protocol_packet_sequence(&next, 8);
+        receive(next);
+        CHECK(protocol_server_handle(&server, &next));
+        CHECK(calls == 2);
+        receive(next);
+        REQUIRE(protocol_packet_unsequence(&next, &sequence));
+        CHECK(sequence == 8);
+        CHECK(bytestream_extract_u32(&next.stream) == 3);
+
+        // so is a different request that reuses the sequence number, as
+        // happens when the client restarts
+        protocol_packet restarted;
+        protocol_packet_init(&restarted, 0x10);
+        bytestream_inject_u32(&restarted.stream, 5);
+        bytestream_inject_u32(&restarted.stream, 5);
+        protocol_packet_sequence(&restarted, 8);
+        receive(restarted);
+        CHECK(protocol_server_handle(&server, &restarted));
+        CHECK(calls == 3);
+        receive(restarted);
+        REQUIRE(protocol_packet_unsequence(&restarted, &sequence));
+        CHECK(bytestream_extract_u32(&restarted.stream) == 10);
+    }
+
+    SECTION("addressed")
+    {
+        protocol_server_address(&server, 3);
+
+        protocol_packet packet;
+        protocol_packet_init(&packet, 0x10);
+        bytestream_inject_u32(&packet.stream, 40);
+        bytestream_inject_u32(&packet.stream, 2);
+        protocol_packet_address(&packet, 3);
+        protocol_packet_sequence(&packet, 9);
+        receive(packet);
+
+        CHECK(protocol_server_handle(&server, &packet));
+        CHECK(calls == 1);
+
+        // the response is wrapped in the same order as the request
+        receive(packet);
+        uint8_t sequence = 0;
+        uint8_t address = 0;
+        CHECK(protocol_packet_destination(&packet, &address));
+        CHECK(address == 3);
+        REQUIRE(protocol_packet_unsequence(&packet, &sequence));
+        CHECK(sequence == 9);
+        REQUIRE(protocol_packet_unaddress(&packet, &address));
+        CHECK(address == 3);
+        CHECK(protocol_packet_command(&packet) == 0x10);
+        CHECK(bytestream_extract_u32(&packet.stream) == 42);
+    }
+
+    SECTION("unregister")
+    {
+        protocol_server_register(&server, 0x10, nullptr, nullptr);
+        protocol_packet packet;
+        protocol_packet_init(&packet, 0x10);
+        receive(packet);
+        CHECK(!protocol_server_handle(&server, &packet));
+        CHECK(calls == 0);
+    }
+}
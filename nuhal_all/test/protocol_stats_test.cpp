@@ -0,0 +1,74 @@
+/// \file
+/// \brief test the protocol latency histograms and counters
+#include "nuhal/catch.hpp"
+#include "nuhal/protocol_stats.h"
+#include "nuhal/utilities.h"
+#include <vector>
+
+TEST_CASE("protocol_stats_bucket", "[protocol_stats]")
+{
+    // small values map directly to their own bucket
+    for(uint32_t i = 0; i != PROTOCOL_STATS_SUB_BUCKETS; ++i)
+    {
+        CHECK(protocol_stats_bucket(i) == i);
+    }
+
+    CHECK(protocol_stats_bucket(8) == 8);
+    CHECK(protocol_stats_bucket(15) == 15);
+    CHECK(protocol_stats_bucket(16) == 16);
+    CHECK(protocol_stats_bucket(17) == 16);
+    CHECK(protocol_stats_bucket(18) == 17);
+    CHECK(protocol_stats_bucket(0xFFFFFFFFu) == PROTOCOL_STATS_BUCKETS - 1);
+
+    // every bucket starts at its value and the bucket before
+    // ends just before it
+    for(uint32_t i = 1; i != PROTOCOL_STATS_BUCKETS; ++i)
+    {
+        const uint32_t value = protocol_stats_bucket_value(i);
+        CHECK(protocol_stats_bucket(value) == i);
+        CHECK(protocol_stats_bucket(value - 1) == i - 1);
+    }
+}
+
+TEST_CASE("protocol_stats_record", "[protocol_stats]")
+{
+    std::vector<protocol_command_stats> storage(4);
+    protocol_stats_enable(storage.data(), storage.size());
+    REQUIRE(protocol_stats_enabled());
+
+    for(uint32_t i = 1; i <= 100; ++i)
+    {
+        protocol_stats_count(2, PROTOCOL_STATS_REQUESTS);
+        protocol_stats_latency(2, i * 100);
+    }
+    protocol_stats_count(2, PROTOCOL_STATS_TIMEOUTS);
+
+    // commands beyond the storage are ignored
+    protocol_stats_count(200, PROTOCOL_STATS_REQUESTS);
+
+    protocol_command_stats snapshot;
+    protocol_stats_snapshot(2, &snapshot, false);
+    CHECK(snapshot.counter[PROTOCOL_STATS_REQUESTS] == 100);
+    CHECK(snapshot.counter[PROTOCOL_STATS_TIMEOUTS] == 1);
+    CHECK(snapshot.counter[PROTOCOL_STATS_CHECKSUM_ERRORS] == 0);
+
+    // percentiles are accurate to within a bucket
+    const uint32_t median = protocol_stats_percentile(&snapshot, 50.0f);
+    CHECK(median <= 5000);
+    CHECK(median > 5000 - 5000/PROTOCOL_STATS_SUB_BUCKETS);
+    CHECK(protocol_stats_percentile(&snapshot, 0.0f) == 96);
+    CHECK(protocol_stats_percentile(&snapshot, 100.0f) == 9216);
+
+    // resetting returns the values and clears them
+    protocol_stats_snapshot(2, &snapshot, true);
+    CHECK(snapshot.counter[PROTOCOL_STATS_REQUESTS] == 100);
+    protocol_stats_snapshot(2, &snapshot, false);
+    CHECK(snapshot.counter[PROTOCOL_STATS_REQUESTS] == 0);
+    CHECK(protocol_stats_percentile(&snapshot, 50.0f) == 0);
+
+    protocol_stats_snapshot(200, &snapshot, false);
+    CHECK(snapshot.counter[PROTOCOL_STATS_REQUESTS] == 0);
+
+    protocol_stats_enable(NULL, 0);
+    CHECK_FALSE(protocol_stats_enabled());
+}
@@ -0,0 +1,62 @@
+/// \file
+/// \brief test patching fields of packet templates
+#include "nuhal/catch.hpp"
+#include "nuhal/protocol_template.h"
+
+/// the checksum of a frame, computed from scratch
+static uint8_t checksum(const protocol_template & frame)
+{
+    uint8_t sum = 0;
+    for(uint8_t i = 2; i != frame.length; ++i)
+    {
+        sum += frame._frame[i];
+    }
+    return sum;
+}
+
+TEST_CASE("protocol_template", "[protocol_template]")
+{
+    protocol_packet packet;
+    protocol_packet_init(&packet, 0x42);
+    const uint8_t u8 = protocol_template_field(&packet);
+    bytestream_inject_u8(&packet.stream, 0);
+    const uint8_t u16 = protocol_template_field(&packet);
+    bytestream_inject_u16(&packet.stream, 0);
+    const uint8_t i32 = protocol_template_field(&packet);
+    bytestream_inject_i32(&packet.stream, 0);
+    const uint8_t f = protocol_template_field(&packet);
+    bytestream_inject_f(&packet.stream, 0.0f);
+
+    protocol_template frame;
+    protocol_template_init(&frame, &packet);
+    CHECK(frame.length == 14);
+    CHECK(frame._frame[0] == 14);
+    CHECK(frame._frame[1] == 0x42);
+    CHECK(frame._frame[2] == 0x42);
+
+    // the patched template matches a packet built with the new values
+    protocol_template_set_u8(&frame, u8, 0xAB);
+    protocol_template_set_u16(&frame, u16, 0xBEEF);
+    protocol_template_set_i32(&frame, i32, -123456);
+    protocol_template_set_f(&frame, f, 3.5f);
+    CHECK(frame._frame[1] == checksum(frame));
+
+    protocol_packet expected;
+    protocol_packet_init(&expected, 0x42);
+    bytestream_inject_u8(&expected.stream, 0xAB);
+    bytestream_inject_u16(&expected.stream, 0xBEEF);
+    bytestream_inject_i32(&expected.stream, -123456);
+    bytestream_inject_f(&expected.stream, 3.5f);
+    for(size_t i = 0; i != expected.stream.size; ++i)
+    {
+        CHECK(frame._frame[2 + i] == expected.stream.data[i]);
+    }
+
+    // repeated updates keep the checksum consistent
+    for(uint32_t value = 0; value != 1000; value += 7)
+    {
+        protocol_template_set_i32(&frame, i32, value * 0x01010101u);
+        protocol_template_set_f(&frame, f, static_cast<float>(value) / 3.0f);
+    }
+    CHECK(frame._frame[1] == checksum(frame));
+}
@@ -0,0 +1,103 @@
+/// \file
+/// \brief test the parts of the protocol that do not require a uart
+#include "nuhal/catch.hpp"
+#include "nuhal/protocol.h"
+
+TEST_CASE("protocol_rtt_update", "[protocol]")
+{
+    protocol_rtt rtt = {0, 0, false};
+
+    // without a measurement the ceiling is used
+    CHECK(protocol_rtt_timeout_us(&rtt, 2000, 50000) == 50000);
+
+    protocol_rtt_update(&rtt, 800);
+    CHECK(rtt.valid);
+    CHECK(rtt.srtt_us == 800);
+    CHECK(rtt.rttvar_us == 400);
+    CHECK(protocol_rtt_timeout_us(&rtt, 0, 50000) == 800 + 4*400);
+
+    // a steady round trip time converges, and the variation decays
+    for(int i = 0; i != 100; ++i)
+    {
+        protocol_rtt_update(&rtt, 1000);
+    }
+    CHECK(rtt.srtt_us > 990);
+    CHECK(rtt.srtt_us <= 1000);
+    CHECK(rtt.rttvar_us < 10);
+
+    // the variation is never below the resolution of the timer
+    CHECK(protocol_rtt_timeout_us(&rtt, 0, 50000) == rtt.srtt_us + 1000);
+
+    // the timeout is clamped
+    CHECK(protocol_rtt_timeout_us(&rtt, 5000, 50000) == 5000);
+    CHECK(protocol_rtt_timeout_us(&rtt, 0, 1500) == 1500);
+
+    // an outlier increases the variation more than the round trip time
+    const uint32_t srtt = rtt.srtt_us;
+    protocol_rtt_update(&rtt, 9000);
+    CHECK(rtt.srtt_us == (7*srtt + 9000)/8);
+    CHECK(rtt.rttvar_us >= (9000 - srtt)/4);
+}
+
+TEST_CASE("protocol_select_baud", "[protocol]")
+{
+    const uint32_t offered[] = {115200, 3000000, 1000000, 2000000};
+    const uint32_t supported[] = {9600, 1000000, 2000000};
+    CHECK(protocol_select_baud(offered, 4, supported, 3) == 2000000);
+    CHECK(protocol_select_baud(offered, 4, supported, 2) == 1000000);
+    CHECK(protocol_select_baud(offered, 1, supported, 3) == 0);
+    CHECK(protocol_select_baud(offered, 0, supported, 3) == 0);
+}
+
+TEST_CASE("protocol_packet_address", "[protocol]")
+{
+    protocol_packet packet;
+    protocol_packet_init(&packet, 0x20);
+    bytestream_inject_u8(&packet.stream, 0xAB);
+    protocol_packet_address(&packet, 0x04);
+    CHECK(protocol_packet_command(&packet) == PROTOCOL_ADDRESSED);
+
+    // the address can be found inside a sequenced packet
+    protocol_packet_sequence(&packet, 0x55);
+    uint8_t address = 0;
+    REQUIRE(protocol_packet_destination(&packet, &address));
+    CHECK(address == 0x04);
+
+    // make it look like it was received
+    bytestream_init(&packet.stream, packet.stream.data, packet.stream.size);
+    (void)bytestream_extract_u8(&packet.stream);
+
+    uint8_t sequence = 0;
+    REQUIRE(protocol_packet_unsequence(&packet, &sequence));
+    REQUIRE(protocol_packet_unaddress(&packet, &address));
+    CHECK(address == 0x04);
+    CHECK(protocol_packet_command(&packet) == 0x20);
+    CHECK(bytestream_extract_u8(&packet.stream) == 0xAB);
+    CHECK(!protocol_packet_destination(&packet, &address));
+}
+
+TEST_CASE("protocol_packet_sequence", "[protocol]")
+{
+    protocol_packet packet;
+    protocol_packet_init(&packet, 0x20);
+    bytestream_inject_u16(&packet.stream, 0x1234);
+    protocol_packet_sequence(&packet, 0x55);
+    CHECK(protocol_packet_command(&packet) == PROTOCOL_SEQUENCED);
+    CHECK(packet.stream.size == 5);
+
+    // make it look like it was received
+    protocol_packet copy;
+    protocol_packet_copy(&copy, &packet);
+    bytestream_init(&copy.stream, copy.stream.data, copy.stream.size);
+    (void)bytestream_extract_u8(&copy.stream);
+
+    uint8_t sequence = 0;
+    REQUIRE(protocol_packet_unsequence(&copy, &sequence));
+    CHECK(sequence == 0x55);
+    CHECK(protocol_packet_command(&copy) == 0x20);
+    CHECK(bytestream_extract_u16(&copy.stream) == 0x1234);
+
+    // a packet without a sequence number is left alone
+    CHECK(!protocol_packet_unsequence(&copy, &sequence));
+    CHECK(protocol_packet_command(&copy) == 0x20);
+}
@@ -0,0 +1,96 @@
+/// \file
+/// \brief test the generated serialization functions
+#include "nuhal/catch.hpp"
+#include "nuhal/serialize.h"
+#include "nuhal/encoder.h"
+
+/// a message with every type of field
+struct message
+{
+    uint8_t mode;
+    uint16_t count;
+    uint32_t flags;
+    int32_t position;
+    float velocity;
+};
+
+#define MESSAGE_FIELDS(X) \
+    X(u8, mode)           \
+    X(u16, count)         \
+    X(u32, flags)         \
+    X(i32, position)      \
+    X(f, velocity)
+
+SERIALIZE_DECLARE(message, struct message);
+SERIALIZE_DEFINE(message, struct message, MESSAGE_FIELDS, true)
+
+/// the same message, with two fields swapped
+#define SWAPPED_FIELDS(X) \
+    X(u8, mode)           \
+    X(u32, flags)         \
+    X(u16, count)         \
+    X(i32, position)      \
+    X(f, velocity)
+
+SERIALIZE_DECLARE(swapped, struct message);
+SERIALIZE_DEFINE(swapped, struct message, SWAPPED_FIELDS, true)
+
+/// the same layout as a message, with different field names
+struct renamed
+{
+    uint8_t m;
+    uint16_t c;
+    uint32_t fl;
+    int32_t pos;
+    float vel;
+};
+
+#define RENAMED_FIELDS(X) \
+    X(u8, m)              \
+    X(u16, c)             \
+    X(u32, fl)            \
+    X(i32, pos)           \
+    X(f, vel)
+
+SERIALIZE_DECLARE(renamed, struct renamed);
+SERIALIZE_DEFINE(renamed, struct renamed, RENAMED_FIELDS, true)
+
+TEST_CASE("serialize", "[serialize]")
+{
+    STATIC_REQUIRE(SERIALIZE_BYTES(MESSAGE_FIELDS) == 15);
+
+    // the fingerprint and the fields
+    uint8_t buffer[16] = "";
+    bytestream bs;
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+
+    const message in{3, 1776, 0xDEADBEEF, -42, 2.5f};
+    message_inject(&bs, &in);
+    CHECK(bs.size == 16);
+    CHECK(buffer[0] == message_fingerprint());
+
+    // the layout is the same as with the bytestream functions
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    bs.size = 1;
+    CHECK(3 == bytestream_extract_u8(&bs));
+    CHECK(1776 == bytestream_extract_u16(&bs));
+    CHECK(0xDEADBEEF == bytestream_extract_u32(&bs));
+    CHECK(-42 == bytestream_extract_i32(&bs));
+    CHECK(2.5f == bytestream_extract_f(&bs));
+
+    message out{};
+    bytestream_init(&bs, buffer, ARRAY_LEN(buffer));
+    message_extract(&bs, &out);
+    CHECK(out.mode == in.mode);
+    CHECK(out.count == in.count);
+    CHECK(out.flags == in.flags);
+    CHECK(out.position == in.position);
+    CHECK(out.velocity == in.velocity);
+
+    // a different layout has a different fingerprint
+    CHECK(message_fingerprint() != swapped_fingerprint());
+    CHECK(encoder_joints_fingerprint() != encoder_gimbal_fingerprint());
+
+    // the names of the fields are not part of the layout
+    CHECK(message_fingerprint() == renamed_fingerprint());
+}
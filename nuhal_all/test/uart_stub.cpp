@@ -31,3 +31,13 @@ int uart_write_nonblock(const struct uart_port * , const void * , size_t )
 {
     throw std::logic_error("uart_write_nonblock is a stub function");
 }
+
+void uart_close(const struct uart_port *)
+{
+    throw std::logic_error("uart_close is a stub function");
+}
+
+void uart_set_baud(const struct uart_port *, uint32_t)
+{
+    throw std::logic_error("uart_set_baud is a stub function");
+}
@@ -0,0 +1,119 @@
+#ifndef NUHAL_BYTESTREAM_CHAIN_H_INCLUDE_GUARD
+#define NUHAL_BYTESTREAM_CHAIN_H_INCLUDE_GUARD
+/// @file
+/// @brief A growable buffer for serializing data of unknown size on the host,
+/// such as batches of packets or logs.
+///
+/// The data is stored in a chain of chunks, each twice the size of the one
+/// before, so the number of allocations grows with the logarithm of the
+/// data size and nothing is copied when the chain grows. Data is serialized
+/// with the ordinary bytestream functions:
+///
+///     struct bytestream * bs = bytestream_chain_reserve(&chain, 8);
+///     bytestream_inject_f(bs, x);
+///     bytestream_inject_f(bs, y);
+///     bytestream_chain_commit(&chain);
+///
+/// The chunks are sent, without first copying them into one buffer, with
+/// bytestream_chain_write (or bytestream_chain_iovec and writev).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include "nuhal/bytestream.h"
+
+struct uart_port;
+
+/// \cond implementation detail
+struct bytestream_chunk;
+/// \endcond
+
+/// @brief a growable buffer made of chunks
+struct bytestream_chain
+{
+    /// \cond implementation detail
+    struct bytestream_chunk * first;
+    struct bytestream_chunk * last;
+
+    // the capacity of the next chunk to allocate
+    size_t next_capacity;
+
+    // the stream returned by bytestream_chain_reserve, over the free space
+    // of the last chunk
+    struct bytestream stream;
+    /// \endcond
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief initialize an empty chain
+/// @param out - the chain
+/// @param capacity - the capacity of the first chunk, in bytes.
+/// Later chunks are larger. 0 uses a default
+void bytestream_chain_init(struct bytestream_chain * out, size_t capacity);
+
+/// @brief get a bytestream over at least len free bytes at the end of the
+/// chain, allocating a new chunk if needed. The bytes are added to the
+/// chain by bytestream_chain_commit
+/// @param chain - the chain
+/// @param len - the number of bytes needed
+/// @return the stream, which is valid until the next call with this chain
+struct bytestream * bytestream_chain_reserve(struct bytestream_chain * chain,
+                                             size_t len);
+
+/// @brief add the bytes written to the stream returned by
+/// bytestream_chain_reserve to the chain
+/// @param chain - the chain
+void bytestream_chain_commit(struct bytestream_chain * chain);
+
+/// @brief copy bytes to the end of the chain, splitting them between
+/// chunks if needed
+/// @param chain - the chain
+/// @param data - the bytes
+/// @param len - the number of bytes
+void bytestream_chain_append(struct bytestream_chain * chain,
+                             const void * data,
+                             size_t len);
+
+/// @brief get the number of bytes in the chain
+/// @param chain - the chain
+/// @return the number of bytes committed to the chain
+size_t bytestream_chain_size(const struct bytestream_chain * chain);
+
+/// @brief describe the data in the chain for writev
+/// @param chain - the chain
+/// @param iov [out] - the buffers, in order. Empty chunks are skipped
+/// @param len - the number of elements in iov
+/// @return the number of buffers needed to describe the chain, at most len
+/// of which were stored in iov
+size_t bytestream_chain_iovec(const struct bytestream_chain * chain,
+                              struct iovec iov[],
+                              size_t len);
+
+/// @brief write the data in the chain to a uart, with uart_writev
+/// @param chain - the chain
+/// @param port - the uart port
+/// @param timeout - time to wait for all the data to be written, in ms.
+/// 0 waits forever
+/// @return the number of bytes written
+size_t bytestream_chain_write(const struct bytestream_chain * chain,
+                              const struct uart_port * port,
+                              uint32_t timeout);
+
+/// @brief empty the chain for reuse. The chunks are replaced with one chunk
+/// as large as all of them together, so that data of the same size fits
+/// without allocating
+/// @param chain - the chain
+void bytestream_chain_reset(struct bytestream_chain * chain);
+
+/// @brief free the memory used by the chain
+/// @param chain - the chain
+void bytestream_chain_free(struct bytestream_chain * chain);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
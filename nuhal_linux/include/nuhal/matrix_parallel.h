@@ -0,0 +1,64 @@
+#ifndef NUHAL_MATRIX_PARALLEL_H_INCLUDE_GUARD
+#define NUHAL_MATRIX_PARALLEL_H_INCLUDE_GUARD
+/// @file
+/// @brief Split large batches of matrix operations across threads.
+///
+/// The batches are stored as in the matrix batch functions, with a stride
+/// equal to the number of items. Each thread operates on a contiguous range
+/// of items, so the results are the same for any number of threads.
+/// Batches too small to make up for the cost of starting a thread are
+/// computed by the calling thread.
+
+#include <stddef.h>
+
+/// @brief the fewest items given to each thread
+#define MATRIX_PARALLEL_GRAIN 4096u
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief matrix_3x3_multiply_vector_batch, split across threads
+/// @param A - the matrices, 9 elements per item
+/// @param x - the vectors, 3 elements per item
+/// @param[out] v - the output vectors v = Ax, 3 elements per item
+/// @param count - the number of items, which is also the stride
+/// @param threads - the most threads to use, including the calling thread.
+/// 0 uses one per processor
+void matrix_3x3_multiply_vector_parallel(const float A[],
+                                         const float x[],
+                                         float v[],
+                                         size_t count,
+                                         unsigned int threads);
+
+/// @brief matrix_6x6_multiply_vector_batch, split across threads
+/// @param A - the matrices, 36 elements per item
+/// @param x - the vectors, 6 elements per item
+/// @param[out] v - the output vectors v = Ax, 6 elements per item
+/// @param count - the number of items, which is also the stride
+/// @param threads - the most threads to use, including the calling thread.
+/// 0 uses one per processor
+void matrix_6x6_multiply_vector_parallel(const float A[],
+                                         const float x[],
+                                         float v[],
+                                         size_t count,
+                                         unsigned int threads);
+
+/// @brief matrix_3x1_cross_batch, split across threads
+/// @param w - the first vectors, 3 elements per item
+/// @param v - the second vectors, 3 elements per item
+/// @param[out] out - w x v, 3 elements per item
+/// @param count - the number of items, which is also the stride
+/// @param threads - the most threads to use, including the calling thread.
+/// 0 uses one per processor
+void matrix_3x1_cross_parallel(const float w[],
+                               const float v[],
+                               float out[],
+                               size_t count,
+                               unsigned int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
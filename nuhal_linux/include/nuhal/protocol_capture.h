@@ -0,0 +1,110 @@
+#ifndef NUHAL_PROTOCOL_CAPTURE_H_INCLUDE_GUARD
+#define NUHAL_PROTOCOL_CAPTURE_H_INCLUDE_GUARD
+/// @file
+/// @brief record protocol traffic to a file and read it back.
+///
+/// While a capture is running, every packet sent or received with the
+/// protocol functions is appended to a binary log (@see protocol_set_tap).
+/// The log is meant to be read with mmap: it consists of a
+/// protocol_capture_file_header followed by records. Each record is a
+/// protocol_capture_record followed by the raw bytes of the packet, padded
+/// with zeros to a multiple of 8 bytes, so every record header is aligned.
+/// All fields are stored in the byte order of the host that made the capture.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/// @brief the magic bytes at the start of a capture file
+#define PROTOCOL_CAPTURE_MAGIC "NUHALCAP"
+
+/// @brief the version of the capture file format
+#define PROTOCOL_CAPTURE_VERSION 1u
+
+/// @brief The header at the start of a capture file
+struct protocol_capture_file_header
+{
+    /// PROTOCOL_CAPTURE_MAGIC, without the null character
+    char magic[8];
+
+    /// PROTOCOL_CAPTURE_VERSION
+    uint32_t version;
+
+    /// Unused, zero
+    uint32_t reserved;
+};
+
+/// @brief The header of a single packet in the capture file
+struct protocol_capture_record
+{
+    /// Time the packet was sent or received, in ns, from CLOCK_MONOTONIC
+    uint64_t timestamp_ns;
+
+    /// \brief Identifies the port over which the packet travelled.
+    ///
+    /// Ports are numbered from 0 in the order in which they first
+    /// appear in the capture. When a capture is appended to an existing
+    /// file, its ports are numbered after the ids already in the file
+    uint16_t port;
+
+    /// An enum protocol_direction, relative to the capturing program
+    uint8_t direction;
+
+    /// Unused, zero
+    uint8_t reserved;
+
+    /// The length of the packet data that follows this header
+    uint32_t length;
+};
+
+/// @brief A capture file that is open for reading
+struct protocol_capture
+{
+    /// The contents of the file, mapped into memory
+    const uint8_t * data;
+
+    /// The size of the file, in bytes
+    size_t size;
+
+    /// Offset of the next record to read
+    size_t offset;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Start recording all protocol traffic
+/// @param filename - the capture file. If it exists, packets are
+/// appended to it, and port ids continue from those in the file.
+/// Otherwise it is created
+/// @post replaces any tap that was set with protocol_set_tap
+void protocol_capture_start(const char filename[]);
+
+/// @brief Stop recording protocol traffic and close the capture file
+void protocol_capture_stop(void);
+
+/// @brief Open a capture file for reading
+/// @param[out] out - the capture
+/// @param filename - the name of the file to open
+void protocol_capture_open(struct protocol_capture * out, const char filename[]);
+
+/// @brief Read the next packet in the capture
+/// @param capture - the capture to read from
+/// @param[out] record - the header of the packet
+/// @param[out] data - set to point to the raw packet bytes, which remain
+/// valid until the capture is closed
+/// @return true if a packet was read, false at the end of the capture
+bool protocol_capture_next(struct protocol_capture * capture,
+                           struct protocol_capture_record * record,
+                           const uint8_t ** data);
+
+/// @brief Close a capture that was opened for reading
+/// @param capture - the capture
+void protocol_capture_close(struct protocol_capture * capture);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef NUHAL_PROTOCOL_FLASH_H_INCLUDE_GUARD
+#define NUHAL_PROTOCOL_FLASH_H_INCLUDE_GUARD
+/// @file
+/// @brief program boards through the TI serial bootloader
+/// @see TI Application Report SPMA074A "Implementation of Programmer
+/// for Serial Bootloaders on TM4C12x Microcontroller"
+///
+/// The bootloader uses the same packet format as the protocol, and
+/// acknowledges every packet with 0x00 0xCC (ACK) or 0x00 0x33 (NAK).
+/// The image is sent in blocks of up to PROTOCOL_FLASH_BLOCK_MAX bytes,
+/// the largest that fit in a packet.
+///
+/// Rather than asking for the status after every block, the client sends
+/// the next block as soon as the previous one is acknowledged, and checks
+/// the status once the image has been sent. Bootloaders that can buffer
+/// more than one packet may be given a deeper pipeline, in which case
+/// several blocks are sent before their acknowledgements arrive. A
+/// bootloader that can only hold the packet it is programming must use a
+/// pipeline of 1.
+/// After a NAK or a timeout, the download restarts with a new DOWNLOAD
+/// command. The bootloader erases every flash page that a download touches,
+/// so the download restarts at the start of the page that holds the first
+/// byte that was not acknowledged, and that whole page is sent again.
+///
+/// Several boards can be flashed at once, each on its own port and thread.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "nuhal/protocol.h"
+
+/// @brief bootloader command: check that the bootloader is listening
+#define PROTOCOL_FLASH_PING 0x20
+
+/// @brief bootloader command: erase flash and start a download.
+/// Data: u32 address, u32 size
+#define PROTOCOL_FLASH_DOWNLOAD 0x21
+
+/// @brief bootloader command: jump to an address. Data: u32 address
+#define PROTOCOL_FLASH_RUN 0x22
+
+/// @brief bootloader command: get the status of the last command
+#define PROTOCOL_FLASH_GET_STATUS 0x23
+
+/// @brief bootloader command: program the next block of the download
+#define PROTOCOL_FLASH_SEND_DATA 0x24
+
+/// @brief bootloader command: reset the microcontroller
+#define PROTOCOL_FLASH_RESET 0x25
+
+/// @brief bootloader status: the last command succeeded
+#define PROTOCOL_FLASH_STATUS_SUCCESS 0x40
+
+/// @brief the largest block of the image sent in a single packet.
+/// Blocks must be a multiple of 4 bytes
+#define PROTOCOL_FLASH_BLOCK_MAX 252u
+
+/// @brief the size of a flash page on the TM4C123, the smallest region that
+/// can be erased
+#define PROTOCOL_FLASH_PAGE_DEFAULT 1024u
+
+/// @brief how to flash a board
+struct protocol_flash_options
+{
+    /// the baud rate at which to open the port
+    uint32_t baud;
+
+    /// if true, send the autobaud synchronization bytes (0x55 0x55) first
+    bool autobaud;
+
+    /// the number of bytes sent in each block, a multiple of 4 of at most
+    /// PROTOCOL_FLASH_BLOCK_MAX
+    uint32_t block_size;
+
+    /// the size of a flash page, a power of 2 and at least 4, which sets
+    /// where a failed download restarts. 0 restarts from the start of the
+    /// image
+    uint32_t page_size;
+
+    /// the maximum number of blocks sent before their acknowledgement
+    /// arrives. At least 1
+    unsigned int pipeline;
+
+    /// time to wait for each acknowledgement, in ms
+    uint32_t timeout_ms;
+
+    /// the number of times the download can be restarted after a failure
+    unsigned int retries;
+
+    /// if true, reset the board after a successful download
+    bool reset;
+};
+
+/// @brief 115200 baud with autobaud, the largest blocks and a pipeline of 1,
+/// so each block is acknowledged before the next is sent
+#define PROTOCOL_FLASH_OPTIONS_DEFAULT \
+    {115200u, true, PROTOCOL_FLASH_BLOCK_MAX, PROTOCOL_FLASH_PAGE_DEFAULT, \
+     1u, 1000u, 3u, true}
+
+/// @brief the outcome of flashing a board
+struct protocol_flash_result
+{
+    /// true if the image was programmed
+    bool ok;
+
+    /// why flashing failed, or "" if it succeeded
+    const char * message;
+
+    /// the last status reported by the bootloader, 0 if none
+    uint8_t status;
+
+    /// the number of image bytes that were acknowledged
+    size_t bytes;
+
+    /// the number of times the download was restarted
+    unsigned int retries;
+
+    /// the time taken, in s
+    double seconds;
+};
+
+/// @brief flashing a single board, for protocol_flash_parallel
+struct protocol_flash_job
+{
+    /// the name of the port to which the board is connected
+    const char * port_name;
+
+    /// how to flash the board
+    struct protocol_flash_options options;
+
+    /// [out] the outcome
+    struct protocol_flash_result result;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief program an image into a board
+/// @param port - the port, opened with protocol_open_baud
+/// @param image - the image
+/// @param size - the size of the image in bytes. The last block is padded
+/// with 0xFF to a multiple of 4 bytes
+/// @param address - the address at which to program the image
+/// @param options - how to flash the board
+/// @param result [out] - the outcome
+/// @return result->ok
+/// Failures of the board are reported in result rather than with error(),
+/// so that one bad board does not stop others from being flashed
+bool protocol_flash(const struct uart_port * port,
+                    const uint8_t image[],
+                    size_t size,
+                    uint32_t address,
+                    const struct protocol_flash_options * options,
+                    struct protocol_flash_result * result);
+
+/// @brief program the same image into several boards at once
+/// @param jobs [in/out] - the boards to flash, each on a different port
+/// @param count - the number of jobs
+/// @param image - the image
+/// @param size - the size of the image, in bytes
+/// @param address - the address at which to program the image
+/// @return true if every board was flashed
+bool protocol_flash_parallel(struct protocol_flash_job jobs[],
+                             unsigned int count,
+                             const uint8_t image[],
+                             size_t size,
+                             uint32_t address);
+
+/// @brief print the outcome and throughput of flashing a board
+/// @param name - the name of the board or its port
+/// @param result - the outcome
+/// @param out - where to print
+void protocol_flash_report(const char * name,
+                           const struct protocol_flash_result * result,
+                           FILE * out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef NUHAL_PROTOCOL_SIM_H_INCLUDE_GUARD
+#define NUHAL_PROTOCOL_SIM_H_INCLUDE_GUARD
+/// @file
+/// @brief a simulated device at the far end of a pseudo-terminal (or any
+/// other uart), for testing and benchmarking host code without hardware.
+///
+/// Requests are handled by a protocol_server as protocol_server_poll does,
+/// including its address filtering and PROTOCOL_NEGOTIATE. Before each
+/// response is sent, the simulator waits for the processing delay of the
+/// command, and it can inject faults: a dropped request is never answered
+/// (the host times out) and a corrupted response has an invalid checksum.
+/// Faults are chosen with a seeded pseudo-random generator, so a run can
+/// be repeated exactly. The simulator counts the traffic so that the
+/// throughput of the whole serial path can be reported.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "nuhal/protocol_server.h"
+
+/// @brief faults are specified as a rate in parts per million
+#define PROTOCOL_SIM_PPM 1000000u
+
+/// @brief traffic counters of a simulator
+struct protocol_sim_counters
+{
+    /// requests received with a valid checksum
+    uint64_t requests;
+
+    /// responses sent, including corrupted ones. Broadcasts, requests for
+    /// other devices and PROTOCOL_NEGOTIATE (which the server answers
+    /// itself) are not counted
+    uint64_t responses;
+
+    /// requests that were dropped
+    uint64_t dropped;
+
+    /// responses that were corrupted
+    uint64_t corrupted;
+
+    /// packets that arrived with an invalid checksum or incomplete
+    uint64_t bad_requests;
+
+    /// bytes received, including packet headers
+    uint64_t bytes_rx;
+
+    /// bytes sent, including packet headers
+    uint64_t bytes_tx;
+};
+
+/// @brief a simulated device
+struct protocol_sim
+{
+    /// the port over which requests arrive
+    const struct uart_port * port;
+
+    /// the handlers for the requests
+    struct protocol_server * server;
+
+    /// the processing delay of each command, in us
+    uint32_t delay_us[256];
+
+    /// a random amount of up to this many us is added to each delay
+    uint32_t jitter_us;
+
+    /// the rate at which requests are dropped, in parts per million
+    uint32_t drop_ppm;
+
+    /// the rate at which responses are corrupted, in parts per million
+    uint32_t corrupt_ppm;
+
+    /// state of the pseudo-random generator
+    uint32_t random;
+
+    /// the traffic so far
+    struct protocol_sim_counters counters;
+
+    /// the time at which the counters were last reset, in ns
+    uint64_t start_ns;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief initialize a simulator with no delays and no faults
+/// @param out - the simulator
+/// @param port - the port on which to receive requests and send responses,
+/// for example the master side of uart_open_pty
+/// @param server - the handlers for the requests. Must remain valid while
+/// the simulator is in use
+/// @param seed - seed for the pseudo-random generator. Runs with the same
+/// seed and the same traffic inject the same faults
+void protocol_sim_init(struct protocol_sim * out,
+                       const struct uart_port * port,
+                       struct protocol_server * server,
+                       uint32_t seed);
+
+/// @brief set the processing delay of commands
+/// @param sim - the simulator
+/// @param command - the command. Sequenced and addressed requests use the
+/// delay of the command they wrap
+/// @param delay_us - the time between receiving a request and sending
+/// its response, in us
+void protocol_sim_set_delay(struct protocol_sim * sim,
+                            uint8_t command,
+                            uint32_t delay_us);
+
+/// @brief set the processing delay of every command
+/// @param sim - the simulator
+/// @param delay_us - the delay, in us
+/// @param jitter_us - up to this many us are randomly added to each delay
+void protocol_sim_set_delay_all(struct protocol_sim * sim,
+                                uint32_t delay_us,
+                                uint32_t jitter_us);
+
+/// @brief set the rate at which faults are injected
+/// @param sim - the simulator
+/// @param drop_ppm - requests dropped per million
+/// @param corrupt_ppm - responses corrupted per million
+void protocol_sim_set_faults(struct protocol_sim * sim,
+                             uint32_t drop_ppm,
+                             uint32_t corrupt_ppm);
+
+/// @brief handle a single request, if one arrives in time
+/// @param sim - the simulator
+/// @param timeout_ms - the time to wait for a request. 0 waits forever
+/// @return true if a packet was received (even if it was bad or dropped),
+/// false on timeout
+bool protocol_sim_poll(struct protocol_sim * sim, uint32_t timeout_ms);
+
+/// @brief reset the counters and the time from which throughput is measured
+/// @param sim - the simulator
+void protocol_sim_reset(struct protocol_sim * sim);
+
+/// @brief print the counters and the throughput since the last reset
+/// @param sim - the simulator
+/// @param out - where to print
+void protocol_sim_report(const struct protocol_sim * sim, FILE * out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
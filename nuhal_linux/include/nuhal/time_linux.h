@@ -0,0 +1,26 @@
+#ifndef NUHAL_TIME_LINUX_INCLUDE_GUARD
+#define NUHAL_TIME_LINUX_INCLUDE_GUARD
+/// @file
+/// @brief linux-specific time functions, with the resolution and range
+/// needed to timestamp and pace traffic on the host
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief get the time from the monotonic clock
+/// @return the time in ns, from an arbitrary starting point
+uint64_t time_monotonic_ns(void);
+
+/// @brief sleep until the monotonic clock reaches a time
+/// @param ns - the time, in ns, as returned by time_monotonic_ns. If it has
+/// already passed, returns immediately
+void time_sleep_until_ns(uint64_t ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
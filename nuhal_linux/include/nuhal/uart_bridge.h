@@ -0,0 +1,140 @@
+#ifndef NUHAL_UART_BRIDGE_H_INCLUDE_GUARD
+#define NUHAL_UART_BRIDGE_H_INCLUDE_GUARD
+/// @file
+/// @brief forward data between two uart ports (or a uart and a
+/// pseudo-terminal), like uart_passthrough on the tiva.
+///
+/// In raw mode, bytes are moved from one port to the other with splice()
+/// through a pipe, so the data is never copied into this process and the
+/// bridge sleeps in poll() until a port is ready. Kernels whose tty driver
+/// does not support splice fall back to read() and write().
+///
+/// In frame mode, the bridge reassembles protocol packets and forwards only
+/// whole packets, dropping those whose command byte is filtered out. A
+/// packet with an invalid checksum means the bridge lost track of the
+/// packet boundaries, so it discards bytes until a valid packet starts.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "nuhal/uart.h"
+
+/// @brief the number of bytes buffered (or held in the pipe) in each
+/// direction
+#define UART_BRIDGE_BUFFER_BYTES 4096
+
+/// @brief how a bridge forwards data
+enum uart_bridge_mode
+{
+    /// forward every byte as soon as it arrives
+    UART_BRIDGE_RAW,
+    /// forward whole protocol packets, which can be filtered
+    UART_BRIDGE_FRAME
+};
+
+/// @brief the traffic in one direction of a bridge
+struct uart_bridge_counters
+{
+    /// bytes forwarded
+    uint64_t bytes;
+
+    /// packets forwarded, in frame mode
+    uint64_t packets;
+
+    /// packets dropped by the filter, in frame mode
+    uint64_t filtered;
+
+    /// bytes discarded to find the start of a packet, in frame mode
+    uint64_t discarded;
+};
+
+/// \cond implementation detail
+/// @brief one direction of a bridge
+struct uart_bridge_direction
+{
+    int in;
+    int out;
+
+    // the pipe used with splice, or -1 if copying
+    int pipe[2];
+
+    // bytes in the pipe, waiting to be written
+    size_t piped;
+
+    // bytes read but not yet written (or not yet framed)
+    uint8_t buffer[UART_BRIDGE_BUFFER_BYTES];
+
+    // number of bytes in buffer, and of those the number at the start
+    // that are ready to be written
+    size_t buffered;
+    size_t ready;
+
+    // in frame mode, forward packets with this command
+    bool forward[256];
+
+    struct uart_bridge_counters counters;
+};
+/// \endcond
+
+/// @brief a bridge between two ports
+struct uart_bridge
+{
+    /// how data is forwarded
+    enum uart_bridge_mode mode;
+
+    /// data from port a to port b [0] and from b to a [1]
+    struct uart_bridge_direction direction[2];
+
+    /// true once either port has hung up or failed, after which nothing
+    /// more is forwarded
+    bool closed;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief set up a bridge that forwards everything between two ports
+/// @param out - the bridge
+/// @param a - a port, opened with uart_open or uart_open_pty
+/// @param b - the other port
+/// @param mode - how data is forwarded
+void uart_bridge_init(struct uart_bridge * out,
+                      const struct uart_port * a,
+                      const struct uart_port * b,
+                      enum uart_bridge_mode mode);
+
+/// @brief choose whether packets with a command are forwarded, in frame mode
+/// @param bridge - the bridge
+/// @param from_a - true for packets from port a to port b, false for the
+/// other direction
+/// @param command - the command byte
+/// @param forward - true to forward the packets, false to drop them
+void uart_bridge_filter(struct uart_bridge * bridge,
+                        bool from_a,
+                        uint8_t command,
+                        bool forward);
+
+/// @brief wait for either port to be ready and forward what it can
+/// @param bridge - the bridge
+/// @param timeout_ms - the time to wait. 0 waits forever
+/// @return false if nothing happened before the timeout, or if the bridge
+/// is closed because a port hung up or failed
+bool uart_bridge_poll(struct uart_bridge * bridge, uint32_t timeout_ms);
+
+/// @brief get the traffic through the bridge
+/// @param bridge - the bridge
+/// @param from_a - true for traffic from port a to port b
+/// @return the counters
+struct uart_bridge_counters uart_bridge_counters(const struct uart_bridge * bridge,
+                                                 bool from_a);
+
+/// @brief release the pipes used by a bridge. The ports stay open
+/// @param bridge - the bridge
+void uart_bridge_close(struct uart_bridge * bridge);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
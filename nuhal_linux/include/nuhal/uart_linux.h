@@ -3,6 +3,12 @@
 /// @file
 /// @brief linux-specific uart functions
 
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+struct uart_port;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -20,6 +26,37 @@ void uart_lock(const struct uart_port * port);
 /// @param port - the uart port to obtain exclusive access to
 void uart_unlock(const struct uart_port * port);
 
+/// @brief create a pseudo-terminal that acts as a virtual uart.
+/// The returned port is the master side. Another program (or this one)
+/// opens the slave side, whose name is returned in name, as if it were an
+/// ordinary serial port (e.g., with uart_open or protocol_open).
+/// Baud rate, flow control, and parity have no effect on a pseudo-terminal.
+/// @param[out] name - buffer where the name of the slave device is stored
+/// @param len - the length of the name buffer
+/// @return a handle to the master side of the pseudo-terminal
+/// @post all errors result in program termination
+const struct uart_port * uart_open_pty(char name[], size_t len);
+
+/// @brief get the file descriptor of a port, for use with poll or splice.
+/// The descriptor is non-blocking and remains owned by the port
+/// @param port - the uart port
+/// @return the file descriptor (the master side, for a pseudo-terminal)
+int uart_fd(const struct uart_port * port);
+
+/// @brief write several buffers to the uart, in order, with as few system
+/// calls as possible (see writev)
+/// @param port - the uart port
+/// @param iov - the buffers
+/// @param count - the number of buffers
+/// @param timeout - time to wait for all the data to be written, in ms.
+/// 0 waits forever
+/// @return the number of bytes written
+/// @post it is an error if the data is not written before the timeout
+size_t uart_writev(const struct uart_port * port,
+                   const struct iovec iov[],
+                   size_t count,
+                   uint32_t timeout);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,253 @@
+#include "nuhal/bytestream_chain.h"
+#include "nuhal/uart_linux.h"
+#include "nuhal/error.h"
+#include "nuhal/time.h"
+#include "nuhal/utilities.h"
+#include <stdlib.h>
+#include <string.h>
+
+// the capacity of the first chunk, if none is given
+#define DEFAULT_CAPACITY 256u
+
+// the most buffers passed to one call of uart_writev
+#define WRITE_BATCH 16u
+
+/// \cond implementation detail
+struct bytestream_chunk
+{
+    struct bytestream_chunk * next;
+
+    // bytes available in data, and the number used
+    size_t capacity;
+    size_t size;
+    uint8_t data[];
+};
+/// \endcond
+
+// allocate a chunk
+static struct bytestream_chunk * chunk_new(size_t capacity)
+{
+    if(capacity > SIZE_MAX - sizeof(struct bytestream_chunk))
+    {
+        error(FILE_LINE, "overflow");
+    }
+
+    struct bytestream_chunk * chunk =
+        malloc(sizeof(struct bytestream_chunk) + capacity);
+    if(!chunk)
+    {
+        error(FILE_LINE, "out of memory");
+    }
+    chunk->next = NULL;
+    chunk->capacity = capacity;
+    chunk->size = 0;
+    return chunk;
+}
+
+// free a list of chunks
+static void chunk_free_all(struct bytestream_chunk * chunk)
+{
+    while(chunk)
+    {
+        struct bytestream_chunk * next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+// point the stream of the chain at the free space of its last chunk
+static void chain_stream_reset(struct bytestream_chain * chain)
+{
+    struct bytestream_chunk * last = chain->last;
+    chain->stream.data = &last->data[last->size];
+    chain->stream.capacity = last->capacity - last->size;
+    chain->stream.size = 0;
+}
+
+void bytestream_chain_init(struct bytestream_chain * out, size_t capacity)
+{
+    if(!out)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    out->next_capacity = 0 == capacity ? DEFAULT_CAPACITY : capacity;
+    out->first = chunk_new(out->next_capacity);
+    out->last = out->first;
+    out->next_capacity = out->next_capacity > SIZE_MAX / 2 ?
+        out->next_capacity : 2 * out->next_capacity;
+    chain_stream_reset(out);
+}
+
+struct bytestream * bytestream_chain_reserve(struct bytestream_chain * chain,
+                                             size_t len)
+{
+    if(!chain)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    // bytes written since the last commit are discarded
+    chain_stream_reset(chain);
+    if(chain->stream.capacity < len)
+    {
+        const size_t capacity =
+            len > chain->next_capacity ? len : chain->next_capacity;
+        chain->last->next = chunk_new(capacity);
+        chain->last = chain->last->next;
+        chain->next_capacity =
+            capacity > SIZE_MAX / 2 ? capacity : 2 * capacity;
+        chain_stream_reset(chain);
+    }
+    return &chain->stream;
+}
+
+void bytestream_chain_commit(struct bytestream_chain * chain)
+{
+    if(!chain)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    chain->last->size += chain->stream.size;
+    chain_stream_reset(chain);
+}
+
+void bytestream_chain_append(struct bytestream_chain * chain,
+                             const void * data,
+                             size_t len)
+{
+    if(!chain || (!data && 0 != len))
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    // fill the last chunk, and put the rest in a new one
+    chain_stream_reset(chain);
+    const size_t first = len < chain->stream.capacity ? len : chain->stream.capacity;
+    if(0 != first)
+    {
+        bytestream_inject_u8_array(&chain->stream, data, first);
+        bytestream_chain_commit(chain);
+    }
+    if(first != len)
+    {
+        struct bytestream * bs = bytestream_chain_reserve(chain, len - first);
+        bytestream_inject_u8_array(bs, (const uint8_t *)data + first, len - first);
+        bytestream_chain_commit(chain);
+    }
+}
+
+size_t bytestream_chain_size(const struct bytestream_chain * chain)
+{
+    if(!chain)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    size_t size = 0;
+    for(const struct bytestream_chunk * chunk = chain->first; chunk; chunk = chunk->next)
+    {
+        size += chunk->size;
+    }
+    return size;
+}
+
+size_t bytestream_chain_iovec(const struct bytestream_chain * chain,
+                              struct iovec iov[],
+                              size_t len)
+{
+    if(!chain || (!iov && 0 != len))
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    size_t count = 0;
+    for(const struct bytestream_chunk * chunk = chain->first; chunk; chunk = chunk->next)
+    {
+        if(0 == chunk->size)
+        {
+            continue;
+        }
+        if(count < len)
+        {
+            iov[count].iov_base = (void *)chunk->data;
+            iov[count].iov_len = chunk->size;
+        }
+        ++count;
+    }
+    return count;
+}
+
+size_t bytestream_chain_write(const struct bytestream_chain * chain,
+                              const struct uart_port * port,
+                              uint32_t timeout)
+{
+    if(!chain || !port)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    // the timeout covers the whole chain, not each batch
+    struct time_elapsed_ms stamp = time_elapsed_ms_init();
+    struct iovec batch[WRITE_BATCH];
+    size_t written = 0;
+    const struct bytestream_chunk * chunk = chain->first;
+    while(chunk)
+    {
+        size_t count = 0;
+        for(; chunk && count != ARRAY_LEN(batch); chunk = chunk->next)
+        {
+            if(0 != chunk->size)
+            {
+                batch[count].iov_base = (void *)chunk->data;
+                batch[count].iov_len = chunk->size;
+                ++count;
+            }
+        }
+
+        uint32_t remaining = 0;
+        if(0 != timeout)
+        {
+            const uint32_t elapsed = time_elapsed_ms(&stamp);
+            if(elapsed >= timeout)
+            {
+                error(FILE_LINE, "Timeout on blocking write.");
+            }
+            remaining = timeout - elapsed;
+        }
+        written += uart_writev(port, batch, count, remaining);
+    }
+    return written;
+}
+
+void bytestream_chain_reset(struct bytestream_chain * chain)
+{
+    if(!chain)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(chain->first != chain->last)
+    {
+        size_t capacity = 0;
+        for(const struct bytestream_chunk * chunk = chain->first; chunk; chunk = chunk->next)
+        {
+            capacity += chunk->capacity;
+        }
+        chunk_free_all(chain->first);
+        chain->first = chunk_new(capacity);
+        chain->last = chain->first;
+    }
+    chain->first->size = 0;
+    chain_stream_reset(chain);
+}
+
+void bytestream_chain_free(struct bytestream_chain * chain)
+{
+    if(!chain)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    chunk_free_all(chain->first);
+    chain->first = NULL;
+    chain->last = NULL;
+}
@@ -0,0 +1,138 @@
+#define _DEFAULT_SOURCE // for _SC_NPROCESSORS_ONLN
+#include "nuhal/matrix_parallel.h"
+#include "nuhal/matrix.h"
+#include "nuhal/error.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// the ranges start on a multiple of this many items, so that only the last
+// one has items left over after the last full SIMD vector
+#define RANGE_ALIGN 4u
+
+// a batch function from matrix.h
+typedef void (*matrix_batch_fn)(const float [], const float [], float [],
+                                size_t, size_t);
+
+// a range of items computed by one thread
+struct matrix_range
+{
+    pthread_t thread;
+    matrix_batch_fn fn;
+    const float * a;
+    const float * b;
+    float * out;
+    size_t begin;
+    size_t end;
+    size_t stride;
+};
+
+// compute the items of a range
+static void * matrix_range_main(void * arg)
+{
+    struct matrix_range * range = arg;
+    range->fn(range->a + range->begin, range->b + range->begin,
+              range->out + range->begin, range->end - range->begin,
+              range->stride);
+    return NULL;
+}
+
+// split a batch into ranges and compute them, one per thread
+static void matrix_parallel(matrix_batch_fn fn,
+                            const float * a,
+                            const float * b,
+                            float * out,
+                            size_t count,
+                            unsigned int threads)
+{
+    if(!a || !b || !out)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(0 == threads)
+    {
+        const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = processors > 0 ? (unsigned int)processors : 1u;
+    }
+
+    const size_t most = count / MATRIX_PARALLEL_GRAIN;
+    if(most < threads)
+    {
+        threads = 0 == most ? 1u : (unsigned int)most;
+    }
+
+    if(1 == threads)
+    {
+        fn(a, b, out, count, count);
+        return;
+    }
+
+    size_t per_thread = (count + threads - 1) / threads;
+    per_thread = (per_thread + RANGE_ALIGN - 1) / RANGE_ALIGN * RANGE_ALIGN;
+
+    struct matrix_range * ranges = calloc(threads, sizeof(*ranges));
+    if(!ranges)
+    {
+        error(FILE_LINE, "out of memory");
+    }
+
+    for(unsigned int i = 0; i != threads; ++i)
+    {
+        ranges[i].fn = fn;
+        ranges[i].a = a;
+        ranges[i].b = b;
+        ranges[i].out = out;
+        ranges[i].begin = i * per_thread < count ? i * per_thread : count;
+        ranges[i].end = count - ranges[i].begin > per_thread ?
+            ranges[i].begin + per_thread : count;
+        ranges[i].stride = count;
+    }
+
+    // the calling thread computes the first range while the others run
+    for(unsigned int i = 1; i != threads; ++i)
+    {
+        if(0 != pthread_create(&ranges[i].thread, NULL,
+                               matrix_range_main, &ranges[i]))
+        {
+            error(FILE_LINE, "pthread_create failed");
+        }
+    }
+    (void)matrix_range_main(&ranges[0]);
+
+    for(unsigned int i = 1; i != threads; ++i)
+    {
+        if(0 != pthread_join(ranges[i].thread, NULL))
+        {
+            error(FILE_LINE, "pthread_join failed");
+        }
+    }
+    free(ranges);
+}
+
+void matrix_3x3_multiply_vector_parallel(const float A[],
+                                         const float x[],
+                                         float v[],
+                                         size_t count,
+                                         unsigned int threads)
+{
+    matrix_parallel(matrix_3x3_multiply_vector_batch, A, x, v, count, threads);
+}
+
+void matrix_6x6_multiply_vector_parallel(const float A[],
+                                         const float x[],
+                                         float v[],
+                                         size_t count,
+                                         unsigned int threads)
+{
+    matrix_parallel(matrix_6x6_multiply_vector_batch, A, x, v, count, threads);
+}
+
+void matrix_3x1_cross_parallel(const float w[],
+                               const float v[],
+                               float out[],
+                               size_t count,
+                               unsigned int threads)
+{
+    matrix_parallel(matrix_3x1_cross_batch, w, v, out, count, threads);
+}
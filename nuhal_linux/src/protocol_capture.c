@@ -0,0 +1,291 @@
+#define _DEFAULT_SOURCE // for mmap
+#include "nuhal/protocol_capture.h"
+#include "nuhal/protocol.h"
+#include "nuhal/error.h"
+#include "nuhal/time_linux.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// the maximum number of distinct ports that can appear in a capture
+#define MAX_PORTS 64
+
+// records are padded so that each record header is 8-byte aligned
+#define RECORD_ALIGN 8u
+
+STATIC_ASSERT(sizeof(struct protocol_capture_file_header) == 16, capture_file_header_size);
+STATIC_ASSERT(sizeof(struct protocol_capture_record) == 16, capture_record_size);
+
+// file descriptor of the capture file, -1 when not capturing
+static int capture_fd = -1;
+
+// protects the capture state, the tap can be called from multiple threads
+static pthread_mutex_t capture_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// the ports in the order in which they were first seen.
+// The index is the port id in the capture
+static const struct uart_port * capture_ports[MAX_PORTS];
+
+// the number of ports that have been seen
+static unsigned int capture_num_ports = 0;
+
+// the id of the first port seen. Ids continue after those already in the
+// file, so that ports from different sessions are never confused
+static unsigned int capture_first_id = 0;
+
+// round a length up to the alignment of the records
+static size_t record_padded(size_t len)
+{
+    return (len + RECORD_ALIGN - 1) & ~(size_t)(RECORD_ALIGN - 1);
+}
+
+// get the id of a port, assigning a new one if it has not been seen
+static uint16_t capture_port_id(const struct uart_port * port)
+{
+    for(unsigned int i = 0; i != capture_num_ports; ++i)
+    {
+        if(capture_ports[i] == port)
+        {
+            return capture_first_id + i;
+        }
+    }
+
+    if(capture_num_ports == MAX_PORTS
+       || capture_first_id + capture_num_ports > UINT16_MAX)
+    {
+        error(FILE_LINE, "too many ports");
+    }
+    capture_ports[capture_num_ports] = port;
+    return capture_first_id + capture_num_ports++;
+}
+
+// the first port id that is not used by the records in a capture file
+static unsigned int capture_next_id(const char filename[])
+{
+    struct protocol_capture capture;
+    protocol_capture_open(&capture, filename);
+
+    unsigned int next = 0;
+    struct protocol_capture_record record;
+    const uint8_t * data = NULL;
+    while(protocol_capture_next(&capture, &record, &data))
+    {
+        if(record.port >= next)
+        {
+            next = record.port + 1u;
+        }
+    }
+    protocol_capture_close(&capture);
+    return next;
+}
+
+// the tap function that writes each packet to the capture file
+static void capture_tap(const struct uart_port * port,
+                        enum protocol_direction direction,
+                        const uint8_t data[],
+                        size_t len,
+                        void * context)
+{
+    (void)context;
+    if(len > PROTOCOL_PACKET_MAX_LENGTH)
+    {
+        error(FILE_LINE, "packet too long");
+    }
+
+    // the whole record is written with a single call so that
+    // records from different threads are never interleaved
+    uint8_t buffer[sizeof(struct protocol_capture_record)
+                   + PROTOCOL_PACKET_MAX_LENGTH + RECORD_ALIGN] = {0};
+
+    struct protocol_capture_record record = {0};
+    record.timestamp_ns = time_monotonic_ns();
+    record.direction = direction;
+    record.length = len;
+
+    if(0 != pthread_mutex_lock(&capture_mutex))
+    {
+        error(FILE_LINE, "mutex lock failed");
+    }
+    record.port = capture_port_id(port);
+    memcpy(buffer, &record, sizeof(record));
+    memcpy(buffer + sizeof(record), data, len);
+
+    const size_t total = record_padded(sizeof(record) + len);
+    if(capture_fd >= 0 && write(capture_fd, buffer, total) != (ssize_t)total)
+    {
+        error_with_errno(FILE_LINE);
+    }
+    if(0 != pthread_mutex_unlock(&capture_mutex))
+    {
+        error(FILE_LINE, "mutex unlock failed");
+    }
+}
+
+void protocol_capture_start(const char filename[])
+{
+    if(!filename)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(capture_fd >= 0)
+    {
+        error(FILE_LINE, "capture already started");
+    }
+
+    const int fd = open(filename, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if(-1 == fd)
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    struct stat info;
+    if(0 != fstat(fd, &info))
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    // a new file needs a header
+    capture_first_id = 0;
+    if(0 != info.st_size)
+    {
+        capture_first_id = capture_next_id(filename);
+    }
+    else
+    {
+        struct protocol_capture_file_header header = {{0}, 0, 0};
+        memcpy(header.magic, PROTOCOL_CAPTURE_MAGIC, sizeof(header.magic));
+        header.version = PROTOCOL_CAPTURE_VERSION;
+        if(write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header))
+        {
+            error_with_errno(FILE_LINE);
+        }
+    }
+
+    capture_num_ports = 0;
+    capture_fd = fd;
+    protocol_set_tap(capture_tap, NULL);
+}
+
+void protocol_capture_stop(void)
+{
+    protocol_set_tap(NULL, NULL);
+
+    // wait for any packet that is being recorded to finish
+    if(0 != pthread_mutex_lock(&capture_mutex))
+    {
+        error(FILE_LINE, "mutex lock failed");
+    }
+    if(capture_fd >= 0)
+    {
+        if(0 != close(capture_fd))
+        {
+            error_with_errno(FILE_LINE);
+        }
+        capture_fd = -1;
+    }
+    if(0 != pthread_mutex_unlock(&capture_mutex))
+    {
+        error(FILE_LINE, "mutex unlock failed");
+    }
+}
+
+void protocol_capture_open(struct protocol_capture * out, const char filename[])
+{
+    if(!out || !filename)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    const int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if(-1 == fd)
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    struct stat info;
+    if(0 != fstat(fd, &info))
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    if((size_t)info.st_size < sizeof(struct protocol_capture_file_header))
+    {
+        error(FILE_LINE, "not a capture file");
+    }
+
+    void * data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(MAP_FAILED == data)
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    // the mapping remains valid after the file is closed
+    if(0 != close(fd))
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    struct protocol_capture_file_header header;
+    memcpy(&header, data, sizeof(header));
+    if(0 != memcmp(header.magic, PROTOCOL_CAPTURE_MAGIC, sizeof(header.magic)))
+    {
+        error(FILE_LINE, "not a capture file");
+    }
+
+    if(PROTOCOL_CAPTURE_VERSION != header.version)
+    {
+        error(FILE_LINE, "unsupported capture version");
+    }
+
+    out->data = data;
+    out->size = info.st_size;
+    out->offset = sizeof(header);
+}
+
+bool protocol_capture_next(struct protocol_capture * capture,
+                           struct protocol_capture_record * record,
+                           const uint8_t ** data)
+{
+    if(!capture || !record || !data)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(capture->offset + sizeof(*record) > capture->size)
+    {
+        return false;
+    }
+    memcpy(record, capture->data + capture->offset, sizeof(*record));
+
+    // a record that was only partially written (e.g., if the capturing
+    // program crashed) ends the capture
+    const size_t total = record_padded(sizeof(*record) + record->length);
+    if(capture->offset + total > capture->size)
+    {
+        return false;
+    }
+
+    *data = capture->data + capture->offset + sizeof(*record);
+    capture->offset += total;
+    return true;
+}
+
+void protocol_capture_close(struct protocol_capture * capture)
+{
+    if(!capture)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    if(0 != munmap((void *)capture->data, capture->size))
+    {
+        error_with_errno(FILE_LINE);
+    }
+    capture->data = NULL;
+    capture->size = 0;
+    capture->offset = 0;
+}
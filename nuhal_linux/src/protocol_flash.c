@@ -0,0 +1,358 @@
+#include "nuhal/protocol_flash.h"
+#include "nuhal/error.h"
+#include "nuhal/time_linux.h"
+#include "nuhal/uart.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// time for the bootloader to erase the flash and acknowledge a download
+#define ERASE_TIMEOUT_MS 10000u
+
+// time for the port to be quiet before a download is restarted, in ms
+#define DRAIN_MS 10u
+
+// timeout for sending the raw acknowledgement and synchronization bytes
+#define WRITE_TIMEOUT_MS 100u
+
+// value of the padding that rounds the image up to a multiple of 4 bytes
+#define ERASED_BYTE 0xFF
+
+// get the current time in s from the monotonic clock
+static double now_s(void)
+{
+    return (double)time_monotonic_ns() / 1e9;
+}
+
+// record a failure in the result
+static bool flash_fail(struct protocol_flash_result * result,
+                       double start,
+                       const char * message)
+{
+    result->ok = false;
+    result->message = message;
+    result->seconds = now_s() - start;
+    return false;
+}
+
+// wait for the bootloader to acknowledge a packet
+// returns false on a NAK, a timeout, or an unexpected packet
+static bool flash_wait_ack(const struct uart_port * port, uint32_t timeout_ms)
+{
+    struct protocol_packet packet;
+    // the ACK has no data, not even a command byte
+    return PROTOCOL_STATUS_OK == protocol_read_status(port, &packet, timeout_ms)
+        && 0 == packet.stream.capacity;
+}
+
+// send a packet and wait for the bootloader to acknowledge it
+static bool flash_command(const struct uart_port * port,
+                          struct protocol_packet * packet,
+                          uint32_t timeout_ms)
+{
+    protocol_write_block(port, packet);
+    return flash_wait_ack(port, timeout_ms);
+}
+
+// get the status of the last command
+// returns false if the bootloader does not respond
+static bool flash_status(const struct uart_port * port,
+                         uint32_t timeout_ms,
+                         uint8_t * status)
+{
+    struct protocol_packet packet;
+    protocol_packet_init(&packet, PROTOCOL_FLASH_GET_STATUS);
+    if(!flash_command(port, &packet, timeout_ms))
+    {
+        return false;
+    }
+
+    // the status is a packet with a single byte, which must be acknowledged
+    if(PROTOCOL_STATUS_OK != protocol_read_status(port, &packet, timeout_ms)
+       || 1 != packet.stream.capacity)
+    {
+        return false;
+    }
+    *status = protocol_packet_command(&packet);
+
+    const uint8_t ack[] = {0x00, 0xCC};
+    (void)uart_write_block(port, ack, sizeof(ack), WRITE_TIMEOUT_MS);
+    return true;
+}
+
+// start a download, which erases the flash that it covers
+static bool flash_download(const struct uart_port * port,
+                           uint32_t address,
+                           uint32_t size,
+                           struct protocol_flash_result * result)
+{
+    struct protocol_packet packet;
+    protocol_packet_init(&packet, PROTOCOL_FLASH_DOWNLOAD);
+    bytestream_inject_u32(&packet.stream, address);
+    bytestream_inject_u32(&packet.stream, size);
+    if(!flash_command(port, &packet, ERASE_TIMEOUT_MS)
+       || !flash_status(port, ERASE_TIMEOUT_MS, &result->status))
+    {
+        return false;
+    }
+    return PROTOCOL_FLASH_STATUS_SUCCESS == result->status;
+}
+
+// the offset in the image at which a failed download restarts: the start
+// of the flash page that holds the byte at offset, since a download erases
+// the whole of every page it touches
+static size_t flash_restart_offset(uint32_t address,
+                                   size_t offset,
+                                   uint32_t page_size)
+{
+    if(0 == page_size)
+    {
+        return 0;
+    }
+    const uint32_t page = (uint32_t)(address + offset) & ~(page_size - 1u);
+    return page > address ? page - address : 0;
+}
+
+// send the block of the image that starts at offset
+// returns the number of bytes in the block
+static size_t flash_send_block(const struct uart_port * port,
+                               const uint8_t image[],
+                               size_t size,
+                               size_t padded,
+                               size_t offset,
+                               uint32_t block_size)
+{
+    const size_t len = padded - offset < block_size ? padded - offset : block_size;
+
+    struct protocol_packet packet;
+    protocol_packet_init(&packet, PROTOCOL_FLASH_SEND_DATA);
+    if(offset < size)
+    {
+        const size_t data = size - offset < len ? size - offset : len;
+        bytestream_inject_u8_array(&packet.stream, &image[offset], data);
+    }
+    while(packet.stream.size != 1 + len)
+    {
+        bytestream_inject_u8(&packet.stream, ERASED_BYTE);
+    }
+    protocol_write_block(port, &packet);
+    return len;
+}
+
+bool protocol_flash(const struct uart_port * port,
+                    const uint8_t image[],
+                    size_t size,
+                    uint32_t address,
+                    const struct protocol_flash_options * options,
+                    struct protocol_flash_result * result)
+{
+    if(!port || !image || !options || !result)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(0 == options->block_size
+       || 0 != options->block_size % 4
+       || options->block_size > PROTOCOL_FLASH_BLOCK_MAX
+       || (0 != options->page_size
+           && (options->page_size < 4 || 0 != (options->page_size & (options->page_size - 1u))))
+       || 0 == options->pipeline)
+    {
+        error(FILE_LINE, "invalid options");
+    }
+
+    const double start = now_s();
+    result->ok = false;
+    result->message = "";
+    result->status = 0;
+    result->bytes = 0;
+    result->retries = 0;
+    result->seconds = 0;
+
+    if(options->autobaud)
+    {
+        protocol_drain(port, DRAIN_MS);
+        const uint8_t sync[] = {0x55, 0x55};
+        (void)uart_write_block(port, sync, sizeof(sync), WRITE_TIMEOUT_MS);
+        if(!flash_wait_ack(port, options->timeout_ms))
+        {
+            return flash_fail(result, start, "no response to autobaud");
+        }
+    }
+
+    struct protocol_packet ping;
+    protocol_packet_init(&ping, PROTOCOL_FLASH_PING);
+    if(!flash_command(port, &ping, options->timeout_ms))
+    {
+        return flash_fail(result, start, "no response to ping");
+    }
+
+    const size_t padded = (size + 3u) & ~(size_t)3u;
+    const size_t window = (size_t)options->pipeline * options->block_size;
+
+    // bytes of the image that have been acknowledged
+    size_t acked = 0;
+    while(acked < padded)
+    {
+        bool failed = !flash_download(port, address + acked, padded - acked, result);
+
+        // bytes of the image that have been sent
+        size_t sent = acked;
+        while(!failed && acked < padded)
+        {
+            // keep the pipeline full so the bootloader never waits for a block
+            while(sent < padded && sent - acked < window)
+            {
+                sent += flash_send_block(port, image, size, padded, sent,
+                                         options->block_size);
+            }
+
+            if(!flash_wait_ack(port, options->timeout_ms))
+            {
+                failed = true;
+                break;
+            }
+            acked += padded - acked < options->block_size ?
+                padded - acked : options->block_size;
+        }
+
+        if(failed)
+        {
+            if(result->retries == options->retries)
+            {
+                result->bytes = acked < size ? acked : size;
+                return flash_fail(result, start, "download failed");
+            }
+            ++result->retries;
+
+            // discard acknowledgements of blocks that were in flight
+            protocol_drain(port, DRAIN_MS);
+
+            // restarting the download erases the page that holds the
+            // first byte that was not acknowledged, so all of it is resent
+            acked = flash_restart_offset(address, acked, options->page_size);
+        }
+    }
+    result->bytes = size;
+
+    if(!flash_status(port, options->timeout_ms, &result->status))
+    {
+        return flash_fail(result, start, "no status after download");
+    }
+
+    if(PROTOCOL_FLASH_STATUS_SUCCESS != result->status)
+    {
+        return flash_fail(result, start, "programming failed");
+    }
+
+    if(options->reset)
+    {
+        // the bootloader resets immediately, possibly before the ACK is sent
+        struct protocol_packet reset;
+        protocol_packet_init(&reset, PROTOCOL_FLASH_RESET);
+        (void)flash_command(port, &reset, options->timeout_ms);
+    }
+
+    result->ok = true;
+    result->seconds = now_s() - start;
+    return true;
+}
+
+// a board that is being flashed by protocol_flash_parallel
+struct flash_thread
+{
+    pthread_t thread;
+    const struct uart_port * port;
+    struct protocol_flash_job * job;
+    const uint8_t * image;
+    size_t size;
+    uint32_t address;
+};
+
+// flash a single board of protocol_flash_parallel
+static void * flash_thread_main(void * arg)
+{
+    struct flash_thread * board = arg;
+    (void)protocol_flash(board->port, board->image, board->size, board->address,
+                         &board->job->options, &board->job->result);
+    return NULL;
+}
+
+bool protocol_flash_parallel(struct protocol_flash_job jobs[],
+                             unsigned int count,
+                             const uint8_t image[],
+                             size_t size,
+                             uint32_t address)
+{
+    if(!jobs || !image)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    struct flash_thread * boards = calloc(count, sizeof(*boards));
+    if(!boards && 0 != count)
+    {
+        error(FILE_LINE, "out of memory");
+    }
+
+    // the protocol keeps per-port state that is not thread safe to add or
+    // remove, so the ports are opened and closed by this thread
+    for(unsigned int i = 0; i != count; ++i)
+    {
+        boards[i].port = protocol_open_baud(jobs[i].port_name, jobs[i].options.baud);
+        boards[i].job = &jobs[i];
+        boards[i].image = image;
+        boards[i].size = size;
+        boards[i].address = address;
+    }
+
+    for(unsigned int i = 0; i != count; ++i)
+    {
+        const int err = pthread_create(&boards[i].thread, NULL,
+                                       flash_thread_main, &boards[i]);
+        if(0 != err)
+        {
+            error(FILE_LINE, "pthread_create failed");
+        }
+    }
+
+    bool ok = true;
+    for(unsigned int i = 0; i != count; ++i)
+    {
+        if(0 != pthread_join(boards[i].thread, NULL))
+        {
+            error(FILE_LINE, "pthread_join failed");
+        }
+        protocol_close(boards[i].port);
+        ok = ok && jobs[i].result.ok;
+    }
+
+    free(boards);
+    return ok;
+}
+
+void protocol_flash_report(const char * name,
+                           const struct protocol_flash_result * result,
+                           FILE * out)
+{
+    if(!name || !result || !out)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(result->ok)
+    {
+        fprintf(out, "%s: flashed %zu bytes in %.3f s", name, result->bytes,
+                result->seconds);
+        if(result->seconds > 0)
+        {
+            fprintf(out, " (%.1f bytes/s)", (double)result->bytes / result->seconds);
+        }
+    }
+    else
+    {
+        fprintf(out, "%s: failed after %zu bytes: %s (status 0x%02X)", name,
+                result->bytes, result->message, result->status);
+    }
+    fprintf(out, ", %u retries\n", result->retries);
+}
@@ -0,0 +1,233 @@
+#include "nuhal/protocol_sim.h"
+#include "nuhal/error.h"
+#include "nuhal/time_linux.h"
+#include "nuhal/uart.h"
+#include "nuhal/utilities.h"
+#include <inttypes.h>
+
+// time to wait for the rest of a request once it starts arriving, in ms
+#define READ_TIMEOUT_MS 100u
+
+// timeout for sending a response, in ms
+#define WRITE_TIMEOUT_MS 100u
+
+// bytes in the length and checksum that precede the packet data
+#define HEADER_BYTES 2u
+
+// the next value of the pseudo-random generator (xorshift32)
+static uint32_t sim_random(struct protocol_sim * sim)
+{
+    uint32_t x = sim->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->random = x;
+    return x;
+}
+
+// decide whether a fault with the given rate occurs
+static bool sim_fault(struct protocol_sim * sim, uint32_t ppm)
+{
+    return 0 != ppm && sim_random(sim) % PROTOCOL_SIM_PPM < ppm;
+}
+
+void protocol_sim_init(struct protocol_sim * out,
+                       const struct uart_port * port,
+                       struct protocol_server * server,
+                       uint32_t seed)
+{
+    if(!out || !port || !server)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    out->port = port;
+    out->server = server;
+    for(unsigned int i = 0; i != ARRAY_LEN(out->delay_us); ++i)
+    {
+        out->delay_us[i] = 0;
+    }
+    out->jitter_us = 0;
+    out->drop_ppm = 0;
+    out->corrupt_ppm = 0;
+
+    // xorshift never leaves the zero state
+    out->random = 0 == seed ? 1 : seed;
+    protocol_sim_reset(out);
+}
+
+void protocol_sim_set_delay(struct protocol_sim * sim,
+                            uint8_t command,
+                            uint32_t delay_us)
+{
+    if(!sim)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    sim->delay_us[command] = delay_us;
+}
+
+void protocol_sim_set_delay_all(struct protocol_sim * sim,
+                                uint32_t delay_us,
+                                uint32_t jitter_us)
+{
+    if(!sim)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    for(unsigned int i = 0; i != ARRAY_LEN(sim->delay_us); ++i)
+    {
+        sim->delay_us[i] = delay_us;
+    }
+    sim->jitter_us = jitter_us;
+}
+
+void protocol_sim_set_faults(struct protocol_sim * sim,
+                             uint32_t drop_ppm,
+                             uint32_t corrupt_ppm)
+{
+    if(!sim)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(drop_ppm > PROTOCOL_SIM_PPM || corrupt_ppm > PROTOCOL_SIM_PPM)
+    {
+        error(FILE_LINE, "invalid fault rate");
+    }
+    sim->drop_ppm = drop_ppm;
+    sim->corrupt_ppm = corrupt_ppm;
+}
+
+// send a response with an invalid checksum. The framing is the same
+// as protocol_write_block
+static void sim_write_corrupt(struct protocol_sim * sim,
+                              const struct protocol_packet * packet)
+{
+    uint8_t frame[PROTOCOL_PACKET_MAX_LENGTH];
+    const size_t length = HEADER_BYTES + packet->stream.size;
+    frame[0] = length;
+
+    uint8_t checksum = 0;
+    for(size_t i = 0; i != packet->stream.size; ++i)
+    {
+        frame[HEADER_BYTES + i] = packet->stream.data[i];
+        checksum += packet->stream.data[i];
+    }
+    frame[1] = ~checksum;
+    (void)uart_write_block(sim->port, frame, length, WRITE_TIMEOUT_MS);
+}
+
+// the command of a request, inside its sequence number and address, if any
+static uint8_t sim_command(const struct protocol_packet * packet)
+{
+    struct protocol_packet inner;
+    protocol_packet_copy(&inner, packet);
+    uint8_t value = 0;
+    (void)protocol_packet_unsequence(&inner, &value);
+    (void)protocol_packet_unaddress(&inner, &value);
+    return protocol_packet_command(&inner);
+}
+
+bool protocol_sim_poll(struct protocol_sim * sim, uint32_t timeout_ms)
+{
+    if(!sim)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(!uart_wait_for_data(sim->port, timeout_ms))
+    {
+        return false;
+    }
+
+    struct protocol_packet packet;
+    const uint64_t received = time_monotonic_ns();
+    if(PROTOCOL_STATUS_OK != protocol_read_status(sim->port, &packet, READ_TIMEOUT_MS))
+    {
+        // let the rest of the bad packet arrive so the next one starts cleanly
+        protocol_drain(sim->port, 2);
+        ++sim->counters.bad_requests;
+        return true;
+    }
+
+    ++sim->counters.requests;
+    sim->counters.bytes_rx += HEADER_BYTES + packet.stream.capacity;
+
+    uint32_t delay_us = sim->delay_us[sim_command(&packet)];
+    if(0 != sim->jitter_us)
+    {
+        delay_us += sim_random(sim) % (sim->jitter_us + 1);
+    }
+
+    if(sim_fault(sim, sim->drop_ppm))
+    {
+        ++sim->counters.dropped;
+        return true;
+    }
+
+    // the same path as protocol_server_poll, so addresses and negotiation
+    // are handled as on a real device
+    bool respond = false;
+    (void)protocol_server_process(sim->server, sim->port, &packet, &respond);
+    if(!respond)
+    {
+        return true;
+    }
+
+    // the delay is measured from when the request arrived, so it
+    // includes the time taken by the handler
+    if(0 != delay_us)
+    {
+        time_sleep_until_ns(received + (uint64_t)delay_us * 1000u);
+    }
+
+    ++sim->counters.responses;
+    sim->counters.bytes_tx += HEADER_BYTES + packet.stream.size;
+    if(sim_fault(sim, sim->corrupt_ppm))
+    {
+        ++sim->counters.corrupted;
+        sim_write_corrupt(sim, &packet);
+    }
+    else
+    {
+        protocol_write_block(sim->port, &packet);
+    }
+    return true;
+}
+
+void protocol_sim_reset(struct protocol_sim * sim)
+{
+    if(!sim)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    const struct protocol_sim_counters zero = {0, 0, 0, 0, 0, 0, 0};
+    sim->counters = zero;
+    sim->start_ns = time_monotonic_ns();
+}
+
+void protocol_sim_report(const struct protocol_sim * sim, FILE * out)
+{
+    if(!sim || !out)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    const struct protocol_sim_counters * c = &sim->counters;
+    const double seconds = (double)(time_monotonic_ns() - sim->start_ns) / 1e9;
+    fprintf(out,
+            "%.3f s: %" PRIu64 " requests, %" PRIu64 " responses, "
+            "%" PRIu64 " dropped, %" PRIu64 " corrupted, %" PRIu64 " bad, "
+            "%" PRIu64 " bytes in, %" PRIu64 " bytes out",
+            seconds, c->requests, c->responses, c->dropped, c->corrupted,
+            c->bad_requests, c->bytes_rx, c->bytes_tx);
+    if(seconds > 0)
+    {
+        fprintf(out, " (%.1f requests/s, %.1f bytes/s)",
+                (double)c->requests / seconds,
+                (double)(c->bytes_rx + c->bytes_tx) / seconds);
+    }
+    fprintf(out, "\n");
+}
@@ -1,6 +1,8 @@
-#define _POSIX_C_SOURCE 199309L // enable posix so we can use clock_gettime
+#define _POSIX_C_SOURCE 200112L // enable posix so we can use clock_gettime and clock_nanosleep
 #include "nuhal/time.h"
+#include "nuhal/time_linux.h"
 #include "nuhal/error.h"
+#include <errno.h>
 #include <time.h>
 
 uint32_t time_period_ms(void)
@@ -40,3 +42,27 @@ uint32_t time_current_us(void)
         + (unsigned long)tspec.tv_nsec/1000ul; // nsec to us
     return newtime % UINT32_MAX;
 }
+
+uint64_t time_monotonic_ns(void)
+{
+    struct timespec now;
+    if(0 != clock_gettime(CLOCK_MONOTONIC, &now))
+    {
+        error_with_errno(FILE_LINE);
+    }
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+void time_sleep_until_ns(uint64_t ns)
+{
+    const struct timespec when = {ns / 1000000000ull, ns % 1000000000ull};
+    int err = 0;
+    while(EINTR == (err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, NULL)))
+    {
+        ;
+    }
+    if(0 != err)
+    {
+        error(FILE_LINE, "clock_nanosleep failed");
+    }
+}
@@ -0,0 +1,377 @@
+#define _GNU_SOURCE // for splice and pipe2
+#include "nuhal/uart_bridge.h"
+#include "nuhal/uart_linux.h"
+#include "nuhal/error.h"
+#include "nuhal/utilities.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+// the number of bytes in the length and checksum of a packet
+#define HEADER_BYTES 2u
+
+// the checksums of the bootloader ACK and NAK, which have a length of 0
+#define ACK_CHECKSUM 0xCC
+#define NAK_CHECKSUM 0x33
+
+// set up one direction of a bridge
+static void bridge_direction_init(struct uart_bridge_direction * dir,
+                                  int in,
+                                  int out,
+                                  bool use_pipe)
+{
+    dir->in = in;
+    dir->out = out;
+    dir->pipe[0] = -1;
+    dir->pipe[1] = -1;
+    if(use_pipe && 0 != pipe2(dir->pipe, O_NONBLOCK | O_CLOEXEC))
+    {
+        error_with_errno(FILE_LINE);
+    }
+    dir->piped = 0;
+    dir->buffered = 0;
+    dir->ready = 0;
+    for(unsigned int i = 0; i != ARRAY_LEN(dir->forward); ++i)
+    {
+        dir->forward[i] = true;
+    }
+    memset(&dir->counters, 0, sizeof(dir->counters));
+}
+
+// stop using splice in a direction, moving any data in its pipe to the buffer
+static void bridge_direction_unpipe(struct uart_bridge_direction * dir)
+{
+    if(dir->piped > 0)
+    {
+        // the pipe never holds more than fits in the buffer
+        const ssize_t n = read(dir->pipe[0], dir->buffer, sizeof(dir->buffer));
+        if(n < 0)
+        {
+            error_with_errno(FILE_LINE);
+        }
+        dir->buffered = n;
+        dir->ready = n;
+        dir->piped = 0;
+    }
+    close(dir->pipe[0]);
+    close(dir->pipe[1]);
+    dir->pipe[0] = -1;
+    dir->pipe[1] = -1;
+}
+
+// true if the direction can accept more input
+static bool bridge_direction_can_read(const struct uart_bridge_direction * dir)
+{
+    // the pipe holds no more than the buffer, so that its contents can be
+    // moved to the buffer if splice fails
+    return dir->piped + dir->buffered < sizeof(dir->buffer);
+}
+
+// true if the direction has data waiting to be written
+static bool bridge_direction_can_write(const struct uart_bridge_direction * dir)
+{
+    return dir->piped > 0 || dir->ready > 0;
+}
+
+// remove bytes from the buffer
+static void bridge_direction_remove(struct uart_bridge_direction * dir,
+                                    size_t start,
+                                    size_t len)
+{
+    memmove(&dir->buffer[start], &dir->buffer[start + len],
+            dir->buffered - start - len);
+    dir->buffered -= len;
+}
+
+// determine if a complete packet has a valid checksum
+static bool bridge_checksum_valid(const uint8_t packet[], size_t length)
+{
+    if(0 == packet[0])
+    {
+        return ACK_CHECKSUM == packet[1] || NAK_CHECKSUM == packet[1];
+    }
+
+    uint8_t checksum = 0;
+    for(size_t i = HEADER_BYTES; i != length; ++i)
+    {
+        checksum += packet[i];
+    }
+    return checksum == packet[1];
+}
+
+// find the complete packets in the buffer, dropping those that are filtered
+static void bridge_direction_frame(struct uart_bridge_direction * dir)
+{
+    while(dir->buffered - dir->ready >= HEADER_BYTES)
+    {
+        const uint8_t * packet = &dir->buffer[dir->ready];
+        const size_t length = 0 == packet[0] ? HEADER_BYTES : packet[0];
+        if(length < HEADER_BYTES)
+        {
+            bridge_direction_remove(dir, dir->ready, 1);
+            ++dir->counters.discarded;
+            continue;
+        }
+
+        if(dir->buffered - dir->ready < length)
+        {
+            return;
+        }
+
+        if(!bridge_checksum_valid(packet, length))
+        {
+            // not the start of a packet: try the next byte
+            bridge_direction_remove(dir, dir->ready, 1);
+            ++dir->counters.discarded;
+            continue;
+        }
+
+        // ACK and NAK packets have no command byte
+        if(length == HEADER_BYTES || dir->forward[packet[HEADER_BYTES]])
+        {
+            dir->ready += length;
+            ++dir->counters.packets;
+        }
+        else
+        {
+            bridge_direction_remove(dir, dir->ready, length);
+            ++dir->counters.filtered;
+        }
+    }
+}
+
+// move data from the input into the pipe or the buffer
+static void bridge_direction_read(struct uart_bridge_direction * dir,
+                                  enum uart_bridge_mode mode)
+{
+    if(-1 != dir->pipe[0])
+    {
+        const ssize_t n = splice(dir->in, NULL, dir->pipe[1], NULL,
+                                 sizeof(dir->buffer) - dir->piped,
+                                 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if(n > 0)
+        {
+            dir->piped += n;
+            return;
+        }
+        if(n < 0 && EINVAL == errno)
+        {
+            bridge_direction_unpipe(dir);
+        }
+        else if(n < 0 && EAGAIN != errno && EINTR != errno)
+        {
+            error_with_errno(FILE_LINE);
+        }
+        else
+        {
+            return;
+        }
+    }
+
+    const ssize_t n = read(dir->in, &dir->buffer[dir->buffered],
+                           sizeof(dir->buffer) - dir->buffered);
+    if(n < 0 && EAGAIN != errno && EINTR != errno)
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    if(n > 0)
+    {
+        dir->buffered += n;
+        if(UART_BRIDGE_FRAME == mode)
+        {
+            bridge_direction_frame(dir);
+        }
+        else
+        {
+            dir->ready = dir->buffered;
+        }
+    }
+}
+
+// move data from the pipe or the buffer to the output
+static void bridge_direction_write(struct uart_bridge_direction * dir)
+{
+    if(dir->piped > 0)
+    {
+        const ssize_t n = splice(dir->pipe[0], NULL, dir->out, NULL, dir->piped,
+                                 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if(n > 0)
+        {
+            dir->piped -= n;
+            dir->counters.bytes += n;
+            return;
+        }
+        if(n < 0 && EINVAL == errno)
+        {
+            bridge_direction_unpipe(dir);
+        }
+        else if(n < 0 && EAGAIN != errno && EINTR != errno)
+        {
+            error_with_errno(FILE_LINE);
+        }
+        else
+        {
+            return;
+        }
+    }
+
+    if(0 == dir->ready)
+    {
+        return;
+    }
+
+    const ssize_t n = write(dir->out, dir->buffer, dir->ready);
+    if(n < 0 && EAGAIN != errno && EINTR != errno)
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    if(n > 0)
+    {
+        dir->ready -= n;
+        bridge_direction_remove(dir, 0, n);
+        dir->counters.bytes += n;
+    }
+}
+
+void uart_bridge_init(struct uart_bridge * out,
+                      const struct uart_port * a,
+                      const struct uart_port * b,
+                      enum uart_bridge_mode mode)
+{
+    if(!out || !a || !b)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    // frames are parsed in the buffer, so they cannot bypass it
+    const bool use_pipe = UART_BRIDGE_RAW == mode;
+    out->mode = mode;
+    out->closed = false;
+    bridge_direction_init(&out->direction[0], uart_fd(a), uart_fd(b), use_pipe);
+    bridge_direction_init(&out->direction[1], uart_fd(b), uart_fd(a), use_pipe);
+}
+
+void uart_bridge_filter(struct uart_bridge * bridge,
+                        bool from_a,
+                        uint8_t command,
+                        bool forward)
+{
+    if(!bridge)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    bridge->direction[from_a ? 0 : 1].forward[command] = forward;
+}
+
+bool uart_bridge_poll(struct uart_bridge * bridge, uint32_t timeout_ms)
+{
+    if(!bridge)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(timeout_ms > INT_MAX)
+    {
+        error(FILE_LINE, "invalid param");
+    }
+
+    if(bridge->closed)
+    {
+        return false;
+    }
+
+    struct uart_bridge_direction * ab = &bridge->direction[0];
+    struct uart_bridge_direction * ba = &bridge->direction[1];
+
+    // each port is read if its direction has room, and written if
+    // the other direction has data for it
+    struct pollfd fds[2] = {
+        {.fd = ab->in,
+         .events = (bridge_direction_can_read(ab) ? POLLIN : 0)
+         | (bridge_direction_can_write(ba) ? POLLOUT : 0)},
+        {.fd = ba->in,
+         .events = (bridge_direction_can_read(ba) ? POLLIN : 0)
+         | (bridge_direction_can_write(ab) ? POLLOUT : 0)}
+    };
+
+    const int ready = poll(fds, ARRAY_LEN(fds), 0 == timeout_ms ? -1 : (int)timeout_ms);
+    if(ready < 0)
+    {
+        if(EINTR == errno)
+        {
+            return false;
+        }
+        error_with_errno(FILE_LINE);
+    }
+
+    if(0 == ready)
+    {
+        return false;
+    }
+
+    // poll reports these even when no events are requested, so a port that
+    // is gone would otherwise wake every call without anything to forward
+    const short gone = POLLHUP | POLLERR | POLLNVAL;
+    if((fds[0].revents & gone) || (fds[1].revents & gone))
+    {
+        bridge->closed = true;
+        return false;
+    }
+
+    if(fds[0].revents & POLLIN)
+    {
+        bridge_direction_read(ab, bridge->mode);
+    }
+
+    if(fds[1].revents & POLLIN)
+    {
+        bridge_direction_read(ba, bridge->mode);
+    }
+
+    // write what was just read, without waiting for another poll
+    if(bridge_direction_can_write(ab))
+    {
+        bridge_direction_write(ab);
+    }
+
+    if(bridge_direction_can_write(ba))
+    {
+        bridge_direction_write(ba);
+    }
+    return true;
+}
+
+struct uart_bridge_counters uart_bridge_counters(const struct uart_bridge * bridge,
+                                                 bool from_a)
+{
+    if(!bridge)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    return bridge->direction[from_a ? 0 : 1].counters;
+}
+
+void uart_bridge_close(struct uart_bridge * bridge)
+{
+    if(!bridge)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    for(unsigned int i = 0; i != ARRAY_LEN(bridge->direction); ++i)
+    {
+        struct uart_bridge_direction * dir = &bridge->direction[i];
+        if(-1 != dir->pipe[0])
+        {
+            close(dir->pipe[0]);
+            close(dir->pipe[1]);
+            dir->pipe[0] = -1;
+            dir->pipe[1] = -1;
+        }
+    }
+}
@@ -1,7 +1,10 @@
 #define _DEFAULT_SOURCE // enable posix so we can use clock_gettime
+#define _GNU_SOURCE // for the pseudo-terminal functions
 /// @brief implementation of common/uart.h interface on linux systems
 #include"nuhal/uart.h"
 #include"nuhal/error.h"
+#include"nuhal/time.h"
+#include"nuhal/uart_linux.h"
 
 #include <poll.h>
 #include <fcntl.h>
@@ -22,6 +25,9 @@
 // timeout to wait for pending writes to finish before closing the port
 static const int CLOSE_TIMEOUT = 200;
 
+// the most buffers passed to one call of writev
+#define WRITEV_BATCH 64u
+
 /// \cond DO not document with doxygen: implementation detail
 // store old termios data with the port that is opened.
 // All open ports are stored in a linked list to track them
@@ -30,6 +36,8 @@ struct uart_port
     int fd;   // file descriptor
     bool is_open;
     bool is_usb;
+    bool has_serial; // true if the device supports the serial_struct ioctls
+    int pty_slave_fd; // for pseudo-terminals, the slave side kept open, else -1
     struct termios old_tio;
     struct serial_struct old_serial;
 
@@ -58,9 +66,8 @@ static void uart_cleanup(void)
     }
 }
 
-// open a serial port (using POSIX calls)
-const struct uart_port * uart_open(const char name[], uint32_t baud,
-                                   enum uart_flow flow, enum uart_parity parity)
+// allocate a new port and add it to the list of open ports
+static struct uart_port * uart_port_new(void)
 {
     static bool first_run = true;
     // set an at_exit function to automatically close all uart ports on exit
@@ -73,7 +80,6 @@ const struct uart_port * uart_open(const char name[], uint32_t baud,
         }
     }
 
-
     // allocate a new port struct
     struct uart_port * port =  (struct uart_port *)malloc(sizeof(struct uart_port));
     if(NULL == port)
@@ -85,6 +91,7 @@ const struct uart_port * uart_open(const char name[], uint32_t baud,
     port->next = NULL;
     port->prev = NULL;
     port->self = port;
+    port->pty_slave_fd = -1;
 
     // add the port to the port list
     if(NULL == port_list_head)
@@ -102,6 +109,37 @@ const struct uart_port * uart_open(const char name[], uint32_t baud,
         curr_port->next = port;
         port->prev = curr_port;
     }
+    return port;
+}
+
+// convert a baud rate to the termios speed
+static speed_t uart_speed(uint32_t baud)
+{
+    switch(baud)
+    {
+    case 9600:
+        return B9600;
+    case 115200:
+        return B115200;
+    case 230400:
+        return B230400;
+    case 1000000:
+        return B1000000;
+    case 2000000:
+        return B2000000;
+    case 3000000:
+        return B3000000;
+    default:
+        error(FILE_LINE, "Unsupported baud rate selected.");
+    }
+}
+
+// open a serial port (using POSIX calls)
+const struct uart_port * uart_open(const char name[], uint32_t baud,
+                                   enum uart_flow flow, enum uart_parity parity)
+{
+
+    struct uart_port * port = uart_port_new();
 
     // determine whether the device is a usb-serial converter
     // any device that starts with /dev/ttyUSB or /dev/ttyACM counts
@@ -137,21 +175,27 @@ const struct uart_port * uart_open(const char name[], uint32_t baud,
     // for example, defaults to a latency of 16ms.  The
     // minimum (for a USB 2.0 Full Speed converter) is
     // 1 ms, which we set here
-    if(-1 == ioctl(port->fd, TIOCGSERIAL, &port->old_serial))
+    // Virtual devices such as pseudo-terminals have no serial_struct
+    port->has_serial = -1 != ioctl(port->fd, TIOCGSERIAL, &port->old_serial);
+    if(!port->has_serial && errno != ENOTTY && errno != EINVAL)
     {
         error_with_errno(FILE_LINE);
     }
-    struct serial_struct serial = port->old_serial;
-    // the below is defined in serial.h
-    serial.flags |= ASYNC_LOW_LATENCY;
 
-    if(-1 == ioctl(port->fd, TIOCSSERIAL, &serial))
+    if(port->has_serial)
     {
-        // if the operation is not supported on this particular
-        // device, ignore the error
-        if(errno != ENOTSUP)
+        struct serial_struct serial = port->old_serial;
+        // the below is defined in serial.h
+        serial.flags |= ASYNC_LOW_LATENCY;
+
+        if(-1 == ioctl(port->fd, TIOCSSERIAL, &serial))
         {
-            error_with_errno(FILE_LINE);
+            // if the operation is not supported on this particular
+            // device, ignore the error
+            if(errno != ENOTSUP)
+            {
+                error_with_errno(FILE_LINE);
+            }
         }
     }
 
@@ -181,31 +225,7 @@ const struct uart_port * uart_open(const char name[], uint32_t baud,
     tio.c_oflag &= ~OPOST;
 
     // set the baud rate
-    speed_t stdbaud = 0;
-    switch(baud)
-    {
-    case 9600:
-        stdbaud = B9600;
-        break;
-    case 115200:
-        stdbaud = B115200;
-        break;
-    case 230400:
-        stdbaud = B230400;
-        break;
-    case 1000000:
-        stdbaud = B1000000;
-        break;
-    case 2000000:
-        stdbaud = B2000000;
-        break;
-    case 3000000:
-        stdbaud = B3000000;
-        break;
-    default:
-        error(FILE_LINE, "Unsupported baud rate selected.");
-        break;
-    }
+    const speed_t stdbaud = uart_speed(baud);
 
     switch(flow)
     {
@@ -278,6 +298,97 @@ const struct uart_port * uart_open(const char name[], uint32_t baud,
 
 
 
+void uart_set_baud(const struct uart_port * port, uint32_t baud)
+{
+    if(!port)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    const speed_t stdbaud = uart_speed(baud);
+
+    struct termios tio;
+    if(0 != tcgetattr(port->fd, &tio))
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    if(cfsetospeed(&tio, stdbaud) != 0)
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    if(cfsetispeed(&tio, stdbaud) != 0)
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    // TCSADRAIN sends pending output at the old baud rate first
+    if(0 != tcsetattr(port->fd, TCSADRAIN, &tio))
+    {
+        error_with_errno(FILE_LINE);
+    }
+}
+
+const struct uart_port * uart_open_pty(char name[], size_t len)
+{
+    if(!name)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    struct uart_port * port = uart_port_new();
+    port->fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(-1 == port->fd)
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    if(0 != grantpt(port->fd) || 0 != unlockpt(port->fd))
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    const int err = ptsname_r(port->fd, name, len);
+    if(0 != err)
+    {
+        errno = err;
+        error_with_errno(FILE_LINE);
+    }
+
+    // Keep the slave side open: otherwise reads on the master fail until
+    // another program opens the slave. The slave is placed in raw mode so
+    // that data written before the other program opens it is not mangled
+    port->pty_slave_fd = open(name, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(-1 == port->pty_slave_fd)
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    struct termios tio;
+    if(0 != tcgetattr(port->pty_slave_fd, &tio))
+    {
+        error_with_errno(FILE_LINE);
+    }
+    cfmakeraw(&tio);
+    if(0 != tcsetattr(port->pty_slave_fd, TCSANOW, &tio))
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    if(0 != tcgetattr(port->fd, &port->old_tio))
+    {
+        error_with_errno(FILE_LINE);
+    }
+    tio = port->old_tio;
+    cfmakeraw(&tio);
+    if(0 != tcsetattr(port->fd, TCSANOW, &tio))
+    {
+        error_with_errno(FILE_LINE);
+    }
+    return port;
+}
+
 int uart_read_nonblock(const struct uart_port * port, void * data, size_t length)
 {
     int val = read(port->fd, data, length);
@@ -348,14 +459,15 @@ void uart_close(const struct uart_port * port)
     if(0 != tcsetattr(port->fd, TCSADRAIN, &port->old_tio))
     {
         // if the operation is not supported on this particular
-        // device, just ignore the error
-        if(errno != ENOTSUP)
+        // device, just ignore the error. EIO means the device hung up,
+        // (e.g., the master side of a pseudo-terminal was closed)
+        if(errno != ENOTSUP && errno != EIO)
         {
             error_with_errno(FILE_LINE);
         }
     }
 
-    if(-1 == ioctl(port->fd, TIOCSSERIAL, &port->old_serial))
+    if(port->has_serial && -1 == ioctl(port->fd, TIOCSSERIAL, &port->old_serial))
     {
         if(errno != ENOTSUP)
         {
@@ -368,6 +480,11 @@ void uart_close(const struct uart_port * port)
         error_with_errno(FILE_LINE);
     }
 
+    if(-1 != port->pty_slave_fd && 0 != close(port->pty_slave_fd))
+    {
+        error_with_errno(FILE_LINE);
+    }
+
     // remove the port from the list
     if(NULL != port->prev)
     {
@@ -497,3 +614,84 @@ void uart_unlock(const struct uart_port * port)
         error_with_errno(FILE_LINE);
     }
 }
+
+int uart_fd(const struct uart_port * port)
+{
+    if(!port)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+    return port->fd;
+}
+
+size_t uart_writev(const struct uart_port * port,
+                   const struct iovec iov[],
+                   size_t count,
+                   uint32_t timeout)
+{
+    if(!port || (!iov && 0 != count))
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    if(timeout > INT_MAX)
+    {
+        error(FILE_LINE, "invalid param");
+    }
+
+    struct time_elapsed_ms stamp = time_elapsed_ms_init();
+    size_t written = 0;
+
+    // the buffer being written, and the bytes of it already written
+    size_t index = 0;
+    size_t offset = 0;
+    while(index != count)
+    {
+        // the rest of the data, with the first buffer trimmed
+        struct iovec batch[WRITEV_BATCH];
+        size_t len = 0;
+        for(; len != WRITEV_BATCH && index + len != count; ++len)
+        {
+            batch[len] = iov[index + len];
+        }
+        batch[0].iov_base = (uint8_t *)batch[0].iov_base + offset;
+        batch[0].iov_len -= offset;
+
+        ssize_t n = writev(port->fd, batch, (int)len);
+        if(n < 0)
+        {
+            if(EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno)
+            {
+                error_with_errno(FILE_LINE);
+            }
+            n = 0;
+        }
+        written += n;
+
+        // skip the buffers that were written
+        size_t remaining = n + offset;
+        while(index != count && remaining >= iov[index].iov_len)
+        {
+            remaining -= iov[index].iov_len;
+            ++index;
+        }
+        offset = remaining;
+
+        if(index != count && 0 == n)
+        {
+            // the port is not ready for more data
+            const uint32_t elapsed = time_elapsed_ms(&stamp);
+            if(0 != timeout && elapsed >= timeout)
+            {
+                error(FILE_LINE, "Timeout on blocking write.");
+            }
+            struct pollfd fds[] = {{.fd = port->fd, .events = POLLOUT}};
+            if(poll(fds, ARRAY_LEN(fds), 0 == timeout ? -1 : (int)(timeout - elapsed)) < 0
+               && EINTR != errno)
+            {
+                error_with_errno(FILE_LINE);
+            }
+        }
+    }
+    return written;
+}
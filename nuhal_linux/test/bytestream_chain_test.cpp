@@ -0,0 +1,116 @@
+/// \file
+/// \brief test growable chains of bytestream chunks
+#include "nuhal/bytestream_chain.h"
+#include "nuhal/protocol.h"
+#include "nuhal/protocol_template.h"
+#include "nuhal/uart.h"
+#include "nuhal/uart_linux.h"
+#include "nuhal/catch.hpp"
+#include <climits>
+#include <vector>
+
+/// the data in a chain, in one buffer
+static std::vector<uint8_t> flatten(const bytestream_chain & chain)
+{
+    std::vector<iovec> iov(bytestream_chain_iovec(&chain, nullptr, 0));
+    bytestream_chain_iovec(&chain, iov.data(), iov.size());
+    std::vector<uint8_t> data;
+    for(const iovec & buffer : iov)
+    {
+        const uint8_t * bytes = static_cast<const uint8_t *>(buffer.iov_base);
+        data.insert(data.end(), bytes, bytes + buffer.iov_len);
+    }
+    return data;
+}
+
+TEST_CASE("bytestream_chain", "[bytestream_chain]")
+{
+    bytestream_chain chain;
+    bytestream_chain_init(&chain, 16);
+
+    // the chain grows without moving the data already in it
+    std::vector<uint8_t> expected;
+    for(uint32_t i = 0; i != 10; ++i)
+    {
+        bytestream * bs = bytestream_chain_reserve(&chain, 8);
+        bytestream_inject_u32(bs, i);
+        bytestream_inject_u32(bs, ~i);
+        bytestream_chain_commit(&chain);
+
+        const uint8_t bytes[] = {
+            0, 0, 0, static_cast<uint8_t>(i),
+            0xFF, 0xFF, 0xFF, static_cast<uint8_t>(~i)
+        };
+        expected.insert(expected.end(), bytes, bytes + sizeof(bytes));
+    }
+
+    // bytes that are not committed are discarded
+    bytestream_inject_u8(bytestream_chain_reserve(&chain, 1), 0xAA);
+
+    // the chunks hold 16, 32 and 64 bytes
+    CHECK(bytestream_chain_size(&chain) == 80);
+    CHECK(bytestream_chain_iovec(&chain, nullptr, 0) == 3);
+    CHECK(flatten(chain) == expected);
+
+    // appended data is split between chunks
+    std::vector<uint8_t> block(100);
+    for(size_t i = 0; i != block.size(); ++i)
+    {
+        block[i] = static_cast<uint8_t>(i);
+    }
+    bytestream_chain_append(&chain, block.data(), block.size());
+    expected.insert(expected.end(), block.begin(), block.end());
+    CHECK(bytestream_chain_size(&chain) == 180);
+    CHECK(flatten(chain) == expected);
+
+    // after a reset, the same data fits in one chunk
+    const size_t chunks = bytestream_chain_iovec(&chain, nullptr, 0);
+    CHECK(chunks > 1);
+    bytestream_chain_reset(&chain);
+    CHECK(bytestream_chain_size(&chain) == 0);
+    bytestream_chain_append(&chain, expected.data(), expected.size());
+    CHECK(bytestream_chain_iovec(&chain, nullptr, 0) == 1);
+    CHECK(flatten(chain) == expected);
+
+    bytestream_chain_free(&chain);
+}
+
+TEST_CASE("bytestream_chain_write", "[bytestream_chain]")
+{
+    char name[PATH_MAX] = "";
+    const uart_port * device = uart_open_pty(name, sizeof(name));
+    const uart_port * host = protocol_open(name);
+
+    // a batch of packets, sent with one call
+    bytestream_chain chain;
+    bytestream_chain_init(&chain, 64);
+    for(uint32_t i = 0; i != 20; ++i)
+    {
+        protocol_packet packet;
+        protocol_packet_init(&packet, 0x30);
+        bytestream_inject_u32(&packet.stream, i);
+        protocol_template frame;
+        protocol_template_init(&frame, &packet);
+        bytestream_chain_append(&chain, frame._frame, frame.length);
+    }
+    const size_t size = bytestream_chain_size(&chain);
+    CHECK(bytestream_chain_iovec(&chain, nullptr, 0) > 1);
+    CHECK(bytestream_chain_write(&chain, host, 1000) == size);
+    bytestream_chain_free(&chain);
+
+    unsigned int received = 0;
+    for(uint32_t i = 0; i != 20; ++i)
+    {
+        protocol_packet packet;
+        if(PROTOCOL_STATUS_OK == protocol_read_status(device, &packet, 1000)
+           && 0x30 == protocol_packet_command(&packet)
+           && i == bytestream_extract_u32(&packet.stream))
+        {
+            ++received;
+        }
+    }
+    CHECK(received == 20);
+
+    protocol_close(host);
+    uart_close(device);
+}
@@ -0,0 +1,41 @@
+/// \file
+/// \brief test matrix batches split across threads
+#include "nuhal/matrix_parallel.h"
+#include "nuhal/matrix.h"
+#include "nuhal/catch.hpp"
+#include <random>
+#include <vector>
+
+TEST_CASE("matrix_parallel", "[matrix]")
+{
+    // large enough for several threads, with items left over at the end
+    const size_t count = 4 * MATRIX_PARALLEL_GRAIN + 7;
+    std::mt19937 generator(91011);
+    std::uniform_real_distribution<float> uniform(-100.0f, 100.0f);
+    std::vector<float> A3(9*count), x3(3*count), w3(3*count);
+    std::vector<float> A6(36*count), x6(6*count);
+    for(std::vector<float> * data : {&A3, &x3, &w3, &A6, &x6})
+    {
+        for(float & element : *data)
+        {
+            element = uniform(generator);
+        }
+    }
+
+    std::vector<float> v3(3*count), v6(6*count), cross(3*count);
+    matrix_3x3_multiply_vector_batch(A3.data(), x3.data(), v3.data(), count, count);
+    matrix_6x6_multiply_vector_batch(A6.data(), x6.data(), v6.data(), count, count);
+    matrix_3x1_cross_batch(w3.data(), x3.data(), cross.data(), count, count);
+
+    // the results do not depend on the number of threads
+    for(unsigned int threads : {0u, 1u, 3u, 64u})
+    {
+        std::vector<float> p3(3*count), p6(6*count), pcross(3*count);
+        matrix_3x3_multiply_vector_parallel(A3.data(), x3.data(), p3.data(), count, threads);
+        matrix_6x6_multiply_vector_parallel(A6.data(), x6.data(), p6.data(), count, threads);
+        matrix_3x1_cross_parallel(w3.data(), x3.data(), pcross.data(), count, threads);
+        CHECK(p3 == v3);
+        CHECK(p6 == v6);
+        CHECK(pcross == cross);
+    }
+}
@@ -0,0 +1,170 @@
+/// \file
+/// \brief test a multi-drop bus over a pseudo-terminal
+#include "nuhal/protocol_bus.h"
+#include "nuhal/protocol_server.h"
+#include "nuhal/uart.h"
+#include "nuhal/uart_linux.h"
+#include "nuhal/catch.hpp"
+#include <chrono>
+#include <climits>
+#include <thread>
+#include <vector>
+
+/// reply with the address of the device
+static bool whoami_handler(protocol_packet * packet, void * context)
+{
+    protocol_packet_reply_init(packet);
+    bytestream_inject_u8(&packet->stream, *static_cast<uint8_t *>(context));
+    return true;
+}
+
+/// count the broadcasts received by a device
+static bool broadcast_handler(protocol_packet *, void * context)
+{
+    ++*static_cast<int *>(context);
+    return true;
+}
+
+/// record the order of the responses and the time each request was sent
+struct poll_record
+{
+    std::vector<uint8_t> address;
+    std::vector<std::chrono::steady_clock::time_point> time;
+};
+
+/// every drop is asked who it is
+static void build_whoami(uint8_t, protocol_packet * request, void * context)
+{
+    // the request is built at the start of its slot, whereas the response
+    // arrives after a delay that varies with the load on the machine
+    static_cast<poll_record *>(context)->time.push_back(
+        std::chrono::steady_clock::now());
+    protocol_packet_init(request, 0x10);
+}
+
+static void record_whoami(uint8_t address, protocol_status status,
+                          protocol_packet * response, void * context)
+{
+    poll_record * record = static_cast<poll_record *>(context);
+    if(PROTOCOL_STATUS_OK == status
+       && bytestream_extract_u8(&response->stream) == address)
+    {
+        record->address.push_back(address);
+    }
+}
+
+TEST_CASE("protocol_bus", "[protocol_bus]")
+{
+    char name[PATH_MAX] = "";
+    const uart_port * device = uart_open_pty(name, sizeof(name));
+    const uart_port * host = protocol_open(name);
+
+    // three devices share the bus. Each one sees every packet, and
+    // responds only to those sent to its address
+    uint8_t addresses[] = {1, 2, 5};
+    int broadcasts[3] = {0, 0, 0};
+
+    // the number of broadcasts that each device should have received
+    int expected_broadcasts = 0;
+    protocol_server server[3];
+    for(unsigned int i = 0; i != 3; ++i)
+    {
+        protocol_server_init(&server[i]);
+        protocol_server_address(&server[i], addresses[i]);
+        protocol_server_register(&server[i], 0x10, whoami_handler, &addresses[i]);
+        protocol_server_register(&server[i], 0x11, broadcast_handler, &broadcasts[i]);
+    }
+
+    // the responder stops after a packet with command 0x12
+    std::thread responder([&]() {
+        for(;;)
+        {
+            protocol_packet packet;
+            if(PROTOCOL_STATUS_OK != protocol_read_status(device, &packet, 0))
+            {
+                continue;
+            }
+
+            uint8_t address = 0;
+            if(!protocol_packet_destination(&packet, &address))
+            {
+                return;
+            }
+
+            for(unsigned int i = 0; i != 3; ++i)
+            {
+                if(address == addresses[i] || PROTOCOL_ADDRESS_BROADCAST == address)
+                {
+                    protocol_packet copy;
+                    protocol_packet_copy(&copy, &packet);
+                    (void)protocol_server_handle(&server[i], &copy);
+                    if(PROTOCOL_ADDRESS_BROADCAST != address)
+                    {
+                        protocol_write_block(device, &copy);
+                    }
+                }
+            }
+        }
+    });
+
+    poll_record record;
+    SECTION("round robin")
+    {
+        protocol_bus bus;
+        protocol_bus_init(&bus, host, PROTOCOL_BUS_ROUND_ROBIN, 0, 100);
+        protocol_bus_add(&bus, 5);
+        protocol_bus_add(&bus, 1);
+        protocol_bus_add(&bus, 2);
+
+        CHECK(protocol_bus_poll(&bus, build_whoami, record_whoami, &record)
+              == PROTOCOL_STATUS_OK);
+        CHECK(protocol_bus_cycle(&bus, build_whoami, record_whoami, &record) == 3);
+        CHECK(record.address == std::vector<uint8_t>({5, 1, 2, 5}));
+
+        protocol_packet broadcast;
+        protocol_packet_init(&broadcast, 0x11);
+        protocol_bus_broadcast(&bus, &broadcast);
+        expected_broadcasts = 1;
+
+        // a drop that is not on the bus does not respond
+        protocol_packet request;
+        protocol_packet_init(&request, 0x10);
+        CHECK(protocol_bus_request(&bus, 7, &request, nullptr, 20)
+              == PROTOCOL_STATUS_TIMEOUT);
+    }
+
+    SECTION("time slotted")
+    {
+        protocol_bus bus;
+        protocol_bus_init(&bus, host, PROTOCOL_BUS_TIME_SLOTTED, 20000, 10);
+        protocol_bus_add(&bus, 1);
+        protocol_bus_add(&bus, 2);
+
+        CHECK(protocol_bus_cycle(&bus, build_whoami, record_whoami, &record) == 2);
+        CHECK(protocol_bus_cycle(&bus, build_whoami, record_whoami, &record) == 2);
+        REQUIRE(record.address == std::vector<uint8_t>({1, 2, 1, 2}));
+
+        // each poll starts no earlier than its slot. A poll can start late
+        // if the one before it overran its slot, so the times are measured
+        // from the start of the first cycle
+        for(unsigned int i = 1; i != record.time.size(); ++i)
+        {
+            CHECK(record.time[i] - record.time[0]
+                  >= i * std::chrono::microseconds(19000));
+        }
+    }
+
+    protocol_packet stop;
+    protocol_packet_init(&stop, 0x12);
+    protocol_write_block(host, &stop);
+    responder.join();
+
+    // the broadcast in the round robin section reaches every device once
+    for(unsigned int i = 0; i != 3; ++i)
+    {
+        CHECK(broadcasts[i] == expected_broadcasts);
+    }
+
+    protocol_close(host);
+    uart_close(device);
+}
@@ -0,0 +1,80 @@
+/// \file
+/// \brief test recording protocol traffic sent over a pseudo-terminal
+#include "nuhal/protocol_capture.h"
+#include "nuhal/protocol.h"
+#include "nuhal/uart.h"
+#include "nuhal/uart_linux.h"
+#include "nuhal/catch.hpp"
+#include <climits>
+#include <cstdlib>
+#include <unistd.h>
+
+TEST_CASE("protocol_capture_roundtrip", "[protocol_capture]")
+{
+    char name[PATH_MAX] = "";
+    const uart_port * device = uart_open_pty(name, sizeof(name));
+    const uart_port * host = protocol_open(name);
+
+    char filename[] = "/tmp/nuhal_capture_XXXXXX";
+    const int fd = mkstemp(filename);
+    REQUIRE(fd >= 0);
+    close(fd);
+
+    protocol_capture_start(filename);
+    protocol_packet request;
+    protocol_packet_init(&request, 0x42);
+    bytestream_inject_u32(&request.stream, 0xDEADBEEF);
+    protocol_write_block(host, &request);
+
+    protocol_packet received;
+    protocol_read_block(device, &received, 100);
+    protocol_capture_stop();
+
+    CHECK(protocol_packet_command(&received) == 0x42);
+    CHECK(bytestream_extract_u32(&received.stream) == 0xDEADBEEF);
+
+    protocol_capture capture;
+    protocol_capture_open(&capture, filename);
+
+    protocol_capture_record first;
+    const uint8_t * first_data = nullptr;
+    REQUIRE(protocol_capture_next(&capture, &first, &first_data));
+    CHECK(first.port == 0);
+    CHECK(first.direction == PROTOCOL_DIRECTION_TX);
+    CHECK(first.length == 7);
+    CHECK(first_data[2] == 0x42);
+
+    protocol_capture_record second;
+    const uint8_t * second_data = nullptr;
+    REQUIRE(protocol_capture_next(&capture, &second, &second_data));
+    CHECK(second.port == 1);
+    CHECK(second.direction == PROTOCOL_DIRECTION_RX);
+    CHECK(second.length == first.length);
+    CHECK(std::equal(first_data, first_data + first.length, second_data));
+    CHECK(second.timestamp_ns >= first.timestamp_ns);
+
+    protocol_capture_record end;
+    const uint8_t * end_data = nullptr;
+    CHECK(!protocol_capture_next(&capture, &end, &end_data));
+
+    protocol_capture_close(&capture);
+
+    // a second session appended to the file gives its port a new id
+    protocol_capture_start(filename);
+    protocol_write_block(host, &request);
+    protocol_capture_stop();
+    protocol_read_block(device, &received, 100);
+
+    protocol_capture_open(&capture, filename);
+    REQUIRE(protocol_capture_next(&capture, &first, &first_data));
+    REQUIRE(protocol_capture_next(&capture, &second, &second_data));
+    protocol_capture_record third;
+    const uint8_t * third_data = nullptr;
+    REQUIRE(protocol_capture_next(&capture, &third, &third_data));
+    CHECK(third.port == 2);
+    CHECK(!protocol_capture_next(&capture, &end, &end_data));
+    protocol_capture_close(&capture);
+    unlink(filename);
+    protocol_close(host);
+    uart_close(device);
+}
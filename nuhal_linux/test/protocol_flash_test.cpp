@@ -0,0 +1,266 @@
+/// \file
+/// \brief test flashing boards through a simulated TI serial bootloader
+#include "nuhal/protocol_flash.h"
+#include "nuhal/uart.h"
+#include "nuhal/uart_linux.h"
+#include "nuhal/catch.hpp"
+#include <atomic>
+#include <climits>
+#include <thread>
+#include <vector>
+
+/// a bootloader that programs a simulated flash memory
+class fake_bootloader
+{
+public:
+    /// @param nak_block - send a NAK instead of programming this block.
+    /// -1 never sends a NAK
+    explicit fake_bootloader(int nak_block = -1)
+        : port(uart_open_pty(name, sizeof(name))),
+          flash(0x2000, 0),
+          nak_block(nak_block),
+          thread([this]() { run(); })
+    {
+    }
+
+    ~fake_bootloader()
+    {
+        thread.join();
+        uart_close(port);
+    }
+
+    /// the name of the port to which the host connects
+    char name[PATH_MAX] = "";
+
+    /// the port of the bootloader
+    const uart_port * port;
+
+    /// the contents of the flash
+    std::vector<uint8_t> flash;
+
+    /// true if the board was reset, after which the bootloader stops
+    std::atomic<bool> reset{false};
+
+    /// wait for the board to be reset
+    void wait_for_reset() const
+    {
+        while(!reset)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    void ack()
+    {
+        const uint8_t ack[] = {0x00, 0xCC};
+        uart_write_block(port, ack, sizeof(ack), 100);
+    }
+
+    void nak()
+    {
+        const uint8_t nak[] = {0x00, 0x33};
+        uart_write_block(port, nak, sizeof(nak), 100);
+    }
+
+    void run()
+    {
+        // autobaud
+        uint8_t sync[2] = {0, 0};
+        if(2 != uart_read_block_error(port, sync, 2, 2000, UART_TERM_NONE, false)
+           || 0x55 != sync[0] || 0x55 != sync[1])
+        {
+            return;
+        }
+        ack();
+
+        uint32_t address = 0;
+        uint8_t status = PROTOCOL_FLASH_STATUS_SUCCESS;
+        int block = 0;
+        for(;;)
+        {
+            protocol_packet packet;
+            const protocol_status received = protocol_read_status(port, &packet, 1000);
+            if(PROTOCOL_STATUS_TIMEOUT == received)
+            {
+                return;
+            }
+            if(PROTOCOL_STATUS_OK != received)
+            {
+                nak();
+                continue;
+            }
+
+            // the host acknowledges the status
+            if(0 == packet.stream.capacity)
+            {
+                continue;
+            }
+
+            switch(protocol_packet_command(&packet))
+            {
+            case PROTOCOL_FLASH_PING:
+                ack();
+                break;
+            case PROTOCOL_FLASH_DOWNLOAD:
+            {
+                address = bytestream_extract_u32(&packet.stream);
+                const uint32_t size = bytestream_extract_u32(&packet.stream);
+                status = address + size <= flash.size() ?
+                    PROTOCOL_FLASH_STATUS_SUCCESS : 0x43;
+
+                // like the real bootloader, erase every page the download
+                // touches, including the bytes of those pages outside it
+                const uint32_t page = PROTOCOL_FLASH_PAGE_DEFAULT;
+                const uint32_t end = (address + size + page - 1) / page * page;
+                for(uint32_t i = address / page * page; i < end && i < flash.size(); ++i)
+                {
+                    flash[i] = 0xFF;
+                }
+                ack();
+                break;
+            }
+            case PROTOCOL_FLASH_GET_STATUS:
+                ack();
+                protocol_packet_init(&packet, status);
+                protocol_write_block(port, &packet);
+                break;
+            case PROTOCOL_FLASH_SEND_DATA:
+                if(block++ == nak_block)
+                {
+                    nak();
+                    break;
+                }
+                while(packet.stream.size != packet.stream.capacity)
+                {
+                    flash.at(address++) = bytestream_extract_u8(&packet.stream);
+                }
+                ack();
+                break;
+            case PROTOCOL_FLASH_RESET:
+                ack();
+                reset = true;
+                return;
+            default:
+                nak();
+            }
+        }
+    }
+
+    int nak_block;
+    std::thread thread;
+};
+
+/// an image whose bytes differ from the erased value
+static std::vector<uint8_t> make_image(size_t size)
+{
+    std::vector<uint8_t> image(size);
+    for(size_t i = 0; i != size; ++i)
+    {
+        image[i] = static_cast<uint8_t>(i * 7 + 1);
+    }
+    return image;
+}
+
+/// check that the image was programmed at the address
+static bool programmed(const fake_bootloader & board,
+                       const std::vector<uint8_t> & image,
+                       uint32_t address)
+{
+    for(size_t i = 0; i != image.size(); ++i)
+    {
+        if(board.flash[address + i] != image[i])
+        {
+            return false;
+        }
+    }
+    // the padding is erased flash
+    return 0xFF == board.flash[address + image.size()];
+}
+
+TEST_CASE("protocol_flash", "[protocol_flash]")
+{
+    const std::vector<uint8_t> image = make_image(1001);
+    protocol_flash_options options = PROTOCOL_FLASH_OPTIONS_DEFAULT;
+    options.timeout_ms = 100;
+    protocol_flash_result result;
+
+    SECTION("single")
+    {
+        fake_bootloader board;
+        const uart_port * port = protocol_open_baud(board.name, options.baud);
+        CHECK(protocol_flash(port, image.data(), image.size(), 0x400,
+                             &options, &result));
+        protocol_close(port);
+        board.wait_for_reset();
+        CHECK(programmed(board, image, 0x400));
+        CHECK(result.ok);
+        CHECK(result.bytes == image.size());
+        CHECK(result.retries == 0);
+        CHECK(result.status == PROTOCOL_FLASH_STATUS_SUCCESS);
+    }
+
+    SECTION("pipelined with a NAK")
+    {
+        options.pipeline = 4;
+        options.block_size = 64;
+        fake_bootloader board(2);
+        const uart_port * port = protocol_open_baud(board.name, options.baud);
+        const bool ok = protocol_flash(port, image.data(), image.size(), 0x400,
+                                       &options, &result);
+        protocol_close(port);
+        CHECK(ok);
+        CHECK(result.retries == 1);
+
+        board.wait_for_reset();
+        CHECK(programmed(board, image, 0x400));
+    }
+
+    SECTION("NAK after the first page")
+    {
+        // the download restarts at the page that holds the failed block
+        const std::vector<uint8_t> large = make_image(3001);
+        options.block_size = 64;
+        fake_bootloader board(20);
+        const uart_port * port = protocol_open_baud(board.name, options.baud);
+        const bool ok = protocol_flash(port, large.data(), large.size(), 0x400,
+                                       &options, &result);
+        protocol_close(port);
+        CHECK(ok);
+        CHECK(result.retries == 1);
+
+        board.wait_for_reset();
+        CHECK(programmed(board, large, 0x400));
+    }
+
+    SECTION("invalid address")
+    {
+        fake_bootloader board;
+        const uart_port * port = protocol_open_baud(board.name, options.baud);
+        CHECK(!protocol_flash(port, image.data(), image.size(), 0x1F00,
+                              &options, &result));
+        protocol_close(port);
+        CHECK(result.status == 0x43);
+        CHECK(result.retries == options.retries);
+    }
+}
+
+TEST_CASE("protocol_flash_parallel", "[protocol_flash]")
+{
+    const std::vector<uint8_t> image = make_image(3001);
+    fake_bootloader boards[3];
+    protocol_flash_job jobs[3];
+    for(unsigned int i = 0; i != 3; ++i)
+    {
+        jobs[i].port_name = boards[i].name;
+        jobs[i].options = PROTOCOL_FLASH_OPTIONS_DEFAULT;
+    }
+
+    CHECK(protocol_flash_parallel(jobs, 3, image.data(), image.size(), 0));
+    for(unsigned int i = 0; i != 3; ++i)
+    {
+        CHECK(jobs[i].result.ok);
+        boards[i].wait_for_reset();
+        CHECK(programmed(boards[i], image, 0));
+    }
+}
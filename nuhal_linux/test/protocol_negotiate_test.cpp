@@ -0,0 +1,171 @@
+/// \file
+/// \brief test baud rate negotiation over a pseudo-terminal
+#include "nuhal/protocol.h"
+#include "nuhal/protocol_server.h"
+#include "nuhal/uart.h"
+#include "nuhal/uart_linux.h"
+#include "nuhal/catch.hpp"
+#include <atomic>
+#include <climits>
+#include <thread>
+
+TEST_CASE("protocol_negotiate", "[protocol_negotiate]")
+{
+    char name[PATH_MAX] = "";
+    const uart_port * device = uart_open_pty(name, sizeof(name));
+    const uart_port * host = protocol_open(name);
+    CHECK(protocol_baud(host) == 1000000);
+
+    const uint32_t device_bauds[] = {115200, 1000000, 2000000};
+    protocol_server server;
+    protocol_server_init(&server);
+
+    SECTION("agreed")
+    {
+        protocol_server_negotiation(&server, 1000000, device_bauds,
+                                    ARRAY_LEN(device_bauds),
+                                    PROTOCOL_FEATURE_SEQUENCED);
+
+        // Catch assertions are not thread safe, so they are checked after joining
+        bool handled = false;
+        std::thread responder([&]() {
+            (void)uart_wait_for_data(device, 1000);
+            handled = protocol_server_poll(&server, device);
+        });
+
+        const uint32_t host_bauds[] = {1000000, 2000000, 3000000};
+        uint32_t features = PROTOCOL_FEATURE_SEQUENCED | 0x80;
+        CHECK(protocol_negotiate(host, host_bauds, ARRAY_LEN(host_bauds), &features)
+              == 2000000);
+        responder.join();
+        CHECK(handled);
+        CHECK(features == PROTOCOL_FEATURE_SEQUENCED);
+        CHECK(protocol_baud(host) == 2000000);
+        CHECK(server.baud == 2000000);
+    }
+
+    SECTION("unsupported")
+    {
+        // a device without negotiation replies with an error
+        std::thread responder([&]() {
+            (void)uart_wait_for_data(device, 1000);
+            (void)protocol_server_poll(&server, device);
+        });
+
+        const uint32_t host_bauds[] = {2000000};
+        uint32_t features = PROTOCOL_FEATURE_SEQUENCED;
+        CHECK(protocol_negotiate(host, host_bauds, ARRAY_LEN(host_bauds), &features)
+              == 1000000);
+        responder.join();
+        CHECK(features == 0);
+        CHECK(protocol_baud(host) == 1000000);
+    }
+
+    SECTION("not confirmed")
+    {
+        // the device selects a new rate but never hears the confirmation
+        std::thread responder([&]() {
+            protocol_packet packet;
+            if(PROTOCOL_STATUS_OK == protocol_read_status(device, &packet, 1000))
+            {
+                protocol_packet_init(&packet, PROTOCOL_NEGOTIATE);
+                bytestream_inject_u32(&packet.stream, 0);
+                bytestream_inject_u32(&packet.stream, 2000000);
+                protocol_write_block(device, &packet);
+            }
+        });
+
+        const uint32_t host_bauds[] = {2000000};
+        CHECK(protocol_negotiate(host, host_bauds, ARRAY_LEN(host_bauds), nullptr)
+              == 1000000);
+        responder.join();
+        CHECK(protocol_baud(host) == 1000000);
+    }
+
+    SECTION("confirmation reply lost")
+    {
+        // the device switches when it hears the confirmation, but its reply
+        // is lost, so it answers the next confirmation at the new rate
+        bool handled = false;
+        std::thread responder([&]() {
+            protocol_packet packet;
+            if(PROTOCOL_STATUS_OK == protocol_read_status(device, &packet, 1000))
+            {
+                protocol_packet_init(&packet, PROTOCOL_NEGOTIATE);
+                bytestream_inject_u32(&packet.stream, 0);
+                bytestream_inject_u32(&packet.stream, 2000000);
+                protocol_write_block(device, &packet);
+            }
+            (void)protocol_read_status(device, &packet, 1000);
+            protocol_server_negotiation(&server, 2000000, device_bauds,
+                                        ARRAY_LEN(device_bauds), 0);
+            (void)uart_wait_for_data(device, 1000);
+            handled = protocol_server_poll(&server, device);
+        });
+
+        const uint32_t host_bauds[] = {2000000};
+        CHECK(protocol_negotiate(host, host_bauds, ARRAY_LEN(host_bauds), nullptr)
+              == 2000000);
+        responder.join();
+        CHECK(handled);
+        CHECK(protocol_baud(host) == 2000000);
+    }
+
+    SECTION("confirmation lost")
+    {
+        // a relay between the host and the device drops the first
+        // confirmation, so the device must still be waiting for the second
+        char server_name[PATH_MAX] = "";
+        const uart_port * server_port = uart_open_pty(server_name, sizeof(server_name));
+        const uart_port * relay = uart_open(server_name, 1000000,
+                                            UART_FLOW_NONE, UART_PARITY_NONE);
+        protocol_server_negotiation(&server, 1000000, device_bauds,
+                                    ARRAY_LEN(device_bauds), 0);
+
+        // forward packets, dropping the one with index drop (from 1)
+        std::atomic<bool> done{false};
+        auto forward = [&done](const uart_port * from, const uart_port * to,
+                               unsigned int drop) {
+            unsigned int count = 0;
+            while(!done)
+            {
+                protocol_packet packet;
+                if(uart_wait_for_data(from, 10)
+                   && PROTOCOL_STATUS_OK == protocol_read_status(from, &packet, 100)
+                   && ++count != drop)
+                {
+                    // the length and checksum precede the data
+                    uart_write_block(to, packet._data, 2 + packet.stream.capacity, 100);
+                }
+            }
+        };
+
+        // the request is the first packet from the host, the first
+        // confirmation is the second
+        std::thread to_device(forward, device, relay, 2u);
+        std::thread to_host(forward, relay, device, 0u);
+
+        bool handled = false;
+        std::thread responder([&]() {
+            (void)uart_wait_for_data(server_port, 1000);
+            handled = protocol_server_poll(&server, server_port);
+        });
+
+        const uint32_t host_bauds[] = {2000000};
+        CHECK(protocol_negotiate(host, host_bauds, ARRAY_LEN(host_bauds), nullptr)
+              == 2000000);
+        responder.join();
+        done = true;
+        to_device.join();
+        to_host.join();
+        CHECK(handled);
+        CHECK(protocol_baud(host) == 2000000);
+        CHECK(server.baud == 2000000);
+
+        uart_close(relay);
+        uart_close(server_port);
+    }
+
+    protocol_close(host);
+    uart_close(device);
+}
@@ -0,0 +1,138 @@
+/// \file
+/// \brief test retrying requests over a pseudo-terminal
+#include "nuhal/protocol.h"
+#include "nuhal/protocol_server.h"
+#include "nuhal/uart.h"
+#include "nuhal/uart_linux.h"
+#include "nuhal/catch.hpp"
+#include <chrono>
+#include <climits>
+#include <thread>
+
+/// add two numbers and reply with the sum. Counts the number of calls
+static bool add_handler(protocol_packet * packet, void * context)
+{
+    const uint32_t a = bytestream_extract_u32(&packet->stream);
+    const uint32_t b = bytestream_extract_u32(&packet->stream);
+    ++*static_cast<int *>(context);
+    protocol_packet_reply_init(packet);
+    bytestream_inject_u32(&packet->stream, a + b);
+    return true;
+}
+
+TEST_CASE("protocol_retry_lost_response", "[protocol_retry]")
+{
+    char name[PATH_MAX] = "";
+    const uart_port * device = uart_open_pty(name, sizeof(name));
+    const uart_port * host = protocol_open(name);
+
+    int calls = 0;
+    protocol_server server;
+    protocol_server_init(&server);
+    protocol_server_register(&server, 0x10, add_handler, &calls);
+
+    // the device handles two requests, but the first response is lost.
+    // Catch assertions are not thread safe, so they are checked after joining
+    bool received = true;
+    std::thread responder([&]() {
+        for(int i = 0; i != 2; ++i)
+        {
+            protocol_packet packet;
+            received &= PROTOCOL_STATUS_OK == protocol_read_status(device, &packet, 0);
+            protocol_server_handle(&server, &packet);
+            if(i != 0)
+            {
+                protocol_write_block(device, &packet);
+            }
+        }
+    });
+
+    const protocol_retry_policy policy = {2, 1, 4, 1, true};
+    protocol_set_retry_policy(&policy);
+
+    protocol_packet request;
+    protocol_packet_init(&request, 0x10);
+    bytestream_inject_u32(&request.stream, 40);
+    bytestream_inject_u32(&request.stream, 2);
+
+    protocol_packet response;
+    CHECK(protocol_request_status(host, &request, &response, 20) == PROTOCOL_STATUS_OK);
+    responder.join();
+    protocol_set_retry_policy(nullptr);
+    CHECK(received);
+
+    // the retry was answered from the server's copy of the response
+    CHECK(calls == 1);
+    CHECK(protocol_packet_command(&response) == 0x10);
+    CHECK(bytestream_extract_u32(&response.stream) == 42);
+
+    // the request is restored after it is sent
+    CHECK(protocol_packet_command(&request) == 0x10);
+
+    protocol_close(host);
+    uart_close(device);
+}
+
+TEST_CASE("protocol_retry_timeout", "[protocol_retry]")
+{
+    char name[PATH_MAX] = "";
+    const uart_port * device = uart_open_pty(name, sizeof(name));
+    const uart_port * host = protocol_open(name);
+
+    const protocol_retry_policy policy = {1, 1, 1, 1, false};
+    protocol_set_retry_policy(&policy);
+
+    // nothing responds, so the request fails without an error
+    protocol_packet request;
+    protocol_packet_init(&request, 0x10);
+    CHECK(protocol_request_status(host, &request, nullptr, 10) == PROTOCOL_STATUS_TIMEOUT);
+    CHECK(!protocol_request_timeout(host, &request, nullptr, 10, false));
+
+    // backoff_max_ms also limits the first delay
+    const protocol_retry_policy capped = {1, 1000, 0, 1, false};
+    protocol_set_retry_policy(&capped);
+    const auto start = std::chrono::steady_clock::now();
+    CHECK(protocol_request_status(host, &request, nullptr, 10) == PROTOCOL_STATUS_TIMEOUT);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+    protocol_set_retry_policy(nullptr);
+
+    protocol_close(host);
+    uart_close(device);
+}
+
+TEST_CASE("protocol_adaptive_timeout", "[protocol_retry]")
+{
+    char name[PATH_MAX] = "";
+    const uart_port * device = uart_open_pty(name, sizeof(name));
+    const uart_port * host = protocol_open(name);
+    protocol_set_timeout_limits(host, 2000, 20000);
+
+    // the device echoes each request
+    std::thread responder([&]() {
+        protocol_packet packet;
+        if(PROTOCOL_STATUS_OK == protocol_read_status(device, &packet, 0))
+        {
+            protocol_packet_reply_init(&packet);
+            protocol_write_block(device, &packet);
+        }
+    });
+
+    protocol_packet request;
+    protocol_packet_init(&request, 0x10);
+    CHECK(protocol_request_status(host, &request, nullptr, 1000) == PROTOCOL_STATUS_OK);
+    responder.join();
+
+    const protocol_rtt rtt = protocol_port_rtt(host);
+    CHECK(rtt.valid);
+    CHECK(rtt.srtt_us < 20000);
+
+    // with nothing responding, the timeout is at most the ceiling,
+    // not the much larger timeout argument
+    const auto start = std::chrono::steady_clock::now();
+    CHECK(protocol_request_status(host, &request, nullptr, 1000) == PROTOCOL_STATUS_TIMEOUT);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200));
+
+    protocol_set_timeout_limits(host, 0, 0);
+    protocol_close(host);
+    uart_close(device);
+}
@@ -0,0 +1,156 @@
+/// \file
+/// \brief test the simulated device against the host side of the protocol
+#include "nuhal/protocol_sim.h"
+#include "nuhal/protocol_server.h"
+#include "nuhal/uart.h"
+#include "nuhal/uart_linux.h"
+#include "nuhal/catch.hpp"
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <thread>
+
+/// reply with the increment of the request
+static bool increment_handler(protocol_packet * packet, void *)
+{
+    const uint32_t value = bytestream_extract_u32(&packet->stream);
+    protocol_packet_reply_init(packet);
+    bytestream_inject_u32(&packet->stream, value + 1);
+    return true;
+}
+
+/// run a simulator in another thread while in scope
+class sim_thread
+{
+public:
+    explicit sim_thread(protocol_sim * sim)
+        : done(false), thread([this, sim]() {
+            while(!done)
+            {
+                (void)protocol_sim_poll(sim, 10);
+            }
+        })
+    {
+    }
+
+    ~sim_thread()
+    {
+        done = true;
+        thread.join();
+    }
+
+private:
+    std::atomic<bool> done;
+    std::thread thread;
+};
+
+TEST_CASE("protocol_sim", "[protocol_sim]")
+{
+    char name[PATH_MAX] = "";
+    const uart_port * device = uart_open_pty(name, sizeof(name));
+    const uart_port * host = protocol_open(name);
+
+    protocol_server server;
+    protocol_server_init(&server);
+    protocol_server_register(&server, 0x10, increment_handler, nullptr);
+
+    protocol_sim sim;
+    protocol_sim_init(&sim, device, &server, 42);
+
+    protocol_packet request;
+    protocol_packet response;
+
+    SECTION("requests")
+    {
+        protocol_sim_set_delay(&sim, 0x10, 5000);
+        sim_thread running(&sim);
+        for(uint32_t i = 0; i != 3; ++i)
+        {
+            protocol_packet_init(&request, 0x10);
+            bytestream_inject_u32(&request.stream, i);
+            const auto start = std::chrono::steady_clock::now();
+            CHECK(protocol_request_status(host, &request, &response, 100)
+                  == PROTOCOL_STATUS_OK);
+            CHECK(std::chrono::steady_clock::now() - start
+                  >= std::chrono::microseconds(5000));
+            CHECK(bytestream_extract_u32(&response.stream) == i + 1);
+        }
+
+        // unknown commands get an error response
+        protocol_packet_init(&request, 0x11);
+        CHECK(protocol_request_status(host, &request, nullptr, 100)
+              == PROTOCOL_STATUS_ERROR_RESPONSE);
+    }
+
+    SECTION("faults")
+    {
+        protocol_packet_init(&request, 0x10);
+        bytestream_inject_u32(&request.stream, 1);
+        {
+            protocol_sim_set_faults(&sim, PROTOCOL_SIM_PPM, 0);
+            sim_thread running(&sim);
+            CHECK(protocol_request_status(host, &request, nullptr, 20)
+                  == PROTOCOL_STATUS_TIMEOUT);
+        }
+        {
+            protocol_sim_set_faults(&sim, 0, PROTOCOL_SIM_PPM);
+            sim_thread running(&sim);
+            CHECK(protocol_request_status(host, &request, nullptr, 20)
+                  == PROTOCOL_STATUS_CHECKSUM);
+        }
+    }
+
+    // the simulator has stopped, so the counters are no longer changing
+    const protocol_sim_counters & counters = sim.counters;
+    CHECK(counters.requests == counters.responses + counters.dropped);
+    CHECK(counters.bytes_rx > 0);
+    CHECK(counters.bad_requests == 0);
+
+    protocol_close(host);
+    uart_close(device);
+}
+
+TEST_CASE("protocol_sim_routing", "[protocol_sim]")
+{
+    char name[PATH_MAX] = "";
+    const uart_port * device = uart_open_pty(name, sizeof(name));
+    const uart_port * host = protocol_open(name);
+
+    protocol_server server;
+    protocol_server_init(&server);
+    protocol_server_register(&server, 0x10, increment_handler, nullptr);
+    protocol_server_address(&server, 4);
+
+    protocol_sim sim;
+    protocol_sim_init(&sim, device, &server, 42);
+    protocol_sim_set_delay(&sim, 0x10, 5000);
+
+    protocol_packet request;
+    protocol_packet response;
+    {
+        sim_thread running(&sim);
+
+        // the delay is that of the wrapped command
+        protocol_packet_init(&request, 0x10);
+        bytestream_inject_u32(&request.stream, 7);
+        protocol_packet_address(&request, 4);
+        protocol_packet_sequence(&request, 1);
+        const auto start = std::chrono::steady_clock::now();
+        CHECK(protocol_request_status(host, &request, &response, 100)
+              == PROTOCOL_STATUS_OK);
+        CHECK(std::chrono::steady_clock::now() - start
+              >= std::chrono::microseconds(5000));
+
+        // requests for other devices are ignored, as by a real device
+        protocol_packet_init(&request, 0x10);
+        bytestream_inject_u32(&request.stream, 7);
+        protocol_packet_address(&request, 5);
+        CHECK(protocol_request_status(host, &request, nullptr, 20)
+              == PROTOCOL_STATUS_TIMEOUT);
+    }
+    CHECK(sim.counters.requests == 2);
+    CHECK(sim.counters.responses == 1);
+
+    protocol_close(host);
+    uart_close(device);
+}
@@ -0,0 +1,153 @@
+/// \file
+/// \brief test forwarding data between pseudo-terminals with a bridge
+#include "nuhal/uart_bridge.h"
+#include "nuhal/protocol.h"
+#include "nuhal/uart.h"
+#include "nuhal/uart_linux.h"
+#include "nuhal/time.h"
+#include "nuhal/catch.hpp"
+#include <atomic>
+#include <climits>
+#include <thread>
+
+/// run a bridge in another thread while in scope
+class bridge_thread
+{
+public:
+    explicit bridge_thread(uart_bridge * bridge)
+        : done(false), thread([this, bridge]() {
+            while(!done)
+            {
+                (void)uart_bridge_poll(bridge, 10);
+            }
+        })
+    {
+    }
+
+    ~bridge_thread()
+    {
+        done = true;
+        thread.join();
+    }
+
+private:
+    std::atomic<bool> done;
+    std::thread thread;
+};
+
+TEST_CASE("uart_bridge", "[uart_bridge]")
+{
+    // the bridge connects the devices of two pseudo-terminals,
+    // so a host on one terminal talks to a host on the other
+    char name_a[PATH_MAX] = "";
+    char name_b[PATH_MAX] = "";
+    const uart_port * device_a = uart_open_pty(name_a, sizeof(name_a));
+    const uart_port * device_b = uart_open_pty(name_b, sizeof(name_b));
+    const uart_port * host_a = protocol_open(name_a);
+    const uart_port * host_b = protocol_open(name_b);
+
+    protocol_packet packet;
+    uart_bridge bridge;
+
+    SECTION("raw")
+    {
+        uart_bridge_init(&bridge, device_a, device_b, UART_BRIDGE_RAW);
+        bool forwarded = false;
+        bool returned = false;
+        {
+            bridge_thread running(&bridge);
+            protocol_packet_init(&packet, 0x10);
+            bytestream_inject_u32(&packet.stream, 0xDEADBEEF);
+            protocol_write_block(host_a, &packet);
+            forwarded = PROTOCOL_STATUS_OK == protocol_read_status(host_b, &packet, 1000)
+                && 0x10 == protocol_packet_command(&packet)
+                && 0xDEADBEEF == bytestream_extract_u32(&packet.stream);
+
+            protocol_packet_init(&packet, 0x20);
+            protocol_write_block(host_b, &packet);
+            returned = PROTOCOL_STATUS_OK == protocol_read_status(host_a, &packet, 1000)
+                && 0x20 == protocol_packet_command(&packet);
+        }
+        CHECK(forwarded);
+        CHECK(returned);
+
+        // each packet is its length, checksum, command, and data
+        CHECK(uart_bridge_counters(&bridge, true).bytes == 7);
+        CHECK(uart_bridge_counters(&bridge, false).bytes == 3);
+    }
+
+    SECTION("frame")
+    {
+        uart_bridge_init(&bridge, device_a, device_b, UART_BRIDGE_FRAME);
+        uart_bridge_filter(&bridge, true, 0x11, false);
+        bool skipped = false;
+        bool returned = false;
+        {
+            bridge_thread running(&bridge);
+
+            // garbage before a packet is discarded
+            const uint8_t noise[] = {0x05, 0x01};
+            uart_write_block(host_a, noise, sizeof(noise), 100);
+
+            protocol_packet_init(&packet, 0x11);
+            bytestream_inject_u8(&packet.stream, 1);
+            protocol_write_block(host_a, &packet);
+            protocol_packet_init(&packet, 0x12);
+            bytestream_inject_u8(&packet.stream, 2);
+            protocol_write_block(host_a, &packet);
+
+            // the filter only applies from a to b
+            skipped = PROTOCOL_STATUS_OK == protocol_read_status(host_b, &packet, 1000)
+                && 0x12 == protocol_packet_command(&packet)
+                && 2 == bytestream_extract_u8(&packet.stream);
+
+            protocol_packet_init(&packet, 0x11);
+            protocol_write_block(host_b, &packet);
+            returned = PROTOCOL_STATUS_OK == protocol_read_status(host_a, &packet, 1000)
+                && 0x11 == protocol_packet_command(&packet);
+        }
+        CHECK(skipped);
+        CHECK(returned);
+
+        const struct uart_bridge_counters ab = uart_bridge_counters(&bridge, true);
+        CHECK(ab.packets == 1);
+        CHECK(ab.filtered == 1);
+        CHECK(ab.discarded == 2);
+        CHECK(ab.bytes == 4);
+        CHECK(uart_bridge_counters(&bridge, false).packets == 1);
+    }
+
+    uart_bridge_close(&bridge);
+    protocol_close(host_b);
+    protocol_close(host_a);
+    uart_close(device_b);
+    uart_close(device_a);
+}
+
+TEST_CASE("uart_bridge_hang_up", "[uart_bridge]")
+{
+    // the bridge connects a pseudo-terminal to the slave side of another,
+    // which hangs up when the master side closes
+    char name_a[PATH_MAX] = "";
+    char name_b[PATH_MAX] = "";
+    const uart_port * device_a = uart_open_pty(name_a, sizeof(name_a));
+    const uart_port * device_b = uart_open_pty(name_b, sizeof(name_b));
+    const uart_port * host_b = uart_open(name_b, 115200, UART_FLOW_NONE, UART_PARITY_NONE);
+
+    uart_bridge bridge;
+    uart_bridge_init(&bridge, device_a, host_b, UART_BRIDGE_RAW);
+    CHECK_FALSE(bridge.closed);
+
+    uart_close(device_b);
+    CHECK_FALSE(uart_bridge_poll(&bridge, 1000));
+    CHECK(bridge.closed);
+
+    // a closed bridge returns at once rather than waiting for the timeout
+    struct time_elapsed_ms elapsed = time_elapsed_ms_init();
+    CHECK_FALSE(uart_bridge_poll(&bridge, 1000));
+    CHECK(time_elapsed_ms(&elapsed) < 500);
+
+    uart_bridge_close(&bridge);
+    uart_close(host_b);
+    uart_close(device_a);
+}
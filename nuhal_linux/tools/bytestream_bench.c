@@ -0,0 +1,110 @@
+/// @file
+/// @brief Compare the speed of serializing arrays element by element with
+/// the bytestream array functions.
+///
+/// usage: bytestream_bench [-n floats] [-r repetitions]
+///   -n        floats per array, default 36 (a 6x6 matrix). At most 63,
+///             the number that fits in a protocol packet
+///   -r        number of times each array is serialized, default 1000000
+#define _DEFAULT_SOURCE // for getopt
+#include "nuhal/bytestream.h"
+#include "nuhal/error.h"
+#include "nuhal/protocol.h"
+#include "nuhal/time_linux.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/// @brief the most floats that fit in the data of a packet
+#define MAX_FLOATS (PROTOCOL_DATA_MAX_LENGTH / sizeof(float))
+
+/// @brief print the usage and exit
+static void usage(const char * name)
+{
+    fprintf(stderr, "usage: %s [-n floats] [-r repetitions]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+/// @brief get the current time in s from the monotonic clock
+static double now_s(void)
+{
+    return (double)time_monotonic_ns() / 1e9;
+}
+
+/// @brief print the time per float of a method
+static void report(const char * method, double seconds, unsigned long total)
+{
+    printf("%-20s %8.3f s  %6.2f ns/float\n", method, seconds, seconds * 1e9 / (double)total);
+}
+
+int main(int argc, char * argv[])
+{
+    unsigned long count = 36;
+    unsigned long repetitions = 1000000;
+
+    int opt = 0;
+    while(-1 != (opt = getopt(argc, argv, "n:r:")))
+    {
+        switch(opt)
+        {
+        case 'n':
+            count = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            repetitions = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if(optind != argc || 0 == count || count > MAX_FLOATS || 0 == repetitions)
+    {
+        usage(argv[0]);
+    }
+
+    float in[MAX_FLOATS];
+    float out[MAX_FLOATS];
+    for(unsigned long i = 0; i != count; ++i)
+    {
+        in[i] = (float)i * 0.5f;
+    }
+
+    uint8_t buffer[PROTOCOL_DATA_MAX_LENGTH];
+    struct bytestream bs;
+    const unsigned long total = count * repetitions;
+
+    // the checksum keeps the compiler from discarding the work
+    float checksum = 0.0f;
+
+    double start = now_s();
+    for(unsigned long r = 0; r != repetitions; ++r)
+    {
+        bytestream_init(&bs, buffer, sizeof(buffer));
+        for(unsigned long i = 0; i != count; ++i)
+        {
+            bytestream_inject_f(&bs, in[i]);
+        }
+        bytestream_init(&bs, buffer, sizeof(buffer));
+        for(unsigned long i = 0; i != count; ++i)
+        {
+            out[i] = bytestream_extract_f(&bs);
+        }
+        checksum += out[r % count];
+    }
+    report("element by element", now_s() - start, total);
+
+    start = now_s();
+    for(unsigned long r = 0; r != repetitions; ++r)
+    {
+        bytestream_init(&bs, buffer, sizeof(buffer));
+        bytestream_inject_f_array(&bs, in, count);
+        bytestream_init(&bs, buffer, sizeof(buffer));
+        bytestream_extract_f_array(&bs, out, count);
+        checksum += out[r % count];
+    }
+    report("array", now_s() - start, total);
+
+    printf("checksum %g\n", (double)checksum);
+    return 0;
+}
@@ -0,0 +1,177 @@
+/// @file
+/// @brief Program boards through the TI serial bootloader
+/// (@see protocol_flash.h). Every port is flashed at the same time.
+///
+/// usage: protocol_flash [-a address] [-b baud] [-s block] [-e page]
+///                       [-p depth] [-t ms] [-r retries] [-n] [-N]
+///                       image.bin port...
+///   -a        address at which to program the image, default 0
+///   -b        baud rate, default 115200
+///   -s        bytes per block, a multiple of 4 up to 252 (the default)
+///   -e        bytes per flash page, a power of 2, default 1024. A failed
+///             download restarts at a page boundary. 0 restarts from the
+///             start of the image
+///   -p        blocks sent before waiting for an acknowledgement, default 1.
+///             Only use more with bootloaders that buffer whole packets
+///   -t        time to wait for each acknowledgement in ms, default 1000
+///   -r        times to restart a failed download, default 3
+///   -n        do not reset the boards after programming them
+///   -N        do not send the autobaud synchronization bytes
+#define _DEFAULT_SOURCE // for getopt
+#include "nuhal/protocol_flash.h"
+#include "nuhal/error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/// @brief print the usage and exit
+static void usage(const char * name)
+{
+    fprintf(stderr,
+            "usage: %s [-a address] [-b baud] [-s block] [-e page] [-p depth] [-t ms]"
+            " [-r retries] [-n] [-N] image.bin port...\n",
+            name);
+    exit(EXIT_FAILURE);
+}
+
+/// @brief read a whole file into memory
+/// @param filename - the file
+/// @param size [out] - the size of the file
+/// @return the contents of the file, to be freed by the caller
+static uint8_t * read_image(const char * filename, size_t * size)
+{
+    FILE * file = fopen(filename, "rb");
+    if(!file)
+    {
+        error_with_errno(FILE_LINE);
+    }
+
+    size_t capacity = 4096;
+    *size = 0;
+    uint8_t * image = malloc(capacity);
+    while(image)
+    {
+        *size += fread(image + *size, 1, capacity - *size, file);
+        if(*size != capacity)
+        {
+            break;
+        }
+        capacity *= 2;
+        uint8_t * bigger = realloc(image, capacity);
+        if(!bigger)
+        {
+            free(image);
+        }
+        image = bigger;
+    }
+
+    if(!image)
+    {
+        error(FILE_LINE, "out of memory");
+    }
+
+    if(ferror(file))
+    {
+        error(FILE_LINE, "failed to read the image");
+    }
+    fclose(file);
+    return image;
+}
+
+int main(int argc, char * argv[])
+{
+    const struct protocol_flash_options defaults = PROTOCOL_FLASH_OPTIONS_DEFAULT;
+    struct protocol_flash_options options = defaults;
+    uint32_t address = 0;
+
+    int opt = 0;
+    while(-1 != (opt = getopt(argc, argv, "a:b:s:e:p:t:r:nN")))
+    {
+        switch(opt)
+        {
+        case 'a':
+            address = strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            options.baud = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            options.block_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'e':
+            options.page_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            options.pipeline = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            options.timeout_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            options.retries = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            options.reset = false;
+            break;
+        case 'N':
+            options.autobaud = false;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if(optind + 2 > argc
+       || 0 == options.block_size
+       || 0 != options.block_size % 4
+       || options.block_size > PROTOCOL_FLASH_BLOCK_MAX
+       || (0 != options.page_size
+           && (options.page_size < 4 || 0 != (options.page_size & (options.page_size - 1u))))
+       || 0 == options.pipeline)
+    {
+        usage(argv[0]);
+    }
+
+    size_t size = 0;
+    uint8_t * image = read_image(argv[optind], &size);
+
+    const unsigned int count = argc - optind - 1;
+    struct protocol_flash_job * jobs = calloc(count, sizeof(*jobs));
+    if(!jobs)
+    {
+        error(FILE_LINE, "out of memory");
+    }
+
+    for(unsigned int i = 0; i != count; ++i)
+    {
+        jobs[i].port_name = argv[optind + 1 + i];
+        jobs[i].options = options;
+    }
+
+    const bool ok = protocol_flash_parallel(jobs, count, image, size, address);
+
+    size_t total = 0;
+    double seconds = 0;
+    for(unsigned int i = 0; i != count; ++i)
+    {
+        protocol_flash_report(jobs[i].port_name, &jobs[i].result, stdout);
+        if(jobs[i].result.ok)
+        {
+            total += jobs[i].result.bytes;
+        }
+        if(jobs[i].result.seconds > seconds)
+        {
+            seconds = jobs[i].result.seconds;
+        }
+    }
+
+    if(count > 1 && seconds > 0)
+    {
+        printf("total: %zu bytes in %.3f s (%.1f bytes/s)\n",
+               total, seconds, (double)total / seconds);
+    }
+
+    free(jobs);
+    free(image);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
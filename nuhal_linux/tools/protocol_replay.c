@@ -0,0 +1,157 @@
+/// @file
+/// @brief Replay a protocol capture (@see protocol_capture.h) over a
+/// pseudo-terminal, so that a program can be run against recorded traffic.
+///
+/// usage: protocol_replay [-f] [-d rx|tx|all] [-p port] [-w ms] capture_file
+///   -f        replay as fast as possible instead of with the recorded timing
+///   -d        which packets to replay: those the capturing program received
+///             (rx, the default, so the program under test sees what the
+///             device sent), those it sent (tx), or all
+///   -p        only replay packets from the given port id
+///   -w        time in ms to wait before starting, default 1000
+///
+/// The name of the pseudo-terminal is printed on the first line of output.
+/// Open it with protocol_open() in the program under test. Anything the
+/// program writes to the pseudo-terminal is discarded.
+#define _DEFAULT_SOURCE // for getopt
+#include "nuhal/protocol_capture.h"
+#include "nuhal/protocol.h"
+#include "nuhal/uart.h"
+#include "nuhal/uart_linux.h"
+#include "nuhal/time_linux.h"
+#include "nuhal/error.h"
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/// @brief timeout for writing a single packet to the pseudo-terminal, in ms
+#define WRITE_TIMEOUT_MS 1000u
+
+/// @brief print the usage and exit
+static void usage(const char * name)
+{
+    fprintf(stderr,
+            "usage: %s [-f] [-d rx|tx|all] [-p port] [-w ms] capture_file\n",
+            name);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char * argv[])
+{
+    bool fast = false;
+    bool replay_rx = true;
+    bool replay_tx = false;
+    long port_filter = -1;
+    unsigned long wait_ms = 1000;
+
+    int opt = 0;
+    while(-1 != (opt = getopt(argc, argv, "fd:p:w:")))
+    {
+        switch(opt)
+        {
+        case 'f':
+            fast = true;
+            break;
+        case 'd':
+            replay_rx = 0 == strcmp(optarg, "rx") || 0 == strcmp(optarg, "all");
+            replay_tx = 0 == strcmp(optarg, "tx") || 0 == strcmp(optarg, "all");
+            if(!replay_rx && !replay_tx)
+            {
+                usage(argv[0]);
+            }
+            break;
+        case 'p':
+            port_filter = strtol(optarg, NULL, 0);
+            break;
+        case 'w':
+            wait_ms = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if(optind + 1 != argc)
+    {
+        usage(argv[0]);
+    }
+
+    struct protocol_capture capture;
+    protocol_capture_open(&capture, argv[optind]);
+
+    char name[PATH_MAX] = "";
+    const struct uart_port * port = uart_open_pty(name, sizeof(name));
+    printf("%s\n", name);
+    fflush(stdout);
+
+    time_sleep_until_ns(time_monotonic_ns() + (uint64_t)wait_ms * 1000000ull);
+
+    unsigned long packets = 0;
+    unsigned long bytes = 0;
+    uint64_t max_lag_ns = 0;
+    uint64_t first_timestamp = 0;
+    const uint64_t start = time_monotonic_ns();
+
+    struct protocol_capture_record record;
+    const uint8_t * data = NULL;
+    while(protocol_capture_next(&capture, &record, &data))
+    {
+        const bool direction_match =
+            (replay_rx && PROTOCOL_DIRECTION_RX == record.direction)
+            || (replay_tx && PROTOCOL_DIRECTION_TX == record.direction);
+        if(!direction_match || (port_filter >= 0 && record.port != port_filter))
+        {
+            continue;
+        }
+
+        if(0 == packets)
+        {
+            first_timestamp = record.timestamp_ns;
+        }
+
+        if(!fast)
+        {
+            const uint64_t due = start + (record.timestamp_ns - first_timestamp);
+            const uint64_t now = time_monotonic_ns();
+            if(now < due)
+            {
+                time_sleep_until_ns(due);
+            }
+            else if(now - due > max_lag_ns)
+            {
+                max_lag_ns = now - due;
+            }
+        }
+
+        uart_write_block(port, data, record.length, WRITE_TIMEOUT_MS);
+        ++packets;
+        bytes += record.length;
+
+        // discard whatever the program under test sends
+        uint8_t discard[PROTOCOL_PACKET_MAX_LENGTH];
+        while(uart_read_nonblock(port, discard, sizeof(discard)) > 0)
+        {
+            ;
+        }
+    }
+
+    const double seconds = (double)(time_monotonic_ns() - start) / 1e9;
+    printf("replayed %lu packets, %lu bytes in %.6f s", packets, bytes, seconds);
+    if(seconds > 0)
+    {
+        printf(" (%.1f packets/s, %.1f bytes/s)",
+               (double)packets / seconds, (double)bytes / seconds);
+    }
+    printf("\n");
+    if(!fast)
+    {
+        printf("maximum lag behind the recorded timing: %" PRIu64 " us\n",
+               max_lag_ns / 1000u);
+    }
+
+    protocol_capture_close(&capture);
+    return 0;
+}
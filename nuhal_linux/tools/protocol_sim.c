@@ -0,0 +1,205 @@
+/// @file
+/// @brief Simulate a device over a pseudo-terminal (@see protocol_sim.h),
+/// so that host programs can be tested and benchmarked without hardware.
+///
+/// usage: protocol_sim [-d us] [-j us] [-l ppm] [-c ppm] [-s seed]
+///                     [-i s] [-n requests] [-e cmd]... [-r cmd:len]...
+///   -d        processing delay of every command, in us, default 0
+///   -j        random jitter added to each delay, up to this many us
+///   -l        requests lost (never answered) per million
+///   -c        responses corrupted (invalid checksum) per million
+///   -s        seed for choosing faults, default 1
+///   -i        seconds between throughput reports, default 1. 0 disables
+///   -n        exit after this many requests, default 0 (run until killed)
+///   -e        answer the command by echoing the request data
+///   -r        answer the command with len bytes of data
+///
+/// Without -e or -r, every command is echoed. Commands that are not
+/// answered get an error response.
+///
+/// The name of the pseudo-terminal is printed on the first line of output.
+/// Open it with protocol_open() in the program under test.
+#define _DEFAULT_SOURCE // for getopt
+#include "nuhal/protocol_sim.h"
+#include "nuhal/protocol_server.h"
+#include "nuhal/uart.h"
+#include "nuhal/uart_linux.h"
+#include "nuhal/time.h"
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/// @brief how often to check for a stop request while idle, in ms
+#define POLL_TIMEOUT_MS 100u
+
+/// @brief set when the program is interrupted
+static volatile sig_atomic_t stop = 0;
+
+/// @brief stop at the next opportunity
+static void on_signal(int signal)
+{
+    (void)signal;
+    stop = 1;
+}
+
+/// @brief print the usage and exit
+static void usage(const char * name)
+{
+    fprintf(stderr,
+            "usage: %s [-d us] [-j us] [-l ppm] [-c ppm] [-s seed] [-i s]"
+            " [-n requests] [-e cmd]... [-r cmd:len]...\n",
+            name);
+    exit(EXIT_FAILURE);
+}
+
+/// @brief reply with the request data
+static bool echo_handler(struct protocol_packet * packet, void * context)
+{
+    (void)context;
+    uint8_t data[PROTOCOL_DATA_MAX_LENGTH];
+    const size_t len = packet->stream.capacity - packet->stream.size;
+    for(size_t i = 0; i != len; ++i)
+    {
+        data[i] = bytestream_extract_u8(&packet->stream);
+    }
+    protocol_packet_reply_init(packet);
+    bytestream_inject_u8_array(&packet->stream, data, len);
+    return true;
+}
+
+/// @brief reply with a fixed amount of data
+/// @param context - the number of bytes, cast to a pointer
+static bool fixed_handler(struct protocol_packet * packet, void * context)
+{
+    const size_t len = (size_t)context;
+    protocol_packet_reply_init(packet);
+    for(size_t i = 0; i != len; ++i)
+    {
+        bytestream_inject_u8(&packet->stream, (uint8_t)i);
+    }
+    return true;
+}
+
+/// @brief parse a command byte argument
+static uint8_t parse_command(const char * arg, char ** end, const char * name)
+{
+    const unsigned long command = strtoul(arg, end, 0);
+    if(*end == arg || command >= PROTOCOL_ERROR)
+    {
+        usage(name);
+    }
+    return command;
+}
+
+int main(int argc, char * argv[])
+{
+    struct protocol_server server;
+    protocol_server_init(&server);
+
+    uint32_t delay_us = 0;
+    uint32_t jitter_us = 0;
+    uint32_t drop_ppm = 0;
+    uint32_t corrupt_ppm = 0;
+    uint32_t seed = 1;
+    unsigned long interval_s = 1;
+    unsigned long max_requests = 0;
+    bool configured = false;
+
+    int opt = 0;
+    char * end = NULL;
+    while(-1 != (opt = getopt(argc, argv, "d:j:l:c:s:i:n:e:r:")))
+    {
+        switch(opt)
+        {
+        case 'd':
+            delay_us = strtoul(optarg, NULL, 0);
+            break;
+        case 'j':
+            jitter_us = strtoul(optarg, NULL, 0);
+            break;
+        case 'l':
+            drop_ppm = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            corrupt_ppm = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            interval_s = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            max_requests = strtoul(optarg, NULL, 0);
+            break;
+        case 'e':
+            protocol_server_register(&server, parse_command(optarg, &end, argv[0]),
+                                     echo_handler, NULL);
+            configured = true;
+            break;
+        case 'r':
+        {
+            const uint8_t command = parse_command(optarg, &end, argv[0]);
+            if(':' != *end)
+            {
+                usage(argv[0]);
+            }
+            const unsigned long len = strtoul(end + 1, NULL, 0);
+            if(len > PROTOCOL_DATA_MAX_LENGTH)
+            {
+                usage(argv[0]);
+            }
+            protocol_server_register(&server, command, fixed_handler, (void *)len);
+            configured = true;
+            break;
+        }
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if(optind != argc || drop_ppm > PROTOCOL_SIM_PPM || corrupt_ppm > PROTOCOL_SIM_PPM)
+    {
+        usage(argv[0]);
+    }
+
+    if(!configured)
+    {
+        for(unsigned int command = 0; command != PROTOCOL_ERROR; ++command)
+        {
+            protocol_server_register(&server, command, echo_handler, NULL);
+        }
+    }
+
+    char name[PATH_MAX] = "";
+    const struct uart_port * port = uart_open_pty(name, sizeof(name));
+    printf("%s\n", name);
+    fflush(stdout);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    struct protocol_sim sim;
+    protocol_sim_init(&sim, port, &server, seed);
+    protocol_sim_set_delay_all(&sim, delay_us, jitter_us);
+    protocol_sim_set_faults(&sim, drop_ppm, corrupt_ppm);
+
+    struct time_elapsed_ms since_report = time_elapsed_ms_init();
+    while(!stop && (0 == max_requests || sim.counters.requests < max_requests))
+    {
+        (void)protocol_sim_poll(&sim, POLL_TIMEOUT_MS);
+        if(0 != interval_s && time_elapsed_ms(&since_report) >= interval_s * 1000u)
+        {
+            protocol_sim_report(&sim, stdout);
+            fflush(stdout);
+            since_report = time_elapsed_ms_init();
+        }
+    }
+
+    protocol_sim_report(&sim, stdout);
+    uart_close(port);
+    return 0;
+}
@@ -0,0 +1,166 @@
+/// @file
+/// @brief Forward data between two serial ports, or between a serial port
+/// and a pseudo-terminal (@see uart_bridge.h). Use it to let host programs
+/// share a device, to watch its traffic, or to keep some commands from
+/// reaching it.
+///
+/// usage: uart_bridge [-b baud] [-f] [-x cmd]... [-i s] port [port]
+///   -b        baud rate of the ports, default 115200
+///   -f        forward whole packets instead of bytes
+///   -x        drop packets with this command (implies -f)
+///   -i        seconds between traffic reports, default 0 (disabled)
+///
+/// With one port, the bridge creates a pseudo-terminal for the other end and
+/// prints its name on the first line of output. The bridge exits when a
+/// port hangs up, for example when a usb adapter is unplugged.
+#define _DEFAULT_SOURCE // for getopt
+#include "nuhal/uart_bridge.h"
+#include "nuhal/uart.h"
+#include "nuhal/uart_linux.h"
+#include "nuhal/time.h"
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/// @brief how often to check for a stop request while idle, in ms
+#define POLL_TIMEOUT_MS 100u
+
+/// @brief the most commands that can be dropped
+#define MAX_DROPPED 256u
+
+/// @brief set when the program is interrupted
+static volatile sig_atomic_t stop = 0;
+
+/// @brief stop at the next opportunity
+static void on_signal(int signal)
+{
+    (void)signal;
+    stop = 1;
+}
+
+/// @brief print the usage and exit
+static void usage(const char * name)
+{
+    fprintf(stderr, "usage: %s [-b baud] [-f] [-x cmd]... [-i s] port [port]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+/// @brief print the traffic in one direction
+static void report(const char * from, const char * to,
+                   const struct uart_bridge_counters * counters)
+{
+    printf("%s -> %s: %llu bytes, %llu packets, %llu filtered, %llu discarded\n",
+           from, to,
+           (unsigned long long)counters->bytes,
+           (unsigned long long)counters->packets,
+           (unsigned long long)counters->filtered,
+           (unsigned long long)counters->discarded);
+}
+
+int main(int argc, char * argv[])
+{
+    unsigned int baud = 115200;
+    enum uart_bridge_mode mode = UART_BRIDGE_RAW;
+    uint8_t dropped[MAX_DROPPED];
+    unsigned int num_dropped = 0;
+    unsigned long interval_s = 0;
+
+    int opt = 0;
+    while(-1 != (opt = getopt(argc, argv, "b:fx:i:")))
+    {
+        switch(opt)
+        {
+        case 'b':
+            baud = strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            mode = UART_BRIDGE_FRAME;
+            break;
+        case 'x':
+        {
+            char * end = NULL;
+            const unsigned long command = strtoul(optarg, &end, 0);
+            if(end == optarg || command > UINT8_MAX || num_dropped == MAX_DROPPED)
+            {
+                usage(argv[0]);
+            }
+            dropped[num_dropped++] = command;
+            mode = UART_BRIDGE_FRAME;
+            break;
+        }
+        case 'i':
+            interval_s = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if(optind + 1 != argc && optind + 2 != argc)
+    {
+        usage(argv[0]);
+    }
+
+    const char * name_a = argv[optind];
+    const struct uart_port * a = uart_open(name_a, baud, UART_FLOW_NONE, UART_PARITY_NONE);
+
+    char pty_name[PATH_MAX] = "";
+    const char * name_b = pty_name;
+    const struct uart_port * b = NULL;
+    if(optind + 2 == argc)
+    {
+        name_b = argv[optind + 1];
+        b = uart_open(name_b, baud, UART_FLOW_NONE, UART_PARITY_NONE);
+    }
+    else
+    {
+        b = uart_open_pty(pty_name, sizeof(pty_name));
+        printf("%s\n", pty_name);
+        fflush(stdout);
+    }
+
+    struct uart_bridge bridge;
+    uart_bridge_init(&bridge, a, b, mode);
+
+    // commands are dropped in both directions
+    for(unsigned int i = 0; i != num_dropped; ++i)
+    {
+        uart_bridge_filter(&bridge, true, dropped[i], false);
+        uart_bridge_filter(&bridge, false, dropped[i], false);
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    struct time_elapsed_ms since_report = time_elapsed_ms_init();
+    while(!stop && !bridge.closed)
+    {
+        (void)uart_bridge_poll(&bridge, POLL_TIMEOUT_MS);
+        if(0 != interval_s && time_elapsed_ms(&since_report) >= interval_s * 1000u)
+        {
+            const struct uart_bridge_counters ab = uart_bridge_counters(&bridge, true);
+            const struct uart_bridge_counters ba = uart_bridge_counters(&bridge, false);
+            report(name_a, name_b, &ab);
+            report(name_b, name_a, &ba);
+            fflush(stdout);
+            since_report = time_elapsed_ms_init();
+        }
+    }
+
+    if(bridge.closed)
+    {
+        fprintf(stderr, "a port hung up\n");
+    }
+
+    const struct uart_bridge_counters ab = uart_bridge_counters(&bridge, true);
+    const struct uart_bridge_counters ba = uart_bridge_counters(&bridge, false);
+    report(name_a, name_b, &ab);
+    report(name_b, name_a, &ba);
+
+    uart_bridge_close(&bridge);
+    uart_close(b);
+    uart_close(a);
+    return bridge.closed ? EXIT_FAILURE : 0;
+}
@@ -260,6 +260,23 @@ void uart_transmit_single_block(const struct uart_port * port, const uint8_t dat
     }
 }
 
+void uart_set_baud(const struct uart_port * port, uint32_t baud)
+{
+    if(!port)
+    {
+        error(FILE_LINE, "NULL ptr");
+    }
+
+    // keep the current data format and only change the baud rate
+    uint32_t old_baud = 0;
+    uint32_t config = 0;
+    UARTConfigGetExpClk(port->base, tiva_clock_hz(), &old_baud, &config);
+
+    // this waits for the transmitter to finish sending the current data
+    UARTConfigSetExpClk(port->base, tiva_clock_hz(), baud, config);
+    UARTFIFOEnable(port->base);
+}
+
 void uart_close(const struct uart_port * port)
 {
     if(!port)